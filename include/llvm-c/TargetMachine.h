@@ -27,6 +27,7 @@ extern "C" {
 #endif
 typedef struct LLVMOpaqueTargetMachine *LLVMTargetMachineRef;
 typedef struct LLVMTarget *LLVMTargetRef;
+typedef struct LLVMOpaqueCodeGenSession *LLVMCodeGenSessionRef;
 
 typedef enum {
     LLVMCodeGenLevelNone,
@@ -132,6 +133,23 @@ LLVMBool LLVMTargetMachineEmitToFile(LLVMTargetMachineRef T, LLVMModuleRef M,
 LLVMBool LLVMTargetMachineEmitToMemoryBuffer(LLVMTargetMachineRef T, LLVMModuleRef M,
   LLVMCodeGenFileType codegen, char** ErrorMessage, LLVMMemoryBufferRef *OutMemBuf);
 
+/*===-- Code generation sessions ------------------------------------------===*/
+
+/** Builds the code generation pipeline for \p T once so that it can be run
+  on many modules. See llvm::CodeGenSession. Returns NULL and sets
+  ErrorMessage if \p T cannot emit this kind of file. Use LLVMDisposeMessage
+  to dispose the message. */
+LLVMCodeGenSessionRef LLVMCreateCodeGenSession(LLVMTargetMachineRef T,
+  LLVMCodeGenFileType codegen, char **ErrorMessage);
+
+/** Compile \p M with the session's pipeline and return the result. The
+  buffer needs to be disposed with LLVMDisposeMemoryBuffer. */
+LLVMMemoryBufferRef LLVMCodeGenSessionEmitToMemoryBuffer(
+  LLVMCodeGenSessionRef S, LLVMModuleRef M);
+
+/** Dispose a session. The target machine must outlive it. */
+void LLVMDisposeCodeGenSession(LLVMCodeGenSessionRef S);
+
 /*===-- Triple ------------------------------------------------------------===*/
 /** Get a triple for the host machine as a string. The result needs to be
   disposed with LLVMDisposeMessage. */
@@ -40,7 +40,7 @@ typedef bool lto_bool_t;
  * @{
  */
 
-#define LTO_API_VERSION 5
+#define LTO_API_VERSION 6
 
 typedef enum {
     LTO_SYMBOL_ALIGNMENT_MASK              = 0x0000001F, /* log2 of alignment */
@@ -249,6 +249,18 @@ extern void
 lto_codegen_set_cpu(lto_code_gen_t cg, const char *cpu);
 
 
+/**
+ * Sets the number of threads to generate code on.  With more than one, the
+ * optimized module is split into that many partitions of similar size,
+ * keeping functions that share internal symbols together, and code for the
+ * partitions is generated concurrently.
+ *
+ * @since LTO_API_VERSION=6
+ */
+extern void
+lto_codegen_set_parallelism(lto_code_gen_t cg, unsigned parallelism);
+
+
 /**
  * Sets the location of the assembler tool to run. If not set, libLTO
  * will use gcc to invoke the assembler.
@@ -296,6 +308,20 @@ lto_codegen_compile(lto_code_gen_t cg, size_t* length);
 extern lto_bool_t
 lto_codegen_compile_to_file(lto_code_gen_t cg, const char** name);
 
+/**
+ * Generates code for all added modules into one native object file for each
+ * partition set by lto_codegen_set_parallelism().  The names of the files are
+ * written to names and their number to count.  The array is owned by the
+ * lto_code_gen_t and stays valid until lto_codegen_dispose() is called, or
+ * lto_codegen_compile_to_files() is called again.  The linker is responsible
+ * for removing the files.  Returns true on error.
+ *
+ * @since LTO_API_VERSION=6
+ */
+extern lto_bool_t
+lto_codegen_compile_to_files(lto_code_gen_t cg, const char*** names,
+                             unsigned int* count);
+
 
 /**
  * Sets options to help debug codegen bugs.
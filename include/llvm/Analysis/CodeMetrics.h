@@ -86,6 +86,9 @@ struct CodeMetrics {
 
   /// \brief Add information about a block to the current state.
   void analyzeBasicBlock(const BasicBlock *BB, const TargetTransformInfo &TTI);
+
+  /// \brief Add information about every block of a function.
+  void analyzeFunction(const Function *F, const TargetTransformInfo &TTI);
 };
 
 }
@@ -0,0 +1,70 @@
+//===- llvm/Analysis/DivergenceAnalysis.h - Divergence Analysis -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The divergence analysis determines which values and branches of a function
+// may differ between the threads (or SIMD lanes) that execute it together on
+// a target with branch divergence.  A value is divergent if it is data
+// dependent on a source of divergence named by the target, such as a thread
+// index, or if it is sync dependent on a divergent branch: a phi that merges
+// paths which different threads may have taken, or a value defined in a loop
+// and used after a divergent exit from it.
+//
+// Everything that is not divergent is uniform.  On targets without branch
+// divergence every value is uniform.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_DIVERGENCEANALYSIS_H
+#define LLVM_ANALYSIS_DIVERGENCEANALYSIS_H
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Pass.h"
+
+namespace llvm {
+
+class Value;
+
+class DivergenceAnalysis : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+
+  DivergenceAnalysis() : FunctionPass(ID) {
+    initializeDivergenceAnalysisPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+  virtual bool runOnFunction(Function &F);
+
+  virtual void releaseMemory() { DivergentValues.clear(); }
+
+  /// \brief Print the divergent arguments and instructions of the function,
+  /// with -analyze.
+  virtual void print(raw_ostream &OS, const Module *) const;
+
+  /// \brief Return true if \p V may differ between threads.  A conditional
+  /// terminator is divergent if its condition is.
+  bool isDivergent(const Value *V) const {
+    return DivergentValues.count(V);
+  }
+
+  /// \brief Return true if \p V is the same for all threads.
+  bool isUniform(const Value *V) const { return !isDivergent(V); }
+
+private:
+  const Function *F;
+
+  /// The divergent values, including the terminators that branch on a
+  /// divergent condition.
+  DenseSet<const Value *> DivergentValues;
+};
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,232 @@
+//===- llvm/Analysis/MemorySSA.h - Memory SSA -------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file exposes the MemorySSA analysis, which puts the memory state of a
+// function into a factored SSA form.  All of memory is treated as a single
+// variable: every instruction that may write it is a MemoryDef, every other
+// instruction that may read it is a MemoryUse, and a MemoryPhi merges the
+// states that reach a join block.  Each MemoryUse and MemoryDef names the
+// access that defines the state it sees, so walking up these chains replaces
+// the block-by-block backwards scans of MemoryDependenceAnalysis.
+//
+// The chains are built without consulting alias analysis.  The caching walker
+// (getClobberingMemoryAccess) uses it to skip the defs that do not touch a
+// given location, and remembers the answer for every access it walked past.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_ANALYSIS_MEMORYSSA_H
+#define LLVM_ANALYSIS_MEMORYSSA_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Pass.h"
+#include <vector>
+
+namespace llvm {
+
+class BasicBlock;
+class DominatorTree;
+class Instruction;
+
+/// MemoryAccess - The common base of the nodes of the memory SSA form.
+class MemoryAccess {
+public:
+  enum AccessKind { LiveOnEntryKind, UseKind, DefKind, PhiKind };
+
+  virtual ~MemoryAccess() {}
+
+  AccessKind getKind() const { return Kind; }
+
+  /// getBlock - The block the access is in.  The live-on-entry state belongs
+  /// to the entry block.
+  BasicBlock *getBlock() const { return Block; }
+
+  /// getID - A number for the defs and phis of a function, in program order.
+  /// Uses define nothing and have no number.
+  unsigned getID() const { return ID; }
+
+  /// The uses and defs that name this access as their defining access and
+  /// the phis that have it as an incoming value, so a walk can go down the
+  /// chains as well as up.  Each phi is listed once per incoming edge.
+  typedef SmallVectorImpl<MemoryAccess *>::const_iterator user_iterator;
+  user_iterator user_begin() const { return Users.begin(); }
+  user_iterator user_end() const { return Users.end(); }
+  bool user_empty() const { return Users.empty(); }
+
+  void print(raw_ostream &OS) const;
+  void dump() const;
+
+protected:
+  MemoryAccess(AccessKind K, BasicBlock *BB) : Kind(K), Block(BB), ID(0) {}
+
+private:
+  friend class MemorySSA;
+
+  AccessKind Kind;
+  BasicBlock *Block;
+  unsigned ID;
+  SmallVector<MemoryAccess *, 4> Users;
+};
+
+inline raw_ostream &operator<<(raw_ostream &OS, const MemoryAccess &MA) {
+  MA.print(OS);
+  return OS;
+}
+
+/// MemoryUseOrDef - An access made by an instruction.
+class MemoryUseOrDef : public MemoryAccess {
+public:
+  /// getMemoryInst - The instruction, or null once the instruction has been
+  /// removed with MemorySSA::removeMemoryAccess.
+  Instruction *getMemoryInst() const { return MemoryInst; }
+
+  /// getDefiningAccess - The def or phi that produced the memory state this
+  /// access sees, or the live-on-entry state.
+  MemoryAccess *getDefiningAccess() const { return DefiningAccess; }
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == UseKind || MA->getKind() == DefKind;
+  }
+
+protected:
+  MemoryUseOrDef(AccessKind K, Instruction *I, BasicBlock *BB)
+    : MemoryAccess(K, BB), MemoryInst(I), DefiningAccess(0) {}
+
+private:
+  friend class MemorySSA;
+
+  Instruction *MemoryInst;
+  MemoryAccess *DefiningAccess;
+};
+
+/// MemoryUse - An instruction that may read memory but does not write it.
+class MemoryUse : public MemoryUseOrDef {
+public:
+  MemoryUse(Instruction *I, BasicBlock *BB) : MemoryUseOrDef(UseKind, I, BB) {}
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == UseKind;
+  }
+};
+
+/// MemoryDef - An instruction that may write memory, which includes anything
+/// with ordering constraints such as fences and volatile loads.
+class MemoryDef : public MemoryUseOrDef {
+public:
+  MemoryDef(Instruction *I, BasicBlock *BB) : MemoryUseOrDef(DefKind, I, BB) {}
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == DefKind;
+  }
+};
+
+/// MemoryPhi - The merge of the memory states reaching a join block, with
+/// one incoming access per reachable predecessor.
+class MemoryPhi : public MemoryAccess {
+public:
+  explicit MemoryPhi(BasicBlock *BB) : MemoryAccess(PhiKind, BB) {}
+
+  unsigned getNumIncomingValues() const { return Incoming.size(); }
+  MemoryAccess *getIncomingValue(unsigned i) const {
+    return Incoming[i].second;
+  }
+  BasicBlock *getIncomingBlock(unsigned i) const { return Incoming[i].first; }
+
+  static bool classof(const MemoryAccess *MA) {
+    return MA->getKind() == PhiKind;
+  }
+
+private:
+  friend class MemorySSA;
+
+  SmallVector<std::pair<BasicBlock *, MemoryAccess *>, 4> Incoming;
+};
+
+class MemorySSA : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+
+  MemorySSA();
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+  virtual bool runOnFunction(Function &F);
+
+  virtual void releaseMemory();
+
+  /// \brief Print the function with each memory access written as a comment
+  /// above its instruction or at the start of its block, with -analyze.
+  virtual void print(raw_ostream &OS, const Module *) const;
+
+  /// \brief Return the access of \p I, or null if \p I does not touch memory
+  /// or is unreachable.
+  MemoryUseOrDef *getMemoryAccess(const Instruction *I) const;
+
+  /// \brief Return the phi at the start of \p BB, if there is one.
+  MemoryPhi *getMemoryAccess(const BasicBlock *BB) const;
+
+  MemoryAccess *getLiveOnEntryDef() const { return LiveOnEntryDef; }
+  bool isLiveOnEntryDef(const MemoryAccess *MA) const {
+    return MA == LiveOnEntryDef;
+  }
+
+  /// \brief Return the nearest access above \p I that may write the location
+  /// \p I reads or writes: a def, a phi of states that differ for that
+  /// location, or the live-on-entry state.  For an instruction without a
+  /// single location, such as a call, this is its defining access.  Returns
+  /// null if \p I has no access.
+  MemoryAccess *getClobberingMemoryAccess(const Instruction *I);
+
+  /// \brief Return the nearest access at or above \p Start that may write
+  /// \p Loc.
+  MemoryAccess *getClobberingMemoryAccess(MemoryAccess *Start,
+                                          const AliasAnalysis::Location &Loc);
+
+  /// \brief Forget the access of \p I, which is about to be erased.  A use
+  /// is dropped from the users of its defining access.  A def stays in the
+  /// chains of the accesses below it but no longer clobbers anything.
+  void removeMemoryAccess(const Instruction *I);
+
+private:
+  typedef std::pair<const MemoryAccess *, AliasAnalysis::Location> WalkKey;
+
+  void placePhis(SmallPtrSet<BasicBlock *, 32> &DefBlocks);
+  void renameAccesses();
+  MemoryAccess *walkToClobber(MemoryAccess *MA,
+                              const AliasAnalysis::Location &Loc,
+                              unsigned &MinDepth);
+  MemoryAccess *resolvePhi(MemoryPhi *Phi, const AliasAnalysis::Location &Loc,
+                           unsigned &MinDepth);
+
+  Function *F;
+  AliasAnalysis *AA;
+  DominatorTree *DT;
+
+  MemoryAccess *LiveOnEntryDef;
+
+  /// The access of each instruction, and the phi of each block that has one.
+  DenseMap<const Value *, MemoryAccess *> ValueToMemoryAccess;
+
+  /// Every access created for this function, removed ones included.
+  std::vector<MemoryAccess *> Accesses;
+
+  /// The clobber of a location seen from a def or phi, filled in by the
+  /// walker for every access it settles.
+  DenseMap<WalkKey, MemoryAccess *> ClobberCache;
+
+  /// The phis the walker is currently resolving, with their nesting depth.
+  DenseMap<const MemoryPhi *, unsigned> PhisInProgress;
+};
+
+} // End llvm namespace
+
+#endif
@@ -141,6 +141,14 @@ namespace llvm {
   //
   FunctionPass *createDelinearizationPass();
 
+  //===--------------------------------------------------------------------===//
+  //
+  // createDivergenceAnalysisPass - This pass determines which values and
+  // branches may differ between the threads of a target with branch
+  // divergence.
+  //
+  FunctionPass *createDivergenceAnalysisPass();
+
   //===--------------------------------------------------------------------===//
   //
   // Minor pass prototypes, allowing us to expose them through bugpoint and
@@ -163,6 +171,13 @@ namespace llvm {
   // information and prints it with -analyze.
   //
   FunctionPass *createMemDepPrinter();
+
+  //===--------------------------------------------------------------------===//
+  //
+  // createMemorySSAPass - This pass builds the memory SSA form of a function
+  // and prints it with -analyze.
+  //
+  FunctionPass *createMemorySSAPass();
 }
 
 #endif
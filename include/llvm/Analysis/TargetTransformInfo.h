@@ -178,6 +178,13 @@ public:
   /// branches.
   virtual bool hasBranchDivergence() const;
 
+  /// \brief Return true if the value of \p V may differ between the threads
+  /// that execute the same instruction together, such as a thread index or
+  /// a load from memory private to each thread.  DivergenceAnalysis starts
+  /// from these values; it is only consulted when hasBranchDivergence()
+  /// returns true.
+  virtual bool isSourceOfDivergence(const Value *V) const;
+
   /// \brief Test whether calls to a function lower to actual program function
   /// calls.
   ///
@@ -222,6 +229,12 @@ public:
   /// target-independent defaults.
   virtual void getUnrollingPreferences(Loop *L, UnrollingPreferences &UP) const;
 
+  /// \brief Return the size, counted like CodeMetrics::NumInsts, past which a
+  /// function no longer fits the target's instruction memory, or zero if
+  /// there is no such limit.  The inliner and the loop unroller do not grow a
+  /// function beyond it.
+  virtual unsigned getCodeSizeBudget() const;
+
   /// @}
 
   /// \name Scalar Target Information
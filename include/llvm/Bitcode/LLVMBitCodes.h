@@ -42,7 +42,9 @@ namespace bitc {
 
     TYPE_BLOCK_ID_NEW,
 
-    USELIST_BLOCK_ID
+    USELIST_BLOCK_ID,
+
+    FUNCTION_INDEX_BLOCK_ID
   };
 
 
@@ -332,6 +334,13 @@ namespace bitc {
     USELIST_CODE_ENTRY = 1   // USELIST_CODE_ENTRY: TBD.
   };
 
+  /// The function index block gives the position of each function body, in
+  /// the order of the function records, as a little endian 32-bit offset in
+  /// words from the start of the block's contents.
+  enum FunctionIndexCodes {
+    FUNCTION_INDEX_CODE_OFFSETS = 1  // OFFSETS: [blob of 32-bit offsets]
+  };
+
   enum AttributeKindCodes {
     // = 0 is unused
     ATTR_KIND_ALIGNMENT = 1,
@@ -72,7 +72,7 @@ private:
   bool ScannedRemattable;
 
   /// Remattable - Values defined by remattable instructions as identified by
-  /// tii.isTriviallyReMaterializable().
+  /// tii.isTriviallyReMaterializable() or tii.isReMaterializableWithLiveUses().
   SmallPtrSet<const VNInfo*,4> Remattable;
 
   /// Rematted - Values that were actually rematted, and so need to have their
@@ -88,6 +88,7 @@ extern cl::opt<bool> ForceBottomUp;
 
 class AliasAnalysis;
 class LiveIntervals;
+class MachineBlockFrequencyInfo;
 class MachineDominatorTree;
 class MachineLoopInfo;
 class RegisterClassInfo;
@@ -100,6 +101,9 @@ struct MachineSchedContext {
   MachineFunction *MF;
   const MachineLoopInfo *MLI;
   const MachineDominatorTree *MDT;
+  /// Null unless the target computes block frequencies right before the
+  /// scheduler, by inserting MachineBlockFrequencyInfo after the coalescer.
+  const MachineBlockFrequencyInfo *MBFI;
   const TargetPassConfig *PassConfig;
   AliasAnalysis *AA;
   LiveIntervals *LIS;
@@ -470,6 +474,13 @@ protected:
   void releasePredecessors(SUnit *SU);
 };
 
+/// Create the strategy of the standard converging scheduler.  A target that
+/// picks a strategy per scheduling region can use it for some of them.
+MachineSchedStrategy *createGenericSchedStrategy(MachineSchedContext *C);
+
+/// Add the DAG mutations the standard converging scheduler relies on.
+void addGenericSchedMutations(ScheduleDAGMI *DAG);
+
 } // namespace llvm
 
 #endif
@@ -0,0 +1,51 @@
+//===-- llvm/CodeGen/ParallelCG.h - Parallel code generation ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares splitCodeGen, which generates code for the partitions
+// of a module on several threads.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_PARALLELCG_H
+#define LLVM_CODEGEN_PARALLELCG_H
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class Module;
+class raw_ostream;
+
+/// PartitionCompiler - Generates code for one partition of a module on
+/// behalf of splitCodeGen.  It is called from several threads at once, each
+/// with a module in an LLVMContext of its own, so it must create whatever
+/// TargetMachine and passes it needs for each call.
+class PartitionCompiler {
+public:
+  virtual ~PartitionCompiler();
+
+  /// compile - Generate code for \p M and write it to \p OS.  Returns true
+  /// and sets \p ErrMsg on failure.
+  virtual bool compile(Module &M, raw_ostream &OS, std::string &ErrMsg) = 0;
+};
+
+/// splitCodeGen - Split \p M into \p NumPartitions pieces with
+/// extractModulePartition and generate code for them with \p PC on up to
+/// \p NumPartitions threads.  The code for partition N ends up in
+/// Outputs[N], so the result does not depend on how the threads were
+/// scheduled.  \p M itself is not modified.  Returns true and sets \p ErrMsg
+/// to the error of the first failing partition on failure.
+bool splitCodeGen(const Module &M, unsigned NumPartitions,
+                  PartitionCompiler &PC, std::vector<std::string> &Outputs,
+                  std::string &ErrMsg);
+
+} // End llvm namespace
+
+#endif
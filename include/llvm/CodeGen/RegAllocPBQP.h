@@ -8,8 +8,9 @@
 //===----------------------------------------------------------------------===//
 //
 // This file defines the PBQPBuilder interface, for classes which build PBQP
-// instances to represent register allocation problems, and the RegAllocPBQP
-// interface.
+// instances to represent register allocation problems, the PBQPRAConstraint
+// interface, through which targets add their own costs to those instances,
+// and the RegAllocPBQP interface.
 //
 //===----------------------------------------------------------------------===//
 
@@ -69,6 +70,18 @@ namespace llvm {
     /// Get the PBQP node corresponding to the given virtual register.
     PBQP::Graph::NodeId getNodeForVReg(unsigned vreg) const;
 
+    /// Returns true if the given virtual register has a PBQP node.  Vregs
+    /// with empty live intervals are allocated without one.
+    bool hasNodeForVReg(unsigned vreg) const {
+      return vreg2Node.count(vreg);
+    }
+
+    /// Add costs to the edge between the nodes of the two virtual registers,
+    /// creating it if there is none.  The rows of costs are the options of
+    /// vreg1, the columns those of vreg2.
+    void addEdgeCosts(unsigned vreg1, unsigned vreg2,
+                      const PBQP::Matrix &costs);
+
     /// Returns true if the given PBQP option represents a physical register,
     /// false otherwise.
     bool isPRegOption(unsigned vreg, unsigned option) const {
@@ -157,6 +170,23 @@ namespace llvm {
                             PBQP::PBQPNum benefit);
   };
 
+  /// Adds target specific costs to a PBQP instance once the builder has
+  /// added spill, interference and coalescing costs. Targets return one from
+  /// TargetSubtargetInfo::getCustomPBQPConstraints to model register file
+  /// restrictions that register classes cannot express.
+  class PBQPRAConstraint {
+  public:
+    virtual ~PBQPRAConstraint();
+
+    /// Add costs for the given MachineFunction to the problem.
+    virtual void apply(PBQPRAProblem &problem, MachineFunction &mf,
+                       const LiveIntervals &lis,
+                       const MachineBlockFrequencyInfo &mbfi) = 0;
+
+  private:
+    virtual void anchor();
+  };
+
   FunctionPass* createPBQPRegisterAllocator(OwningPtr<PBQPBuilder> &builder,
                                             char *customPassID=0);
 }
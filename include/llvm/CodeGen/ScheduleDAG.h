@@ -416,12 +416,12 @@ namespace llvm {
 
     /// setDepthToAtLeast - If NewDepth is greater than this node's
     /// depth value, set it to be the new depth value. This also
-    /// recursively marks successor nodes dirty.
+    /// raises the depth of successor nodes that depend on it.
     void setDepthToAtLeast(unsigned NewDepth);
 
-    /// setDepthToAtLeast - If NewDepth is greater than this node's
-    /// depth value, set it to be the new height value. This also
-    /// recursively marks predecessor nodes dirty.
+    /// setHeightToAtLeast - If NewHeight is greater than this node's
+    /// height value, set it to be the new height value. This also
+    /// raises the height of predecessor nodes that depend on it.
     void setHeightToAtLeast(unsigned NewHeight);
 
     /// setDepthDirty - Set a flag in this node to indicate that its
@@ -0,0 +1,82 @@
+//===-- FileObjectCache.h - On-disk ObjectCache -------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares FileObjectCache, an ObjectCache that keeps compiled
+// objects in a directory so that they survive the process.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+#define LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include <string>
+
+namespace llvm {
+
+class TargetMachine;
+
+/// FileObjectCache - An ObjectCache that stores each object in its own file
+/// under a cache directory.
+///
+/// Objects are keyed by the MD5 of the module's bitcode together with a
+/// target key that describes how the code was generated, so the module
+/// identifier plays no part and two modules with the same contents share an
+/// entry.  Files are written through FileOutputBuffer, which renames them
+/// into place, so a reader never sees a partial object even when several
+/// processes share the directory.  Hits are returned as file-backed
+/// MemoryBuffers, which are mmap'd when large enough.
+///
+/// When a size limit is set, the least recently used objects are removed
+/// after each store until the cache fits.  A hit counts as a use.  File times
+/// only have a resolution of a second, so uses within the same second are
+/// ordered by when this cache saw them, and objects it never used by name.
+class FileObjectCache : public ObjectCache {
+  std::string CacheDir;
+  std::string TargetKey;
+  uint64_t MaxSize;
+
+  /// Keys computed by getObject for modules that missed.  MCJIT runs the
+  /// codegen passes, which may change the IR, between getObject and
+  /// notifyObjectCompiled, so the key has to be taken before that.
+  DenseMap<const Module *, std::string> PendingKeys;
+
+  /// The order in which this cache last stored or hit each object file.
+  StringMap<uint64_t> UseOrder;
+  uint64_t UseCount;
+
+  std::string getKey(const Module *M) const;
+  std::string getObjectPath(StringRef Key) const;
+  void prune();
+
+public:
+  /// FileObjectCache - Create a cache in the directory \p Dir, which is
+  /// created if it does not exist.  \p TargetKey must distinguish every
+  /// code generation setting that varies between the users of \p Dir;
+  /// getTargetKey provides one for a TargetMachine.  A \p MaxSize of zero
+  /// means no limit.
+  FileObjectCache(StringRef Dir, StringRef TargetKey, uint64_t MaxSize = 0);
+
+  virtual void notifyObjectCompiled(const Module *M, const MemoryBuffer *Obj);
+  virtual MemoryBuffer *getObject(const Module *M);
+
+  /// getTargetKey - Return a string describing the triple, CPU, features,
+  /// relocation and code models, optimization level and target options of
+  /// \p TM.
+  static std::string getTargetKey(const TargetMachine &TM);
+
+  StringRef getCacheDir() const { return CacheDir; }
+  uint64_t getMaxSize() const { return MaxSize; }
+};
+
+} // End llvm namespace
+
+#endif
@@ -49,6 +49,7 @@ namespace llvm {
   class GlobalValue;
   class Mangler;
   class MemoryBuffer;
+  class Target;
   class TargetLibraryInfo;
   class TargetMachine;
   class raw_ostream;
@@ -73,6 +74,12 @@ struct LTOCodeGenerator {
 
   void setCpu(const char *mCpu) { MCpu = mCpu; }
 
+  // Generate code for the merged module on up to N threads. The optimized
+  // module is split into N partitions of roughly equal size, keeping
+  // functions that share internal symbols together. The default of 1
+  // generates code for the whole module on the calling thread.
+  void setParallelism(unsigned N) { Parallelism = N ? N : 1; }
+
   void addMustPreserveSymbol(const char *sym) { MustPreserveSymbols[sym] = 1; }
 
   // To pass options to the driver and optimization passes. These options are
@@ -95,6 +102,10 @@ struct LTOCodeGenerator {
   // file is returned to the caller via argument "name". Return true on
   // success.
   //
+  // When the parallelism is greater than 1 and the target uses ELF, the
+  // objects generated for each partition are combined into this one file.
+  // Other object formats fall back to serial code generation.
+  //
   // NOTE that it is up to the linker to remove the intermediate object file.
   //  Do not try to remove the object file in LTOCodeGenerator's destructor
   //  as we don't who (LTOCodeGenerator or the obj file) will last longer.
@@ -117,14 +128,31 @@ struct LTOCodeGenerator {
                       bool disableGVNLoadPRE,
                       std::string &errMsg);
 
+  // Compile the merged module into one object file per partition (see
+  // setParallelism()), generating code for the partitions concurrently. The
+  // paths to the object files are returned to the caller via arguments
+  // "names" and "count", and stay valid until the next call. Return true on
+  // success.
+  //
+  // As with compile_to_file(), it is up to the linker to remove the files.
+  //
+  bool compile_to_files(const char ***names,
+                        unsigned *count,
+                        bool disableOpt,
+                        bool disableInline,
+                        bool disableGVNLoadPRE,
+                        std::string &errMsg);
+
 private:
   void initializeLTOPasses();
 
-  bool generateObjectFile(llvm::raw_ostream &out,
-                          bool disableOpt,
-                          bool disableInline,
-                          bool disableGVNLoadPRE,
-                          std::string &errMsg);
+  bool optimize(bool disableOpt,
+                bool disableInline,
+                bool disableGVNLoadPRE,
+                std::string &errMsg);
+  bool generateObjectFile(llvm::raw_ostream &out, std::string &errMsg);
+  bool generateObjectFiles(std::vector<std::string> &objects,
+                           std::string &errMsg);
   void applyScopeRestrictions();
   void applyRestriction(llvm::GlobalValue &GV,
                         const llvm::ArrayRef<llvm::StringRef> &Libcalls,
@@ -137,16 +165,20 @@ private:
 
   llvm::LLVMContext &Context;
   llvm::Linker Linker;
+  const llvm::Target *MArch;
   llvm::TargetMachine *TargetMach;
   bool EmitDwarfDebugInfo;
   bool ScopeRestrictionsDone;
   lto_codegen_model CodeModel;
+  unsigned Parallelism;
   StringSet MustPreserveSymbols;
   StringSet AsmUndefinedRefs;
   llvm::MemoryBuffer *NativeObjectFile;
   std::vector<char *> CodegenOptions;
   std::string MCpu;
   std::string NativeObjectPath;
+  std::vector<std::string> NativeObjectPaths;
+  std::vector<const char *> NativeObjectNames;
   llvm::TargetOptions Options;
 };
 
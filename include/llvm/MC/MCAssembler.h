@@ -921,9 +921,16 @@ private:
   /// were adjusted.
   bool layoutOnce(MCAsmLayout &Layout);
 
-  /// \brief Perform one layout iteration of the given section and return true
-  /// if any offsets were adjusted.
-  bool layoutSectionOnce(MCAsmLayout &Layout, MCSectionData &SD);
+  /// \brief Relax the fragments of the given section and return true if any
+  /// offsets were adjusted.
+  ///
+  /// After a fragment is relaxed, only the fragments whose fixups span it are
+  /// checked again, instead of every fragment in the section.
+  bool layoutSection(MCAsmLayout &Layout, MCSectionData &SD);
+
+  /// \brief Relax the given fragment if it needs it, and return true if its
+  /// size changed.
+  bool relaxFragment(MCAsmLayout &Layout, MCFragment &F);
 
   bool relaxInstruction(MCAsmLayout &Layout, MCRelaxableFragment &IF);
 
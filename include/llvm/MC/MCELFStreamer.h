@@ -42,6 +42,14 @@ public:
 
   virtual ~MCELFStreamer();
 
+  /// state management
+  virtual void reset() {
+    SeenIdent = false;
+    LocalCommons.clear();
+    BindingExplicitlySet.clear();
+    MCObjectStreamer::reset();
+  }
+
   /// @name MCStreamer Interface
   /// @{
 
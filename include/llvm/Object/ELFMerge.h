@@ -0,0 +1,43 @@
+//===- ELFMerge.h - Combine relocatable ELF objects -------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares mergeELFObjects, which combines relocatable ELF objects
+// that were generated from pieces of one module into a single object.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_OBJECT_ELFMERGE_H
+#define LLVM_OBJECT_ELFMERGE_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/system_error.h"
+
+namespace llvm {
+
+class raw_ostream;
+
+namespace object {
+
+/// mergeELFObjects - Write to \p OS a relocatable ELF object holding the
+/// sections and symbols of all of \p Objects, in order.
+///
+/// This is a partial link without any section merging: every section of
+/// every input keeps its own section header, so that section symbols and
+/// relocations carry over unchanged apart from their indices.  Global
+/// symbols with the same name are combined, a definition taking the place
+/// of undefined references and the most restrictive visibility winning.
+/// The inputs must have the same class, byte order and machine, and must
+/// not define the same strong global twice.
+error_code mergeELFObjects(ArrayRef<StringRef> Objects, raw_ostream &OS);
+
+} // end namespace object
+} // end namespace llvm
+
+#endif
@@ -7,7 +7,8 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// Utility for creating a in-memory buffer that will be written to a file.
+// Utility for creating a in-memory buffer that will be written to a file, and
+// a raw_ostream that writes through one.
 //
 //===----------------------------------------------------------------------===//
 
@@ -16,9 +17,11 @@
 
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace llvm {
 class error_code;
@@ -87,6 +90,43 @@ private:
   SmallString<128>    FinalPath;
   SmallString<128>    TempPath;
 };
+
+/// raw_mmap_ostream - A raw_ostream that writes to a file through a
+/// FileOutputBuffer, so that the stream buffer is flushed into a mapping of
+/// the file instead of through write() calls.
+///
+/// The file can only be mapped once its size is known: writers that know the
+/// size of their output call reserveExtraSpace before writing it. Output
+/// written without, or in excess of, a reservation is kept in memory instead,
+/// and written out by commit(). Like a FileOutputBuffer, nothing appears at
+/// the path until commit() is called.
+class raw_mmap_ostream : public raw_ostream {
+  SmallString<128> Path;
+
+  /// Buffer - The mapped output file, if space has been reserved.
+  OwningPtr<FileOutputBuffer> Buffer;
+
+  /// Pending - The output written while there was no room in Buffer.
+  SmallVector<char, 0> Pending;
+
+  /// Pos - The number of bytes written so far.
+  uint64_t Pos;
+
+  virtual void write_impl(const char *Ptr, size_t Size) LLVM_OVERRIDE;
+  virtual uint64_t current_pos() const LLVM_OVERRIDE { return Pos; }
+
+public:
+  explicit raw_mmap_ostream(StringRef Path);
+  ~raw_mmap_ostream();
+
+  /// reserveExtraSpace - Map the output file, with room for \p ExtraSize
+  /// more bytes than have been written so far.
+  virtual void reserveExtraSpace(uint64_t ExtraSize) LLVM_OVERRIDE;
+
+  /// commit - Write the output to the file at the path given to the
+  /// constructor. Nothing may be written to the stream afterwards.
+  error_code commit();
+};
 } // end namespace llvm
 
 #endif
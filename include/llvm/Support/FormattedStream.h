@@ -151,6 +151,10 @@ public:
     return TheStream->is_displayed();
   }
 
+  virtual void reserveExtraSpace(uint64_t ExtraSize) LLVM_OVERRIDE {
+    TheStream->reserveExtraSpace(GetNumBytesInBuffer() + ExtraSize);
+  }
+
 private:
   void releaseStream() {
     // Delete the stream if needed. Otherwise, transfer the buffer
@@ -54,6 +54,18 @@ namespace llvm {
   /// the thread stack.
   void llvm_execute_on_thread(void (*UserFn)(void*), void *UserData,
                               unsigned RequestedStackSize = 0);
+
+  /// llvm_execute_in_parallel - Call \p UserFn once for each of the \p Count
+  /// entries of \p UserData, running up to \p NumThreads calls at a time, and
+  /// return when all of them have finished.
+  ///
+  /// Entries are handed out in order to whichever thread is free first, so
+  /// the callback must not depend on which thread runs it.  Where threads
+  /// are not available the calls are made in order on the calling thread.
+  /// Concurrent calls into LLVM are only safe after llvm_start_multithreaded
+  /// and with a separate LLVMContext for each thread.
+  void llvm_execute_in_parallel(void (*UserFn)(void*), void *const *UserData,
+                                unsigned Count, unsigned NumThreads);
 }
 
 #endif
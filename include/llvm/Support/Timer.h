@@ -153,6 +153,31 @@ struct NamedRegionTimer : public TimeRegion {
 };
 
 
+/// isTimeTraceEnabled - Whether -time-trace-file names a file to write the
+/// timeline to.  The pass managers then time passes as if -time-passes had
+/// been given.
+bool isTimeTraceEnabled();
+
+/// TimeTraceContext - Names what the current thread is working on, such as the
+/// function the running pass was given, for the timeline written with
+/// -time-trace-file.  Each timer started while the object is alive records the
+/// name of the innermost context of its thread with its begin event.  The
+/// object does nothing if no trace is being recorded.
+///
+class TimeTraceContext {
+  std::string Detail;
+  const TimeTraceContext *Prev;
+  bool Active;
+  TimeTraceContext(const TimeTraceContext &) LLVM_DELETED_FUNCTION;
+  void operator=(const TimeTraceContext &) LLVM_DELETED_FUNCTION;
+public:
+  explicit TimeTraceContext(StringRef Detail);
+  ~TimeTraceContext();
+
+  const std::string &getDetail() const { return Detail; }
+};
+
+
 /// The TimerGroup class is used to group together related timers into a single
 /// report that is printed when the TimerGroup is destroyed.  It is illegal to
 /// destroy a TimerGroup object before all of the Timers in it are gone.  A
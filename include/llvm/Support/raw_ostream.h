@@ -122,6 +122,11 @@ public:
     return OutBufCur - OutBufStart;
   }
 
+  /// reserveExtraSpace - Tell the stream that \p ExtraSize more bytes are
+  /// about to be written to it, so that it can allocate room for all of them
+  /// at once. This is only a hint, and most streams ignore it.
+  virtual void reserveExtraSpace(uint64_t ExtraSize) {}
+
   //===--------------------------------------------------------------------===//
   // Data Output Interface
   //===--------------------------------------------------------------------===//
@@ -469,6 +474,9 @@ public:
   /// if the raw_svector_ostream has previously been flushed.
   void resync();
 
+  /// reserveExtraSpace - Grow the vector to hold \p ExtraSize more bytes.
+  virtual void reserveExtraSpace(uint64_t ExtraSize) LLVM_OVERRIDE;
+
   /// str - Flushes the stream contents to the target vector and return a
   /// StringRef for the vector contents.
   StringRef str();
@@ -0,0 +1,69 @@
+//===-- llvm/Target/CodeGenSession.h - Reusable codegen pipeline -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares CodeGenSession, which builds the code generation
+// pipeline for a TargetMachine once and then runs it on any number of
+// modules, returning the emitted code in memory.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TARGET_CODEGENSESSION_H
+#define LLVM_TARGET_CODEGENSESSION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/PassManager.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <string>
+
+namespace llvm {
+
+class Module;
+
+/// CodeGenSession - A code generation pipeline that is kept alive between
+/// modules.
+///
+/// Setting up the passes, the MCContext and the object streamer is a large
+/// part of the cost of compiling a small module.  A session does that once
+/// and then relies on the passes resetting their per-module state in
+/// doFinalization, so the MCContext allocator and the output buffer keep
+/// their memory from one module to the next.
+///
+/// A session is not thread safe; use one per thread.
+class CodeGenSession {
+  TargetMachine &TM;
+  std::string Output;
+  raw_string_ostream OutputOS;
+  formatted_raw_ostream FormattedOS;
+  // Declared last so that the streamer inside it goes before FormattedOS.
+  PassManager PM;
+
+  explicit CodeGenSession(TargetMachine &TM);
+
+  CodeGenSession(const CodeGenSession &) LLVM_DELETED_FUNCTION;
+  void operator=(const CodeGenSession &) LLVM_DELETED_FUNCTION;
+
+public:
+  /// create - Build the pipeline that emits \p FileType for \p TM.  Returns
+  /// null and sets \p ErrMsg if the target cannot emit that kind of file.
+  static CodeGenSession *create(TargetMachine &TM,
+                                TargetMachine::CodeGenFileType FileType,
+                                std::string &ErrMsg);
+
+  /// emit - Generate code for \p M.  The returned bytes belong to the
+  /// session and stay valid until the next call to emit.
+  StringRef emit(Module &M);
+
+  TargetMachine &getTargetMachine() const { return TM; }
+};
+
+} // End llvm namespace
+
+#endif
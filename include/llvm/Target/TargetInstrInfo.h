@@ -73,6 +73,16 @@ public:
              isReallyTriviallyReMaterializableGeneric(MI, AA)));
   }
 
+  /// isReMaterializableWithLiveUses - Return true if the instruction is not
+  /// trivially rematerializable but can be recomputed wherever the virtual
+  /// registers it reads still hold the values they had at the original def.
+  /// Callers must check that, as LiveRangeEdit does, so this must not be used
+  /// in place of isTriviallyReMaterializable.
+  virtual bool isReMaterializableWithLiveUses(const MachineInstr *MI,
+                                              AliasAnalysis *AA) const {
+    return false;
+  }
+
 protected:
   /// isReallyTriviallyReMaterializable - For instructions with opcodes for
   /// which the M_REMATERIALIZABLE flag is set, this hook lets the target
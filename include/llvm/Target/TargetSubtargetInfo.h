@@ -21,6 +21,7 @@ namespace llvm {
 
 class MachineFunction;
 class MachineInstr;
+class PBQPRAConstraint;
 class SDep;
 class SUnit;
 class TargetRegisterClass;
@@ -93,6 +94,11 @@ public:
   /// scheduling, DAGCombine, etc.).
   virtual bool useAA() const;
 
+  /// \brief Return the target specific costs the PBQP register allocator
+  /// adds to every problem it builds, or null for none. The caller takes
+  /// ownership.
+  virtual PBQPRAConstraint *getCustomPBQPConstraints() const { return 0; }
+
   /// \brief Reset the features for the subtarget.
   virtual void resetSubtargetFeatures(const MachineFunction *MF) { }
 };
@@ -148,6 +148,12 @@ ModulePass *createIPConstantPropagationPass();
 ///
 ModulePass *createIPSCCPPass();
 
+//===----------------------------------------------------------------------===//
+/// createKernelSpecializationPass - This pass clones functions for the
+/// distinct constant arguments their call sites pass, when that pays off.
+///
+ModulePass *createKernelSpecializationPass();
+
 //===----------------------------------------------------------------------===//
 //
 /// createLoopExtractorPass - This pass extracts all natural loops from the
@@ -218,7 +218,10 @@ FunctionPass *createFlattenCFGPass();
 //
 // CFG Structurization - Remove irreducible control flow
 //
-Pass *createStructurizeCFGPass();
+// When SkipUniformRegions is true, regions whose branches are all uniform
+// according to the DivergenceAnalysis are left as they are.
+//
+Pass *createStructurizeCFGPass(bool SkipUniformRegions = false);
 
 //===----------------------------------------------------------------------===//
 //
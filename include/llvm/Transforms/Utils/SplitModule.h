@@ -0,0 +1,45 @@
+//===-- SplitModule.h - Split a module into partitions ----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares extractModulePartition, which reduces a module to one of
+// several partitions that can be code generated independently.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
+#define LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
+
+namespace llvm {
+
+class Module;
+
+/// extractModulePartition - Reduce \p M to partition \p Partition of
+/// \p NumPartitions.
+///
+/// Every definition in the module belongs to exactly one partition and is
+/// turned into a declaration in the others, so code generated for all the
+/// partitions together defines the same symbols as code generated for the
+/// whole module.  Definitions that cannot be referenced from another object
+/// file stay in the same partition as their users: local symbols, appending
+/// arrays such as llvm.global_ctors, thread local variables, functions whose
+/// block addresses are taken and the targets of aliases.
+/// Local constants with unnamed_addr that refer to no other global are
+/// instead copied into every partition that uses them.  Module level inline
+/// asm goes to partition 0.
+///
+/// Partitions are balanced by instruction count.  The assignment depends
+/// only on the contents and order of the module, so separate copies of a
+/// module, such as ones read from the same bitcode into different contexts,
+/// can each be reduced to a different partition.
+void extractModulePartition(Module &M, unsigned Partition,
+                            unsigned NumPartitions);
+
+} // End llvm namespace
+
+#endif
@@ -122,6 +122,15 @@ Pass *createLoopVectorizePass(bool NoUnrolling = false);
 //
 Pass *createSLPVectorizerPass();
 
+//===----------------------------------------------------------------------===//
+//
+// SPMDVectorizer - Create a pass that rewrites single work-item kernels to run
+// Width work items side by side, one per vector lane.  A Width of zero means
+// the value of -spmd-width.  If IdName is given, calls to it are the only
+// work-item id queries; otherwise those named by -spmd-id-function are.
+//
+Pass *createSPMDVectorizerPass(unsigned Width = 0, const char *IdName = 0);
+
 //===----------------------------------------------------------------------===//
 /// @brief Vectorize the BasicBlock.
 ///
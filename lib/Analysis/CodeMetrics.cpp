@@ -94,3 +94,11 @@ void CodeMetrics::analyzeBasicBlock(const BasicBlock *BB,
   // Remember NumInsts for this BB.
   NumBBInsts[BB] = NumInsts - NumInstsBeforeThisBB;
 }
+
+/// analyzeFunction - Fill in the current structure with information gleaned
+/// from every block of the specified function.
+void CodeMetrics::analyzeFunction(const Function *F,
+                                  const TargetTransformInfo &TTI) {
+  for (Function::const_iterator BB = F->begin(), E = F->end(); BB != E; ++BB)
+    analyzeBasicBlock(BB, TTI);
+}
@@ -0,0 +1,282 @@
+//===- DivergenceAnalysis.cpp - Divergence Analysis Implementation --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the divergence analysis.  The target names the
+// sources of divergence through TargetTransformInfo::isSourceOfDivergence,
+// and the analysis propagates divergence from them along two kinds of
+// dependence:
+//
+// Data dependence: an instruction with a divergent operand is divergent.
+//
+// Sync dependence: a branch on a divergent condition is divergent, and the
+// threads reaching it may take different paths through its influence region,
+// the blocks on some path from the branch to its immediate post-dominator.
+// A phi in a block where paths from two different successors of the branch
+// meet is divergent unless all of its incoming values are the same, because
+// each thread picks the incoming value of the path it took.  A value defined
+// in the region and used outside it (such as a value defined in a loop and
+// used after a divergent exit from that loop) is also divergent at its
+// users, because threads leave the region at different times.
+//
+// A phi in the header of a loop that is entered from the region but does
+// not contain the branch only merges the entry and the back edges of that
+// loop.  All threads that enter the loop run it in step, so such a phi
+// stays uniform unless the loop has more than one entering block on a path
+// from the branch.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "divergence"
+#include "llvm/Analysis/DivergenceAnalysis.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+char DivergenceAnalysis::ID = 0;
+INITIALIZE_PASS_BEGIN(DivergenceAnalysis, "divergence",
+                      "Divergence Analysis", false, true)
+INITIALIZE_AG_DEPENDENCY(TargetTransformInfo)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_END(DivergenceAnalysis, "divergence",
+                    "Divergence Analysis", false, true)
+
+FunctionPass *llvm::createDivergenceAnalysisPass() {
+  return new DivergenceAnalysis();
+}
+
+namespace {
+
+/// Maps each block of an influence region to the successor of the branch
+/// that reaches it, or to null if more than one successor does.
+typedef DenseMap<BasicBlock *, BasicBlock *> RegionMap;
+
+class DivergencePropagator {
+  DominatorTree &DT;
+  PostDominatorTree &PDT;
+  LoopInfo &LI;
+  DenseSet<const Value *> &DV;
+  SmallVector<const Value *, 16> Worklist;
+
+  void markDivergent(const Value *V);
+  unsigned computeInfluenceRegion(BasicBlock *Start, BasicBlock *End,
+                                  RegionMap &Region);
+  bool isJoin(BasicBlock *BB, BasicBlock *Start, const RegionMap &Region);
+  void exploreSyncDependency(TerminatorInst *TI);
+  void exploreDataDependency(const Value *V);
+
+public:
+  DivergencePropagator(DominatorTree &DT, PostDominatorTree &PDT,
+                       LoopInfo &LI, DenseSet<const Value *> &DV)
+    : DT(DT), PDT(PDT), LI(LI), DV(DV) {}
+
+  void populateWithSourcesOfDivergence(Function &F,
+                                       const TargetTransformInfo &TTI);
+  void propagate();
+};
+
+} // end anonymous namespace
+
+/// markDivergent - Record that V differs between threads.  Only values and
+/// branches with more than one successor are worth recording; stores and
+/// other instructions without a result have nothing to propagate.
+void DivergencePropagator::markDivergent(const Value *V) {
+  if (const TerminatorInst *TI = dyn_cast<TerminatorInst>(V)) {
+    if (TI->getNumSuccessors() < 2)
+      return;
+  } else if (V->getType()->isVoidTy()) {
+    return;
+  }
+  if (DV.insert(V).second)
+    Worklist.push_back(V);
+}
+
+void DivergencePropagator::populateWithSourcesOfDivergence(
+    Function &F, const TargetTransformInfo &TTI) {
+  for (Function::arg_iterator AI = F.arg_begin(), AE = F.arg_end();
+       AI != AE; ++AI)
+    if (TTI.isSourceOfDivergence(AI))
+      markDivergent(AI);
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if (TTI.isSourceOfDivergence(&*I))
+      markDivergent(&*I);
+}
+
+/// computeInfluenceRegion - Collect the blocks on some path from Start to
+/// End, not counting Start and End themselves unless a path leads back to
+/// Start, and note which successors of Start reach each of them.  A null
+/// End stands for the exit of the function.  Returns the number of distinct
+/// successors of Start.
+unsigned DivergencePropagator::computeInfluenceRegion(
+    BasicBlock *Start, BasicBlock *End, RegionMap &Region) {
+  SmallPtrSet<BasicBlock *, 4> Succs;
+  SmallVector<BasicBlock *, 16> Stack;
+  for (succ_iterator SI = succ_begin(Start), SE = succ_end(Start);
+       SI != SE; ++SI) {
+    BasicBlock *Succ = *SI;
+    if (!Succs.insert(Succ) || Succ == End)
+      continue;
+
+    // A block is visited once for the first successor that reaches it, and
+    // once more when a second one does, to pass that on to what follows.
+    Stack.push_back(Succ);
+    while (!Stack.empty()) {
+      BasicBlock *BB = Stack.pop_back_val();
+      std::pair<RegionMap::iterator, bool> Ins =
+        Region.insert(std::make_pair(BB, Succ));
+      if (!Ins.second) {
+        if (!Ins.first->second || Ins.first->second == Succ)
+          continue;
+        Ins.first->second = 0;
+      }
+      for (succ_iterator BI = succ_begin(BB), BE = succ_end(BB);
+           BI != BE; ++BI)
+        if (*BI != End)
+          Stack.push_back(*BI);
+    }
+  }
+  return Succs.size();
+}
+
+/// isJoin - Return true if threads that went different ways at the end of
+/// Start may meet again at the start of BB, a block of the influence region
+/// reached from more than one successor of Start.
+bool DivergencePropagator::isJoin(BasicBlock *BB, BasicBlock *Start,
+                                  const RegionMap &Region) {
+  // Back edges of a loop that does not contain the branch only carry the
+  // threads that entered it, so count the entering blocks alone.
+  Loop *L = LI.getLoopFor(BB);
+  bool SkipLatches = L && L->getHeader() == BB && !L->contains(Start);
+
+  unsigned Reached = 0;
+  for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
+    BasicBlock *Pred = *PI;
+    if (Pred != Start && !Region.count(Pred))
+      continue;
+    if (SkipLatches && L->contains(Pred))
+      continue;
+    if (++Reached > 1)
+      return true;
+  }
+  return false;
+}
+
+void DivergencePropagator::exploreSyncDependency(TerminatorInst *TI) {
+  BasicBlock *ThisBB = TI->getParent();
+
+  // Without a post-dominator (ThisBB cannot reach an exit, or the paths only
+  // meet at the virtual exit node) the region extends to the function exit.
+  BasicBlock *IPostDom = 0;
+  if (DomTreeNode *Node = PDT.getNode(ThisBB))
+    if (DomTreeNode *IDom = Node->getIDom())
+      IPostDom = IDom->getBlock();
+
+  RegionMap Region;
+  unsigned NumSuccs = computeInfluenceRegion(ThisBB, IPostDom, Region);
+
+  // Phis where paths from different successors meet pick different values
+  // for different threads.  Every successor reaches the post-dominator.
+  SmallVector<BasicBlock *, 16> Joins;
+  for (RegionMap::iterator I = Region.begin(), E = Region.end(); I != E; ++I)
+    if (!I->second)
+      Joins.push_back(I->first);
+  if (IPostDom && NumSuccs > 1)
+    Joins.push_back(IPostDom);
+  for (unsigned i = 0, e = Joins.size(); i != e; ++i) {
+    BasicBlock *BB = Joins[i];
+    if (!isa<PHINode>(BB->begin()) || !isJoin(BB, ThisBB, Region))
+      continue;
+    for (BasicBlock::iterator I = BB->begin(); isa<PHINode>(I); ++I)
+      if (!cast<PHINode>(I)->hasConstantValue())
+        markDivergent(I);
+  }
+
+  // A value defined in the region and used outside it must dominate the
+  // branch (otherwise it could not reach the use without passing through
+  // the post-dominator, which ends the region), so only the dominators of
+  // ThisBB inside the region need to be searched.
+  for (DomTreeNode *Node = DT.getNode(ThisBB);
+       Node && Region.count(Node->getBlock()); Node = Node->getIDom()) {
+    BasicBlock *BB = Node->getBlock();
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+      for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+           UI != UE; ++UI) {
+        Instruction *User = dyn_cast<Instruction>(*UI);
+        if (User && !Region.count(User->getParent()))
+          markDivergent(User);
+      }
+  }
+}
+
+void DivergencePropagator::exploreDataDependency(const Value *V) {
+  for (Value::const_use_iterator UI = V->use_begin(), UE = V->use_end();
+       UI != UE; ++UI)
+    if (isa<Instruction>(*UI))
+      markDivergent(*UI);
+}
+
+void DivergencePropagator::propagate() {
+  while (!Worklist.empty()) {
+    const Value *V = Worklist.pop_back_val();
+    if (const TerminatorInst *TI = dyn_cast<TerminatorInst>(V))
+      exploreSyncDependency(const_cast<TerminatorInst *>(TI));
+    // An invoke is both a branch and a value.
+    if (!V->getType()->isVoidTy())
+      exploreDataDependency(V);
+  }
+}
+
+void DivergenceAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<TargetTransformInfo>();
+  AU.addRequired<DominatorTree>();
+  AU.addRequired<PostDominatorTree>();
+  AU.addRequired<LoopInfo>();
+  AU.setPreservesAll();
+}
+
+bool DivergenceAnalysis::runOnFunction(Function &F) {
+  this->F = &F;
+  DivergentValues.clear();
+
+  const TargetTransformInfo &TTI = getAnalysis<TargetTransformInfo>();
+  if (!TTI.hasBranchDivergence())
+    return false;
+
+  DivergencePropagator DP(getAnalysis<DominatorTree>(),
+                          getAnalysis<PostDominatorTree>(),
+                          getAnalysis<LoopInfo>(), DivergentValues);
+  DP.populateWithSourcesOfDivergence(F, TTI);
+  DP.propagate();
+  return false;
+}
+
+void DivergenceAnalysis::print(raw_ostream &OS, const Module *) const {
+  if (DivergentValues.empty())
+    return;
+
+  // Print in program order so that the output is stable.
+  for (Function::const_arg_iterator AI = F->arg_begin(), AE = F->arg_end();
+       AI != AE; ++AI)
+    if (isDivergent(AI))
+      OS << "DIVERGENT: " << *AI << "\n";
+  for (const_inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if (isDivergent(&*I))
+      OS << "DIVERGENT:" << *I << "\n";
+}
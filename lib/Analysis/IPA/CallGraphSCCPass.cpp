@@ -120,6 +120,9 @@ bool CGPassManager::RunPassOnSCC(Pass *P, CallGraphSCC &CurSCC,
     }
 
     {
+      // The SCC goes by the name of its first function in the time trace.
+      Function *F = (*CurSCC.begin())->getFunction();
+      TimeTraceContext TraceContext(F ? F->getName() : "<external node>");
       TimeRegion PassTimer(getPassTimer(CGSP));
       Changed = CGSP->runOnSCC(CurSCC);
     }
@@ -0,0 +1,464 @@
+//===- MemorySSA.cpp - Memory SSA -----------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file builds the memory SSA form of a function.  Accesses are created
+// for every reachable instruction that touches memory, phis are placed at the
+// iterated dominance frontier of the blocks that write memory, and a walk
+// over the dominator tree links every access to the state it sees, exactly as
+// for the SSA construction of a single promoted variable.
+//
+// The walker answers "which access last wrote this location" by following the
+// defining accesses upwards and asking alias analysis about each def.  At a
+// phi it resolves every incoming state; if they all lead to the same clobber,
+// the phi is looked through.  A path that comes back to a phi being resolved
+// (around a loop) has no clobber of its own and agrees with the others.
+// Answers are cached per (access, location), so later queries for the same
+// location stop at the first access an earlier query walked past.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "memoryssa"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/Assembly/AssemblyAnnotationWriter.h"
+#include "llvm/Assembly/Writer.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+using namespace llvm;
+
+STATISTIC(NumClobberQueries, "Number of clobber queries");
+STATISTIC(NumCachedClobbers, "Number of clobber walks ended by the cache");
+
+static cl::opt<unsigned>
+MaxPhiDepth("memoryssa-max-phi-depth", cl::Hidden, cl::init(32),
+            cl::desc("Nesting depth of memory phis the clobber walker looks "
+                     "through before giving up (default = 32)"));
+
+char MemorySSA::ID = 0;
+INITIALIZE_PASS_BEGIN(MemorySSA, "memoryssa", "Memory SSA", false, true)
+INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_END(MemorySSA, "memoryssa", "Memory SSA", false, true)
+
+FunctionPass *llvm::createMemorySSAPass() {
+  return new MemorySSA();
+}
+
+//===----------------------------------------------------------------------===//
+// MemoryAccess printing
+//===----------------------------------------------------------------------===//
+
+static void printAccessRef(raw_ostream &OS, const MemoryAccess *MA) {
+  if (MA->getKind() == MemoryAccess::LiveOnEntryKind)
+    OS << "liveOnEntry";
+  else
+    OS << MA->getID();
+}
+
+void MemoryAccess::print(raw_ostream &OS) const {
+  switch (getKind()) {
+  case LiveOnEntryKind:
+    OS << "liveOnEntry";
+    break;
+  case UseKind:
+    OS << "MemoryUse(";
+    printAccessRef(OS, cast<MemoryUse>(this)->getDefiningAccess());
+    OS << ')';
+    break;
+  case DefKind:
+    OS << getID() << " = MemoryDef(";
+    printAccessRef(OS, cast<MemoryDef>(this)->getDefiningAccess());
+    OS << ')';
+    break;
+  case PhiKind: {
+    const MemoryPhi *Phi = cast<MemoryPhi>(this);
+    OS << getID() << " = MemoryPhi(";
+    for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e; ++i) {
+      if (i)
+        OS << ',';
+      OS << '{';
+      WriteAsOperand(OS, Phi->getIncomingBlock(i), false);
+      OS << ',';
+      printAccessRef(OS, Phi->getIncomingValue(i));
+      OS << '}';
+    }
+    OS << ')';
+    break;
+  }
+  }
+}
+
+void MemoryAccess::dump() const {
+  print(dbgs());
+  dbgs() << '\n';
+}
+
+namespace {
+/// MemorySSAAnnotatedWriter - Write the phi of each block after its label and
+/// the access of each instruction above it.
+class MemorySSAAnnotatedWriter : public AssemblyAnnotationWriter {
+  const MemorySSA *MSSA;
+
+public:
+  explicit MemorySSAAnnotatedWriter(const MemorySSA *M) : MSSA(M) {}
+
+  virtual void emitBasicBlockStartAnnot(const BasicBlock *BB,
+                                        formatted_raw_ostream &OS) {
+    if (MemoryPhi *Phi = MSSA->getMemoryAccess(BB))
+      OS << "; " << *Phi << '\n';
+  }
+
+  virtual void emitInstructionAnnot(const Instruction *I,
+                                    formatted_raw_ostream &OS) {
+    if (MemoryUseOrDef *MA = MSSA->getMemoryAccess(I))
+      OS << "; " << *MA << '\n';
+  }
+};
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// MemorySSA construction
+//===----------------------------------------------------------------------===//
+
+MemorySSA::MemorySSA()
+  : FunctionPass(ID), F(0), AA(0), DT(0), LiveOnEntryDef(0) {
+  initializeMemorySSAPass(*PassRegistry::getPassRegistry());
+}
+
+void MemorySSA::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequiredTransitive<AliasAnalysis>();
+  AU.addRequiredTransitive<DominatorTree>();
+}
+
+void MemorySSA::releaseMemory() {
+  for (std::vector<MemoryAccess *>::iterator I = Accesses.begin(),
+       E = Accesses.end(); I != E; ++I)
+    delete *I;
+  Accesses.clear();
+  ValueToMemoryAccess.clear();
+  ClobberCache.clear();
+  LiveOnEntryDef = 0;
+}
+
+bool MemorySSA::runOnFunction(Function &Fn) {
+  F = &Fn;
+  AA = &getAnalysis<AliasAnalysis>();
+  DT = &getAnalysis<DominatorTree>();
+
+  LiveOnEntryDef = new MemoryAccess(MemoryAccess::LiveOnEntryKind,
+                                    &F->getEntryBlock());
+  Accesses.push_back(LiveOnEntryDef);
+
+  // Create an access for every instruction that touches memory.  Calls are
+  // classified by what alias analysis knows about the callee.
+  SmallPtrSet<BasicBlock *, 32> DefBlocks;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    if (!DT->isReachableFromEntry(BB))
+      continue;
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      if (!I->mayReadFromMemory() && !I->mayWriteToMemory())
+        continue;
+
+      bool IsDef = I->mayWriteToMemory();
+      ImmutableCallSite CS(I);
+      if (CS) {
+        AliasAnalysis::ModRefBehavior MRB = AA->getModRefBehavior(CS);
+        if (MRB == AliasAnalysis::DoesNotAccessMemory)
+          continue;
+        IsDef = !AliasAnalysis::onlyReadsMemory(MRB);
+      }
+
+      MemoryUseOrDef *MA;
+      if (IsDef) {
+        MA = new MemoryDef(I, BB);
+        DefBlocks.insert(BB);
+      } else {
+        MA = new MemoryUse(I, BB);
+      }
+      Accesses.push_back(MA);
+      ValueToMemoryAccess[I] = MA;
+    }
+  }
+
+  placePhis(DefBlocks);
+  renameAccesses();
+
+  // Number the defs and phis in program order.
+  unsigned NextID = 0;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    if (MemoryPhi *Phi = getMemoryAccess(BB))
+      Phi->ID = ++NextID;
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (MemoryUseOrDef *MA = getMemoryAccess(I))
+        if (isa<MemoryDef>(MA))
+          MA->ID = ++NextID;
+  }
+
+  return false;
+}
+
+/// placePhis - Put a phi in every block of the iterated dominance frontier of
+/// the blocks that write memory.  The frontiers are computed from the
+/// dominator tree by walking up from the predecessors of each join block to
+/// its immediate dominator.
+void MemorySSA::placePhis(SmallPtrSet<BasicBlock *, 32> &DefBlocks) {
+  DenseMap<BasicBlock *, SmallVector<BasicBlock *, 4> > Frontier;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    if (!DT->isReachableFromEntry(BB))
+      continue;
+    pred_iterator PI = pred_begin(BB), PE = pred_end(BB);
+    if (PI == PE || llvm::next(PI) == PE)
+      continue;
+
+    BasicBlock *IDom = DT->getNode(BB)->getIDom()->getBlock();
+    for (; PI != PE; ++PI) {
+      BasicBlock *Runner = *PI;
+      if (!DT->isReachableFromEntry(Runner))
+        continue;
+      while (Runner != IDom) {
+        SmallVectorImpl<BasicBlock *> &DF = Frontier[Runner];
+        if (DF.empty() || DF.back() != BB)
+          DF.push_back(BB);
+        Runner = DT->getNode(Runner)->getIDom()->getBlock();
+      }
+    }
+  }
+
+  SmallVector<BasicBlock *, 32> Worklist(DefBlocks.begin(), DefBlocks.end());
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    SmallVectorImpl<BasicBlock *> &DF = Frontier[BB];
+    for (unsigned i = 0, e = DF.size(); i != e; ++i) {
+      BasicBlock *Join = DF[i];
+      if (ValueToMemoryAccess.count(Join))
+        continue;
+      MemoryPhi *Phi = new MemoryPhi(Join);
+      Accesses.push_back(Phi);
+      ValueToMemoryAccess[Join] = Phi;
+      if (!DefBlocks.count(Join))
+        Worklist.push_back(Join);
+    }
+  }
+}
+
+/// renameAccesses - Walk the dominator tree, passing down the access that
+/// defines the memory state at the end of each block, to fill in the
+/// defining access of every use and def and the incoming states of the phis.
+void MemorySSA::renameAccesses() {
+  SmallVector<std::pair<DomTreeNode *, MemoryAccess *>, 32> Worklist;
+  Worklist.push_back(std::make_pair(DT->getRootNode(), LiveOnEntryDef));
+  while (!Worklist.empty()) {
+    DomTreeNode *Node = Worklist.back().first;
+    MemoryAccess *Incoming = Worklist.back().second;
+    Worklist.pop_back();
+
+    BasicBlock *BB = Node->getBlock();
+    if (MemoryPhi *Phi = getMemoryAccess(BB))
+      Incoming = Phi;
+
+    for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
+      MemoryUseOrDef *MA = getMemoryAccess(I);
+      if (!MA)
+        continue;
+      MA->DefiningAccess = Incoming;
+      Incoming->Users.push_back(MA);
+      if (isa<MemoryDef>(MA))
+        Incoming = MA;
+    }
+
+    for (succ_iterator SI = succ_begin(BB), SE = succ_end(BB); SI != SE; ++SI)
+      if (MemoryPhi *Phi = getMemoryAccess(*SI)) {
+        Phi->Incoming.push_back(std::make_pair(BB, Incoming));
+        Incoming->Users.push_back(Phi);
+      }
+
+    for (DomTreeNode::iterator CI = Node->begin(), CE = Node->end();
+         CI != CE; ++CI)
+      Worklist.push_back(std::make_pair(*CI, Incoming));
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// MemorySSA queries
+//===----------------------------------------------------------------------===//
+
+MemoryUseOrDef *MemorySSA::getMemoryAccess(const Instruction *I) const {
+  DenseMap<const Value *, MemoryAccess *>::const_iterator It =
+    ValueToMemoryAccess.find(I);
+  if (It == ValueToMemoryAccess.end())
+    return 0;
+  return cast<MemoryUseOrDef>(It->second);
+}
+
+MemoryPhi *MemorySSA::getMemoryAccess(const BasicBlock *BB) const {
+  DenseMap<const Value *, MemoryAccess *>::const_iterator It =
+    ValueToMemoryAccess.find(BB);
+  if (It == ValueToMemoryAccess.end())
+    return 0;
+  return cast<MemoryPhi>(It->second);
+}
+
+void MemorySSA::removeMemoryAccess(const Instruction *I) {
+  DenseMap<const Value *, MemoryAccess *>::iterator It =
+    ValueToMemoryAccess.find(I);
+  if (It == ValueToMemoryAccess.end())
+    return;
+
+  MemoryUseOrDef *MA = cast<MemoryUseOrDef>(It->second);
+  if (isa<MemoryUse>(MA)) {
+    SmallVectorImpl<MemoryAccess *> &Users = MA->DefiningAccess->Users;
+    Users.erase(std::find(Users.begin(), Users.end(), MA));
+  }
+
+  // Nothing refers to a use.  A def is still the defining access of the
+  // accesses below it; with no instruction the walker steps over it.  Cached
+  // answers naming it stay correct for the accesses that remain, which see
+  // the same memory as before minus one write.
+  MA->MemoryInst = 0;
+  ValueToMemoryAccess.erase(It);
+}
+
+MemoryAccess *MemorySSA::getClobberingMemoryAccess(const Instruction *I) {
+  MemoryUseOrDef *MA = getMemoryAccess(I);
+  if (!MA)
+    return 0;
+
+  AliasAnalysis::Location Loc;
+  if (const LoadInst *LI = dyn_cast<LoadInst>(I))
+    Loc = AA->getLocation(LI);
+  else if (const StoreInst *SI = dyn_cast<StoreInst>(I))
+    Loc = AA->getLocation(SI);
+  else
+    return MA->getDefiningAccess();
+
+  return getClobberingMemoryAccess(MA->getDefiningAccess(), Loc);
+}
+
+MemoryAccess *
+MemorySSA::getClobberingMemoryAccess(MemoryAccess *Start,
+                                     const AliasAnalysis::Location &Loc) {
+  ++NumClobberQueries;
+  unsigned MinDepth = ~0U;
+  MemoryAccess *Clobber = walkToClobber(Start, Loc, MinDepth);
+  assert(Clobber && PhisInProgress.empty() && "Walk did not settle");
+  return Clobber;
+}
+
+/// walkToClobber - Follow the defining accesses up from \p MA to the first
+/// one that may write \p Loc.  Returns null if the walk only reached a phi
+/// that is still being resolved, in which case \p MinDepth is lowered to the
+/// depth of that phi.  Answers that do not depend on such a phi are cached
+/// for every def walked past.
+MemoryAccess *MemorySSA::walkToClobber(MemoryAccess *MA,
+                                       const AliasAnalysis::Location &Loc,
+                                       unsigned &MinDepth) {
+  SmallVector<MemoryAccess *, 16> WalkedPast;
+  unsigned LocalMin = ~0U;
+  MemoryAccess *Clobber = 0;
+  for (;;) {
+    DenseMap<WalkKey, MemoryAccess *>::iterator It =
+      ClobberCache.find(WalkKey(MA, Loc));
+    if (It != ClobberCache.end()) {
+      ++NumCachedClobbers;
+      Clobber = It->second;
+      break;
+    }
+
+    if (MA == LiveOnEntryDef) {
+      Clobber = MA;
+      break;
+    }
+
+    if (MemoryPhi *Phi = dyn_cast<MemoryPhi>(MA)) {
+      Clobber = resolvePhi(Phi, Loc, LocalMin);
+      break;
+    }
+
+    MemoryDef *Def = cast<MemoryDef>(MA);
+    Instruction *I = Def->getMemoryInst();
+    if (I && (AA->getModRefInfo(I, Loc) & AliasAnalysis::Mod)) {
+      Clobber = Def;
+      break;
+    }
+    WalkedPast.push_back(Def);
+    MA = Def->getDefiningAccess();
+  }
+
+  if (LocalMin == ~0U)
+    for (unsigned i = 0, e = WalkedPast.size(); i != e; ++i)
+      ClobberCache[WalkKey(WalkedPast[i], Loc)] = Clobber;
+  MinDepth = std::min(MinDepth, LocalMin);
+  return Clobber;
+}
+
+/// resolvePhi - Find the clobber of \p Loc on every incoming path of \p Phi.
+/// If all the paths agree, that is the clobber; otherwise the phi itself is.
+MemoryAccess *MemorySSA::resolvePhi(MemoryPhi *Phi,
+                                    const AliasAnalysis::Location &Loc,
+                                    unsigned &MinDepth) {
+  // A path that leads back to a phi being resolved adds no clobber of its
+  // own.  The answer then holds only if that phi resolves the way its other
+  // paths do, so it is not cached until that phi is done.
+  DenseMap<const MemoryPhi *, unsigned>::iterator It =
+    PhisInProgress.find(Phi);
+  if (It != PhisInProgress.end()) {
+    MinDepth = std::min(MinDepth, It->second);
+    return 0;
+  }
+
+  unsigned Depth = PhisInProgress.size();
+  if (Depth >= MaxPhiDepth)
+    return Phi;
+
+  PhisInProgress[Phi] = Depth;
+  MemoryAccess *Clobber = 0;
+  unsigned LocalMin = ~0U;
+  bool Agree = true;
+  for (unsigned i = 0, e = Phi->getNumIncomingValues(); i != e && Agree; ++i) {
+    MemoryAccess *C = walkToClobber(Phi->getIncomingValue(i), Loc, LocalMin);
+    if (!C)
+      continue;
+    if (!Clobber)
+      Clobber = C;
+    else if (C != Clobber)
+      Agree = false;
+  }
+  PhisInProgress.erase(Phi);
+
+  // Disagreeing paths make the phi the clobber whatever the phis above it
+  // resolve to.  Depending only on this phi is the same as not depending on
+  // anything, now that it is resolved.
+  if (!Agree || (!Clobber && LocalMin >= Depth)) {
+    Clobber = Phi;
+    LocalMin = ~0U;
+  } else if (LocalMin >= Depth) {
+    LocalMin = ~0U;
+  }
+
+  if (LocalMin == ~0U)
+    ClobberCache[WalkKey(Phi, Loc)] = Clobber;
+  MinDepth = std::min(MinDepth, LocalMin);
+  return Clobber;
+}
+
+void MemorySSA::print(raw_ostream &OS, const Module *) const {
+  MemorySSAAnnotatedWriter Writer(this);
+  F->print(OS, &Writer);
+}
@@ -15,10 +15,16 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 
 using namespace llvm;
 
+static cl::opt<unsigned>
+CodeSizeBudget("code-size-budget", cl::Hidden, cl::init(0),
+               cl::desc("The code size budget of functions for targets that "
+                        "do not set one (default = 0, no limit)"));
+
 // Setup the analysis group to manage the TargetTransformInfo passes.
 INITIALIZE_ANALYSIS_GROUP(TargetTransformInfo, "Target Information", NoTTI)
 char TargetTransformInfo::ID = 0;
@@ -92,6 +98,10 @@ bool TargetTransformInfo::hasBranchDivergence() const {
   return PrevTTI->hasBranchDivergence();
 }
 
+bool TargetTransformInfo::isSourceOfDivergence(const Value *V) const {
+  return PrevTTI->isSourceOfDivergence(V);
+}
+
 bool TargetTransformInfo::isLoweredToCall(const Function *F) const {
   return PrevTTI->isLoweredToCall(F);
 }
@@ -101,6 +111,10 @@ void TargetTransformInfo::getUnrollingPreferences(Loop *L,
   PrevTTI->getUnrollingPreferences(L, UP);
 }
 
+unsigned TargetTransformInfo::getCodeSizeBudget() const {
+  return PrevTTI->getCodeSizeBudget();
+}
+
 bool TargetTransformInfo::isLegalAddImmediate(int64_t Imm) const {
   return PrevTTI->isLegalAddImmediate(Imm);
 }
@@ -448,6 +462,8 @@ struct NoTTI : ImmutablePass, TargetTransformInfo {
 
   bool hasBranchDivergence() const { return false; }
 
+  bool isSourceOfDivergence(const Value *V) const { return false; }
+
   bool isLoweredToCall(const Function *F) const {
     // FIXME: These should almost certainly not be handled here, and instead
     // handled with the help of TLI or the target itself. This was largely
@@ -481,6 +497,10 @@ struct NoTTI : ImmutablePass, TargetTransformInfo {
 
   void getUnrollingPreferences(Loop *, UnrollingPreferences &) const { }
 
+  unsigned getCodeSizeBudget() const {
+    return CodeSizeBudget;
+  }
+
   bool isLegalAddImmediate(int64_t Imm) const {
     return false;
   }
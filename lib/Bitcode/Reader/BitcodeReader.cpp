@@ -22,6 +22,7 @@
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/Support/DataStream.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -1611,6 +1612,61 @@ error_code BitcodeReader::RememberAndSkipFunctionBody() {
   return error_code::success();
 }
 
+/// ParseFunctionIndex - Read the position of every function body from the
+/// function index block, so that they can be materialized without first
+/// skipping over all of the function blocks in the module.
+error_code BitcodeReader::ParseFunctionIndex() {
+  // A function block starts with an ENTER_SUBBLOCK abbrev ID as wide as the
+  // module block's and its block ID as a single VBR chunk.  The index points
+  // at the start, RememberAndSkipFunctionBody records the position after.
+  uint64_t HeaderBits = Stream.getAbbrevIDWidth() + bitc::BlockIDWidth;
+
+  if (Stream.EnterSubBlock(bitc::FUNCTION_INDEX_BLOCK_ID))
+    return Error(InvalidRecord);
+  uint64_t BaseBit = Stream.GetCurrentBitNo();
+
+  SmallVector<uint64_t, 1> Record;
+
+  // Read all the records.
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return Error(MalformedBlock);
+    case BitstreamEntry::EndBlock:
+      return error_code::success();
+    case BitstreamEntry::Record:
+      // The interesting case.
+      break;
+    }
+
+    // Read an index record.
+    Record.clear();
+    StringRef Blob;
+    switch (Stream.readRecord(Entry.ID, Record, &Blob)) {
+    default:  // Default behavior: unknown type.
+      break;
+    case bitc::FUNCTION_INDEX_CODE_OFFSETS: { // OFFSETS: [blob]
+      if (Blob.size() != FunctionsWithBodies.size() * 4)
+        return Error(InvalidRecord);
+      for (unsigned i = 0, e = FunctionsWithBodies.size(); i != e; ++i) {
+        uint64_t Offset = support::endian::read<uint32_t, support::little,
+                                                support::unaligned>(
+                                                    Blob.data() + i * 4);
+        uint64_t Pos = BaseBit + Offset * 32 + HeaderBits;
+        if (!Stream.canSkipToPos(Pos / 8))
+          return Error(InvalidRecord);
+        DeferredFunctionInfo[FunctionsWithBodies[i]] = Pos;
+      }
+      HasFunctionIndex = true;
+      break;
+    }
+    }
+  }
+}
+
 error_code BitcodeReader::GlobalCleanup() {
   // Patch the initializers for globals and aliases up.
   ResolveGlobalAndAliasInits();
@@ -1711,8 +1767,10 @@ error_code BitcodeReader::ParseModule(bool Resume) {
         // necessary. For streaming, the function bodies must be at the end of
         // the bitcode. If the bitcode file is old, the symbol table will be
         // at the end instead and will not have been seen yet. In this case,
-        // just finish the parse now.
-        if (LazyStreamer && SeenValueSymbolTable) {
+        // just finish the parse now.  When the function index has given the
+        // position of every body there is no need to skip over the rest of
+        // them either.
+        if ((LazyStreamer || HasFunctionIndex) && SeenValueSymbolTable) {
           NextUnreadBit = Stream.GetCurrentBitNo();
           return error_code::success();
         }
@@ -1721,6 +1779,16 @@ error_code BitcodeReader::ParseModule(bool Resume) {
         if (error_code EC = ParseUseLists())
           return EC;
         break;
+      case bitc::FUNCTION_INDEX_BLOCK_ID:
+        // When streaming, the function bodies are found as they arrive.
+        if (LazyStreamer) {
+          if (Stream.SkipBlock())
+            return Error(InvalidRecord);
+          break;
+        }
+        if (error_code EC = ParseFunctionIndex())
+          return EC;
+        break;
       }
       continue;
 
@@ -1974,7 +2042,8 @@ error_code BitcodeReader::ParseBitcodeInto(Module *M) {
         TheModule = M;
         if (error_code EC = ParseModule(false))
           return EC;
-        if (LazyStreamer)
+        // The rest of a suspended module is read when it is materialized.
+        if (LazyStreamer || NextUnreadBit)
           return error_code::success();
         break;
       default:
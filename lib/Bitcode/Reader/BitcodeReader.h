@@ -174,6 +174,10 @@ class BitcodeReader : public GVMaterializer {
   // we've done this yet.
   bool SeenFirstFunctionBody;
 
+  /// HasFunctionIndex - Set when a function index block gave the position of
+  /// every function body, so the module need not be scanned for them.
+  bool HasFunctionIndex;
+
   /// DeferredFunctionInfo - When function bodies are initially scanned, this
   /// map contains info about where to find deferred function body in the
   /// stream.
@@ -227,13 +231,15 @@ public:
     : Context(C), TheModule(0), Buffer(buffer), BufferOwned(false),
       LazyStreamer(0), NextUnreadBit(0), SeenValueSymbolTable(false),
       ValueList(C), MDValueList(C),
-      SeenFirstFunctionBody(false), UseRelativeIDs(false) {
+      SeenFirstFunctionBody(false), HasFunctionIndex(false),
+      UseRelativeIDs(false) {
   }
   explicit BitcodeReader(DataStreamer *streamer, LLVMContext &C)
     : Context(C), TheModule(0), Buffer(0), BufferOwned(false),
       LazyStreamer(streamer), NextUnreadBit(0), SeenValueSymbolTable(false),
       ValueList(C), MDValueList(C),
-      SeenFirstFunctionBody(false), UseRelativeIDs(false) {
+      SeenFirstFunctionBody(false), HasFunctionIndex(false),
+      UseRelativeIDs(false) {
   }
   ~BitcodeReader() {
     FreeState();
@@ -356,6 +362,7 @@ private:
   error_code ParseValueSymbolTable();
   error_code ParseConstants();
   error_code RememberAndSkipFunctionBody();
+  error_code ParseFunctionIndex();
   error_code ParseFunctionBody(Function *F);
   error_code GlobalCleanup();
   error_code ResolveGlobalAndAliasInits();
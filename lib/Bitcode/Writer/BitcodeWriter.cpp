@@ -1879,6 +1879,37 @@ static void WriteModuleUseLists(const Module *M, ValueEnumerator &VE,
   Stream.ExitBlock();
 }
 
+/// WriteFunctionIndex - Emit the function index block, which lets a lazy
+/// reader find each function body without walking past the ones before it.
+/// The bodies have not been written yet, so the offsets are left as zero to be
+/// backpatched.  Returns the bit at which the offsets are counted from in
+/// BaseBit and the byte holding the first offset in OffsetByteNo.
+static void WriteFunctionIndex(const Module *M, BitstreamWriter &Stream,
+                               uint64_t &BaseBit, unsigned &OffsetByteNo) {
+  unsigned NumBodies = 0;
+  for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
+    if (!F->isDeclaration())
+      ++NumBodies;
+
+  Stream.EnterSubblock(bitc::FUNCTION_INDEX_BLOCK_ID, 3);
+  BaseBit = Stream.GetCurrentBitNo();
+
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FUNCTION_INDEX_CODE_OFFSETS));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  unsigned OffsetsAbbrev = Stream.EmitAbbrev(Abbv);
+
+  // The blob is word aligned, so each offset can be backpatched as a word.
+  SmallVector<char, 64> Offsets(NumBodies * 4, 0);
+  SmallVector<unsigned, 1> Vals;
+  Vals.push_back(bitc::FUNCTION_INDEX_CODE_OFFSETS);
+  Stream.EmitRecordWithBlob(OffsetsAbbrev, Vals,
+                            StringRef(Offsets.data(), Offsets.size()));
+  OffsetByteNo = Stream.GetCurrentBitNo() / 8 - Offsets.size();
+
+  Stream.ExitBlock();
+}
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
@@ -1907,6 +1938,11 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   // descriptors for global variables, and function prototype info.
   WriteModuleInfo(M, VE, Stream);
 
+  // Emit the function index, which must follow the function records.
+  uint64_t IndexBaseBit;
+  unsigned IndexByteNo;
+  WriteFunctionIndex(M, Stream, IndexBaseBit, IndexByteNo);
+
   // Emit constants.
   WriteModuleConstants(VE, Stream);
 
@@ -1923,10 +1959,16 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream) {
   if (EnablePreserveUseListOrdering)
     WriteModuleUseLists(M, VE, Stream);
 
-  // Emit function bodies.
+  // Emit function bodies, recording where each one starts in the index.
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
-    if (!F->isDeclaration())
+    if (!F->isDeclaration()) {
+      uint64_t Offset = Stream.GetCurrentBitNo() - IndexBaseBit;
+      assert(Offset % 32 == 0 && "Function block not word aligned!");
+      assert(Offset / 32 <= ~0U && "Function index offset overflow!");
+      Stream.BackpatchWord(IndexByteNo, unsigned(Offset / 32));
+      IndexByteNo += 4;
       WriteFunction(*F, VE, Stream);
+    }
 
   Stream.ExitBlock();
 }
@@ -54,6 +54,8 @@ using namespace llvm;
 static const char *const DWARFGroupName = "DWARF Emission";
 static const char *const DbgTimerName = "DWARF Debug Writer";
 static const char *const EHTimerName = "DWARF Exception Writer";
+static const char *const MCGroupName = "MC Emission";
+static const char *const MCFinishTimerName = "Streamer Finalization";
 
 STATISTIC(EmittedInsts, "Number of machine instrs printed");
 
@@ -995,7 +997,10 @@ bool AsmPrinter::doFinalization(Module &M) {
   delete Mang; Mang = 0;
   MMI = 0;
 
-  OutStreamer.Finish();
+  {
+    NamedRegionTimer T(MCFinishTimerName, MCGroupName, TimePassesIsEnabled);
+    OutStreamer.Finish();
+  }
   OutStreamer.reset();
 
   return false;
@@ -52,7 +52,10 @@ bool LiveRangeEdit::checkRematerializable(VNInfo *VNI,
                                           AliasAnalysis *aa) {
   assert(DefMI && "Missing instruction");
   ScannedRemattable = true;
-  if (!TII.isTriviallyReMaterializable(DefMI, aa))
+  // canRematerializeAt checks that the uses are available, so defs that
+  // read non-constant virtual registers are fine here too.
+  if (!TII.isTriviallyReMaterializable(DefMI, aa) &&
+      !TII.isReMaterializableWithLiveUses(DefMI, aa))
     return false;
   Remattable.insert(VNI);
   return true;
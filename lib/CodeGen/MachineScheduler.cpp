@@ -19,6 +19,7 @@
 #include "llvm/ADT/PriorityQueue.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/CodeGen/LiveIntervalAnalysis.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
 #include "llvm/CodeGen/MachineDominators.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
@@ -53,6 +54,13 @@ static cl::opt<unsigned> MISchedCutoff("misched-cutoff", cl::Hidden,
 static bool ViewMISchedDAGs = false;
 #endif // NDEBUG
 
+// Scheduling a region costs more than linear time in its size, so very large
+// basic blocks are scheduled as a sequence of windows of at most this many
+// instructions.  The top instruction of each window stays in place.
+static cl::opt<unsigned> MISchedRegionLimit("misched-region-limit", cl::Hidden,
+  cl::desc("Split scheduling regions larger than this (0 = no limit)"),
+  cl::init(1024));
+
 static cl::opt<bool> EnableRegPressure("misched-regpressure", cl::Hidden,
   cl::desc("Enable register pressure scheduling."), cl::init(true));
 
@@ -81,7 +89,7 @@ void ScheduleDAGMutation::anchor() {}
 //===----------------------------------------------------------------------===//
 
 MachineSchedContext::MachineSchedContext():
-    MF(0), MLI(0), MDT(0), PassConfig(0), AA(0), LIS(0) {
+    MF(0), MLI(0), MDT(0), MBFI(0), PassConfig(0), AA(0), LIS(0) {
   RegClassInfo = new RegisterClassInfo();
 }
 
@@ -248,6 +256,7 @@ bool MachineScheduler::runOnMachineFunction(MachineFunction &mf) {
   MF = &mf;
   MLI = &getAnalysis<MachineLoopInfo>();
   MDT = &getAnalysis<MachineDominatorTree>();
+  MBFI = getAnalysisIfAvailable<MachineBlockFrequencyInfo>();
   PassConfig = &getAnalysis<TargetPassConfig>();
   AA = &getAnalysis<AliasAnalysis>();
 
@@ -302,6 +311,9 @@ bool MachineScheduler::runOnMachineFunction(MachineFunction &mf) {
       for(;I != MBB->begin(); --I, --RemainingInstrs, ++NumRegionInstrs) {
         if (TII->isSchedulingBoundary(llvm::prior(I), MBB, *MF))
           break;
+        // The instruction above a full window acts as its boundary.
+        if (NumRegionInstrs + 1 == MISchedRegionLimit)
+          break;
       }
       // Notify the scheduler of the region, even if we may skip scheduling
       // it. Perhaps it still needs to be bundled.
@@ -2829,10 +2841,11 @@ void GenericScheduler::schedNode(SUnit *SU, bool IsTopNode) {
   }
 }
 
-/// Create the standard converging machine scheduler. This will be used as the
-/// default scheduler if the target does not set a default.
-static ScheduleDAGInstrs *createGenericSched(MachineSchedContext *C) {
-  ScheduleDAGMI *DAG = new ScheduleDAGMI(C, new GenericScheduler(C));
+MachineSchedStrategy *llvm::createGenericSchedStrategy(MachineSchedContext *C) {
+  return new GenericScheduler(C);
+}
+
+void llvm::addGenericSchedMutations(ScheduleDAGMI *DAG) {
   // Register DAG post-processors.
   //
   // FIXME: extend the mutation API to allow earlier mutations to instantiate
@@ -2843,6 +2856,13 @@ static ScheduleDAGInstrs *createGenericSched(MachineSchedContext *C) {
     DAG->addMutation(new LoadClusterMutation(DAG->TII, DAG->TRI));
   if (EnableMacroFusion)
     DAG->addMutation(new MacroFusion(DAG->TII));
+}
+
+/// Create the standard converging machine scheduler. This will be used as the
+/// default scheduler if the target does not set a default.
+static ScheduleDAGInstrs *createGenericSched(MachineSchedContext *C) {
+  ScheduleDAGMI *DAG = new ScheduleDAGMI(C, new GenericScheduler(C));
+  addGenericSchedMutations(DAG);
   return DAG;
 }
 static MachineSchedRegistry
@@ -0,0 +1,96 @@
+//===-- ParallelCG.cpp - Parallel code generation -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements splitCodeGen.  Each thread reads the whole module
+// from bitcode into a context of its own and throws away everything outside
+// its partition, so the threads share nothing but the bitcode.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+
+using namespace llvm;
+
+PartitionCompiler::~PartitionCompiler() {}
+
+namespace {
+struct PartitionTask {
+  StringRef Bitcode;
+  StringRef ModuleID;
+  unsigned Partition;
+  unsigned NumPartitions;
+  PartitionCompiler *PC;
+  std::string *Output;
+  std::string ErrMsg;
+  bool Failed;
+};
+}
+
+static void compilePartition(void *Arg) {
+  PartitionTask &Task = *static_cast<PartitionTask *>(Arg);
+  LLVMContext Context;
+  OwningPtr<MemoryBuffer> Buffer(
+    MemoryBuffer::getMemBuffer(Task.Bitcode, Task.ModuleID, false));
+  OwningPtr<Module> M(ParseBitcodeFile(Buffer.get(), Context, &Task.ErrMsg));
+  if (!M) {
+    Task.Failed = true;
+    return;
+  }
+
+  extractModulePartition(*M, Task.Partition, Task.NumPartitions);
+  raw_string_ostream OS(*Task.Output);
+  Task.Failed = Task.PC->compile(*M, OS, Task.ErrMsg);
+  OS.flush();
+}
+
+bool llvm::splitCodeGen(const Module &M, unsigned NumPartitions,
+                        PartitionCompiler &PC,
+                        std::vector<std::string> &Outputs,
+                        std::string &ErrMsg) {
+  assert(NumPartitions && "No partitions to generate");
+  std::string Bitcode;
+  raw_string_ostream BitcodeOS(Bitcode);
+  WriteBitcodeToFile(&M, BitcodeOS);
+  BitcodeOS.flush();
+
+  Outputs.assign(NumPartitions, std::string());
+  std::vector<PartitionTask> Tasks(NumPartitions);
+  std::vector<void *> TaskPtrs(NumPartitions);
+  for (unsigned I = 0; I != NumPartitions; ++I) {
+    PartitionTask &Task = Tasks[I];
+    Task.Bitcode = Bitcode;
+    Task.ModuleID = M.getModuleIdentifier();
+    Task.Partition = I;
+    Task.NumPartitions = NumPartitions;
+    Task.PC = &PC;
+    Task.Output = &Outputs[I];
+    Task.Failed = false;
+    TaskPtrs[I] = &Task;
+  }
+
+  if (NumPartitions > 1 && !llvm_is_multithreaded())
+    llvm_start_multithreaded();
+  llvm_execute_in_parallel(compilePartition, &TaskPtrs[0], NumPartitions,
+                           NumPartitions);
+
+  for (unsigned I = 0; I != NumPartitions; ++I)
+    if (Tasks[I].Failed) {
+      ErrMsg = Tasks[I].ErrMsg;
+      return true;
+    }
+  return false;
+}
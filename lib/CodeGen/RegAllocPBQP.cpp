@@ -55,6 +55,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetInstrInfo.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetSubtargetInfo.h"
 #include <limits>
 #include <memory>
 #include <set>
@@ -186,6 +187,23 @@ unsigned PBQPRAProblem::getPRegForOption(unsigned vreg, unsigned option) const {
   return allowedSet[option - 1];
 }
 
+void PBQPRAProblem::addEdgeCosts(unsigned vreg1, unsigned vreg2,
+                                 const PBQP::Matrix &costs) {
+  PBQP::Graph::NodeId node1 = getNodeForVReg(vreg1);
+  PBQP::Graph::NodeId node2 = getNodeForVReg(vreg2);
+  PBQP::Graph::EdgeId edge = graph.findEdge(node1, node2);
+  if (edge == graph.invalidEdgeId())
+    graph.addEdge(node1, node2, costs);
+  else if (graph.getEdgeNode1(edge) == node1)
+    graph.getEdgeCosts(edge) += costs;
+  else
+    graph.getEdgeCosts(edge) += costs.transpose();
+}
+
+PBQPRAConstraint::~PBQPRAConstraint() {}
+
+void PBQPRAConstraint::anchor() {}
+
 PBQPRAProblem *PBQPBuilder::build(MachineFunction *mf, const LiveIntervals *lis,
                                   const MachineBlockFrequencyInfo *mbfi,
                                   const RegSet &vregs) {
@@ -571,6 +589,9 @@ bool RegAllocPBQP::runOnMachineFunction(MachineFunction &MF) {
   // Find the vreg intervals in need of allocation.
   findVRegIntervalsToAlloc();
 
+  OwningPtr<PBQPRAConstraint> constraint(
+    tm->getSubtarget<TargetSubtargetInfo>().getCustomPBQPConstraints());
+
 #ifndef NDEBUG
   const Function* func = mf->getFunction();
   std::string fqn =
@@ -589,6 +610,8 @@ bool RegAllocPBQP::runOnMachineFunction(MachineFunction &MF) {
 
       OwningPtr<PBQPRAProblem> problem(
         builder->build(mf, lis, mbfi, vregsToAlloc));
+      if (constraint)
+        constraint->apply(*problem, *mf, *lis, *mbfi);
 
 #ifndef NDEBUG
       if (pbqpDumpGraphs) {
@@ -210,23 +210,54 @@ void SUnit::setHeightDirty() {
 /// setDepthToAtLeast - Update this node's successors to reflect the
 /// fact that this node's depth just increased.
 ///
+/// Schedulers call this for nearly every node they schedule, so rather than
+/// marking everything below dirty, which makes the next getDepth walk the
+/// rest of the DAG, raise the successors whose depth actually changes.  A
+/// dirty node only has dirty successors, and they pick up the new depth when
+/// they are recomputed.
 void SUnit::setDepthToAtLeast(unsigned NewDepth) {
   if (NewDepth <= getDepth())
     return;
-  setDepthDirty();
   Depth = NewDepth;
-  isDepthCurrent = true;
+  SmallVector<SUnit*, 8> WorkList;
+  WorkList.push_back(this);
+  do {
+    SUnit *SU = WorkList.pop_back_val();
+    for (SUnit::const_succ_iterator I = SU->Succs.begin(),
+         E = SU->Succs.end(); I != E; ++I) {
+      SUnit *SuccSU = I->getSUnit();
+      unsigned SuccDepth = SU->Depth + I->getLatency();
+      if (SuccSU->isDepthCurrent && SuccDepth > SuccSU->Depth) {
+        SuccSU->Depth = SuccDepth;
+        WorkList.push_back(SuccSU);
+      }
+    }
+  } while (!WorkList.empty());
 }
 
 /// setHeightToAtLeast - Update this node's predecessors to reflect the
 /// fact that this node's height just increased.
 ///
+/// Like setDepthToAtLeast, this only visits the predecessors whose height
+/// changes.
 void SUnit::setHeightToAtLeast(unsigned NewHeight) {
   if (NewHeight <= getHeight())
     return;
-  setHeightDirty();
   Height = NewHeight;
-  isHeightCurrent = true;
+  SmallVector<SUnit*, 8> WorkList;
+  WorkList.push_back(this);
+  do {
+    SUnit *SU = WorkList.pop_back_val();
+    for (SUnit::const_pred_iterator I = SU->Preds.begin(),
+         E = SU->Preds.end(); I != E; ++I) {
+      SUnit *PredSU = I->getSUnit();
+      unsigned PredHeight = SU->Height + I->getLatency();
+      if (PredSU->isHeightCurrent && PredHeight > PredSU->Height) {
+        PredSU->Height = PredHeight;
+        WorkList.push_back(PredSU);
+      }
+    }
+  } while (!WorkList.empty());
 }
 
 /// ComputeDepth - Calculate the maximal path from the node to the exit.
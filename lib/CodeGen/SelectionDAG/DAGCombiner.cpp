@@ -64,6 +64,15 @@ namespace {
                              "slicing"),
                     cl::init(false));
 
+  /// DAGs with more nodes than this are combined operands first.  Visiting
+  /// users first lets reassociation move each constant up an expression
+  /// tree one level per combine, which is quadratic on huge basic blocks.
+  static cl::opt<unsigned>
+  TopologicalThreshold("combiner-topological-threshold", cl::Hidden,
+                       cl::desc("Visit DAGs with more nodes than this in "
+                                "topological order"),
+                       cl::init(2048));
+
 //------------------------------ DAGCombiner ---------------------------------//
 
   class DAGCombiner {
@@ -1016,10 +1025,20 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
   LegalOperations = Level >= AfterLegalizeVectorOps;
   LegalTypes = Level >= AfterLegalizeTypes;
 
-  // Add all the dag nodes to the worklist.
-  for (SelectionDAG::allnodes_iterator I = DAG.allnodes_begin(),
-       E = DAG.allnodes_end(); I != E; ++I)
-    AddToWorkList(I);
+  // Add all the dag nodes to the worklist.  The worklist is a stack, so on
+  // large DAGs push them in reverse topological order to pop operands before
+  // their users.
+  bool OperandsFirst = DAG.allnodes_size() > TopologicalThreshold;
+  if (OperandsFirst) {
+    DAG.AssignTopologicalOrder();
+    for (SelectionDAG::allnodes_iterator I = DAG.allnodes_end(),
+         E = DAG.allnodes_begin(); I != E; )
+      AddToWorkList(--I);
+  } else {
+    for (SelectionDAG::allnodes_iterator I = DAG.allnodes_begin(),
+         E = DAG.allnodes_end(); I != E; ++I)
+      AddToWorkList(I);
+  }
 
   // Create a dummy node (which is not added to allnodes), that adds a reference
   // to the root node, preventing it from being deleted, and tracking any
@@ -1054,6 +1073,24 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
       continue;
     }
 
+    // Users of a replaced node are pushed on top of the worklist, which would
+    // combine them ahead of operands still waiting further down.  On large
+    // DAGs put N back underneath those operands instead.
+    if (OperandsFirst) {
+      bool Deferred = false;
+      for (unsigned i = 0, e = N->getNumOperands(); i != e; ++i) {
+        SDNode *Op = N->getOperand(i).getNode();
+        if (!WorkListContents.count(Op))
+          continue;
+        if (!Deferred)
+          AddToWorkList(N);
+        Deferred = true;
+        WorkListOrder.push_back(Op);
+      }
+      if (Deferred)
+        continue;
+    }
+
     SDValue RV = combine(N);
 
     if (RV.getNode() == 0)
@@ -8814,7 +8851,9 @@ bool DAGCombiner::MergeConsecutiveStores(StoreSDNode* St) {
 
     // Replace the first store with the new store
     CombineTo(EarliestOp, NewStore);
-    // Erase all other stores.
+    // Erase all other stores.  Replacing their uses may CSE other nodes away,
+    // which must leave the worklist too.
+    WorkListRemover DeadNodes(*this);
     for (unsigned i = 0; i < NumElem ; ++i) {
       if (StoreNodes[i].MemNode == EarliestOp)
         continue;
@@ -8984,6 +9023,9 @@ bool DAGCombiner::MergeConsecutiveStores(StoreSDNode* St) {
                                   FirstInChain->getPointerInfo(), false, false,
                                   FirstInChain->getAlignment());
 
+  // Replacing uses below may CSE nodes away, which must leave the worklist.
+  WorkListRemover DeadNodes(*this);
+
   // Replace one of the loads with the new load.
   LoadSDNode *Ld = cast<LoadSDNode>(LoadNodes[0].MemNode);
   DAG.ReplaceAllUsesOfValueWith(SDValue(Ld, 1),
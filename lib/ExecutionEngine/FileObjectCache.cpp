@@ -0,0 +1,214 @@
+//===-- FileObjectCache.cpp - On-disk ObjectCache -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements FileObjectCache.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "object-cache"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if !defined(_MSC_VER) && !defined(__MINGW32__)
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+using namespace llvm;
+
+STATISTIC(NumHits, "Number of objects loaded from the cache");
+STATISTIC(NumMisses, "Number of objects not found in the cache");
+STATISTIC(NumStored, "Number of objects written to the cache");
+STATISTIC(NumPruned, "Number of objects removed to honour the size limit");
+
+static const char CacheFilePrefix[] = "llvmcache-";
+static const char CacheFileSuffix[] = ".o";
+
+FileObjectCache::FileObjectCache(StringRef Dir, StringRef TargetKey,
+                                 uint64_t MaxSize)
+  : CacheDir(Dir), TargetKey(TargetKey), MaxSize(MaxSize), UseCount(0) {
+  // A failure here shows up as a miss on every lookup and a failed store,
+  // both of which are harmless.
+  sys::fs::create_directories(CacheDir);
+}
+
+std::string FileObjectCache::getTargetKey(const TargetMachine &TM) {
+  const TargetOptions &O = TM.Options;
+  std::string Key;
+  raw_string_ostream OS(Key);
+  OS << TM.getTargetTriple() << '|' << TM.getTargetCPU() << '|'
+     << TM.getTargetFeatureString() << '|' << TM.getRelocationModel() << '|'
+     << TM.getCodeModel() << '|' << TM.getOptLevel() << '|';
+  // Everything TargetOptions compares in operator==.
+  OS << O.UnsafeFPMath << O.NoInfsFPMath << O.NoNaNsFPMath
+     << O.HonorSignDependentRoundingFPMathOption << O.UseSoftFloat
+     << O.NoZerosInBSS << O.JITEmitDebugInfo << O.JITEmitDebugInfoToDisk
+     << O.GuaranteedTailCallOpt << O.DisableTailCalls << O.EnableFastISel
+     << O.PositionIndependentExecutable << O.EnableSegmentedStacks
+     << O.UseInitArray << '|' << O.StackAlignmentOverride << '|'
+     << O.FloatABIType << '|' << O.AllowFPOpFusion << '|' << O.TrapFuncName;
+  return OS.str();
+}
+
+std::string FileObjectCache::getKey(const Module *M) const {
+  std::string Bitcode;
+  raw_string_ostream OS(Bitcode);
+  WriteBitcodeToFile(M, OS);
+
+  MD5 Hash;
+  Hash.update(OS.str());
+  // Keep the bitcode and the target key apart so that no combination of the
+  // two can collide with another.
+  static const uint8_t Separator = 0;
+  Hash.update(ArrayRef<uint8_t>(Separator));
+  Hash.update(TargetKey);
+  MD5::MD5Result Result;
+  Hash.final(Result);
+
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+std::string FileObjectCache::getObjectPath(StringRef Key) const {
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, Twine(CacheFilePrefix) + Key + CacheFileSuffix);
+  return Path.str();
+}
+
+MemoryBuffer *FileObjectCache::getObject(const Module *M) {
+  std::string Key = getKey(M);
+  std::string Path = getObjectPath(Key);
+
+  int FD;
+  if (sys::fs::openFileForRead(Path, FD)) {
+    ++NumMisses;
+    PendingKeys[M] = Key;
+    return 0;
+  }
+
+  uint64_t Size;
+  OwningPtr<MemoryBuffer> Obj;
+  error_code EC = sys::fs::file_size(Path, Size);
+  if (!EC)
+    EC = MemoryBuffer::getOpenFile(FD, Path.c_str(), Obj, Size,
+                                   /*RequiresNullTerminator=*/false);
+  // Bump the modification time, which is what prune() orders by.
+  if (!EC)
+    sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+  close(FD);
+
+  if (EC) {
+    ++NumMisses;
+    PendingKeys[M] = Key;
+    return 0;
+  }
+
+  DEBUG(dbgs() << "Object cache hit for '" << M->getModuleIdentifier()
+               << "': " << Path << "\n");
+  ++NumHits;
+  UseOrder[sys::path::filename(Path)] = ++UseCount;
+  return Obj.take();
+}
+
+void FileObjectCache::notifyObjectCompiled(const Module *M,
+                                           const MemoryBuffer *Obj) {
+  std::string Key;
+  DenseMap<const Module *, std::string>::iterator I = PendingKeys.find(M);
+  if (I != PendingKeys.end()) {
+    Key = I->second;
+    PendingKeys.erase(I);
+  } else {
+    Key = getKey(M);
+  }
+  std::string Path = getObjectPath(Key);
+
+  OwningPtr<FileOutputBuffer> Out;
+  if (FileOutputBuffer::create(Path, Obj->getBufferSize(), Out))
+    return;
+  memcpy(Out->getBufferStart(), Obj->getBufferStart(), Obj->getBufferSize());
+  if (Out->commit())
+    return;
+
+  DEBUG(dbgs() << "Object cache stored '" << M->getModuleIdentifier()
+               << "': " << Path << "\n");
+  ++NumStored;
+  UseOrder[sys::path::filename(Path)] = ++UseCount;
+
+  if (MaxSize)
+    prune();
+}
+
+namespace {
+  struct CacheEntry {
+    std::string Path;
+    uint64_t Size;
+    sys::TimeValue LastUse;
+    uint64_t Order;     // 0 for objects this cache has not used.
+
+    bool operator<(const CacheEntry &RHS) const {
+      if (LastUse != RHS.LastUse)
+        return LastUse < RHS.LastUse;
+      if (Order != RHS.Order)
+        return Order < RHS.Order;
+      return Path < RHS.Path;
+    }
+  };
+}
+
+void FileObjectCache::prune() {
+  std::vector<CacheEntry> Entries;
+  uint64_t Total = 0;
+
+  error_code EC;
+  for (sys::fs::directory_iterator I(CacheDir, EC), E; I != E && !EC;
+       I.increment(EC)) {
+    StringRef Name = sys::path::filename(I->path());
+    if (!Name.startswith(CacheFilePrefix) || !Name.endswith(CacheFileSuffix))
+      continue;
+    sys::fs::file_status Status;
+    if (I->status(Status) || !sys::fs::is_regular_file(Status))
+      continue;
+
+    CacheEntry Entry;
+    Entry.Path = I->path();
+    Entry.Size = Status.getSize();
+    Entry.LastUse = Status.getLastModificationTime();
+    StringMap<uint64_t>::iterator U = UseOrder.find(Name);
+    Entry.Order = U == UseOrder.end() ? 0 : U->second;
+    Entries.push_back(Entry);
+    Total += Entry.Size;
+  }
+
+  std::stable_sort(Entries.begin(), Entries.end());
+  for (std::vector<CacheEntry>::iterator I = Entries.begin(),
+       E = Entries.end(); I != E && Total > MaxSize; ++I) {
+    // Another process may have removed it already; either way it is gone.
+    sys::fs::remove(I->Path);
+    UseOrder.erase(sys::path::filename(I->Path));
+    Total -= I->Size;
+    ++NumPruned;
+  }
+}
@@ -0,0 +1,1267 @@
+//===-- DecodedExecution.cpp - Run functions in a pre-decoded form --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file contains the pre-decoded execution mode of the interpreter,
+// enabled with -interpreter-predecode.  The first call to a function
+// translates it into an array of DecodedInsts.  Each one holds a pointer to a
+// handler specialised for its opcode and operand types, and the numbers of
+// the frame slots its operands are read from and its result is written to.
+// Constants are evaluated once into the slots every new frame starts with,
+// and PHI nodes become copies made on the CFG edges into their block, so the
+// dispatch loop in runDecoded never looks at the IR.
+//
+// Instructions without a specialised handler, such as the vector and
+// aggregate operations, are run by the InstVisitor methods in Execution.cpp
+// after copying their operands into the frame's value map.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "interpreter"
+#include "Interpreter.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/IntrinsicLowering.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace llvm;
+
+STATISTIC(NumDecodedFunctions, "Number of functions pre-decoded");
+STATISTIC(NumDecodedInsts, "Number of pre-decoded instructions executed");
+
+/// NoSlot - Marks an absent operand or result.
+static const unsigned NoSlot = ~0U;
+
+namespace llvm {
+
+typedef void (*DecodedHandler)(Interpreter &, ExecutionContext &,
+                               const DecodedInst &);
+
+/// DecodedInst - One instruction of a DecodedFunction.
+struct DecodedInst {
+  DecodedHandler Run;  // Executes the instruction.
+  Instruction *Inst;   // The instruction this was decoded from.
+  unsigned Dest;       // The slot receiving the result, or NoSlot.
+  unsigned Op[3];      // Operand slots, edges, or a range of a list below.
+  uint64_t Imm;        // A size, offset or edge known when decoding.
+};
+
+/// DecodedEdge - A CFG edge and the copies that implement the PHI nodes at
+/// its destination.
+struct DecodedEdge {
+  BasicBlock *Dest;
+  unsigned Target;     // Index of the first non-PHI instruction of Dest.
+  unsigned FirstMove;  // Range of DecodedFunction::Moves.
+  unsigned NumMoves;
+  bool Overlapping;    // A copy reads a slot that an earlier one writes.
+};
+
+/// DecodedIndex - A variable index of a getelementptr.
+struct DecodedIndex {
+  unsigned Slot;
+  bool Is32Bit;
+  uint64_t Scale;
+};
+
+/// DecodedFunction - The pre-decoded form of a function.  Slots are numbered
+/// with the arguments first, then the instruction results, then the
+/// constants the function uses.
+struct DecodedFunction {
+  std::vector<DecodedInst> Code;
+  std::vector<GenericValue> InitialSlots;
+  std::vector<unsigned> Operands;  // Argument, case and edge lists.
+  std::vector<DecodedEdge> Edges;
+  std::vector<std::pair<unsigned, unsigned> > Moves; // Dest and source slot.
+  std::vector<DecodedIndex> Indices;
+  std::vector<GenericValue> EdgeValues; // Scratch space for copies.
+};
+
+/// FPTraits - Access to the member of GenericValue that holds a T.
+template <typename T> struct FPTraits;
+
+template <> struct FPTraits<float> {
+  static float get(const GenericValue &V) { return V.FloatVal; }
+  static void set(GenericValue &V, float X) { V.FloatVal = X; }
+  static APInt toAPInt(float X, unsigned Width) {
+    return APIntOps::RoundFloatToAPInt(X, Width);
+  }
+  static float fromAPInt(const APInt &X, bool Signed) {
+    return Signed ? APIntOps::RoundSignedAPIntToFloat(X)
+                  : APIntOps::RoundAPIntToFloat(X);
+  }
+  static float fromBits(const APInt &X) { return X.bitsToFloat(); }
+  static APInt toBits(float X) { return APInt::floatToBits(X); }
+};
+
+template <> struct FPTraits<double> {
+  static double get(const GenericValue &V) { return V.DoubleVal; }
+  static void set(GenericValue &V, double X) { V.DoubleVal = X; }
+  static APInt toAPInt(double X, unsigned Width) {
+    return APIntOps::RoundDoubleToAPInt(X, Width);
+  }
+  static double fromAPInt(const APInt &X, bool Signed) {
+    return Signed ? APIntOps::RoundSignedAPIntToDouble(X)
+                  : APIntOps::RoundAPIntToDouble(X);
+  }
+  static double fromBits(const APInt &X) { return X.bitsToDouble(); }
+  static APInt toBits(double X) { return APInt::doubleToBits(X); }
+};
+
+/// DecodedExecution - The instruction handlers, and the parts of decoding
+/// that need the interpreter's internals.
+struct DecodedExecution {
+  static GenericValue evaluateConstant(Interpreter &Interp, Value *V) {
+    ExecutionContext Empty;
+    return Interp.getOperandValue(V, Empty);
+  }
+
+  static void lowerIntrinsics(Interpreter &Interp, Function &F);
+  static DecodedFunction *decode(Interpreter &Interp, Function &F);
+
+  /// takeEdge - Make the copies for the PHI nodes at the end of \p Edge and
+  /// continue at its destination.  All of them are read before any is
+  /// written, as the PHI nodes of a block execute simultaneously.
+  static void takeEdge(ExecutionContext &SF, unsigned Edge) {
+    DecodedFunction &DF = *SF.Decoded;
+    const DecodedEdge &E = DF.Edges[Edge];
+    if (E.NumMoves) {
+      const std::pair<unsigned, unsigned> *M = &DF.Moves[E.FirstMove];
+      if (!E.Overlapping) {
+        for (unsigned i = 0; i != E.NumMoves; ++i)
+          SF.Slots[M[i].first] = SF.Slots[M[i].second];
+      } else {
+        for (unsigned i = 0; i != E.NumMoves; ++i)
+          DF.EdgeValues[i] = SF.Slots[M[i].second];
+        for (unsigned i = 0; i != E.NumMoves; ++i)
+          SF.Slots[M[i].first] = DF.EdgeValues[i];
+      }
+    }
+    SF.PC = &DF.Code[E.Target];
+  }
+
+  // Terminators.
+
+  static void ret(Interpreter &Interp, ExecutionContext &SF,
+                  const DecodedInst &I) {
+    Type *RetTy = SF.CurFunction->getReturnType();
+    GenericValue Result;
+    if (I.Op[0] != NoSlot)
+      Result = SF.Slots[I.Op[0]];
+    Interp.popStackAndReturnValueToCaller(RetTy, Result);
+  }
+
+  static void br(Interpreter &, ExecutionContext &SF, const DecodedInst &I) {
+    takeEdge(SF, I.Op[1]);
+  }
+
+  static void condBr(Interpreter &, ExecutionContext &SF,
+                     const DecodedInst &I) {
+    takeEdge(SF, SF.Slots[I.Op[0]].IntVal == 0 ? I.Op[2] : I.Op[1]);
+  }
+
+  static void switchInst(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &I) {
+    const std::vector<unsigned> &Ops = SF.Decoded->Operands;
+    const APInt &Cond = SF.Slots[I.Op[0]].IntVal;
+    for (unsigned i = I.Op[1], e = I.Op[1] + I.Op[2]; i != e; i += 2)
+      if (SF.Slots[Ops[i]].IntVal == Cond) {
+        takeEdge(SF, Ops[i + 1]);
+        return;
+      }
+    takeEdge(SF, I.Imm);
+  }
+
+  static void indirectBr(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &I) {
+    BasicBlock *Dest = (BasicBlock*)GVTOP(SF.Slots[I.Op[0]]);
+    const DecodedFunction &DF = *SF.Decoded;
+    for (unsigned i = I.Op[1], e = I.Op[1] + I.Op[2]; i != e; ++i)
+      if (DF.Edges[DF.Operands[i]].Dest == Dest) {
+        takeEdge(SF, DF.Operands[i]);
+        return;
+      }
+    llvm_unreachable("indirectbr to a block that is not a successor!");
+  }
+
+  static void unreachable(Interpreter &, ExecutionContext &,
+                          const DecodedInst &) {
+    report_fatal_error("Program executed an 'unreachable' instruction!");
+  }
+
+  // Calls.
+
+  static void call(Interpreter &Interp, ExecutionContext &SF,
+                   const DecodedInst &I) {
+    const std::vector<unsigned> &Ops = SF.Decoded->Operands;
+    std::vector<GenericValue> ArgVals;
+    ArgVals.reserve(I.Op[2]);
+    for (unsigned i = I.Op[1], e = I.Op[1] + I.Op[2]; i != e; ++i)
+      ArgVals.push_back(SF.Slots[Ops[i]]);
+
+    // The result is stored and any invoke edge taken by returnToDecodedCall.
+    // SF is invalid once the new frame has been pushed.
+    SF.PendingCall = &I;
+    Interp.callFunction((Function*)GVTOP(SF.Slots[I.Op[0]]), ArgVals);
+  }
+
+  static void vaStart(Interpreter &Interp, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    if (I.Dest == NoSlot)
+      return;
+    GenericValue &R = SF.Slots[I.Dest];
+    R.UIntPairVal.first = Interp.ECStack.size() - 1;
+    R.UIntPairVal.second = 0;
+  }
+
+  static void vaCopy(Interpreter &, ExecutionContext &SF,
+                     const DecodedInst &I) {
+    if (I.Dest != NoSlot)
+      SF.Slots[I.Dest] = SF.Slots[I.Op[0]];
+  }
+
+  static void nop(Interpreter &, ExecutionContext &, const DecodedInst &) {}
+
+  // Arithmetic and comparisons.
+
+  static unsigned getShiftAmount(const APInt &Amount, const APInt &Value) {
+    uint64_t Shift = Amount.getZExtValue();
+    unsigned Width = Value.getBitWidth();
+    if (Shift < (uint64_t)Width)
+      return Shift;
+    // Match the shifts by the width or more done by Execution.cpp.
+    return (NextPowerOf2(Width - 1) - 1) & Shift;
+  }
+
+  template <unsigned Opcode>
+  static void intBinary(Interpreter &, ExecutionContext &SF,
+                        const DecodedInst &I) {
+    const APInt &A = SF.Slots[I.Op[0]].IntVal;
+    const APInt &B = SF.Slots[I.Op[1]].IntVal;
+    APInt &R = SF.Slots[I.Dest].IntVal;
+    switch (Opcode) {
+    case Instruction::Add:  R = A + B; break;
+    case Instruction::Sub:  R = A - B; break;
+    case Instruction::Mul:  R = A * B; break;
+    case Instruction::UDiv: R = A.udiv(B); break;
+    case Instruction::SDiv: R = A.sdiv(B); break;
+    case Instruction::URem: R = A.urem(B); break;
+    case Instruction::SRem: R = A.srem(B); break;
+    case Instruction::And:  R = A & B; break;
+    case Instruction::Or:   R = A | B; break;
+    case Instruction::Xor:  R = A ^ B; break;
+    case Instruction::Shl:  R = A.shl(getShiftAmount(B, A)); break;
+    case Instruction::LShr: R = A.lshr(getShiftAmount(B, A)); break;
+    case Instruction::AShr: R = A.ashr(getShiftAmount(B, A)); break;
+    }
+  }
+
+  template <typename T, unsigned Opcode>
+  static void fpBinary(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    T A = FPTraits<T>::get(SF.Slots[I.Op[0]]);
+    T B = FPTraits<T>::get(SF.Slots[I.Op[1]]);
+    T R = 0;
+    switch (Opcode) {
+    case Instruction::FAdd: R = A + B; break;
+    case Instruction::FSub: R = A - B; break;
+    case Instruction::FMul: R = A * B; break;
+    case Instruction::FDiv: R = A / B; break;
+    case Instruction::FRem: R = fmod(A, B); break;
+    }
+    FPTraits<T>::set(SF.Slots[I.Dest], R);
+  }
+
+  template <unsigned Pred>
+  static void intCompare(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &I) {
+    const APInt &A = SF.Slots[I.Op[0]].IntVal;
+    const APInt &B = SF.Slots[I.Op[1]].IntVal;
+    bool R = false;
+    switch (Pred) {
+    case ICmpInst::ICMP_EQ:  R = A.eq(B); break;
+    case ICmpInst::ICMP_NE:  R = A.ne(B); break;
+    case ICmpInst::ICMP_ULT: R = A.ult(B); break;
+    case ICmpInst::ICMP_SLT: R = A.slt(B); break;
+    case ICmpInst::ICMP_UGT: R = A.ugt(B); break;
+    case ICmpInst::ICMP_SGT: R = A.sgt(B); break;
+    case ICmpInst::ICMP_ULE: R = A.ule(B); break;
+    case ICmpInst::ICMP_SLE: R = A.sle(B); break;
+    case ICmpInst::ICMP_UGE: R = A.uge(B); break;
+    case ICmpInst::ICMP_SGE: R = A.sge(B); break;
+    }
+    SF.Slots[I.Dest].IntVal = APInt(1, R);
+  }
+
+  /// pointerCompare - Pointers are compared as host addresses, whatever the
+  /// signedness of the predicate.
+  template <unsigned Pred>
+  static void pointerCompare(Interpreter &, ExecutionContext &SF,
+                             const DecodedInst &I) {
+    void *A = SF.Slots[I.Op[0]].PointerVal;
+    void *B = SF.Slots[I.Op[1]].PointerVal;
+    bool R = false;
+    switch (Pred) {
+    case ICmpInst::ICMP_EQ:  R = A == B; break;
+    case ICmpInst::ICMP_NE:  R = A != B; break;
+    case ICmpInst::ICMP_ULT:
+    case ICmpInst::ICMP_SLT: R = A < B; break;
+    case ICmpInst::ICMP_UGT:
+    case ICmpInst::ICMP_SGT: R = A > B; break;
+    case ICmpInst::ICMP_ULE:
+    case ICmpInst::ICMP_SLE: R = A <= B; break;
+    case ICmpInst::ICMP_UGE:
+    case ICmpInst::ICMP_SGE: R = A >= B; break;
+    }
+    SF.Slots[I.Dest].IntVal = APInt(1, R);
+  }
+
+  template <typename T, unsigned Pred>
+  static void fpCompare(Interpreter &, ExecutionContext &SF,
+                        const DecodedInst &I) {
+    T A = FPTraits<T>::get(SF.Slots[I.Op[0]]);
+    T B = FPTraits<T>::get(SF.Slots[I.Op[1]]);
+    bool Unordered = A != A || B != B;
+    bool R = false;
+    switch (Pred) {
+    case FCmpInst::FCMP_FALSE: R = false; break;
+    case FCmpInst::FCMP_OEQ:   R = A == B; break;
+    case FCmpInst::FCMP_OGT:   R = A > B; break;
+    case FCmpInst::FCMP_OGE:   R = A >= B; break;
+    case FCmpInst::FCMP_OLT:   R = A < B; break;
+    case FCmpInst::FCMP_OLE:   R = A <= B; break;
+    case FCmpInst::FCMP_ONE:   R = !Unordered && A != B; break;
+    case FCmpInst::FCMP_ORD:   R = !Unordered; break;
+    case FCmpInst::FCMP_UNO:   R = Unordered; break;
+    case FCmpInst::FCMP_UEQ:   R = Unordered || A == B; break;
+    case FCmpInst::FCMP_UGT:   R = Unordered || A > B; break;
+    case FCmpInst::FCMP_UGE:   R = Unordered || A >= B; break;
+    case FCmpInst::FCMP_ULT:   R = Unordered || A < B; break;
+    case FCmpInst::FCMP_ULE:   R = Unordered || A <= B; break;
+    case FCmpInst::FCMP_UNE:   R = A != B; break;
+    case FCmpInst::FCMP_TRUE:  R = true; break;
+    }
+    SF.Slots[I.Dest].IntVal = APInt(1, R);
+  }
+
+  static void selectInt(Interpreter &, ExecutionContext &SF,
+                        const DecodedInst &I) {
+    unsigned Src = SF.Slots[I.Op[0]].IntVal == 0 ? I.Op[2] : I.Op[1];
+    SF.Slots[I.Dest].IntVal = SF.Slots[Src].IntVal;
+  }
+
+  /// selectScalar - Select a float, double or pointer, all of which are held
+  /// in the untyped part of a GenericValue.
+  static void selectScalar(Interpreter &, ExecutionContext &SF,
+                           const DecodedInst &I) {
+    unsigned Src = SF.Slots[I.Op[0]].IntVal == 0 ? I.Op[2] : I.Op[1];
+    memcpy(SF.Slots[I.Dest].Untyped, SF.Slots[Src].Untyped,
+           sizeof(GenericValue().Untyped));
+  }
+
+  static void selectAny(Interpreter &, ExecutionContext &SF,
+                        const DecodedInst &I) {
+    unsigned Src = SF.Slots[I.Op[0]].IntVal == 0 ? I.Op[2] : I.Op[1];
+    SF.Slots[I.Dest] = SF.Slots[Src];
+  }
+
+  // Casts.
+
+  static void intTrunc(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal = SF.Slots[I.Op[0]].IntVal.trunc(I.Imm);
+  }
+
+  static void intZExt(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal = SF.Slots[I.Op[0]].IntVal.zext(I.Imm);
+  }
+
+  static void intSExt(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal = SF.Slots[I.Op[0]].IntVal.sext(I.Imm);
+  }
+
+  static void fpTrunc(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    SF.Slots[I.Dest].FloatVal = (float)SF.Slots[I.Op[0]].DoubleVal;
+  }
+
+  static void fpExt(Interpreter &, ExecutionContext &SF,
+                    const DecodedInst &I) {
+    SF.Slots[I.Dest].DoubleVal = (double)SF.Slots[I.Op[0]].FloatVal;
+  }
+
+  template <typename T>
+  static void fpToInt(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal =
+      FPTraits<T>::toAPInt(FPTraits<T>::get(SF.Slots[I.Op[0]]), I.Imm);
+  }
+
+  template <typename T, bool Signed>
+  static void intToFP(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    FPTraits<T>::set(SF.Slots[I.Dest],
+                     FPTraits<T>::fromAPInt(SF.Slots[I.Op[0]].IntVal, Signed));
+  }
+
+  static void ptrToInt(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal =
+      APInt(I.Imm, (intptr_t)SF.Slots[I.Op[0]].PointerVal);
+  }
+
+  static void intToPtr(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    const APInt &Src = SF.Slots[I.Op[0]].IntVal;
+    uint64_t Addr = Src.getBitWidth() == I.Imm
+                      ? Src.getZExtValue()
+                      : Src.zextOrTrunc(I.Imm).getZExtValue();
+    SF.Slots[I.Dest].PointerVal = PointerTy(intptr_t(Addr));
+  }
+
+  static void copyInt(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal = SF.Slots[I.Op[0]].IntVal;
+  }
+
+  static void copyScalar(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &I) {
+    memcpy(SF.Slots[I.Dest].Untyped, SF.Slots[I.Op[0]].Untyped,
+           sizeof(GenericValue().Untyped));
+  }
+
+  template <typename T>
+  static void fpToBits(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    SF.Slots[I.Dest].IntVal =
+      FPTraits<T>::toBits(FPTraits<T>::get(SF.Slots[I.Op[0]]));
+  }
+
+  template <typename T>
+  static void bitsToFP(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    FPTraits<T>::set(SF.Slots[I.Dest],
+                     FPTraits<T>::fromBits(SF.Slots[I.Op[0]].IntVal));
+  }
+
+  // Memory.
+
+  static void allocaInst(Interpreter &, ExecutionContext &SF,
+                     const DecodedInst &I) {
+    unsigned NumElements = SF.Slots[I.Op[0]].IntVal.getZExtValue();
+    unsigned MemToAlloc = std::max(1U, NumElements * unsigned(I.Imm));
+    void *Memory = malloc(MemToAlloc);
+    assert(Memory != 0 && "Null pointer returned by malloc!");
+    SF.Slots[I.Dest].PointerVal = Memory;
+    SF.Allocas.add(Memory);
+  }
+
+  // Loads and stores go through memcpy, as the address need not be aligned
+  // for the host type.
+
+  /// loadInt - Load an integer whose width is that of T, from memory in the
+  /// host's byte order.
+  template <typename T>
+  static void loadInt(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    T Value;
+    memcpy(&Value, SF.Slots[I.Op[0]].PointerVal, sizeof(T));
+    SF.Slots[I.Dest].IntVal = APInt(sizeof(T) * 8, Value);
+  }
+
+  template <typename T>
+  static void loadFP(Interpreter &, ExecutionContext &SF,
+                     const DecodedInst &I) {
+    T Value;
+    memcpy(&Value, SF.Slots[I.Op[0]].PointerVal, sizeof(T));
+    FPTraits<T>::set(SF.Slots[I.Dest], Value);
+  }
+
+  static void loadPointer(Interpreter &, ExecutionContext &SF,
+                          const DecodedInst &I) {
+    PointerTy Value;
+    memcpy(&Value, SF.Slots[I.Op[0]].PointerVal, sizeof(PointerTy));
+    SF.Slots[I.Dest].PointerVal = Value;
+  }
+
+  static void loadAny(Interpreter &Interp, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    Interp.LoadValueFromMemory(SF.Slots[I.Dest],
+                               (GenericValue*)SF.Slots[I.Op[0]].PointerVal,
+                               I.Inst->getType());
+  }
+
+  template <typename T>
+  static void storeInt(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    T Value = (T)SF.Slots[I.Op[0]].IntVal.getZExtValue();
+    memcpy(SF.Slots[I.Op[1]].PointerVal, &Value, sizeof(T));
+  }
+
+  template <typename T>
+  static void storeFP(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    T Value = FPTraits<T>::get(SF.Slots[I.Op[0]]);
+    memcpy(SF.Slots[I.Op[1]].PointerVal, &Value, sizeof(T));
+  }
+
+  static void storePointer(Interpreter &, ExecutionContext &SF,
+                           const DecodedInst &I) {
+    PointerTy Value = SF.Slots[I.Op[0]].PointerVal;
+    memcpy(SF.Slots[I.Op[1]].PointerVal, &Value, sizeof(PointerTy));
+  }
+
+  static void storeAny(Interpreter &Interp, ExecutionContext &SF,
+                       const DecodedInst &I) {
+    Interp.StoreValueToMemory(SF.Slots[I.Op[0]],
+                              (GenericValue*)SF.Slots[I.Op[1]].PointerVal,
+                              I.Inst->getOperand(0)->getType());
+  }
+
+  /// gepConstant - A getelementptr whose offset is known when decoding.
+  static void gepConstant(Interpreter &, ExecutionContext &SF,
+                          const DecodedInst &I) {
+    SF.Slots[I.Dest].PointerVal =
+      (char*)SF.Slots[I.Op[0]].PointerVal + I.Imm;
+  }
+
+  static void gep(Interpreter &, ExecutionContext &SF, const DecodedInst &I) {
+    const std::vector<DecodedIndex> &Indices = SF.Decoded->Indices;
+    uint64_t Total = I.Imm;
+    for (unsigned i = I.Op[1], e = I.Op[1] + I.Op[2]; i != e; ++i) {
+      const DecodedIndex &Index = Indices[i];
+      uint64_t Idx = SF.Slots[Index.Slot].IntVal.getZExtValue();
+      if (Index.Is32Bit)
+        Total += Index.Scale * (int64_t)(int32_t)Idx;
+      else
+        Total += Index.Scale * (int64_t)Idx;
+    }
+    SF.Slots[I.Dest].PointerVal = (char*)SF.Slots[I.Op[0]].PointerVal + Total;
+  }
+
+  /// generic - Run an instruction with its InstVisitor method, passing the
+  /// operands and the result through the frame's value map.
+  static void generic(Interpreter &Interp, ExecutionContext &SF,
+                      const DecodedInst &I) {
+    Instruction *Inst = I.Inst;
+    const std::vector<unsigned> &Ops = SF.Decoded->Operands;
+    for (unsigned i = 0; i != I.Op[2]; ++i)
+      if (Ops[I.Op[1] + i] != NoSlot)
+        SF.Values[Inst->getOperand(i)] = SF.Slots[Ops[I.Op[1] + i]];
+    Interp.visit(*Inst);
+    if (I.Dest != NoSlot)
+      SF.Slots[I.Dest] = SF.Values[Inst];
+    SF.Values.clear();
+  }
+};
+
+} // End llvm namespace
+
+namespace {
+
+/// FunctionDecoder - Translates one function into a DecodedFunction.
+class FunctionDecoder {
+  Interpreter &Interp;
+  const DataLayout &TD;
+  DecodedFunction &DF;
+  DenseMap<Value*, unsigned> SlotMap;
+  DenseMap<std::pair<BasicBlock*, BasicBlock*>, unsigned> EdgeMap;
+
+public:
+  FunctionDecoder(Interpreter &Interp, DecodedFunction &DF)
+    : Interp(Interp), TD(*Interp.getDataLayout()), DF(DF) {}
+
+  void decode(Function &F);
+
+private:
+  unsigned getSlot(Value *V);
+  unsigned getEdge(BasicBlock *From, BasicBlock *To);
+
+  void decodeInst(DecodedInst &D);
+  void decodeCall(DecodedInst &D);
+  void decodeGEP(DecodedInst &D);
+  void decodeCast(DecodedInst &D);
+  void decodeGeneric(DecodedInst &D);
+
+  DecodedHandler getIntBinaryHandler(unsigned Opcode);
+  template <typename T> DecodedHandler getFPBinaryHandler(unsigned Opcode);
+  DecodedHandler getIntCompareHandler(unsigned Pred);
+  DecodedHandler getPointerCompareHandler(unsigned Pred);
+  template <typename T> DecodedHandler getFPCompareHandler(unsigned Pred);
+  DecodedHandler getLoadHandler(Type *Ty);
+  DecodedHandler getStoreHandler(Type *Ty);
+};
+
+} // End anonymous namespace
+
+/// getSlot - Return the slot holding \p V, giving constants and globals a
+/// slot with their value the first time they are used.
+unsigned FunctionDecoder::getSlot(Value *V) {
+  DenseMap<Value*, unsigned>::iterator I = SlotMap.find(V);
+  if (I != SlotMap.end())
+    return I->second;
+
+  unsigned Slot = DF.InitialSlots.size();
+  DF.InitialSlots.push_back(DecodedExecution::evaluateConstant(Interp, V));
+  SlotMap[V] = Slot;
+  return Slot;
+}
+
+/// getEdge - Return the edge from \p From to \p To, creating it and the
+/// copies for the PHI nodes in \p To if this is the first branch along it.
+unsigned FunctionDecoder::getEdge(BasicBlock *From, BasicBlock *To) {
+  std::pair<BasicBlock*, BasicBlock*> Key(From, To);
+  DenseMap<std::pair<BasicBlock*, BasicBlock*>, unsigned>::iterator I =
+    EdgeMap.find(Key);
+  if (I != EdgeMap.end())
+    return I->second;
+
+  DecodedEdge E;
+  E.Dest = To;
+  E.Target = 0;
+  E.FirstMove = DF.Moves.size();
+  for (BasicBlock::iterator BI = To->begin(); isa<PHINode>(BI); ++BI) {
+    PHINode *PN = cast<PHINode>(BI);
+    unsigned Dest = SlotMap[PN];
+    unsigned Src = getSlot(PN->getIncomingValueForBlock(From));
+    DF.Moves.push_back(std::make_pair(Dest, Src));
+  }
+  E.NumMoves = DF.Moves.size() - E.FirstMove;
+
+  // Copying in order only works if no copy reads what an earlier one wrote.
+  E.Overlapping = false;
+  for (unsigned i = E.FirstMove, e = DF.Moves.size(); i != e; ++i)
+    for (unsigned j = i + 1; j != e; ++j)
+      if (DF.Moves[j].second == DF.Moves[i].first)
+        E.Overlapping = true;
+  if (E.Overlapping && DF.EdgeValues.size() < E.NumMoves)
+    DF.EdgeValues.resize(E.NumMoves);
+
+  unsigned Edge = DF.Edges.size();
+  DF.Edges.push_back(E);
+  EdgeMap[Key] = Edge;
+  return Edge;
+}
+
+void FunctionDecoder::decode(Function &F) {
+  // Arguments and results get the first slots, and the constants are added
+  // after them as they are found.
+  unsigned NumSlots = 0;
+  for (Function::arg_iterator AI = F.arg_begin(), E = F.arg_end(); AI != E;
+       ++AI)
+    SlotMap[AI] = NumSlots++;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if (!I->getType()->isVoidTy())
+      SlotMap[&*I] = NumSlots++;
+  DF.InitialSlots.resize(NumSlots);
+
+  DenseMap<BasicBlock*, unsigned> BlockStarts;
+  for (Function::iterator BB = F.begin(), BE = F.end(); BB != BE; ++BB) {
+    BlockStarts[BB] = DF.Code.size();
+    for (BasicBlock::iterator I = BB->getFirstNonPHI(), E = BB->end(); I != E;
+         ++I) {
+      Instruction *Inst = I;
+      DecodedInst D;
+      D.Run = 0;
+      D.Inst = Inst;
+      D.Dest = Inst->getType()->isVoidTy() ? NoSlot : SlotMap[Inst];
+      D.Op[0] = D.Op[1] = D.Op[2] = NoSlot;
+      D.Imm = 0;
+      decodeInst(D);
+      if (!D.Run)
+        decodeGeneric(D);
+      DF.Code.push_back(D);
+    }
+  }
+
+  for (unsigned i = 0, e = DF.Edges.size(); i != e; ++i)
+    DF.Edges[i].Target = BlockStarts[DF.Edges[i].Dest];
+
+  DEBUG(dbgs() << "Pre-decoded " << F.getName() << ": " << DF.Code.size()
+               << " instructions, " << DF.InitialSlots.size() << " slots, "
+               << DF.Edges.size() << " edges\n");
+}
+
+/// decodeInst - Pick a specialised handler for the instruction and resolve
+/// its operands, or leave D.Run null to use the InstVisitor.
+void FunctionDecoder::decodeInst(DecodedInst &D) {
+  Instruction &I = *D.Inst;
+  BasicBlock *BB = I.getParent();
+  Type *Ty = I.getType();
+
+  switch (I.getOpcode()) {
+  case Instruction::Ret:
+    if (I.getNumOperands())
+      D.Op[0] = getSlot(I.getOperand(0));
+    D.Run = DecodedExecution::ret;
+    return;
+  case Instruction::Br: {
+    BranchInst &BI = cast<BranchInst>(I);
+    D.Op[1] = getEdge(BB, BI.getSuccessor(0));
+    if (BI.isUnconditional()) {
+      D.Run = DecodedExecution::br;
+    } else {
+      D.Op[0] = getSlot(BI.getCondition());
+      D.Op[2] = getEdge(BB, BI.getSuccessor(1));
+      D.Run = DecodedExecution::condBr;
+    }
+    return;
+  }
+  case Instruction::Switch: {
+    SwitchInst &SI = cast<SwitchInst>(I);
+    D.Op[0] = getSlot(SI.getCondition());
+    D.Imm = getEdge(BB, SI.getDefaultDest());
+    SmallVector<unsigned, 16> Cases;
+    for (SwitchInst::CaseIt i = SI.case_begin(), e = SI.case_end(); i != e;
+         ++i) {
+      Cases.push_back(getSlot(i.getCaseValue()));
+      Cases.push_back(getEdge(BB, i.getCaseSuccessor()));
+    }
+    D.Op[1] = DF.Operands.size();
+    D.Op[2] = Cases.size();
+    DF.Operands.insert(DF.Operands.end(), Cases.begin(), Cases.end());
+    D.Run = DecodedExecution::switchInst;
+    return;
+  }
+  case Instruction::IndirectBr: {
+    IndirectBrInst &IBI = cast<IndirectBrInst>(I);
+    D.Op[0] = getSlot(IBI.getAddress());
+    SmallVector<unsigned, 8> Edges;
+    for (unsigned i = 0, e = IBI.getNumDestinations(); i != e; ++i)
+      Edges.push_back(getEdge(BB, IBI.getDestination(i)));
+    D.Op[1] = DF.Operands.size();
+    D.Op[2] = Edges.size();
+    DF.Operands.insert(DF.Operands.end(), Edges.begin(), Edges.end());
+    D.Run = DecodedExecution::indirectBr;
+    return;
+  }
+  case Instruction::Unreachable:
+    D.Run = DecodedExecution::unreachable;
+    return;
+  case Instruction::Call:
+  case Instruction::Invoke:
+    decodeCall(D);
+    return;
+  case Instruction::Alloca:
+    D.Op[0] = getSlot(I.getOperand(0));
+    D.Imm =
+      unsigned(TD.getTypeAllocSize(cast<AllocaInst>(I).getAllocatedType()));
+    D.Run = DecodedExecution::allocaInst;
+    return;
+  case Instruction::Load:
+    // Volatile accesses go through the InstVisitor, which can print them.
+    if (cast<LoadInst>(I).isVolatile())
+      return;
+    D.Op[0] = getSlot(I.getOperand(0));
+    D.Run = getLoadHandler(Ty);
+    return;
+  case Instruction::Store:
+    if (cast<StoreInst>(I).isVolatile())
+      return;
+    D.Op[0] = getSlot(I.getOperand(0));
+    D.Op[1] = getSlot(I.getOperand(1));
+    D.Run = getStoreHandler(I.getOperand(0)->getType());
+    return;
+  case Instruction::GetElementPtr:
+    decodeGEP(D);
+    return;
+  case Instruction::Select: {
+    if (I.getOperand(0)->getType()->isVectorTy())
+      return;
+    if (Ty->isIntegerTy())
+      D.Run = DecodedExecution::selectInt;
+    else if (Ty->isFloatTy() || Ty->isDoubleTy() || Ty->isPointerTy())
+      D.Run = DecodedExecution::selectScalar;
+    else if (!Ty->isVectorTy())
+      D.Run = DecodedExecution::selectAny;
+    else
+      return;
+    for (unsigned i = 0; i != 3; ++i)
+      D.Op[i] = getSlot(I.getOperand(i));
+    return;
+  }
+  case Instruction::ICmp: {
+    Type *OpTy = I.getOperand(0)->getType();
+    unsigned Pred = cast<ICmpInst>(I).getPredicate();
+    if (OpTy->isIntegerTy())
+      D.Run = getIntCompareHandler(Pred);
+    else if (OpTy->isPointerTy())
+      D.Run = getPointerCompareHandler(Pred);
+    break;
+  }
+  case Instruction::FCmp: {
+    Type *OpTy = I.getOperand(0)->getType();
+    unsigned Pred = cast<FCmpInst>(I).getPredicate();
+    if (OpTy->isFloatTy())
+      D.Run = getFPCompareHandler<float>(Pred);
+    else if (OpTy->isDoubleTy())
+      D.Run = getFPCompareHandler<double>(Pred);
+    break;
+  }
+  default:
+    if (I.isBinaryOp()) {
+      if (Ty->isIntegerTy())
+        D.Run = getIntBinaryHandler(I.getOpcode());
+      else if (Ty->isFloatTy())
+        D.Run = getFPBinaryHandler<float>(I.getOpcode());
+      else if (Ty->isDoubleTy())
+        D.Run = getFPBinaryHandler<double>(I.getOpcode());
+      break;
+    }
+    if (I.isCast())
+      decodeCast(D);
+    return;
+  }
+
+  // Binary operators and comparisons.
+  if (D.Run) {
+    D.Op[0] = getSlot(I.getOperand(0));
+    D.Op[1] = getSlot(I.getOperand(1));
+  }
+}
+
+void FunctionDecoder::decodeCall(DecodedInst &D) {
+  CallSite CS(D.Inst);
+  if (Function *F = CS.getCalledFunction())
+    switch (F->getIntrinsicID()) {
+    default:
+      break;
+    case Intrinsic::vastart:
+      D.Run = DecodedExecution::vaStart;
+      return;
+    case Intrinsic::vaend:    // va_end is a noop for the interpreter
+      D.Run = DecodedExecution::nop;
+      return;
+    case Intrinsic::vacopy:
+      D.Op[0] = getSlot(*CS.arg_begin());
+      D.Run = DecodedExecution::vaCopy;
+      return;
+    }
+
+  SmallVector<unsigned, 8> Args;
+  for (CallSite::arg_iterator i = CS.arg_begin(), e = CS.arg_end(); i != e;
+       ++i)
+    Args.push_back(getSlot(*i));
+  D.Op[0] = getSlot(CS.getCalledValue());
+  D.Op[1] = DF.Operands.size();
+  D.Op[2] = Args.size();
+  DF.Operands.insert(DF.Operands.end(), Args.begin(), Args.end());
+  if (InvokeInst *II = dyn_cast<InvokeInst>(D.Inst))
+    D.Imm = getEdge(II->getParent(), II->getNormalDest());
+  D.Run = DecodedExecution::call;
+}
+
+/// decodeGEP - Fold the structure fields and constant array indices into one
+/// offset, leaving a scaled index per variable array index.
+void FunctionDecoder::decodeGEP(DecodedInst &D) {
+  GetElementPtrInst &GEP = cast<GetElementPtrInst>(*D.Inst);
+  if (GEP.getType()->isVectorTy())
+    return;
+
+  uint64_t Offset = 0;
+  SmallVector<DecodedIndex, 4> Indices;
+  for (gep_type_iterator I = gep_type_begin(GEP), E = gep_type_end(GEP);
+       I != E; ++I) {
+    if (StructType *STy = dyn_cast<StructType>(*I)) {
+      unsigned Field = cast<ConstantInt>(I.getOperand())->getZExtValue();
+      Offset += TD.getStructLayout(STy)->getElementOffset(Field);
+      continue;
+    }
+
+    // Other index widths are rejected by the InstVisitor.
+    unsigned BitWidth =
+      cast<IntegerType>(I.getOperand()->getType())->getBitWidth();
+    if (BitWidth != 32 && BitWidth != 64)
+      return;
+    uint64_t Scale =
+      TD.getTypeAllocSize(cast<SequentialType>(*I)->getElementType());
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(I.getOperand())) {
+      Offset += Scale * CI->getSExtValue();
+      continue;
+    }
+    DecodedIndex Index;
+    Index.Slot = getSlot(I.getOperand());
+    Index.Is32Bit = BitWidth == 32;
+    Index.Scale = Scale;
+    Indices.push_back(Index);
+  }
+
+  D.Op[0] = getSlot(GEP.getPointerOperand());
+  D.Imm = Offset;
+  if (Indices.empty()) {
+    D.Run = DecodedExecution::gepConstant;
+    return;
+  }
+  D.Op[1] = DF.Indices.size();
+  D.Op[2] = Indices.size();
+  DF.Indices.insert(DF.Indices.end(), Indices.begin(), Indices.end());
+  D.Run = DecodedExecution::gep;
+}
+
+/// decodeCast - Handle the scalar casts.  Vector casts and bitcasts to or
+/// from vectors use the InstVisitor.
+void FunctionDecoder::decodeCast(DecodedInst &D) {
+  Instruction &I = *D.Inst;
+  Type *SrcTy = I.getOperand(0)->getType();
+  Type *DstTy = I.getType();
+  if (SrcTy->isVectorTy() || DstTy->isVectorTy())
+    return;
+
+  DecodedHandler Run = 0;
+  switch (I.getOpcode()) {
+  case Instruction::Trunc:
+    Run = DecodedExecution::intTrunc;
+    D.Imm = DstTy->getIntegerBitWidth();
+    break;
+  case Instruction::ZExt:
+    Run = DecodedExecution::intZExt;
+    D.Imm = DstTy->getIntegerBitWidth();
+    break;
+  case Instruction::SExt:
+    Run = DecodedExecution::intSExt;
+    D.Imm = DstTy->getIntegerBitWidth();
+    break;
+  case Instruction::FPTrunc:
+    if (SrcTy->isDoubleTy() && DstTy->isFloatTy())
+      Run = DecodedExecution::fpTrunc;
+    break;
+  case Instruction::FPExt:
+    if (SrcTy->isFloatTy() && DstTy->isDoubleTy())
+      Run = DecodedExecution::fpExt;
+    break;
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+    // Both round towards zero into an APInt of the destination width.
+    if (SrcTy->isFloatTy())
+      Run = DecodedExecution::fpToInt<float>;
+    else if (SrcTy->isDoubleTy())
+      Run = DecodedExecution::fpToInt<double>;
+    D.Imm = DstTy->getIntegerBitWidth();
+    break;
+  case Instruction::UIToFP:
+    if (DstTy->isFloatTy())
+      Run = DecodedExecution::intToFP<float, false>;
+    else if (DstTy->isDoubleTy())
+      Run = DecodedExecution::intToFP<double, false>;
+    break;
+  case Instruction::SIToFP:
+    if (DstTy->isFloatTy())
+      Run = DecodedExecution::intToFP<float, true>;
+    else if (DstTy->isDoubleTy())
+      Run = DecodedExecution::intToFP<double, true>;
+    break;
+  case Instruction::PtrToInt:
+    Run = DecodedExecution::ptrToInt;
+    D.Imm = DstTy->getIntegerBitWidth();
+    break;
+  case Instruction::IntToPtr:
+    Run = DecodedExecution::intToPtr;
+    D.Imm = TD.getPointerSizeInBits();
+    break;
+  case Instruction::BitCast:
+    if (DstTy->isPointerTy())
+      Run = DecodedExecution::copyScalar;
+    else if (DstTy->isIntegerTy() && SrcTy->isIntegerTy())
+      Run = DecodedExecution::copyInt;
+    else if (DstTy->isIntegerTy() && SrcTy->isFloatTy())
+      Run = DecodedExecution::fpToBits<float>;
+    else if (DstTy->isIntegerTy() && SrcTy->isDoubleTy())
+      Run = DecodedExecution::fpToBits<double>;
+    else if (DstTy->isFloatTy() && SrcTy->isIntegerTy())
+      Run = DecodedExecution::bitsToFP<float>;
+    else if (DstTy->isDoubleTy() && SrcTy->isIntegerTy())
+      Run = DecodedExecution::bitsToFP<double>;
+    else if (DstTy == SrcTy && (DstTy->isFloatTy() || DstTy->isDoubleTy()))
+      Run = DecodedExecution::copyScalar;
+    break;
+  }
+
+  if (Run) {
+    D.Op[0] = getSlot(I.getOperand(0));
+    D.Run = Run;
+  }
+}
+
+void FunctionDecoder::decodeGeneric(DecodedInst &D) {
+  // Constants are left for the InstVisitor to evaluate.
+  SmallVector<unsigned, 8> Ops;
+  for (unsigned i = 0, e = D.Inst->getNumOperands(); i != e; ++i) {
+    Value *V = D.Inst->getOperand(i);
+    Ops.push_back(isa<Constant>(V) || isa<BasicBlock>(V) ? NoSlot
+                                                         : getSlot(V));
+  }
+  D.Op[1] = DF.Operands.size();
+  D.Op[2] = Ops.size();
+  DF.Operands.insert(DF.Operands.end(), Ops.begin(), Ops.end());
+  D.Run = DecodedExecution::generic;
+}
+
+DecodedHandler FunctionDecoder::getIntBinaryHandler(unsigned Opcode) {
+  switch (Opcode) {
+  default: return 0;
+  case Instruction::Add:  return DecodedExecution::intBinary<Instruction::Add>;
+  case Instruction::Sub:  return DecodedExecution::intBinary<Instruction::Sub>;
+  case Instruction::Mul:  return DecodedExecution::intBinary<Instruction::Mul>;
+  case Instruction::UDiv: return DecodedExecution::intBinary<Instruction::UDiv>;
+  case Instruction::SDiv: return DecodedExecution::intBinary<Instruction::SDiv>;
+  case Instruction::URem: return DecodedExecution::intBinary<Instruction::URem>;
+  case Instruction::SRem: return DecodedExecution::intBinary<Instruction::SRem>;
+  case Instruction::And:  return DecodedExecution::intBinary<Instruction::And>;
+  case Instruction::Or:   return DecodedExecution::intBinary<Instruction::Or>;
+  case Instruction::Xor:  return DecodedExecution::intBinary<Instruction::Xor>;
+  case Instruction::Shl:  return DecodedExecution::intBinary<Instruction::Shl>;
+  case Instruction::LShr: return DecodedExecution::intBinary<Instruction::LShr>;
+  case Instruction::AShr: return DecodedExecution::intBinary<Instruction::AShr>;
+  }
+}
+
+template <typename T>
+DecodedHandler FunctionDecoder::getFPBinaryHandler(unsigned Opcode) {
+  switch (Opcode) {
+  default: return 0;
+  case Instruction::FAdd:
+    return DecodedExecution::fpBinary<T, Instruction::FAdd>;
+  case Instruction::FSub:
+    return DecodedExecution::fpBinary<T, Instruction::FSub>;
+  case Instruction::FMul:
+    return DecodedExecution::fpBinary<T, Instruction::FMul>;
+  case Instruction::FDiv:
+    return DecodedExecution::fpBinary<T, Instruction::FDiv>;
+  case Instruction::FRem:
+    return DecodedExecution::fpBinary<T, Instruction::FRem>;
+  }
+}
+
+DecodedHandler FunctionDecoder::getIntCompareHandler(unsigned Pred) {
+  switch (Pred) {
+  default: return 0;
+  case ICmpInst::ICMP_EQ:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_EQ>;
+  case ICmpInst::ICMP_NE:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_NE>;
+  case ICmpInst::ICMP_ULT:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_ULT>;
+  case ICmpInst::ICMP_SLT:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_SLT>;
+  case ICmpInst::ICMP_UGT:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_UGT>;
+  case ICmpInst::ICMP_SGT:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_SGT>;
+  case ICmpInst::ICMP_ULE:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_ULE>;
+  case ICmpInst::ICMP_SLE:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_SLE>;
+  case ICmpInst::ICMP_UGE:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_UGE>;
+  case ICmpInst::ICMP_SGE:
+    return DecodedExecution::intCompare<ICmpInst::ICMP_SGE>;
+  }
+}
+
+DecodedHandler FunctionDecoder::getPointerCompareHandler(unsigned Pred) {
+  switch (Pred) {
+  default: return 0;
+  case ICmpInst::ICMP_EQ:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_EQ>;
+  case ICmpInst::ICMP_NE:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_NE>;
+  case ICmpInst::ICMP_ULT:
+  case ICmpInst::ICMP_SLT:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_ULT>;
+  case ICmpInst::ICMP_UGT:
+  case ICmpInst::ICMP_SGT:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_UGT>;
+  case ICmpInst::ICMP_ULE:
+  case ICmpInst::ICMP_SLE:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_ULE>;
+  case ICmpInst::ICMP_UGE:
+  case ICmpInst::ICMP_SGE:
+    return DecodedExecution::pointerCompare<ICmpInst::ICMP_UGE>;
+  }
+}
+
+template <typename T>
+DecodedHandler FunctionDecoder::getFPCompareHandler(unsigned Pred) {
+  switch (Pred) {
+  default: return 0;
+  case FCmpInst::FCMP_FALSE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_FALSE>;
+  case FCmpInst::FCMP_OEQ:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_OEQ>;
+  case FCmpInst::FCMP_OGT:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_OGT>;
+  case FCmpInst::FCMP_OGE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_OGE>;
+  case FCmpInst::FCMP_OLT:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_OLT>;
+  case FCmpInst::FCMP_OLE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_OLE>;
+  case FCmpInst::FCMP_ONE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_ONE>;
+  case FCmpInst::FCMP_ORD:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_ORD>;
+  case FCmpInst::FCMP_UNO:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_UNO>;
+  case FCmpInst::FCMP_UEQ:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_UEQ>;
+  case FCmpInst::FCMP_UGT:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_UGT>;
+  case FCmpInst::FCMP_UGE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_UGE>;
+  case FCmpInst::FCMP_ULT:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_ULT>;
+  case FCmpInst::FCMP_ULE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_ULE>;
+  case FCmpInst::FCMP_UNE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_UNE>;
+  case FCmpInst::FCMP_TRUE:
+    return DecodedExecution::fpCompare<T, FCmpInst::FCMP_TRUE>;
+  }
+}
+
+/// getLoadHandler - Pick a handler that reads memory directly when the target
+/// has the host's byte order, and otherwise use LoadValueFromMemory.
+DecodedHandler FunctionDecoder::getLoadHandler(Type *Ty) {
+  if (TD.isLittleEndian() != sys::IsLittleEndianHost)
+    return DecodedExecution::loadAny;
+  if (Ty->isIntegerTy()) {
+    switch (Ty->getIntegerBitWidth()) {
+    case 8:  return DecodedExecution::loadInt<uint8_t>;
+    case 16: return DecodedExecution::loadInt<uint16_t>;
+    case 32: return DecodedExecution::loadInt<uint32_t>;
+    case 64: return DecodedExecution::loadInt<uint64_t>;
+    }
+  } else if (Ty->isFloatTy()) {
+    return DecodedExecution::loadFP<float>;
+  } else if (Ty->isDoubleTy()) {
+    return DecodedExecution::loadFP<double>;
+  } else if (Ty->isPointerTy()) {
+    return DecodedExecution::loadPointer;
+  }
+  return DecodedExecution::loadAny;
+}
+
+DecodedHandler FunctionDecoder::getStoreHandler(Type *Ty) {
+  if (TD.isLittleEndian() != sys::IsLittleEndianHost)
+    return DecodedExecution::storeAny;
+  if (Ty->isIntegerTy()) {
+    switch (Ty->getIntegerBitWidth()) {
+    case 8:  return DecodedExecution::storeInt<uint8_t>;
+    case 16: return DecodedExecution::storeInt<uint16_t>;
+    case 32: return DecodedExecution::storeInt<uint32_t>;
+    case 64: return DecodedExecution::storeInt<uint64_t>;
+    }
+  } else if (Ty->isFloatTy()) {
+    return DecodedExecution::storeFP<float>;
+  } else if (Ty->isDoubleTy()) {
+    return DecodedExecution::storeFP<double>;
+  } else if (Ty->isPointerTy() &&
+             TD.getTypeStoreSize(Ty) == sizeof(PointerTy)) {
+    return DecodedExecution::storePointer;
+  }
+  return DecodedExecution::storeAny;
+}
+
+/// lowerIntrinsics - Lower the intrinsics the interpreter does not implement
+/// itself before decoding, as the InstVisitor does when it first reaches
+/// them.
+void DecodedExecution::lowerIntrinsics(Interpreter &Interp, Function &F) {
+  SmallVector<CallInst*, 16> Calls;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if (CallInst *CI = dyn_cast<CallInst>(&*I))
+      if (Function *Callee = CI->getCalledFunction())
+        switch (Callee->getIntrinsicID()) {
+        case Intrinsic::not_intrinsic:
+        case Intrinsic::vastart:
+        case Intrinsic::vaend:
+        case Intrinsic::vacopy:
+          break;
+        default:
+          Calls.push_back(CI);
+          break;
+        }
+
+  for (unsigned i = 0, e = Calls.size(); i != e; ++i)
+    Interp.IL->LowerIntrinsicCall(Calls[i]);
+}
+
+DecodedFunction *DecodedExecution::decode(Interpreter &Interp, Function &F) {
+  lowerIntrinsics(Interp, F);
+  DecodedFunction *DF = new DecodedFunction();
+  FunctionDecoder(Interp, *DF).decode(F);
+  ++NumDecodedFunctions;
+  return DF;
+}
+
+//===----------------------------------------------------------------------===//
+//                        Dispatch and Execution Code
+//===----------------------------------------------------------------------===//
+
+void Interpreter::runDecoded() {
+  while (!ECStack.empty()) {
+    // Run a single instruction and advance the "PC" before it executes, so
+    // a branch or call can replace it.
+    ExecutionContext &SF = ECStack.back();
+    const DecodedInst &I = *SF.PC++;
+
+    // Track the number of dynamic instructions executed.
+    ++NumDecodedInsts;
+
+    I.Run(*this, SF, I);
+  }
+}
+
+/// enterDecodedFunction - Set up the new frame \p SF for a call to \p F,
+/// decoding F if this is its first call.
+void
+Interpreter::enterDecodedFunction(ExecutionContext &SF, Function *F,
+                                  const std::vector<GenericValue> &ArgVals) {
+  DecodedFunction *&DF = DecodedFunctions[F];
+  if (!DF)
+    DF = DecodedExecution::decode(*this, *F);
+
+  SF.Decoded = DF;
+  SF.PC = &DF->Code[0];
+  SF.Slots = DF->InitialSlots;
+
+  // The arguments have the first slots.
+  unsigned i = 0;
+  for (unsigned e = F->arg_size(); i != e; ++i)
+    SF.Slots[i] = ArgVals[i];
+  SF.VarArgs.assign(ArgVals.begin() + i, ArgVals.end());
+}
+
+/// returnToDecodedCall - Store the result of the call \p CallingSF is waiting
+/// for, and for an invoke, continue at its normal destination.
+void Interpreter::returnToDecodedCall(ExecutionContext &CallingSF,
+                                      const GenericValue &Result) {
+  const DecodedInst &Call = *CallingSF.PendingCall;
+  CallingSF.PendingCall = 0;
+  if (Call.Dest != NoSlot)
+    CallingSF.Slots[Call.Dest] = Result;
+  if (isa<InvokeInst>(Call.Inst))
+    DecodedExecution::takeEdge(CallingSF, Call.Imm);
+}
+
+void Interpreter::freeDecodedFunctions() {
+  DeleteContainerSeconds(DecodedFunctions);
+}
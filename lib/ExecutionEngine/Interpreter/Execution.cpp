@@ -847,7 +847,9 @@ void Interpreter::popStackAndReturnValueToCaller(Type *RetTy,
     // If we have a previous stack frame, and we have a previous call,
     // fill in the return value...
     ExecutionContext &CallingSF = ECStack.back();
-    if (Instruction *I = CallingSF.Caller.getInstruction()) {
+    if (CallingSF.PendingCall) {
+      returnToDecodedCall(CallingSF, Result);
+    } else if (Instruction *I = CallingSF.Caller.getInstruction()) {
       // Save result...
       if (!CallingSF.Caller.getType()->isVoidTy())
         SetValue(I, Result, CallingSF);
@@ -2089,15 +2091,20 @@ void Interpreter::callFunction(Function *F,
     return;
   }
 
-  // Get pointers to first LLVM BB & Instruction in function.
-  StackFrame.CurBB     = F->begin();
-  StackFrame.CurInst   = StackFrame.CurBB->begin();
-
   // Run through the function arguments and initialize their values...
   assert((ArgVals.size() == F->arg_size() ||
          (ArgVals.size() > F->arg_size() && F->getFunctionType()->isVarArg()))&&
          "Invalid number of values passed to function invocation!");
 
+  if (UseDecodedCode) {
+    enterDecodedFunction(StackFrame, F, ArgVals);
+    return;
+  }
+
+  // Get pointers to first LLVM BB & Instruction in function.
+  StackFrame.CurBB     = F->begin();
+  StackFrame.CurInst   = StackFrame.CurBB->begin();
+
   // Handle non-varargs arguments...
   unsigned i = 0;
   for (Function::arg_iterator AI = F->arg_begin(), E = F->arg_end(); 
@@ -2110,6 +2117,11 @@ void Interpreter::callFunction(Function *F,
 
 
 void Interpreter::run() {
+  if (UseDecodedCode) {
+    runDecoded();
+    return;
+  }
+
   while (!ECStack.empty()) {
     // Interpret a single instruction & increment the "PC".
     ExecutionContext &SF = ECStack.back();  // Current stack frame
@@ -17,9 +17,16 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include <cstring>
 using namespace llvm;
 
+static cl::opt<bool>
+PreDecode("interpreter-predecode",
+          cl::desc("Translate functions into a compact pre-decoded form "
+                   "before interpreting them"),
+          cl::init(false));
+
 namespace {
 
 static struct RegisterInterp {
@@ -45,7 +52,7 @@ ExecutionEngine *Interpreter::create(Module *M, std::string* ErrStr) {
 // Interpreter ctor - Initialize stuff
 //
 Interpreter::Interpreter(Module *M)
-  : ExecutionEngine(M), TD(M) {
+  : ExecutionEngine(M), TD(M), UseDecodedCode(PreDecode) {
       
   memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
   setDataLayout(&TD);
@@ -58,6 +65,7 @@ Interpreter::Interpreter(Module *M)
 }
 
 Interpreter::~Interpreter() {
+  freeDecodedFunctions();
   delete IL;
 }
 
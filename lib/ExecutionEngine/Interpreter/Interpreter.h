@@ -14,6 +14,7 @@
 #ifndef LLI_INTERPRETER_H
 #define LLI_INTERPRETER_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/IR/DataLayout.h"
@@ -27,6 +28,8 @@ namespace llvm {
 
 class IntrinsicLowering;
 struct FunctionInfo;
+struct DecodedFunction;
+struct DecodedInst;
 template<typename T> class generic_gep_type_iterator;
 class ConstantExpr;
 typedef generic_gep_type_iterator<User::const_op_iterator> gep_type_iterator;
@@ -76,6 +79,16 @@ struct ExecutionContext {
   CallSite             Caller;     // Holds the call that called subframes.
                                    // NULL if main func or debugger invoked fn
   AllocaHolderHandle    Allocas;    // Track memory allocated by alloca
+
+  // When running pre-decoded code, these take the place of CurBB, CurInst,
+  // Values and Caller.
+  DecodedFunction      *Decoded;    // The decoded form of CurFunction
+  const DecodedInst    *PC;         // The next decoded instruction to execute
+  std::vector<GenericValue> Slots;  // Arguments, results and constants
+  const DecodedInst    *PendingCall;// The call waiting for a subframe
+
+  ExecutionContext()
+    : CurFunction(0), CurBB(0), Decoded(0), PC(0), PendingCall(0) {}
 };
 
 // Interpreter - This class represents the entirety of the interpreter.
@@ -93,6 +106,13 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // UseDecodedCode - Translate each function into a DecodedFunction on its
+  // first call and execute that instead of visiting the IR.  DecodedFunctions
+  // caches the translations.
+  bool UseDecodedCode;
+  DenseMap<Function*, DecodedFunction*> DecodedFunctions;
+  friend struct DecodedExecution;
+
 public:
   explicit Interpreter(Module *M);
   ~Interpreter();
@@ -247,6 +267,14 @@ private:  // Helper functions
                                     Type *Ty, ExecutionContext &SF);
   void popStackAndReturnValueToCaller(Type *RetTy, GenericValue Result);
 
+  // Pre-decoded execution, implemented in DecodedExecution.cpp.
+  void runDecoded();
+  void enterDecodedFunction(ExecutionContext &SF, Function *F,
+                            const std::vector<GenericValue> &ArgVals);
+  void returnToDecodedCall(ExecutionContext &CallingSF,
+                           const GenericValue &Result);
+  void freeDecodedFunctions();
+
 };
 
 } // End llvm namespace
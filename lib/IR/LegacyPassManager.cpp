@@ -1518,6 +1518,7 @@ bool FPPassManager::runOnFunction(Function &F) {
     return false;
 
   bool Changed = false;
+  TimeTraceContext TraceContext(F.getName());
 
   // Collect inherited analysis from Module level pass manager.
   populateInheritedAnalysis(TPM->activeStack);
@@ -1587,6 +1588,7 @@ bool FPPassManager::doFinalization(Module &M) {
 bool
 MPPassManager::runOnModule(Module &M) {
   bool Changed = false;
+  TimeTraceContext TraceContext(M.getModuleIdentifier());
 
   // Initialize on-the-fly passes
   for (std::map<Pass *, FunctionPassManagerImpl *>::iterator
@@ -1758,6 +1760,9 @@ EnableTiming("time-passes", cl::location(TimePassesIsEnabled),
 // a non null value (if the -time-passes option is enabled) or it leaves it
 // null.  It may be called multiple times.
 void TimingInfo::createTheTimeInfo() {
+  // The timeline is made of the timed regions, so asking for one times them.
+  if (isTimeTraceEnabled())
+    TimePassesIsEnabled = true;
   if (!TimePassesIsEnabled || TheTimeInfo) return;
 
   // Constructed the first time this is called, iff -time-passes is enabled.
@@ -18,6 +18,7 @@
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Analysis/Verifier.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/CodeGen/RuntimeLibcalls.h"
 #include "llvm/Config/config.h"
 #include "llvm/IR/Constants.h"
@@ -30,6 +31,7 @@
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Object/ELFMerge.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
@@ -61,8 +63,9 @@ const char* LTOCodeGenerator::getVersionString() {
 
 LTOCodeGenerator::LTOCodeGenerator()
     : Context(getGlobalContext()), Linker(new Module("ld-temp.o", Context)),
-      TargetMach(NULL), EmitDwarfDebugInfo(false), ScopeRestrictionsDone(false),
-      CodeModel(LTO_CODEGEN_PIC_MODEL_DYNAMIC), NativeObjectFile(NULL) {
+      MArch(NULL), TargetMach(NULL), EmitDwarfDebugInfo(false),
+      ScopeRestrictionsDone(false), CodeModel(LTO_CODEGEN_PIC_MODEL_DYNAMIC),
+      Parallelism(1), NativeObjectFile(NULL) {
   initializeLTOPasses();
 }
 
@@ -202,6 +205,16 @@ bool LTOCodeGenerator::compile_to_file(const char** name,
                                        bool disableInline,
                                        bool disableGVNLoadPRE,
                                        std::string& errMsg) {
+  if (!optimize(disableOpt, disableInline, disableGVNLoadPRE, errMsg))
+    return false;
+
+  // The partitions can only be put back together into one ELF object.
+  std::vector<std::string> Objects;
+  bool Split = Parallelism > 1 &&
+               Triple(TargetMach->getTargetTriple()).isOSBinFormatELF();
+  if (Split && !generateObjectFiles(Objects, errMsg))
+    return false;
+
   // make unique temp .o file to put generated object file
   SmallString<128> Filename;
   int FD;
@@ -214,8 +227,16 @@ bool LTOCodeGenerator::compile_to_file(const char** name,
   // generate object file
   tool_output_file objFile(Filename.c_str(), FD);
 
-  bool genResult = generateObjectFile(objFile.os(), disableOpt, disableInline,
-                                      disableGVNLoadPRE, errMsg);
+  bool genResult;
+  if (Split) {
+    std::vector<StringRef> ObjectRefs(Objects.begin(), Objects.end());
+    EC = object::mergeELFObjects(ObjectRefs, objFile.os());
+    if (EC)
+      errMsg = "could not combine object files: " + EC.message();
+    genResult = !EC;
+  } else {
+    genResult = generateObjectFile(objFile.os(), errMsg);
+  }
   objFile.os().close();
   if (objFile.os().has_error()) {
     objFile.os().clear_error();
@@ -234,6 +255,59 @@ bool LTOCodeGenerator::compile_to_file(const char** name,
   return true;
 }
 
+bool LTOCodeGenerator::compile_to_files(const char ***names,
+                                        unsigned *count,
+                                        bool disableOpt,
+                                        bool disableInline,
+                                        bool disableGVNLoadPRE,
+                                        std::string &errMsg) {
+  if (!optimize(disableOpt, disableInline, disableGVNLoadPRE, errMsg))
+    return false;
+
+  std::vector<std::string> Objects;
+  if (Parallelism > 1) {
+    if (!generateObjectFiles(Objects, errMsg))
+      return false;
+  } else {
+    Objects.resize(1);
+    raw_string_ostream OS(Objects[0]);
+    if (!generateObjectFile(OS, errMsg))
+      return false;
+  }
+
+  std::vector<std::string> Paths;
+  for (unsigned I = 0, E = Objects.size(); I != E; ++I) {
+    SmallString<128> Filename;
+    int FD;
+    error_code EC = sys::fs::createTemporaryFile("lto-llvm", "o", FD,
+                                                 Filename);
+    if (!EC) {
+      raw_fd_ostream OS(FD, /*shouldClose=*/true);
+      OS << Objects[I];
+      OS.close();
+      if (OS.has_error()) {
+        OS.clear_error();
+        EC = make_error_code(errc::io_error);
+      }
+      Paths.push_back(Filename.str());
+    }
+    if (EC) {
+      errMsg = EC.message();
+      for (unsigned J = 0, JE = Paths.size(); J != JE; ++J)
+        sys::fs::remove(Paths[J]);
+      return false;
+    }
+  }
+
+  NativeObjectPaths.swap(Paths);
+  NativeObjectNames.clear();
+  for (unsigned I = 0, E = NativeObjectPaths.size(); I != E; ++I)
+    NativeObjectNames.push_back(NativeObjectPaths[I].c_str());
+  *names = &NativeObjectNames[0];
+  *count = NativeObjectNames.size();
+  return true;
+}
+
 const void* LTOCodeGenerator::compile(size_t* length,
                                       bool disableOpt,
                                       bool disableInline,
@@ -266,20 +340,15 @@ const void* LTOCodeGenerator::compile(size_t* length,
   return NativeObjectFile->getBufferStart();
 }
 
-bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
-  if (TargetMach != NULL)
-    return true;
-
-  std::string TripleStr = Linker.getModule()->getTargetTriple();
-  if (TripleStr.empty())
-    TripleStr = sys::getDefaultTargetTriple();
+/// createTargetMachine - Create a target machine for the merged module.  The
+/// partitions that are generated on separate threads each need their own.
+static TargetMachine *createTargetMachine(const Target *March,
+                                          const std::string &TripleStr,
+                                          const std::string &MCpu,
+                                          const TargetOptions &Options,
+                                          lto_codegen_model CodeModel) {
   llvm::Triple Triple(TripleStr);
 
-  // create target machine from info for merged modules
-  const Target *march = TargetRegistry::lookupTarget(TripleStr, errMsg);
-  if (march == NULL)
-    return false;
-
   // The relocation model is actually a static member of TargetMachine and
   // needs to be set before the TargetMachine is instantiated.
   Reloc::Model RelocModel = Reloc::Default;
@@ -295,10 +364,29 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
     break;
   }
 
-  // construct LTOModule, hand over ownership of module and target
   SubtargetFeatures Features;
   Features.getDefaultSubtargetFeatures(Triple);
   std::string FeatureStr = Features.getString();
+
+  return March->createTargetMachine(TripleStr, MCpu, FeatureStr, Options,
+                                    RelocModel, CodeModel::Default,
+                                    CodeGenOpt::Aggressive);
+}
+
+bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
+  if (TargetMach != NULL)
+    return true;
+
+  std::string TripleStr = Linker.getModule()->getTargetTriple();
+  if (TripleStr.empty())
+    TripleStr = sys::getDefaultTargetTriple();
+  llvm::Triple Triple(TripleStr);
+
+  // create target machine from info for merged modules
+  MArch = TargetRegistry::lookupTarget(TripleStr, errMsg);
+  if (MArch == NULL)
+    return false;
+
   // Set a default CPU for Darwin triples.
   if (MCpu.empty() && Triple.isOSDarwin()) {
     if (Triple.getArch() == llvm::Triple::x86_64)
@@ -307,9 +395,7 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
       MCpu = "yonah";
   }
 
-  TargetMach = march->createTargetMachine(TripleStr, MCpu, FeatureStr, Options,
-                                          RelocModel, CodeModel::Default,
-                                          CodeGenOpt::Aggressive);
+  TargetMach = createTargetMachine(MArch, TripleStr, MCpu, Options, CodeModel);
   return true;
 }
 
@@ -439,11 +525,10 @@ void LTOCodeGenerator::applyScopeRestrictions() {
 }
 
 /// Optimize merged modules using various IPO passes
-bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
-                                          bool DisableOpt,
-                                          bool DisableInline,
-                                          bool DisableGVNLoadPRE,
-                                          std::string &errMsg) {
+bool LTOCodeGenerator::optimize(bool DisableOpt,
+                                bool DisableInline,
+                                bool DisableGVNLoadPRE,
+                                std::string &errMsg) {
   if (!this->determineTarget(errMsg))
     return false;
 
@@ -474,32 +559,85 @@ bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
   // Make sure everything is still good.
   passes.add(createVerifierPass());
 
-  PassManager codeGenPasses;
+  // Run our queue of passes all at once now, efficiently.
+  passes.run(*mergedModule);
 
-  codeGenPasses.add(new DataLayout(*TargetMach->getDataLayout()));
-  TargetMach->addAnalysisPasses(codeGenPasses);
+  return true;
+}
 
-  formatted_raw_ostream Out(out);
+/// addCodeGenPasses - Queue the passes that write an object file for a
+/// module to Out.  Returns true if the target cannot do that.
+static bool addCodeGenPasses(PassManager &codeGenPasses, TargetMachine &TM,
+                             formatted_raw_ostream &Out) {
+  codeGenPasses.add(new DataLayout(*TM.getDataLayout()));
+  TM.addAnalysisPasses(codeGenPasses);
 
   // If the bitcode files contain ARC code and were compiled with optimization,
   // the ObjCARCContractPass must be run, so do it unconditionally here.
   codeGenPasses.add(createObjCARCContractPass());
 
-  if (TargetMach->addPassesToEmitFile(codeGenPasses, Out,
-                                      TargetMachine::CGFT_ObjectFile)) {
+  return TM.addPassesToEmitFile(codeGenPasses, Out,
+                                TargetMachine::CGFT_ObjectFile);
+}
+
+/// Generate code for the optimized merged module on this thread.
+bool LTOCodeGenerator::generateObjectFile(raw_ostream &out,
+                                          std::string &errMsg) {
+  PassManager codeGenPasses;
+  formatted_raw_ostream Out(out);
+  if (addCodeGenPasses(codeGenPasses, *TargetMach, Out)) {
     errMsg = "target file type not supported";
     return false;
   }
 
-  // Run our queue of passes all at once now, efficiently.
-  passes.run(*mergedModule);
-
   // Run the code generator, and write assembly file
-  codeGenPasses.run(*mergedModule);
+  codeGenPasses.run(*Linker.getModule());
 
   return true;
 }
 
+namespace {
+/// LTOPartitionCompiler - Generates code for one partition of the merged
+/// module with a target machine of its own.
+class LTOPartitionCompiler : public PartitionCompiler {
+  const Target *March;
+  std::string TripleStr;
+  std::string MCpu;
+  TargetOptions Options;
+  lto_codegen_model CodeModel;
+
+public:
+  LTOPartitionCompiler(const Target *March, const std::string &TripleStr,
+                       const std::string &MCpu, const TargetOptions &Options,
+                       lto_codegen_model CodeModel)
+    : March(March), TripleStr(TripleStr), MCpu(MCpu), Options(Options),
+      CodeModel(CodeModel) {}
+
+  virtual bool compile(Module &M, raw_ostream &OS, std::string &ErrMsg) {
+    OwningPtr<TargetMachine> TM(createTargetMachine(March, TripleStr, MCpu,
+                                                    Options, CodeModel));
+    PassManager codeGenPasses;
+    formatted_raw_ostream Out(OS);
+    if (addCodeGenPasses(codeGenPasses, *TM, Out)) {
+      ErrMsg = "target file type not supported";
+      return true;
+    }
+    codeGenPasses.run(M);
+    return false;
+  }
+};
+}
+
+/// Generate code for partitions of the optimized merged module on up to
+/// Parallelism threads, one object file for each.
+bool LTOCodeGenerator::generateObjectFiles(std::vector<std::string> &objects,
+                                           std::string &errMsg) {
+  Module *mergedModule = Linker.getModule();
+  LTOPartitionCompiler PC(MArch, TargetMach->getTargetTriple(), MCpu,
+                          Options, CodeModel);
+  return !splitCodeGen(*mergedModule, Parallelism, PC, objects, errMsg);
+}
+
 /// setCodeGenDebugOptions - Set codegen debugging options to aid in debugging
 /// LTO problems.
 void LTOCodeGenerator::setCodeGenDebugOptions(const char *options) {
@@ -157,6 +157,8 @@ class ELFObjectWriter : public MCObjectWriter {
 
     virtual ~ELFObjectWriter();
 
+    virtual void reset();
+
     void WriteWord(uint64_t W) {
       if (is64Bit())
         Write64(W);
@@ -367,6 +369,22 @@ bool ELFObjectWriter::RelocNeedsGOT(MCSymbolRefExpr::VariantKind Variant) {
 ELFObjectWriter::~ELFObjectWriter()
 {}
 
+void ELFObjectWriter::reset() {
+  UsedInReloc.clear();
+  WeakrefUsedInReloc.clear();
+  Renames.clear();
+  Relocations.clear();
+  SectionStringTableIndex.clear();
+  StringTable.clear();
+  FileSymbolData.clear();
+  LocalSymbolData.clear();
+  ExternalSymbolData.clear();
+  UndefinedSymbolData.clear();
+  NeedsGOT = false;
+  NeedsSymtabShndx = false;
+  MCObjectWriter::reset();
+}
+
 // Emit the ELF header.
 void ELFObjectWriter::WriteHeader(const MCAssembler &Asm,
                                   uint64_t SectionDataSize,
@@ -1536,6 +1554,7 @@ void ELFObjectWriter::WriteObject(MCAssembler &Asm,
                          SectionIndexMap,
                          RelMap);
 
+  uint64_t StartOffset = OS.tell();
   uint64_t NaturalAlignment = is64Bit() ? 8 : 4;
   uint64_t HeaderSize = is64Bit() ? sizeof(ELF::Elf64_Ehdr) :
                                     sizeof(ELF::Elf32_Ehdr);
@@ -1579,6 +1598,10 @@ void ELFObjectWriter::WriteObject(MCAssembler &Asm,
     FileOff += GetSectionFileSize(Layout, SD);
   }
 
+  // The size of the object is known now, so let the stream allocate it all
+  // at once.
+  OS.reserveExtraSpace(FileOff);
+
   // Write out the ELF header ...
   WriteHeader(Asm, SectionHeaderOffset, NumSections + 1);
 
@@ -1597,6 +1620,10 @@ void ELFObjectWriter::WriteObject(MCAssembler &Asm,
   // ... and then the remaining sections ...
   for (unsigned i = NumRegularSections + 1; i < NumSections; ++i)
     WriteDataSectionData(Asm, Layout, *Sections[i]);
+
+  assert(OS.tell() - StartOffset == FileOff &&
+         "Object size differs from its layout");
+  (void)StartOffset;
 }
 
 bool
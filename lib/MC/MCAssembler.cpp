@@ -28,6 +28,7 @@
 #include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
+#include <queue>
 
 using namespace llvm;
 
@@ -308,9 +309,11 @@ void MCAssembler::reset() {
   SymbolMap.clear();
   IndirectSymbols.clear();
   DataRegions.clear();
+  LinkerOptions.clear();
+  FileNames.clear();
   ThumbFuncs.clear();
-  RelaxAll = false;
-  NoExecStack = false;
+  // RelaxAll and NoExecStack are set when the streamer is created, not by
+  // the input, so they carry over to the next object.
   SubsectionsViaSymbols = false;
   ELFHeaderEFlags = 0;
 
@@ -937,57 +940,176 @@ bool MCAssembler::relaxDwarfCallFrameFragment(MCAsmLayout &Layout,
   return OldSize != Data.size();
 }
 
-bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSectionData &SD) {
-  // Holds the first fragment which needed relaxing during this layout. It will
-  // remain NULL if none were relaxed.
-  // When a fragment is relaxed, all the fragments following it should get
-  // invalidated because their offset is going to change.
-  MCFragment *FirstRelaxedFragment = NULL;
-
-  // Attempt to relax all the fragments in the section.
-  for (MCSectionData::iterator I = SD.begin(), IE = SD.end(); I != IE; ++I) {
-    // Check if this is a fragment that needs relaxation.
-    bool RelaxedFrag = false;
-    switch(I->getKind()) {
+bool MCAssembler::relaxFragment(MCAsmLayout &Layout, MCFragment &F) {
+  switch(F.getKind()) {
+  default:
+    return false;
+  case MCFragment::FT_Relaxable:
+    assert(!getRelaxAll() &&
+           "Did not expect a MCRelaxableFragment in RelaxAll mode");
+    return relaxInstruction(Layout, cast<MCRelaxableFragment>(F));
+  case MCFragment::FT_Dwarf:
+    return relaxDwarfLineAddr(Layout, cast<MCDwarfLineAddrFragment>(F));
+  case MCFragment::FT_DwarfFrame:
+    return relaxDwarfCallFrameFragment(Layout,
+                                       cast<MCDwarfCallFrameFragment>(F));
+  case MCFragment::FT_LEB:
+    return relaxLEB(Layout, cast<MCLEBFragment>(F));
+  }
+}
+
+namespace {
+/// FragmentRangeIndex - Remember, for each relaxable fragment, the range of
+/// fragments whose sizes its fixups depend on, and find all the ranges that
+/// contain a given fragment.
+///
+/// The ranges are stored in a segment tree over the layout order of the
+/// fragments in a section: a range is split over O(log N) nodes, and the
+/// ranges containing a fragment are those stored on the path from its leaf
+/// to the root.
+class FragmentRangeIndex {
+  unsigned NumFragments;
+  std::vector<std::vector<unsigned> > Nodes;
+
+public:
+  explicit FragmentRangeIndex(unsigned NumFragments)
+    : NumFragments(NumFragments), Nodes(2 * NumFragments) {}
+
+  /// insert - Record that fragment \p Frag depends on the sizes of the
+  /// fragments \p Lo to \p Hi, inclusive.
+  void insert(unsigned Lo, unsigned Hi, unsigned Frag) {
+    for (Lo += NumFragments, Hi += NumFragments + 1; Lo < Hi;
+         Lo >>= 1, Hi >>= 1) {
+      if (Lo & 1)
+        Nodes[Lo++].push_back(Frag);
+      if (Hi & 1)
+        Nodes[--Hi].push_back(Frag);
+    }
+  }
+
+  /// find - Add to \p Frags every fragment whose range contains \p Order.
+  void find(unsigned Order, SmallVectorImpl<unsigned> &Frags) const {
+    for (unsigned N = Order + NumFragments; N != 0; N >>= 1)
+      Frags.append(Nodes[N].begin(), Nodes[N].end());
+  }
+};
+}
+
+/// getFixupRange - Widen [Lo, Hi] to include the target of \p Fixup, a fixup
+/// in fragment \p F. Returns false if the value of the fixup may depend on
+/// anything other than the sizes of the fragments between the two.
+static bool getFixupRange(const MCAssembler &Asm, const MCFragment &F,
+                          const MCFixup &Fixup, unsigned &Lo, unsigned &Hi) {
+  // The fixup has to be relative to the position of the fragment, and that
+  // position must not be rounded.
+  unsigned Flags = Asm.getBackend().getFixupKindInfo(Fixup.getKind()).Flags;
+  if (!(Flags & MCFixupKindInfo::FKF_IsPCRel) ||
+      (Flags & MCFixupKindInfo::FKF_IsAlignedDownTo32Bits))
+    return false;
+
+  // Look through a constant addend.
+  const MCExpr *Expr = Fixup.getValue();
+  if (const MCBinaryExpr *BE = dyn_cast<MCBinaryExpr>(Expr))
+    if (BE->getOpcode() == MCBinaryExpr::Add &&
+        isa<MCConstantExpr>(BE->getRHS()))
+      Expr = BE->getLHS();
+
+  // The target must be a label in the same section.
+  const MCSymbolRefExpr *SRE = dyn_cast<MCSymbolRefExpr>(Expr);
+  if (!SRE || SRE->getKind() != MCSymbolRefExpr::VK_None)
+    return false;
+  const MCSymbol &Sym = SRE->getSymbol().AliasedSymbol();
+  if (Sym.isVariable() || !Sym.isInSection() ||
+      &Sym.getSection() != &F.getParent()->getSection())
+    return false;
+  const MCFragment *Target = Asm.getSymbolData(Sym).getFragment();
+  if (!Target || Target->getParent() != F.getParent())
+    return false;
+
+  Lo = std::min(Lo, Target->getLayoutOrder());
+  Hi = std::max(Hi, Target->getLayoutOrder());
+  return true;
+}
+
+bool MCAssembler::layoutSection(MCAsmLayout &Layout, MCSectionData &SD) {
+  std::vector<MCFragment *> Fragments;
+  for (MCSectionData::iterator I = SD.begin(), IE = SD.end(); I != IE; ++I)
+    Fragments.push_back(I);
+  unsigned NumFragments = Fragments.size();
+
+  // Record which fragments each relaxable fragment depends on, if its fixups
+  // only refer to labels in this section. Other fixups, and fragments such as
+  // alignment and bundle padding whose sizes depend on their offsets, are
+  // caught by the next call from layoutOnce, which checks every fragment
+  // again after any relaxation.
+  FragmentRangeIndex Dependents(NumFragments);
+
+  // The worklist is processed in layout order, so that the fragments before
+  // the one being checked are usually already at their final sizes.
+  std::priority_queue<unsigned, std::vector<unsigned>,
+                      std::greater<unsigned> > Worklist;
+  std::vector<bool> Queued(NumFragments);
+
+  for (unsigned i = 0; i != NumFragments; ++i) {
+    MCFragment *F = Fragments[i];
+    switch (F->getKind()) {
     default:
+      continue;
+    case MCFragment::FT_Relaxable: {
+      MCRelaxableFragment *RF = cast<MCRelaxableFragment>(F);
+      if (!getBackend().mayNeedRelaxation(RF->getInst()))
+        continue;
+      unsigned Lo = i, Hi = i;
+      bool Tracked = true;
+      for (MCRelaxableFragment::const_fixup_iterator it = RF->fixup_begin(),
+             ie = RF->fixup_end(); Tracked && it != ie; ++it)
+        Tracked = getFixupRange(*this, *RF, *it, Lo, Hi);
+      if (Tracked)
+        Dependents.insert(Lo, Hi, i);
       break;
-    case MCFragment::FT_Relaxable:
-      assert(!getRelaxAll() &&
-             "Did not expect a MCRelaxableFragment in RelaxAll mode");
-      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
-      break;
+    }
     case MCFragment::FT_Dwarf:
-      RelaxedFrag = relaxDwarfLineAddr(Layout,
-                                       *cast<MCDwarfLineAddrFragment>(I));
-      break;
     case MCFragment::FT_DwarfFrame:
-      RelaxedFrag =
-        relaxDwarfCallFrameFragment(Layout,
-                                    *cast<MCDwarfCallFrameFragment>(I));
-      break;
     case MCFragment::FT_LEB:
-      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(I));
       break;
     }
-    if (RelaxedFrag && !FirstRelaxedFragment)
-      FirstRelaxedFragment = I;
+    Worklist.push(i);
+    Queued[i] = true;
   }
-  if (FirstRelaxedFragment) {
-    Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
-    return true;
+
+  bool WasRelaxed = false;
+  SmallVector<unsigned, 16> Affected;
+  while (!Worklist.empty()) {
+    unsigned i = Worklist.top();
+    Worklist.pop();
+    Queued[i] = false;
+    if (!relaxFragment(Layout, *Fragments[i]))
+      continue;
+    WasRelaxed = true;
+
+    // Lay out again from the relaxed fragment the next time an offset is
+    // needed, and check it and every fragment that depends on its size.
+    Layout.invalidateFragmentsFrom(Fragments[i]);
+    Affected.push_back(i);
+    Dependents.find(i, Affected);
+    for (unsigned j = 0, e = Affected.size(); j != e; ++j)
+      if (!Queued[Affected[j]]) {
+        Worklist.push(Affected[j]);
+        Queued[Affected[j]] = true;
+      }
+    Affected.clear();
   }
-  return false;
+
+  return WasRelaxed;
 }
 
 bool MCAssembler::layoutOnce(MCAsmLayout &Layout) {
   ++stats::RelaxationSteps;
 
   bool WasRelaxed = false;
-  for (iterator it = begin(), ie = end(); it != ie; ++it) {
-    MCSectionData &SD = *it;
-    while (layoutSectionOnce(Layout, SD))
+  for (iterator it = begin(), ie = end(); it != ie; ++it)
+    if (layoutSection(Layout, *it))
       WasRelaxed = true;
-  }
 
   return WasRelaxed;
 }
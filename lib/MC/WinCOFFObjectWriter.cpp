@@ -140,6 +140,8 @@ public:
   WinCOFFObjectWriter(MCWinCOFFObjectTargetWriter *MOTW, raw_ostream &OS);
   virtual ~WinCOFFObjectWriter();
 
+  virtual void reset();
+
   COFFSymbol *createSymbol(StringRef Name);
   COFFSymbol *GetOrCreateCOFFSymbol(const MCSymbol * Symbol);
   COFFSection *createSection(StringRef Name);
@@ -317,6 +319,22 @@ WinCOFFObjectWriter::~WinCOFFObjectWriter() {
     delete *I;
 }
 
+void WinCOFFObjectWriter::reset() {
+  for (symbols::iterator I = Symbols.begin(), E = Symbols.end(); I != E; ++I)
+    delete *I;
+  for (sections::iterator I = Sections.begin(), E = Sections.end(); I != E; ++I)
+    delete *I;
+  Symbols.clear();
+  Sections.clear();
+  SymbolMap.clear();
+  SectionMap.clear();
+  Strings = StringTable();
+
+  memset(&Header, 0, sizeof(Header));
+  Header.Machine = TargetObjectWriter->getMachine();
+  MCObjectWriter::reset();
+}
+
 COFFSymbol *WinCOFFObjectWriter::createSymbol(StringRef Name) {
   return createCOFFEntity<COFFSymbol>(Name, Symbols);
 }
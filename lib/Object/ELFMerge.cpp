@@ -0,0 +1,643 @@
+//===- ELFMerge.cpp - Combine relocatable ELF objects ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements mergeELFObjects.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/ELFMerge.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Object/ELF.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <vector>
+
+using namespace llvm;
+using namespace object;
+
+namespace {
+
+/// StringTable - An ELF string table under construction.
+class StringTable {
+  std::string Data;
+  StringMap<uint32_t> Offsets;
+
+public:
+  StringTable() : Data(1, '\0') {}
+
+  uint32_t add(StringRef S) {
+    if (S.empty())
+      return 0;
+    StringMap<uint32_t>::iterator I = Offsets.find(S);
+    if (I != Offsets.end())
+      return I->second;
+    uint32_t Offset = Data.size();
+    Data.append(S.begin(), S.end());
+    Data.push_back('\0');
+    Offsets[S] = Offset;
+    return Offset;
+  }
+
+  StringRef str() const { return Data; }
+};
+
+void writeZeros(raw_ostream &OS, uint64_t Count) {
+  for (; Count; --Count)
+    OS << '\0';
+}
+
+/// ELFMerger - Combines several relocatable objects of one ELF flavour.
+template <class ELFT>
+class ELFMerger {
+  typedef ELFFile<ELFT> ELFO;
+  typedef typename ELFO::Elf_Ehdr Elf_Ehdr;
+  typedef typename ELFO::Elf_Shdr Elf_Shdr;
+  typedef typename ELFO::Elf_Sym Elf_Sym;
+  typedef typename ELFO::Elf_Rel Elf_Rel;
+  typedef typename ELFO::Elf_Rela Elf_Rela;
+  typedef typename ELFO::Elf_Word Elf_Word;
+
+  struct InputFile {
+    OwningPtr<MemoryBuffer> Buffer;
+    OwningPtr<ELFO> File;
+    const Elf_Shdr *SymTab;
+    ArrayRef<uint8_t> StrTab;
+    /// SectionMap - Output index of each input section, or 0 if dropped.
+    std::vector<uint32_t> SectionMap;
+    /// Discarded - Input sections of COMDAT groups that an earlier input
+    /// already provided.
+    std::vector<bool> Discarded;
+    /// SymbolMap - Output index of each input symbol.
+    std::vector<uint32_t> SymbolMap;
+  };
+
+  struct OutputSection {
+    Elf_Shdr Header;
+    StringRef Name;
+    ArrayRef<uint8_t> Contents;
+    /// Rewritten - Replacement contents, used when IsRewritten is set.
+    std::string Rewritten;
+    bool IsRewritten;
+    unsigned File;
+
+    OutputSection() : IsRewritten(false), File(0) {}
+  };
+
+  std::vector<InputFile *> Inputs;
+  std::vector<OutputSection> Sections;
+  std::vector<Elf_Sym> Locals;
+  std::vector<Elf_Sym> Globals;
+  StringMap<uint32_t> GlobalSlots;
+  /// ComdatGroups - Signatures of the COMDAT groups kept so far.
+  StringSet<> ComdatGroups;
+  /// NoteGNUStack - Output index of the one .note.GNU-stack, or 0.
+  uint32_t NoteGNUStack;
+  /// MissingNoteGNUStack - Whether some input has no .note.GNU-stack.
+  bool MissingNoteGNUStack;
+  StringTable StrTab;
+
+  error_code readInput(StringRef Object, InputFile &In);
+  error_code getSymbolName(const InputFile &In, uint32_t Index,
+                           StringRef &Name) const;
+  error_code discardComdats(unsigned FileIdx);
+  error_code addSections(unsigned FileIdx);
+  error_code addSymbols(unsigned FileIdx, bool Local);
+  error_code mergeGlobal(Elf_Sym &Existing, const Elf_Sym &New);
+  error_code mapSection(const InputFile &In, uint32_t Index,
+                        uint32_t &Result) const;
+  error_code rewriteSection(OutputSection &Sec);
+  template <class RelT> void rewriteRelocations(OutputSection &Sec);
+  void write(raw_ostream &OS);
+
+  bool isMips64EL() const { return Inputs[0]->File->isMips64EL(); }
+
+public:
+  ELFMerger() : NoteGNUStack(0), MissingNoteGNUStack(false) {}
+  ~ELFMerger() { DeleteContainerPointers(Inputs); }
+
+  error_code merge(ArrayRef<StringRef> Objects, raw_ostream &OS);
+};
+
+} // end anonymous namespace
+
+template <class ELFT>
+error_code ELFMerger<ELFT>::readInput(StringRef Object, InputFile &In) {
+  error_code EC;
+  In.Buffer.reset(MemoryBuffer::getMemBuffer(Object, "", false));
+  In.File.reset(new ELFO(In.Buffer.get(), EC));
+  if (EC)
+    return EC;
+  if (In.File->getHeader()->e_type != ELF::ET_REL)
+    return object_error::invalid_file_type;
+
+  In.SymTab = 0;
+  for (typename ELFO::Elf_Shdr_Iter I = In.File->begin_sections(),
+         E = In.File->end_sections(); I != E; ++I) {
+    if (I->sh_type == ELF::SHT_SYMTAB_SHNDX)
+      return object_error::parse_failed;
+    if (I->sh_type != ELF::SHT_SYMTAB)
+      continue;
+    if (In.SymTab || I->sh_entsize != sizeof(Elf_Sym))
+      return object_error::parse_failed;
+    In.SymTab = &*I;
+  }
+  if (!In.SymTab)
+    return error_code::success();
+
+  const Elf_Shdr *StrSec = In.File->getSection(In.SymTab->sh_link);
+  if (!StrSec)
+    return object_error::parse_failed;
+  ErrorOr<ArrayRef<uint8_t> > Str = In.File->getSectionContents(StrSec);
+  if (!Str)
+    return Str;
+  In.StrTab = *Str;
+  return error_code::success();
+}
+
+template <class ELFT>
+error_code ELFMerger<ELFT>::getSymbolName(const InputFile &In, uint32_t Index,
+                                          StringRef &Name) const {
+  if (!In.SymTab || Index >= In.SymTab->sh_size / sizeof(Elf_Sym))
+    return object_error::parse_failed;
+  ErrorOr<ArrayRef<uint8_t> > Data = In.File->getSectionContents(In.SymTab);
+  if (!Data)
+    return Data;
+  const Elf_Sym *Syms = reinterpret_cast<const Elf_Sym *>(Data->data());
+  if (Syms[Index].st_name >= In.StrTab.size())
+    return object_error::parse_failed;
+  Name = StringRef(reinterpret_cast<const char *>(In.StrTab.data()) +
+                   Syms[Index].st_name);
+  return error_code::success();
+}
+
+/// discardComdats - Mark the COMDAT groups of input \p FileIdx whose
+/// signature an earlier input already provided, along with their members
+/// and the relocations for those.  Only the first copy of a group is kept,
+/// as a linker would.
+template <class ELFT>
+error_code ELFMerger<ELFT>::discardComdats(unsigned FileIdx) {
+  InputFile &In = *Inputs[FileIdx];
+  const ELFO &File = *In.File;
+  In.Discarded.assign(File.getNumSections(), false);
+
+  uint32_t Index = 0;
+  for (typename ELFO::Elf_Shdr_Iter I = File.begin_sections(),
+         E = File.end_sections(); I != E; ++I, ++Index) {
+    if (I->sh_type != ELF::SHT_GROUP)
+      continue;
+    ErrorOr<ArrayRef<uint8_t> > Contents = File.getSectionContents(&*I);
+    if (!Contents)
+      return Contents;
+    const Elf_Word *Words =
+      reinterpret_cast<const Elf_Word *>(Contents->data());
+    size_t NumWords = Contents->size() / sizeof(Elf_Word);
+    if (NumWords == 0 || !(Words[0] & ELF::GRP_COMDAT))
+      continue;
+
+    StringRef Signature;
+    if (error_code EC = getSymbolName(In, I->sh_info, Signature))
+      return EC;
+    if (!ComdatGroups.insert(Signature)) {
+      In.Discarded[Index] = true;
+      for (size_t W = 1; W != NumWords; ++W) {
+        if (Words[W] >= In.Discarded.size())
+          return object_error::parse_failed;
+        In.Discarded[Words[W]] = true;
+      }
+    }
+  }
+
+  Index = 0;
+  for (typename ELFO::Elf_Shdr_Iter I = File.begin_sections(),
+         E = File.end_sections(); I != E; ++I, ++Index)
+    if ((I->sh_type == ELF::SHT_REL || I->sh_type == ELF::SHT_RELA) &&
+        I->sh_info < In.Discarded.size() && In.Discarded[I->sh_info])
+      In.Discarded[Index] = true;
+  return error_code::success();
+}
+
+/// addSections - Give every section of input \p FileIdx other than its
+/// symbol and string tables and its discarded COMDAT members a place in the
+/// output.  The inputs' .note.GNU-stack markers share one output section.
+template <class ELFT>
+error_code ELFMerger<ELFT>::addSections(unsigned FileIdx) {
+  InputFile &In = *Inputs[FileIdx];
+  const ELFO &File = *In.File;
+  uint32_t ShStrNdx = File.getHeader()->e_shstrndx;
+  In.SectionMap.assign(File.getNumSections(), 0);
+
+  bool HasNoteGNUStack = false;
+  uint32_t Index = 0;
+  for (typename ELFO::Elf_Shdr_Iter I = File.begin_sections(),
+         E = File.end_sections(); I != E; ++I, ++Index) {
+    if (Index == 0 || Index == ShStrNdx || &*I == In.SymTab ||
+        (In.SymTab && Index == In.SymTab->sh_link) || In.Discarded[Index])
+      continue;
+
+    ErrorOr<StringRef> Name = File.getSectionName(&*I);
+    if (!Name)
+      return Name;
+    if (*Name == ".note.GNU-stack") {
+      HasNoteGNUStack = true;
+      if (NoteGNUStack) {
+        // An executable stack anywhere makes the whole object need one.
+        Elf_Shdr &Note = Sections[NoteGNUStack - 1].Header;
+        Note.sh_flags = Note.sh_flags | (I->sh_flags & ELF::SHF_EXECINSTR);
+        In.SectionMap[Index] = NoteGNUStack;
+        continue;
+      }
+    }
+
+    OutputSection Sec;
+    Sec.Header = *I;
+    Sec.Name = *Name;
+    Sec.File = FileIdx;
+    if (I->sh_type != ELF::SHT_NOBITS) {
+      ErrorOr<ArrayRef<uint8_t> > Contents = File.getSectionContents(&*I);
+      if (!Contents)
+        return Contents;
+      Sec.Contents = *Contents;
+    }
+    // Output section 0 is the null section.
+    Sections.push_back(Sec);
+    In.SectionMap[Index] = Sections.size();
+    if (*Name == ".note.GNU-stack")
+      NoteGNUStack = Sections.size();
+  }
+  if (!HasNoteGNUStack)
+    MissingNoteGNUStack = true;
+  return error_code::success();
+}
+
+template <class ELFT>
+error_code ELFMerger<ELFT>::mapSection(const InputFile &In, uint32_t Index,
+                                       uint32_t &Result) const {
+  if (Index >= In.SectionMap.size() || !In.SectionMap[Index])
+    return object_error::parse_failed;
+  Result = In.SectionMap[Index];
+  return error_code::success();
+}
+
+static unsigned getVisibilityRank(unsigned char Other) {
+  switch (Other & 0x3) {
+  case ELF::STV_INTERNAL:  return 3;
+  case ELF::STV_HIDDEN:    return 2;
+  case ELF::STV_PROTECTED: return 1;
+  default:                 return 0;
+  }
+}
+
+/// mergeGlobal - Fold a global symbol from a later input into the one of
+/// the same name seen before.
+template <class ELFT>
+error_code ELFMerger<ELFT>::mergeGlobal(Elf_Sym &Existing,
+                                        const Elf_Sym &New) {
+  unsigned char Other = Existing.st_other;
+  if (getVisibilityRank(New.st_other) > getVisibilityRank(Other))
+    Other = New.st_other;
+
+  bool ExistingDefined = Existing.st_shndx != ELF::SHN_UNDEF;
+  bool NewDefined = New.st_shndx != ELF::SHN_UNDEF;
+  if (NewDefined) {
+    if (!ExistingDefined) {
+      Existing = New;
+    } else {
+      bool ExistingStrong = Existing.getBinding() != ELF::STB_WEAK &&
+                            Existing.st_shndx != ELF::SHN_COMMON;
+      bool NewStrong = New.getBinding() != ELF::STB_WEAK &&
+                       New.st_shndx != ELF::SHN_COMMON;
+      if (ExistingStrong && NewStrong)
+        return object_error::parse_failed;
+      if (NewStrong)
+        Existing = New;
+    }
+  } else if (!ExistingDefined) {
+    // An undefined reference is weak only if every reference is.
+    if (New.getBinding() != ELF::STB_WEAK)
+      Existing.setBinding(New.getBinding());
+    if (Existing.getType() == ELF::STT_NOTYPE)
+      Existing.setType(New.getType());
+  }
+  Existing.st_other = (Existing.st_other & ~0x3) | (Other & 0x3);
+  return error_code::success();
+}
+
+/// addSymbols - Add the local or the global symbols of input \p FileIdx to
+/// the output and record where each went.  All locals must be added before
+/// any globals, since the output lists them first.
+template <class ELFT>
+error_code ELFMerger<ELFT>::addSymbols(unsigned FileIdx, bool Local) {
+  InputFile &In = *Inputs[FileIdx];
+  if (!In.SymTab)
+    return error_code::success();
+  ErrorOr<ArrayRef<uint8_t> > Data = In.File->getSectionContents(In.SymTab);
+  if (!Data)
+    return Data;
+  const Elf_Sym *Syms = reinterpret_cast<const Elf_Sym *>(Data->data());
+  size_t NumSyms = Data->size() / sizeof(Elf_Sym);
+  In.SymbolMap.resize(NumSyms);
+
+  for (size_t I = 1; I < NumSyms; ++I) {
+    Elf_Sym Sym = Syms[I];
+    if ((Sym.getBinding() == ELF::STB_LOCAL) != Local)
+      continue;
+
+    if (Sym.st_name >= In.StrTab.size())
+      return object_error::parse_failed;
+    StringRef Name(reinterpret_cast<const char *>(In.StrTab.data()) +
+                   Sym.st_name);
+    Sym.st_name = StrTab.add(Name);
+
+    uint32_t Shndx = Sym.st_shndx;
+    if (Shndx == ELF::SHN_XINDEX)
+      return object_error::parse_failed;
+    if (Shndx < In.Discarded.size() && In.Discarded[Shndx]) {
+      // Only the discarded group's own relocations refer to its locals, and
+      // its globals resolve to the copy that was kept.
+      if (Local)
+        continue;
+      Sym.st_shndx = ELF::SHN_UNDEF;
+      Sym.st_value = 0;
+      Sym.st_size = 0;
+    } else if (Shndx != ELF::SHN_UNDEF && Shndx < ELF::SHN_LORESERVE) {
+      uint32_t NewShndx;
+      if (error_code EC = mapSection(In, Shndx, NewShndx))
+        return EC;
+      if (NewShndx >= ELF::SHN_LORESERVE)
+        return object_error::parse_failed;
+      Sym.st_shndx = NewShndx;
+    }
+
+    if (Local) {
+      In.SymbolMap[I] = Locals.size() + 1;
+      Locals.push_back(Sym);
+      continue;
+    }
+
+    // Global symbols follow the null symbol and the locals.
+    uint32_t Slot = GlobalSlots.GetOrCreateValue(Name, Globals.size())
+                      .getValue();
+    if (Slot == Globals.size())
+      Globals.push_back(Sym);
+    else if (error_code EC = mergeGlobal(Globals[Slot], Sym))
+      return EC;
+    In.SymbolMap[I] = Locals.size() + 1 + Slot;
+  }
+  return error_code::success();
+}
+
+template <class ELFT>
+template <class RelT>
+void ELFMerger<ELFT>::rewriteRelocations(OutputSection &Sec) {
+  const InputFile &In = *Inputs[Sec.File];
+  const RelT *Rels = reinterpret_cast<const RelT *>(Sec.Contents.data());
+  size_t NumRels = Sec.Contents.size() / sizeof(RelT);
+  Sec.IsRewritten = true;
+  Sec.Rewritten.resize(NumRels * sizeof(RelT));
+  RelT *Out = reinterpret_cast<RelT *>(&Sec.Rewritten[0]);
+  for (size_t I = 0; I != NumRels; ++I) {
+    Out[I] = Rels[I];
+    uint32_t Sym = Rels[I].getSymbol(false);
+    Out[I].setSymbolAndType(Sym < In.SymbolMap.size() ? In.SymbolMap[Sym] : 0,
+                            Rels[I].getType(false));
+  }
+}
+
+/// rewriteSection - Update the section and symbol indices that \p Sec
+/// refers to for their places in the output.
+template <class ELFT>
+error_code ELFMerger<ELFT>::rewriteSection(OutputSection &Sec) {
+  const InputFile &In = *Inputs[Sec.File];
+  Elf_Shdr &H = Sec.Header;
+  uint32_t SymTabIndex = Sections.size() + 1;
+  uint32_t Index;
+
+  switch (H.sh_type) {
+  case ELF::SHT_REL:
+  case ELF::SHT_RELA:
+    if (H.sh_entsize != (H.sh_type == ELF::SHT_REL ? sizeof(Elf_Rel)
+                                                   : sizeof(Elf_Rela)))
+      return object_error::parse_failed;
+    if (error_code EC = mapSection(In, H.sh_info, Index))
+      return EC;
+    H.sh_info = Index;
+    H.sh_link = SymTabIndex;
+    if (H.sh_type == ELF::SHT_REL)
+      rewriteRelocations<Elf_Rel>(Sec);
+    else
+      rewriteRelocations<Elf_Rela>(Sec);
+    return error_code::success();
+
+  case ELF::SHT_GROUP: {
+    // A flag word followed by the indices of the members.
+    if (H.sh_info >= In.SymbolMap.size())
+      return object_error::parse_failed;
+    H.sh_info = In.SymbolMap[H.sh_info];
+    H.sh_link = SymTabIndex;
+    const Elf_Word *Words =
+      reinterpret_cast<const Elf_Word *>(Sec.Contents.data());
+    size_t NumWords = Sec.Contents.size() / sizeof(Elf_Word);
+    Sec.IsRewritten = true;
+    Sec.Rewritten.resize(NumWords * sizeof(Elf_Word));
+    Elf_Word *Out = reinterpret_cast<Elf_Word *>(&Sec.Rewritten[0]);
+    for (size_t I = 0; I != NumWords; ++I) {
+      Out[I] = Words[I];
+      if (I == 0)
+        continue;
+      if (error_code EC = mapSection(In, Words[I], Index))
+        return EC;
+      Out[I] = Index;
+    }
+    return error_code::success();
+  }
+
+  default:
+    if (H.sh_link) {
+      if (error_code EC = mapSection(In, H.sh_link, Index))
+        return EC;
+      H.sh_link = Index;
+    }
+    return error_code::success();
+  }
+}
+
+template <class ELFT>
+void ELFMerger<ELFT>::write(raw_ostream &OS) {
+  // The symbol table and the two string tables go at the end.
+  Elf_Sym NullSym;
+  memset(&NullSym, 0, sizeof(NullSym));
+  std::string SymTabData;
+  SymTabData.append(reinterpret_cast<const char *>(&NullSym), sizeof(Elf_Sym));
+  SymTabData.append(reinterpret_cast<const char *>(Locals.data()),
+                    Locals.size() * sizeof(Elf_Sym));
+  SymTabData.append(reinterpret_cast<const char *>(Globals.data()),
+                    Globals.size() * sizeof(Elf_Sym));
+
+  StringTable ShStrTab;
+  uint32_t SymTabIndex = Sections.size() + 1;
+  OutputSection Extra[3];
+  memset(&Extra[0].Header, 0, sizeof(Elf_Shdr));
+  memset(&Extra[1].Header, 0, sizeof(Elf_Shdr));
+  memset(&Extra[2].Header, 0, sizeof(Elf_Shdr));
+  Extra[0].Name = ".symtab";
+  Extra[0].Header.sh_type = ELF::SHT_SYMTAB;
+  Extra[0].Header.sh_link = SymTabIndex + 1;
+  Extra[0].Header.sh_info = Locals.size() + 1;
+  Extra[0].Header.sh_entsize = sizeof(Elf_Sym);
+  Extra[0].Header.sh_addralign = ELFT::Is64Bits ? 8 : 4;
+  Extra[0].Rewritten = SymTabData;
+  Extra[1].Name = ".strtab";
+  Extra[1].Header.sh_type = ELF::SHT_STRTAB;
+  Extra[1].Header.sh_addralign = 1;
+  Extra[1].Rewritten = StrTab.str();
+  Extra[2].Name = ".shstrtab";
+  Extra[2].Header.sh_type = ELF::SHT_STRTAB;
+  Extra[2].Header.sh_addralign = 1;
+  for (unsigned I = 0; I != 3; ++I) {
+    Extra[I].IsRewritten = true;
+    Sections.push_back(Extra[I]);
+  }
+
+  for (unsigned I = 0, E = Sections.size(); I != E; ++I)
+    Sections[I].Header.sh_name = ShStrTab.add(Sections[I].Name);
+  Sections.back().Rewritten = ShStrTab.str();
+
+  // Lay out the contents after the file header, then the section headers.
+  uint64_t Offset = sizeof(Elf_Ehdr);
+  for (unsigned I = 0, E = Sections.size(); I != E; ++I) {
+    OutputSection &Sec = Sections[I];
+    Elf_Shdr &H = Sec.Header;
+    if (Sec.IsRewritten)
+      H.sh_size = Sec.Rewritten.size();
+    uint64_t Align = H.sh_addralign;
+    Offset = RoundUpToAlignment(Offset, Align ? Align : 1);
+    H.sh_offset = Offset;
+    if (H.sh_type != ELF::SHT_NOBITS)
+      Offset += H.sh_size;
+  }
+  uint64_t SectionHeaderOffset =
+    RoundUpToAlignment(Offset, ELFT::Is64Bits ? 8 : 4);
+
+  Elf_Ehdr Header = *Inputs[0]->File->getHeader();
+  Header.e_entry = 0;
+  Header.e_phoff = 0;
+  Header.e_phnum = 0;
+  Header.e_phentsize = 0;
+  Header.e_shoff = SectionHeaderOffset;
+  Header.e_ehsize = sizeof(Elf_Ehdr);
+  Header.e_shentsize = sizeof(Elf_Shdr);
+  Header.e_shnum = Sections.size() + 1;
+  Header.e_shstrndx = Sections.size();
+
+  OS.reserveExtraSpace(SectionHeaderOffset +
+                       (Sections.size() + 1) * sizeof(Elf_Shdr));
+
+  uint64_t Written = 0;
+  OS.write(reinterpret_cast<const char *>(&Header), sizeof(Header));
+  Written += sizeof(Header);
+  for (unsigned I = 0, E = Sections.size(); I != E; ++I) {
+    const OutputSection &Sec = Sections[I];
+    if (Sec.Header.sh_type == ELF::SHT_NOBITS)
+      continue;
+    writeZeros(OS, Sec.Header.sh_offset - Written);
+    Written = Sec.Header.sh_offset;
+    if (Sec.IsRewritten)
+      OS << Sec.Rewritten;
+    else
+      OS.write(reinterpret_cast<const char *>(Sec.Contents.data()),
+               Sec.Contents.size());
+    Written += Sec.Header.sh_size;
+  }
+  writeZeros(OS, SectionHeaderOffset - Written);
+
+  Elf_Shdr NullSection;
+  memset(&NullSection, 0, sizeof(NullSection));
+  OS.write(reinterpret_cast<const char *>(&NullSection), sizeof(Elf_Shdr));
+  for (unsigned I = 0, E = Sections.size(); I != E; ++I)
+    OS.write(reinterpret_cast<const char *>(&Sections[I].Header),
+             sizeof(Elf_Shdr));
+}
+
+template <class ELFT>
+error_code ELFMerger<ELFT>::merge(ArrayRef<StringRef> Objects,
+                                  raw_ostream &OS) {
+  for (unsigned I = 0, E = Objects.size(); I != E; ++I) {
+    Inputs.push_back(new InputFile());
+    if (error_code EC = readInput(Objects[I], *Inputs[I]))
+      return EC;
+  }
+
+  const Elf_Ehdr *First = Inputs[0]->File->getHeader();
+  if (isMips64EL())
+    return object_error::invalid_file_type;
+  for (unsigned I = 1, E = Inputs.size(); I != E; ++I)
+    if (Inputs[I]->File->getHeader()->e_machine != First->e_machine)
+      return object_error::invalid_file_type;
+
+  for (unsigned I = 0, E = Inputs.size(); I != E; ++I) {
+    if (error_code EC = discardComdats(I))
+      return EC;
+    if (error_code EC = addSections(I))
+      return EC;
+  }
+  // Without the marker a linker assumes the code needs an executable stack,
+  // so an input that leaves it out must not be hidden by the others.
+  if (NoteGNUStack && MissingNoteGNUStack) {
+    Elf_Shdr &Note = Sections[NoteGNUStack - 1].Header;
+    Note.sh_flags = Note.sh_flags | ELF::SHF_EXECINSTR;
+  }
+  for (unsigned I = 0, E = Inputs.size(); I != E; ++I)
+    if (error_code EC = addSymbols(I, /*Local=*/true))
+      return EC;
+  for (unsigned I = 0, E = Inputs.size(); I != E; ++I)
+    if (error_code EC = addSymbols(I, /*Local=*/false))
+      return EC;
+
+  for (unsigned I = 0, E = Sections.size(); I != E; ++I)
+    if (error_code EC = rewriteSection(Sections[I]))
+      return EC;
+
+  write(OS);
+  return error_code::success();
+}
+
+error_code object::mergeELFObjects(ArrayRef<StringRef> Objects,
+                                   raw_ostream &OS) {
+  if (Objects.empty())
+    return object_error::invalid_file_type;
+
+  // The inputs are usually in memory that is not aligned for the file's
+  // types, so read them with the unaligned variants.
+  std::pair<unsigned char, unsigned char> Ident(ELF::ELFCLASSNONE,
+                                                ELF::ELFDATANONE);
+  for (unsigned I = 0, E = Objects.size(); I != E; ++I) {
+    if (Objects[I].size() < ELF::EI_NIDENT)
+      return object_error::invalid_file_type;
+    std::pair<unsigned char, unsigned char> ThisIdent(
+      Objects[I][ELF::EI_CLASS], Objects[I][ELF::EI_DATA]);
+    if (I != 0 && ThisIdent != Ident)
+      return object_error::invalid_file_type;
+    Ident = ThisIdent;
+  }
+
+  if (Ident.first == ELF::ELFCLASS32 && Ident.second == ELF::ELFDATA2LSB)
+    return ELFMerger<ELFType<support::little, 2, false> >().merge(Objects, OS);
+  if (Ident.first == ELF::ELFCLASS32 && Ident.second == ELF::ELFDATA2MSB)
+    return ELFMerger<ELFType<support::big, 2, false> >().merge(Objects, OS);
+  if (Ident.first == ELF::ELFCLASS64 && Ident.second == ELF::ELFDATA2LSB)
+    return ELFMerger<ELFType<support::little, 2, true> >().merge(Objects, OS);
+  if (Ident.first == ELF::ELFCLASS64 && Ident.second == ELF::ELFDATA2MSB)
+    return ELFMerger<ELFType<support::big, 2, true> >().merge(Objects, OS);
+  return object_error::invalid_file_type;
+}
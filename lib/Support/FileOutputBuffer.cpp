@@ -7,15 +7,18 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// Utility for creating a in-memory buffer that will be written to a file.
+// Utility for creating a in-memory buffer that will be written to a file, and
+// a raw_ostream that writes through one.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/FileOutputBuffer.h"
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Signals.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
+#include <cstring>
 
 using llvm::sys::fs::mapped_file_region;
 
@@ -30,6 +33,7 @@ FileOutputBuffer::FileOutputBuffer(mapped_file_region * R,
 FileOutputBuffer::~FileOutputBuffer() {
   bool Existed;
   sys::fs::remove(Twine(TempPath), Existed);
+  sys::DontRemoveFileOnSignal(TempPath);
 }
 
 error_code FileOutputBuffer::create(StringRef FilePath,
@@ -75,6 +79,9 @@ error_code FileOutputBuffer::create(StringRef FilePath,
   if (EC)
     return EC;
 
+  // Don't leave the temporary file behind if we are interrupted.
+  sys::RemoveFileOnSignal(TempFilePath);
+
   OwningPtr<mapped_file_region> MappedFile(new mapped_file_region(
       FD, true, mapped_file_region::readwrite, Size, 0, EC));
   if (EC)
@@ -101,4 +108,76 @@ error_code FileOutputBuffer::commit(int64_t NewSmallerSize) {
   // Rename file to final name.
   return sys::fs::rename(Twine(TempPath), Twine(FinalPath));
 }
+
+raw_mmap_ostream::raw_mmap_ostream(StringRef Path) : Path(Path), Pos(0) {
+}
+
+raw_mmap_ostream::~raw_mmap_ostream() {
+  flush();
+}
+
+void raw_mmap_ostream::write_impl(const char *Ptr, size_t Size) {
+  if (Buffer) {
+    if (Pos + Size <= Buffer->getBufferSize()) {
+      memcpy(Buffer->getBufferStart() + Pos, Ptr, Size);
+      Pos += Size;
+      return;
+    }
+
+    // The reservation was too small. Keep the output in memory until more
+    // space is reserved, or until commit().
+    const char *Start = (const char *)Buffer->getBufferStart();
+    Pending.append(Start, Start + Pos);
+    Buffer.reset();
+  }
+
+  Pending.append(Ptr, Ptr + Size);
+  Pos += Size;
+}
+
+void raw_mmap_ostream::reserveExtraSpace(uint64_t ExtraSize) {
+  // Leave room for the output still in the stream buffer, too.
+  uint64_t Size = Pos + GetNumBytesInBuffer() + ExtraSize;
+  if (ExtraSize == 0 || (Buffer && Size <= Buffer->getBufferSize()))
+    return;
+
+  // If the file cannot be mapped, for example because the path names a
+  // device, go on writing to memory; commit() reports any real error.
+  OwningPtr<FileOutputBuffer> NewBuffer;
+  if (FileOutputBuffer::create(Path, Size, NewBuffer))
+    return;
+
+  if (Buffer) {
+    memcpy(NewBuffer->getBufferStart(), Buffer->getBufferStart(), Pos);
+  } else {
+    memcpy(NewBuffer->getBufferStart(), Pending.data(), Pos);
+    SmallVector<char, 0>().swap(Pending);
+  }
+  Buffer.swap(NewBuffer);
+}
+
+error_code raw_mmap_ostream::commit() {
+  flush();
+  if (Buffer) {
+    error_code EC =
+      Buffer->commit(Pos < Buffer->getBufferSize() ? int64_t(Pos) : -1);
+    Buffer.reset();
+    return EC;
+  }
+
+  // Nothing was reserved, so write the output the usual way.
+  int FD;
+  if (error_code EC = sys::fs::openFileForWrite(Twine(Path), FD,
+                                                  sys::fs::F_Binary))
+    return EC;
+  raw_fd_ostream Out(FD, /*shouldClose=*/true);
+  Out.write(Pending.data(), Pending.size());
+  Out.close();
+  SmallVector<char, 0>().swap(Pending);
+  if (Out.has_error()) {
+    Out.clear_error();
+    return make_error_code(errc::io_error);
+  }
+  return error_code::success();
+}
 } // namespace
@@ -16,6 +16,7 @@
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/Mutex.h"
 #include <cassert>
+#include <vector>
 
 using namespace llvm;
 
@@ -63,6 +64,29 @@ void llvm::llvm_release_global_lock() {
   if (multithreaded_mode) global_lock->release();
 }
 
+#if LLVM_ENABLE_THREADS != 0 && \
+    (defined(HAVE_PTHREAD_H) || defined(LLVM_ON_WIN32))
+// Shared by the threads of one llvm_execute_in_parallel call, each of which
+// takes the next unclaimed entry until none are left.
+namespace {
+struct ParallelWork {
+  void (*UserFn)(void *);
+  void *const *UserData;
+  unsigned Count;
+  volatile sys::cas_flag Next;
+};
+}
+
+static void RunParallelWork(ParallelWork *W) {
+  for (;;) {
+    unsigned I = unsigned(sys::AtomicIncrement(&W->Next)) - 1;
+    if (I >= W->Count)
+      return;
+    W->UserFn(W->UserData[I]);
+  }
+}
+#endif
+
 #if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
 #include <pthread.h>
 
@@ -102,6 +126,30 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
  error:
   ::pthread_attr_destroy(&Attr);
 }
+
+static void *ExecuteInParallel_Dispatch(void *Arg) {
+  RunParallelWork(reinterpret_cast<ParallelWork*>(Arg));
+  return 0;
+}
+
+void llvm::llvm_execute_in_parallel(void (*Fn)(void*), void *const *UserData,
+                                    unsigned Count, unsigned NumThreads) {
+  ParallelWork Work = { Fn, UserData, Count, 0 };
+  if (NumThreads > Count)
+    NumThreads = Count;
+
+  // The calling thread does its share too.  Any thread that cannot be
+  // created just leaves more of the work to the others.
+  std::vector<pthread_t> Threads;
+  for (unsigned I = 1; I < NumThreads; ++I) {
+    pthread_t Thread;
+    if (::pthread_create(&Thread, 0, ExecuteInParallel_Dispatch, &Work) == 0)
+      Threads.push_back(Thread);
+  }
+  RunParallelWork(&Work);
+  for (unsigned I = 0, E = Threads.size(); I != E; ++I)
+    ::pthread_join(Threads[I], 0);
+}
 #elif LLVM_ENABLE_THREADS!=0 && defined(LLVM_ON_WIN32)
 #include "Windows/Windows.h"
 #include <process.h>
@@ -136,6 +184,31 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
     ::CloseHandle(hThread);
   }
 }
+
+static unsigned __stdcall ParallelCallback(void *param) {
+  RunParallelWork(reinterpret_cast<ParallelWork *>(param));
+  return 0;
+}
+
+void llvm::llvm_execute_in_parallel(void (*Fn)(void*), void *const *UserData,
+                                    unsigned Count, unsigned NumThreads) {
+  ParallelWork Work = { Fn, UserData, Count, 0 };
+  if (NumThreads > Count)
+    NumThreads = Count;
+
+  std::vector<HANDLE> Threads;
+  for (unsigned I = 1; I < NumThreads; ++I) {
+    HANDLE hThread = (HANDLE)::_beginthreadex(NULL, 0, ParallelCallback,
+                                              &Work, 0, NULL);
+    if (hThread)
+      Threads.push_back(hThread);
+  }
+  RunParallelWork(&Work);
+  for (unsigned I = 0, E = Threads.size(); I != E; ++I) {
+    (void)::WaitForSingleObject(Threads[I], INFINITE);
+    ::CloseHandle(Threads[I]);
+  }
+}
 #else
 // Support for non-Win32, non-pthread implementation.
 void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
@@ -144,4 +217,11 @@ void llvm::llvm_execute_on_thread(void (*Fn)(void*), void *UserData,
   Fn(UserData);
 }
 
+void llvm::llvm_execute_in_parallel(void (*Fn)(void*), void *const *UserData,
+                                    unsigned Count, unsigned NumThreads) {
+  (void) NumThreads;
+  for (unsigned I = 0; I != Count; ++I)
+    Fn(UserData[I]);
+}
+
 #endif
@@ -20,6 +20,7 @@
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadLocal.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
@@ -51,6 +52,13 @@ namespace {
   InfoOutputFilename("info-output-file", cl::value_desc("filename"),
                      cl::desc("File to append -stats and -timer output to"),
                    cl::Hidden, cl::location(getLibSupportInfoOutputFilename()));
+
+  static cl::opt<std::string>
+  TimeTraceFile("time-trace-file", cl::value_desc("filename"),
+                cl::desc("Write the regions timed by -time-passes to this file "
+                         "as a Chrome trace-event timeline (implies "
+                         "-time-passes)"),
+                cl::Hidden);
 }
 
 // CreateInfoOutputFile - Return a file stream to print our output on.
@@ -96,6 +104,141 @@ static TimerGroup *getDefaultTimerGroup() {
   return tmp;
 }
 
+//===----------------------------------------------------------------------===//
+// Time Trace Implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+/// TimeTraceEvent - The start ('B') or end ('E') of a timed region.
+struct TimeTraceEvent {
+  char Phase;
+  unsigned ThreadID;
+  uint64_t Time;          // Microseconds since the recorder was created.
+  std::string Name;       // The timer, the group and the context of a 'B'.
+  std::string Group;
+  std::string Detail;
+};
+
+/// TimeTraceRecorder - Collects the events of every timer while the program
+/// runs and writes them out when it is destroyed by llvm_shutdown.
+class TimeTraceRecorder {
+  sys::SmartMutex<true> Lock;
+  std::vector<TimeTraceEvent> Events;
+  std::string Filename;
+  uint64_t StartTime;
+  unsigned NumThreads;
+  sys::ThreadLocal<const void> ThreadID;
+  sys::ThreadLocal<const TimeTraceContext> Context;
+
+  static uint64_t now() {
+    sys::TimeValue Now = sys::TimeValue::now();
+    return uint64_t(Now.seconds()) * 1000000 + Now.microseconds();
+  }
+
+public:
+  TimeTraceRecorder()
+    : Filename(TimeTraceFile), StartTime(now()), NumThreads(0) {}
+  ~TimeTraceRecorder();
+
+  const TimeTraceContext *getContext() { return Context.get(); }
+  void setContext(const TimeTraceContext *C) { Context.set(C); }
+
+  void record(char Phase, const std::string &Name, const std::string &Group);
+};
+
+}
+
+static ManagedStatic<TimeTraceRecorder> TimeTrace;
+
+void TimeTraceRecorder::record(char Phase, const std::string &Name,
+                               const std::string &Group) {
+  uint64_t Time = now() - StartTime;
+  sys::SmartScopedLock<true> L(Lock);
+
+  // Number the threads in the order they first record an event.
+  uintptr_t ID = reinterpret_cast<uintptr_t>(ThreadID.get());
+  if (!ID) {
+    ID = ++NumThreads;
+    ThreadID.set(reinterpret_cast<const void *>(ID));
+  }
+
+  Events.push_back(TimeTraceEvent());
+  TimeTraceEvent &E = Events.back();
+  E.Phase = Phase;
+  E.ThreadID = ID;
+  E.Time = Time;
+  if (Phase == 'B') {
+    E.Name = Name;
+    E.Group = Group;
+    if (const TimeTraceContext *C = Context.get())
+      E.Detail = C->getDetail();
+  }
+}
+
+static void printJSONString(StringRef S, raw_ostream &OS) {
+  OS << '"';
+  for (StringRef::iterator I = S.begin(), E = S.end(); I != E; ++I) {
+    unsigned char C = *I;
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+TimeTraceRecorder::~TimeTraceRecorder() {
+  if (Events.empty())
+    return;
+
+  std::string Error;
+  raw_fd_ostream OS(Filename.c_str(), Error);
+  if (!Error.empty()) {
+    errs() << "Error opening time-trace-file '" << Filename << "': "
+           << Error << '\n';
+    return;
+  }
+
+  OS << "{\"traceEvents\":[";
+  for (unsigned i = 0, e = Events.size(); i != e; ++i) {
+    const TimeTraceEvent &E = Events[i];
+    OS << (i ? ",\n" : "\n") << "{\"ph\":\"" << E.Phase << "\",\"pid\":1,"
+       << "\"tid\":" << E.ThreadID << ",\"ts\":" << E.Time;
+    if (E.Phase == 'B') {
+      OS << ",\"name\":";
+      printJSONString(E.Name, OS);
+      OS << ",\"cat\":";
+      printJSONString(E.Group, OS);
+      OS << ",\"args\":{\"detail\":";
+      printJSONString(E.Detail, OS);
+      OS << '}';
+    }
+    OS << '}';
+  }
+  OS << "\n]}\n";
+}
+
+bool llvm::isTimeTraceEnabled() {
+  return !TimeTraceFile.empty();
+}
+
+TimeTraceContext::TimeTraceContext(StringRef D)
+  : Prev(0), Active(isTimeTraceEnabled()) {
+  if (!Active)
+    return;
+  Detail.assign(D.begin(), D.end());
+  Prev = TimeTrace->getContext();
+  TimeTrace->setContext(this);
+}
+
+TimeTraceContext::~TimeTraceContext() {
+  if (Active)
+    TimeTrace->setContext(Prev);
+}
+
 //===----------------------------------------------------------------------===//
 // Timer Implementation
 //===----------------------------------------------------------------------===//
@@ -147,6 +290,10 @@ TimeRecord TimeRecord::getCurrentTime(bool Start) {
 static ManagedStatic<std::vector<Timer*> > ActiveTimers;
 
 void Timer::startTimer() {
+  // Record the trace event first, so that its cost is not timed.
+  if (!TimeTraceFile.empty())
+    TimeTrace->record('B', Name, TG->Name);
+
   Started = true;
   ActiveTimers->push_back(this);
   Time -= TimeRecord::getCurrentTime(true);
@@ -155,6 +302,9 @@ void Timer::startTimer() {
 void Timer::stopTimer() {
   Time += TimeRecord::getCurrentTime(false);
 
+  if (!TimeTraceFile.empty())
+    TimeTrace->record('E', Name, TG->Name);
+
   if (ActiveTimers->back() == this) {
     ActiveTimers->pop_back();
   } else {
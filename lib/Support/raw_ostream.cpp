@@ -721,6 +721,15 @@ void raw_svector_ostream::resync() {
   SetBuffer(OS.end(), OS.capacity() - OS.size());
 }
 
+void raw_svector_ostream::reserveExtraSpace(uint64_t ExtraSize) {
+  flush();
+
+  // Leave the 64 bytes write_impl wants free after the last write, so that
+  // filling the reserved space does not make it double the vector.
+  OS.reserve(OS.size() + ExtraSize + 64);
+  SetBuffer(OS.end(), OS.capacity() - OS.size());
+}
+
 void raw_svector_ostream::write_impl(const char *Ptr, size_t Size) {
   // If we're writing bytes from the end of the buffer into the smallvector, we
   // don't need to copy the bytes, just commit the bytes because they are
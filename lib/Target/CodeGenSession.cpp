@@ -0,0 +1,52 @@
+//===-- CodeGenSession.cpp - Reusable codegen pipeline --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements CodeGenSession.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Target/CodeGenSession.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
+
+using namespace llvm;
+
+CodeGenSession::CodeGenSession(TargetMachine &TM)
+  : TM(TM), OutputOS(Output), FormattedOS(OutputOS) { }
+
+CodeGenSession *CodeGenSession::create(TargetMachine &TM,
+                                       TargetMachine::CodeGenFileType FileType,
+                                       std::string &ErrMsg) {
+  const DataLayout *TD = TM.getDataLayout();
+  if (!TD) {
+    ErrMsg = "No DataLayout in TargetMachine";
+    return 0;
+  }
+
+  OwningPtr<CodeGenSession> S(new CodeGenSession(TM));
+  S->PM.add(new DataLayout(*TD));
+  if (TM.addPassesToEmitFile(S->PM, S->FormattedOS, FileType)) {
+    ErrMsg = "TargetMachine can't emit a file of this type";
+    return 0;
+  }
+  return S.take();
+}
+
+StringRef CodeGenSession::emit(Module &M) {
+  // Keep the capacity from the previous module.  Object writers take file
+  // offsets from tell(), which starts again from zero once this is empty.
+  Output.clear();
+
+  PM.run(M);
+
+  FormattedOS.flush();
+  OutputOS.flush();
+  return Output;
+}
@@ -21,11 +21,23 @@
 namespace llvm {
   class QpuTargetMachine;
   class FunctionPass;
+  class ImmutablePass;
+  class ModulePass;
+  class PBQPRAConstraint;
+  class ScheduleDAGInstrs;
+  struct MachineSchedContext;
 
   FunctionPass *createQpuISelDag(QpuTargetMachine &TM);
   FunctionPass *createQpuEmitGPRestorePass(QpuTargetMachine &TM);
   FunctionPass *createQpuDelJmpPass(QpuTargetMachine &TM);
   FunctionPass *createQpuNopperPass(QpuTargetMachine &TM);
+  FunctionPass *createQpuModuloSchedulePass(QpuTargetMachine &TM);
+  FunctionPass *createQpuKernelReportPass(QpuTargetMachine &TM,
+                                          StringRef File);
+  ModulePass *createQpuKernelInlinePass();
+  ImmutablePass *createQpuTargetTransformInfoPass(const QpuTargetMachine *TM);
+  ScheduleDAGInstrs *createQpuMachineScheduler(MachineSchedContext *C);
+  PBQPRAConstraint *createQpuPBQPConstraint();
 
 } // end namespace llvm;
 
@@ -18,10 +18,14 @@
 #include "QpuInstrInfo.h"
 #include "InstPrinter/QpuInstPrinter.h"
 #include "MCTargetDesc/QpuBaseInfo.h"
+#include "MCTargetDesc/QpuFixupKinds.h"
+#include "MCTargetDesc/QpuMCTargetDesc.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineConstantPool.h"
@@ -30,9 +34,15 @@
 #include "llvm/CodeGen/MachineMemOperand.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCSymbol.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/Mangler.h"
 #include "llvm/Target/TargetLoweringObjectFile.h"
@@ -40,6 +50,11 @@
 
 using namespace llvm;
 
+static cl::opt<std::string> KernelBinaryFile(
+  "qpu-kernel-binary",
+  cl::desc("Also write the kernels to a relocation-free container."),
+  cl::value_desc("filename"), cl::init(""));
+
 void QpuAsmPrinter::EmitInstrWithMacroNoAT(const MachineInstr *MI) {
   MCInst TmpInst;
 
@@ -47,7 +62,7 @@ void QpuAsmPrinter::EmitInstrWithMacroNoAT(const MachineInstr *MI) {
   OutStreamer.EmitRawText(StringRef("\t.set\tmacro"));
   if (QpuFI->getEmitNOAT())
     OutStreamer.EmitRawText(StringRef("\t.set\tat"));
-  OutStreamer.EmitInstruction(TmpInst);
+  EmitMCInst(TmpInst);
   if (QpuFI->getEmitNOAT())
     OutStreamer.EmitRawText(StringRef("\t.set\tnoat"));
   OutStreamer.EmitRawText(StringRef("\t.set\tnomacro"));
@@ -69,6 +84,9 @@ void QpuAsmPrinter::EmitInstruction(const MachineInstr *MI) {
     return;
   }
 
+  if (KernelEmitter)
+    recordKernelBlocks(MI->getParent());
+
   unsigned Opc = MI->getOpcode();
   MCInst TmpInst0;
   SmallVector<MCInst, 4> MCInsts;
@@ -89,7 +107,7 @@ void QpuAsmPrinter::EmitInstruction(const MachineInstr *MI) {
 
       for (SmallVector<MCInst, 4>::iterator I = MCInsts.begin();
            I != MCInsts.end(); ++I)
-        OutStreamer.EmitInstruction(*I);
+        EmitMCInst(*I);
 
       return;
     }
@@ -101,7 +119,216 @@ void QpuAsmPrinter::EmitInstruction(const MachineInstr *MI) {
   } // lbd document - mark - switch (Opc)
 
   MCInstLowering.Lower(MI, TmpInst0);
-  OutStreamer.EmitInstruction(TmpInst0);
+  EmitMCInst(TmpInst0);
+}
+
+void QpuAsmPrinter::EmitMCInst(const MCInst &Inst) {
+  OutStreamer.EmitInstruction(Inst);
+  if (!KernelEmitter)
+    return;
+
+  SmallString<8> Code;
+  SmallVector<MCFixup, 4> Fixups;
+  raw_svector_ostream VecOS(Code);
+  KernelEmitter->EncodeInstruction(Inst, VecOS, Fixups);
+  VecOS.flush();
+
+  for (unsigned i = 0, e = Fixups.size(); i != e; ++i)
+    KernelFixups.push_back(MCFixup::Create(KernelCode.size() +
+                                           Fixups[i].getOffset(),
+                                           Fixups[i].getValue(),
+                                           Fixups[i].getKind()));
+  KernelCode += Code;
+}
+
+//===----------------------------------------------------------------------===//
+// Kernel container
+//===----------------------------------------------------------------------===//
+
+// Give MBB and every block laid out before it that has not been seen yet the
+// current code offset.  Empty blocks start where the next one does.  A null
+// MBB records all remaining blocks.
+void QpuAsmPrinter::recordKernelBlocks(const MachineBasicBlock *MBB) {
+  while (NextKernelBlock != MF->end()) {
+    const MachineBasicBlock *B = NextKernelBlock++;
+    KernelBlockOffsets[B->getSymbol()] = KernelCode.size();
+    if (B == MBB)
+      break;
+  }
+}
+
+static uint32_t getKernelRegBit(unsigned Reg) {
+  static const uint16_t AccRegs[] = {
+    Qpu::ACC0, Qpu::ACC1, Qpu::ACC2, Qpu::ACC3, 0, Qpu::ACC5
+  };
+  static const uint16_t RARegs[] = {
+    Qpu::RA0, Qpu::RA1, Qpu::RA2, Qpu::RA3,
+    Qpu::RA4, Qpu::RA5, Qpu::RA6, Qpu::RA7
+  };
+  static const uint16_t RBRegs[] = {
+    Qpu::RB0, Qpu::RB1, Qpu::RB2, Qpu::RB3,
+    Qpu::RB4, Qpu::RB5, Qpu::RB6, Qpu::RB7
+  };
+
+  for (unsigned i = 0; i != array_lengthof(AccRegs); ++i)
+    if (AccRegs[i] && AccRegs[i] == Reg)
+      return 1U << (QpuKernelBinary::RegMaskAccShift + i);
+  for (unsigned i = 0; i != array_lengthof(RARegs); ++i) {
+    if (RARegs[i] == Reg)
+      return 1U << (QpuKernelBinary::RegMaskRAShift + i);
+    if (RBRegs[i] == Reg)
+      return 1U << (QpuKernelBinary::RegMaskRBShift + i);
+  }
+  return 0;
+}
+
+// Rows of the VPM the accesses of a kernel reach.  Each object in the VPM is
+// taken to start on a row of its own and to be used from its first row up to
+// the last byte accessed.  An access at a variable offset may reach any row.
+static unsigned getVPMRows(const MachineFunction &MF, const DataLayout *TD) {
+  DenseMap<const Value *, uint64_t> Extent;
+  for (MachineFunction::const_iterator MBB = MF.begin(), E = MF.end();
+       MBB != E; ++MBB)
+    for (MachineBasicBlock::const_iterator MI = MBB->begin(),
+         ME = MBB->end(); MI != ME; ++MI)
+      for (MachineInstr::mmo_iterator I = MI->memoperands_begin(),
+           IE = MI->memoperands_end(); I != IE; ++I) {
+        if ((*I)->getPointerInfo().getAddrSpace() != 1)
+          continue;
+        const Value *V = (*I)->getValue();
+        if (!V)
+          return QpuKernelBinary::VPMRows;
+        int64_t Offset = 0;
+        const Value *Base = GetPointerBaseWithConstantOffset(V, Offset, TD);
+        Offset += (*I)->getOffset();
+        if (Base != GetUnderlyingObject(V, TD) || Offset < 0)
+          return QpuKernelBinary::VPMRows;
+        uint64_t &End = Extent[Base];
+        End = std::max(End, uint64_t(Offset) + (*I)->getSize());
+      }
+
+  uint64_t Rows = 0;
+  for (DenseMap<const Value *, uint64_t>::iterator I = Extent.begin(),
+       E = Extent.end(); I != E; ++I)
+    Rows += RoundUpToAlignment(I->second, QpuKernelBinary::VPMRowSize) /
+            QpuKernelBinary::VPMRowSize;
+  return std::min(Rows, uint64_t(QpuKernelBinary::VPMRows));
+}
+
+// Launch metadata of a kernel.  Loads from the VPM address space are VPM
+// reads, any other load goes through the TMU.  All stores go to the VPM.
+static QpuKernelBinary::KernelEntry getKernelEntry(const MachineFunction &MF,
+                                                   const DataLayout *TD) {
+  QpuKernelBinary::KernelEntry Entry;
+  memset(&Entry, 0, sizeof(Entry));
+  Entry.NumUniforms = MF.getFunction()->arg_size();
+  if (MF.getFunction()->hasFnAttribute("spmd-width")) {
+    Entry.Flags |= QpuKernelBinary::WorkItemVector;
+    ++Entry.NumUniforms;
+  }
+
+  for (MachineFunction::const_iterator MBB = MF.begin(), E = MF.end();
+       MBB != E; ++MBB)
+    for (MachineBasicBlock::const_iterator MI = MBB->begin(),
+         ME = MBB->end(); MI != ME; ++MI) {
+      bool IsVPM = false;
+      for (MachineInstr::mmo_iterator I = MI->memoperands_begin(),
+           IE = MI->memoperands_end(); I != IE; ++I)
+        if ((*I)->getPointerInfo().getAddrSpace() == 1)
+          IsVPM = true;
+
+      if (MI->mayLoad()) {
+        if (IsVPM) {
+          Entry.Flags |= QpuKernelBinary::ReadsVPM;
+        } else {
+          Entry.Flags |= QpuKernelBinary::UsesTMU;
+          ++Entry.NumTMULoads;
+        }
+      }
+      if (MI->mayStore())
+        Entry.Flags |= QpuKernelBinary::WritesVPM;
+
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+        const MachineOperand &MO = MI->getOperand(i);
+        if (MO.isReg() && MO.getReg())
+          Entry.RegMask |= getKernelRegBit(MO.getReg());
+      }
+    }
+
+  // ra4-ra7 and rb4-rb7 belong to the other thread.
+  const uint32_t UpperHalf = (0xf0U << QpuKernelBinary::RegMaskRAShift) |
+                             (0xf0U << QpuKernelBinary::RegMaskRBShift);
+  if (!(Entry.RegMask & UpperHalf))
+    Entry.Flags |= QpuKernelBinary::Threadable;
+  Entry.NumVPMRows = getVPMRows(MF, TD);
+  return Entry;
+}
+
+// Resolve the branches of the function just emitted and add it to the
+// container.  Anything that is not a branch within the function would need
+// a relocation, which the container has no room for.
+void QpuAsmPrinter::finishKernel() {
+  recordKernelBlocks(0);
+
+  for (unsigned i = 0, e = KernelFixups.size(); i != e; ++i) {
+    const MCFixup &F = KernelFixups[i];
+    unsigned Kind = F.getKind();
+    const MCSymbolRefExpr *Ref = dyn_cast<MCSymbolRefExpr>(F.getValue());
+    DenseMap<const MCSymbol *, unsigned>::iterator Target =
+      KernelBlockOffsets.end();
+    if (Ref && (Kind == Qpu::fixup_Qpu_PC16 || Kind == Qpu::fixup_Qpu_PC24))
+      Target = KernelBlockOffsets.find(&Ref->getSymbol());
+    if (Target == KernelBlockOffsets.end())
+      report_fatal_error(Twine("Qpu kernel '") + MF->getName() +
+                         "' needs a relocation and cannot be put in a "
+                         "kernel binary");
+
+    // As in the asm backend, the displacement counts from the instruction
+    // after the branch.
+    uint32_t Value = Target->second - F.getOffset() - 4;
+    uint32_t Mask = Kind == Qpu::fixup_Qpu_PC16 ? 0xffff : 0xffffff;
+    char *Word = KernelCode.data() + F.getOffset();
+    uint32_t Bits = 0;
+    for (unsigned b = 0; b != 4; ++b)
+      Bits |= uint32_t((uint8_t)Word[b]) << (b * 8);
+    Bits |= Value & Mask;
+    for (unsigned b = 0; b != 4; ++b)
+      Word[b] = char(Bits >> (b * 8));
+  }
+
+  QpuKernelBinary::KernelEntry Entry = getKernelEntry(*MF, TM.getDataLayout());
+  if (isVerbose() && OutStreamer.hasRawTextSupport()) {
+    SmallString<128> Str;
+    raw_svector_ostream OS(Str);
+    OS << MAI->getCommentString() << " kernel entry: " << Entry.NumUniforms
+       << " uniforms, " << Entry.NumTMULoads << " TMU loads, "
+       << Entry.NumVPMRows << " VPM rows, flags 0x";
+    OS.write_hex(Entry.Flags) << ", registers 0x";
+    OS.write_hex(Entry.RegMask);
+    OutStreamer.EmitRawText(OS.str());
+  }
+  KernelWriter.addKernel(MF->getName(), KernelCode.str(), Entry);
+}
+
+bool QpuAsmPrinter::doFinalization(Module &M) {
+  if (!KernelBinaryFile.empty()) {
+    // The file is removed again unless it is written out completely.
+    std::string ErrorInfo;
+    tool_output_file Out(KernelBinaryFile.c_str(), ErrorInfo,
+                         sys::fs::F_Binary);
+    if (!ErrorInfo.empty())
+      report_fatal_error(Twine("cannot open kernel binary '") +
+                         KernelBinaryFile + "': " + ErrorInfo);
+    KernelWriter.write(Out.os());
+    Out.os().close();
+    if (Out.os().has_error()) {
+      Out.os().clear_error();
+      report_fatal_error(Twine("cannot write kernel binary '") +
+                         KernelBinaryFile + "'");
+    }
+    Out.keep();
+  }
+  return AsmPrinter::doFinalization(M);
 }
 
 //===----------------------------------------------------------------------===//
@@ -215,6 +442,10 @@ void QpuAsmPrinter::EmitFunctionEntryLabel() {
   /*if (OutStreamer.hasRawTextSupport())
     OutStreamer.EmitRawText("\t.ent\t" + Twine(CurrentFnSym->getName()));
   OutStreamer.EmitLabel(CurrentFnSym);*/
+  // The assembly leaves the label out, but an object file needs the
+  // function symbol defined for its size and relocations.
+  if (!OutStreamer.hasRawTextSupport())
+    OutStreamer.EmitLabel(CurrentFnSym);
 }
 
 
@@ -227,6 +458,20 @@ void QpuAsmPrinter::EmitFunctionEntryLabel() {
 void QpuAsmPrinter::EmitFunctionBodyStart() {
   MCInstLowering.Initialize(&MF->getContext());
 
+  if (!KernelBinaryFile.empty()) {
+    // Only kernels know their uniform layout and have no calls to relocate.
+    if (!Subtarget->isKernelMode())
+      report_fatal_error("-qpu-kernel-binary requires -qpu-kernel");
+    if (!KernelEmitter)
+      KernelEmitter.reset(createQpuMCCodeEmitterEL(*TM.getInstrInfo(),
+                                                   *TM.getRegisterInfo(),
+                                                   *Subtarget, OutContext));
+    KernelCode.clear();
+    KernelFixups.clear();
+    KernelBlockOffsets.clear();
+    NextKernelBlock = MF->begin();
+  }
+
   if (OutStreamer.hasRawTextSupport()) {
 	  OutStreamer.EmitRawText(StringRef("\t.set\treorder"));
   }
@@ -266,6 +511,8 @@ void QpuAsmPrinter::EmitFunctionBodyStart() {
 /// EmitFunctionBodyEnd - Targets can override this to emit stuff after
 /// the last basic block in the function.
 void QpuAsmPrinter::EmitFunctionBodyEnd() {
+  if (KernelEmitter)
+    finishKernel();
 
 	if (OutStreamer.hasRawTextSupport()) {
 	  OutStreamer.EmitRawText(StringRef("\t.set\tnoreorder"));
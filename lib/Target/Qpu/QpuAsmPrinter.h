@@ -14,15 +14,23 @@
 #ifndef QPUASMPRINTER_H
 #define QPUASMPRINTER_H
 
+#include "QpuKernelBinary.h"
 #include "QpuMachineFunction.h"
 #include "QpuMCInstLower.h"
 #include "QpuSubtarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/CodeGen/AsmPrinter.h"
+#include "llvm/MC/MCCodeEmitter.h"
+#include "llvm/MC/MCFixup.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Target/TargetMachine.h"
 
 namespace llvm {
+class MCInst;
 class MCStreamer;
+class MCSymbol;
 class MachineInstr;
 class MachineBasicBlock;
 class Module;
@@ -32,6 +40,20 @@ class LLVM_LIBRARY_VISIBILITY QpuAsmPrinter : public AsmPrinter {
 
   void EmitInstrWithMacroNoAT(const MachineInstr *MI);
 
+  // Kernel container output (-qpu-kernel-binary).  Each instruction is
+  // encoded again next to the normal output so that branches can be
+  // resolved once the function is complete.
+  OwningPtr<MCCodeEmitter> KernelEmitter;
+  QpuKernelBinaryWriter KernelWriter;
+  SmallString<1024> KernelCode;
+  SmallVector<MCFixup, 16> KernelFixups;
+  DenseMap<const MCSymbol *, unsigned> KernelBlockOffsets;
+  MachineFunction::const_iterator NextKernelBlock;
+
+  void EmitMCInst(const MCInst &Inst);
+  void recordKernelBlocks(const MachineBasicBlock *MBB);
+  void finishKernel();
+
 public:
 
   const QpuSubtarget *Subtarget;
@@ -59,6 +81,7 @@ public:
   virtual void EmitFunctionBodyStart();
   virtual void EmitFunctionBodyEnd();
   void EmitStartOfAsmFile(Module &M);
+  virtual bool doFinalization(Module &M);
   virtual MachineLocation getDebugValueLocation(const MachineInstr *MI) const;
   void PrintDebugValueComment(const MachineInstr *MI, raw_ostream &OS);
 };
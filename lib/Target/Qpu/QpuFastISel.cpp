@@ -0,0 +1,476 @@
+//===-- QpuFastISel.cpp - Qpu FastISel implementation ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the Qpu-specific support for the FastISel class, used
+// when kernels are compiled at -O0 where compile time matters most.
+//
+// Most Qpu instructions read their two sources from different register
+// classes, which the tblgen fast-isel emitter cannot handle, so the FastEmit
+// hooks are written out here and each operand is constrained (or copied) to
+// the class its instruction wants, as the DAG emitter does.  Anything not
+// handled falls back to SelectionDAG for that instruction.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Qpu.h"
+#include "QpuISelLowering.h"
+#include "QpuInstrInfo.h"
+#include "QpuSubtarget.h"
+#include "QpuTargetMachine.h"
+#include "llvm/CodeGen/FastISel.h"
+#include "llvm/CodeGen/FunctionLoweringInfo.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Target/TargetLowering.h"
+
+using namespace llvm;
+
+namespace {
+
+class QpuFastISel : public FastISel {
+public:
+  explicit QpuFastISel(FunctionLoweringInfo &funcInfo,
+                       const TargetLibraryInfo *libInfo)
+    : FastISel(funcInfo, libInfo) { }
+
+  virtual bool TargetSelectInstruction(const Instruction *I);
+  virtual unsigned TargetMaterializeConstant(const Constant *C);
+  virtual unsigned TargetMaterializeAlloca(const AllocaInst *AI);
+
+  virtual unsigned FastEmit_i(MVT VT, MVT RetVT, unsigned Opcode,
+                              uint64_t Imm);
+  virtual unsigned FastEmit_r(MVT VT, MVT RetVT, unsigned Opcode,
+                              unsigned Op0, bool Op0IsKill);
+  virtual unsigned FastEmit_rr(MVT VT, MVT RetVT, unsigned Opcode,
+                               unsigned Op0, bool Op0IsKill,
+                               unsigned Op1, bool Op1IsKill);
+  virtual unsigned FastEmit_ri(MVT VT, MVT RetVT, unsigned Opcode,
+                               unsigned Op0, bool Op0IsKill, uint64_t Imm);
+
+private:
+  bool QpuSelectLoad(const Instruction *I);
+  bool QpuSelectStore(const Instruction *I);
+  bool QpuSelectBranch(const Instruction *I);
+  bool QpuSelectRet(const Instruction *I);
+
+  bool isLoadStoreTypeLegal(Type *Ty, MVT &VT);
+  bool addAddress(MachineInstrBuilder &MIB, const MCInstrDesc &II,
+                  unsigned OpNo, const Value *Ptr);
+  unsigned constrainOperand(unsigned Reg, const MCInstrDesc &II,
+                            unsigned OpNo);
+  unsigned createResultReg(const MCInstrDesc &II);
+  unsigned emitR(unsigned Opc, unsigned Op0, bool Op0IsKill);
+  unsigned emitRR(unsigned Opc, unsigned Op0, bool Op0IsKill,
+                  unsigned Op1, bool Op1IsKill);
+  unsigned emitRI(unsigned Opc, unsigned Op0, bool Op0IsKill, int64_t Imm);
+};
+
+} // end anonymous namespace
+
+// The vector types all share one opcode table, ordered by lane count.
+static int getVectorIndex(MVT VT) {
+  switch (VT.SimpleTy) {
+  default:          return -1;
+  case MVT::f32:    return 0;
+  case MVT::v2f32:  return 1;
+  case MVT::v4f32:  return 2;
+  case MVT::v8f32:  return 3;
+  case MVT::v16f32: return 4;
+  }
+}
+
+static unsigned getBinaryOpcode(unsigned ISDOpc, MVT VT) {
+  static const unsigned FAdd[] = {
+    Qpu::F32x1_FADD, Qpu::F32x2_FADD, Qpu::F32x4_FADD, Qpu::F32x8_FADD,
+    Qpu::F32x16_FADD
+  };
+  static const unsigned FSub[] = {
+    Qpu::F32x1_FSUB, Qpu::F32x2_FSUB, Qpu::F32x4_FSUB, Qpu::F32x8_FSUB,
+    Qpu::F32x16_FSUB
+  };
+  static const unsigned FMul[] = {
+    Qpu::F32x1_FMUL, Qpu::F32x2_FMUL, Qpu::F32x4_FMUL, Qpu::F32x8_FMUL,
+    Qpu::F32x16_FMUL
+  };
+
+  if (VT == MVT::i32) {
+    switch (ISDOpc) {
+    default:       return 0;
+    case ISD::ADD: return Qpu::ADDu;
+    case ISD::SUB: return Qpu::SUBu;
+    case ISD::MUL: return Qpu::MUL;
+    case ISD::AND: return Qpu::AND;
+    case ISD::OR:  return Qpu::OR;
+    case ISD::XOR: return Qpu::XOR;
+    case ISD::SHL: return Qpu::SHL;
+    case ISD::SRA: return Qpu::SRA;
+    case ISD::SRL: return Qpu::SRL;
+    }
+  }
+
+  int Idx = getVectorIndex(VT);
+  if (Idx < 0)
+    return 0;
+  switch (ISDOpc) {
+  default:        return 0;
+  case ISD::FADD: return FAdd[Idx];
+  case ISD::FSUB: return FSub[Idx];
+  case ISD::FMUL: return FMul[Idx];
+  }
+}
+
+static unsigned getImmOpcode(unsigned ISDOpc) {
+  switch (ISDOpc) {
+  default:       return 0;
+  case ISD::ADD: return Qpu::ADDiu;
+  case ISD::SUB: return Qpu::SUBiu;
+  case ISD::AND: return Qpu::ANDi;
+  case ISD::OR:  return Qpu::ORi;
+  case ISD::XOR: return Qpu::XORi;
+  case ISD::SHL: return Qpu::SHLi;
+  case ISD::SRA: return Qpu::SRAi;
+  case ISD::SRL: return Qpu::SRLi;
+  }
+}
+
+static bool isSmallImm(int64_t Imm) {
+  return Imm >= -16 && Imm <= 15;
+}
+
+/// constrainOperand - Return a register holding Reg that can be operand OpNo
+/// of II, copying it if its class cannot be narrowed.
+unsigned QpuFastISel::constrainOperand(unsigned Reg, const MCInstrDesc &II,
+                                       unsigned OpNo) {
+  const TargetRegisterClass *RC =
+    TII.getRegClass(II, OpNo, &TRI, *FuncInfo.MF);
+  if (!RC || !TargetRegisterInfo::isVirtualRegister(Reg) ||
+      MRI.constrainRegClass(Reg, RC, 4))
+    return Reg;
+
+  unsigned NewReg = FastISel::createResultReg(RC);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(TargetOpcode::COPY),
+          NewReg).addReg(Reg);
+  return NewReg;
+}
+
+unsigned QpuFastISel::createResultReg(const MCInstrDesc &II) {
+  return FastISel::createResultReg(TII.getRegClass(II, 0, &TRI,
+                                                   *FuncInfo.MF));
+}
+
+unsigned QpuFastISel::emitR(unsigned Opc, unsigned Op0, bool Op0IsKill) {
+  const MCInstrDesc &II = TII.get(Opc);
+  Op0 = constrainOperand(Op0, II, 1);
+  unsigned ResultReg = createResultReg(II);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, II, ResultReg)
+    .addReg(Op0, getKillRegState(Op0IsKill));
+  return ResultReg;
+}
+
+unsigned QpuFastISel::emitRR(unsigned Opc, unsigned Op0, bool Op0IsKill,
+                             unsigned Op1, bool Op1IsKill) {
+  const MCInstrDesc &II = TII.get(Opc);
+  Op0 = constrainOperand(Op0, II, 1);
+  Op1 = constrainOperand(Op1, II, 2);
+  unsigned ResultReg = createResultReg(II);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, II, ResultReg)
+    .addReg(Op0, getKillRegState(Op0IsKill))
+    .addReg(Op1, getKillRegState(Op1IsKill));
+  return ResultReg;
+}
+
+unsigned QpuFastISel::emitRI(unsigned Opc, unsigned Op0, bool Op0IsKill,
+                             int64_t Imm) {
+  const MCInstrDesc &II = TII.get(Opc);
+  Op0 = constrainOperand(Op0, II, 1);
+  unsigned ResultReg = createResultReg(II);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, II, ResultReg)
+    .addReg(Op0, getKillRegState(Op0IsKill))
+    .addImm(Imm);
+  return ResultReg;
+}
+
+unsigned QpuFastISel::FastEmit_i(MVT VT, MVT RetVT, unsigned Opcode,
+                                 uint64_t Imm) {
+  if (Opcode != ISD::Constant || VT != MVT::i32 || RetVT != MVT::i32)
+    return 0;
+  return FastEmitInst_i(Qpu::LUi, &Qpu::GPRAccRARBRegClass, Imm);
+}
+
+unsigned QpuFastISel::FastEmit_r(MVT VT, MVT RetVT, unsigned Opcode,
+                                 unsigned Op0, bool Op0IsKill) {
+  unsigned Opc = 0;
+  if (Opcode == ISD::SINT_TO_FP && VT == MVT::i32 && RetVT == MVT::f32)
+    Opc = Qpu::F32x1_ITOF;
+  else if (Opcode == ISD::FP_TO_SINT && VT == MVT::f32 && RetVT == MVT::i32)
+    Opc = Qpu::F32x1_FTOI;
+  if (!Opc)
+    return 0;
+  return emitR(Opc, Op0, Op0IsKill);
+}
+
+unsigned QpuFastISel::FastEmit_rr(MVT VT, MVT RetVT, unsigned Opcode,
+                                  unsigned Op0, bool Op0IsKill,
+                                  unsigned Op1, bool Op1IsKill) {
+  if (VT != RetVT)
+    return 0;
+  unsigned Opc = getBinaryOpcode(Opcode, VT);
+  if (!Opc)
+    return 0;
+  return emitRR(Opc, Op0, Op0IsKill, Op1, Op1IsKill);
+}
+
+unsigned QpuFastISel::FastEmit_ri(MVT VT, MVT RetVT, unsigned Opcode,
+                                  unsigned Op0, bool Op0IsKill,
+                                  uint64_t Imm) {
+  if (VT != MVT::i32 || RetVT != MVT::i32 || !isSmallImm((int64_t)Imm))
+    return 0;
+  unsigned Opc = getImmOpcode(Opcode);
+  if (!Opc)
+    return 0;
+  return emitRI(Opc, Op0, Op0IsKill, (int64_t)Imm);
+}
+
+unsigned QpuFastISel::TargetMaterializeConstant(const Constant *C) {
+  // f32 constants are built from their bit pattern.
+  const ConstantFP *CFP = dyn_cast<ConstantFP>(C);
+  if (!CFP || !CFP->getType()->isFloatTy())
+    return 0;
+
+  uint64_t Bits = CFP->getValueAPF().bitcastToAPInt().getZExtValue();
+  unsigned IntReg = FastEmitInst_i(Qpu::LUi, &Qpu::GPRAccRARBRegClass, Bits);
+  unsigned ResultReg = FastISel::createResultReg(&Qpu::F32x1_rfRegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(TargetOpcode::COPY),
+          ResultReg).addReg(IntReg, RegState::Kill);
+  return ResultReg;
+}
+
+unsigned QpuFastISel::TargetMaterializeAlloca(const AllocaInst *AI) {
+  DenseMap<const AllocaInst *, int>::iterator SI =
+    FuncInfo.StaticAllocaMap.find(AI);
+  if (SI == FuncInfo.StaticAllocaMap.end())
+    return 0;
+
+  unsigned ResultReg = createResultReg(TII.get(Qpu::LEA_ADDiu));
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(Qpu::LEA_ADDiu),
+          ResultReg).addFrameIndex(SI->second).addImm(0).addImm(0);
+  return ResultReg;
+}
+
+bool QpuFastISel::isLoadStoreTypeLegal(Type *Ty, MVT &VT) {
+  EVT Evt = TLI.getValueType(Ty, true);
+  if (!Evt.isSimple())
+    return false;
+  VT = Evt.getSimpleVT();
+  return VT == MVT::i32 || getVectorIndex(VT) >= 0;
+}
+
+/// addAddress - Add the (base, offset, vpm) memory operand for Ptr starting
+/// at operand OpNo of II.  Static allocas become frame indices.
+bool QpuFastISel::addAddress(MachineInstrBuilder &MIB, const MCInstrDesc &II,
+                             unsigned OpNo, const Value *Ptr) {
+  unsigned AddrSpace = cast<PointerType>(Ptr->getType())->getAddressSpace();
+  int VPM = AddrSpace == 1;
+
+  if (const AllocaInst *AI = dyn_cast<AllocaInst>(Ptr)) {
+    DenseMap<const AllocaInst *, int>::iterator SI =
+      FuncInfo.StaticAllocaMap.find(AI);
+    if (SI != FuncInfo.StaticAllocaMap.end()) {
+      MIB.addFrameIndex(SI->second).addImm(0).addImm(0);
+      return true;
+    }
+  }
+
+  unsigned Base = getRegForValue(Ptr);
+  if (!Base)
+    return false;
+  MIB.addReg(constrainOperand(Base, II, OpNo)).addImm(0).addImm(VPM);
+  return true;
+}
+
+bool QpuFastISel::QpuSelectLoad(const Instruction *I) {
+  const LoadInst *LI = cast<LoadInst>(I);
+  if (LI->isAtomic() || LI->isVolatile())
+    return false;
+
+  static const unsigned VecLoads[] = {
+    Qpu::LD_F32x1, Qpu::LD_F32x2, Qpu::LD_F32x4, Qpu::LD_F32x8,
+    Qpu::LD_F32x16
+  };
+  MVT VT;
+  if (!isLoadStoreTypeLegal(LI->getType(), VT))
+    return false;
+  unsigned Opc = VT == MVT::i32 ? Qpu::LD : VecLoads[getVectorIndex(VT)];
+
+  const MCInstrDesc &II = TII.get(Opc);
+  unsigned ResultReg = createResultReg(II);
+  MachineInstrBuilder MIB =
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, II, ResultReg);
+  if (!addAddress(MIB, II, 1, LI->getPointerOperand())) {
+    MIB->eraseFromParent();
+    return false;
+  }
+  MIB.addMemOperand(FuncInfo.MF->getMachineMemOperand(
+      MachinePointerInfo(LI->getPointerOperand()), MachineMemOperand::MOLoad,
+      TD.getTypeStoreSize(LI->getType()), LI->getAlignment()));
+  UpdateValueMap(I, ResultReg);
+  return true;
+}
+
+bool QpuFastISel::QpuSelectStore(const Instruction *I) {
+  const StoreInst *SI = cast<StoreInst>(I);
+  if (SI->isAtomic() || SI->isVolatile())
+    return false;
+
+  static const unsigned VecStores[] = {
+    Qpu::ST_F32, Qpu::ST_F32x2, Qpu::ST_F32x4, Qpu::ST_F32x8,
+    Qpu::ST_F32x16
+  };
+  const Value *Val = SI->getValueOperand();
+  MVT VT;
+  if (!isLoadStoreTypeLegal(Val->getType(), VT))
+    return false;
+  unsigned Opc = VT == MVT::i32 ? Qpu::ST : VecStores[getVectorIndex(VT)];
+
+  unsigned ValReg = getRegForValue(Val);
+  if (!ValReg)
+    return false;
+
+  const MCInstrDesc &II = TII.get(Opc);
+  ValReg = constrainOperand(ValReg, II, 0);
+  MachineInstrBuilder MIB =
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, II).addReg(ValReg);
+  if (!addAddress(MIB, II, 1, SI->getPointerOperand())) {
+    MIB->eraseFromParent();
+    return false;
+  }
+  MIB.addMemOperand(FuncInfo.MF->getMachineMemOperand(
+      MachinePointerInfo(SI->getPointerOperand()), MachineMemOperand::MOStore,
+      TD.getTypeStoreSize(Val->getType()), SI->getAlignment()));
+  return true;
+}
+
+/// QpuSelectBranch - Select a branch on an i32 compare in the same block,
+/// using the same flag sequence as the brcond patterns: compare, turn the
+/// sign or zero flag of lane 0 into 0/1, broadcast it and branch on all
+/// lanes.  Unconditional branches are handled by the generic code.
+bool QpuFastISel::QpuSelectBranch(const Instruction *I) {
+  const BranchInst *BI = cast<BranchInst>(I);
+  if (BI->isUnconditional())
+    return false;
+
+  const ICmpInst *CI = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!CI || !CI->hasOneUse() || CI->getParent() != I->getParent() ||
+      !CI->getOperand(0)->getType()->isIntegerTy(32))
+    return false;
+
+  const Value *LHS = CI->getOperand(0), *RHS = CI->getOperand(1);
+  unsigned FlagOpc, BranchOpc;
+  switch (CI->getPredicate()) {
+  default:
+    return false;
+  case CmpInst::ICMP_SGE:
+  case CmpInst::ICMP_UGE:
+    FlagOpc = Qpu::LUi_ns; BranchOpc = Qpu::JZERO;
+    break;
+  case CmpInst::ICMP_SLT:
+  case CmpInst::ICMP_ULT:
+    FlagOpc = Qpu::LUi_ns; BranchOpc = Qpu::JONE;
+    break;
+  case CmpInst::ICMP_SLE:
+  case CmpInst::ICMP_ULE:
+    std::swap(LHS, RHS);
+    FlagOpc = Qpu::LUi_ns; BranchOpc = Qpu::JZERO;
+    break;
+  case CmpInst::ICMP_SGT:
+  case CmpInst::ICMP_UGT:
+    std::swap(LHS, RHS);
+    FlagOpc = Qpu::LUi_ns; BranchOpc = Qpu::JONE;
+    break;
+  case CmpInst::ICMP_EQ:
+    FlagOpc = Qpu::LUi_zs; BranchOpc = Qpu::JONE;
+    break;
+  case CmpInst::ICMP_NE:
+    FlagOpc = Qpu::LUi_zs; BranchOpc = Qpu::JZERO;
+    break;
+  }
+
+  unsigned LHSReg = getRegForValue(LHS);
+  unsigned RHSReg = getRegForValue(RHS);
+  if (!LHSReg || !RHSReg)
+    return false;
+
+  unsigned Cmp = emitRR(Qpu::CMP_INTERNAL_i32, LHSReg, false, RHSReg, false);
+  unsigned Zero = emitRI(Qpu::LUi_al, Cmp, true, 0);
+  unsigned Flag = emitRI(FlagOpc, Zero, true, 1);
+
+  unsigned Lane0 = emitR(Qpu::BROADCAST, Flag, true);
+  unsigned Flags = emitR(Qpu::SET_FLAGS, Lane0, true);
+
+  MachineBasicBlock *TBB = FuncInfo.MBBMap[BI->getSuccessor(0)];
+  MachineBasicBlock *FBB = FuncInfo.MBBMap[BI->getSuccessor(1)];
+  const MCInstrDesc &BranchII = TII.get(BranchOpc);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, BranchII)
+    .addReg(constrainOperand(Flags, BranchII, 0), RegState::Kill)
+    .addMBB(TBB);
+  FastEmitBranch(FBB, DL);
+  FuncInfo.MBB->addSuccessor(TBB);
+  return true;
+}
+
+/// QpuSelectRet - Select a return of nothing or of one i32, which goes in
+/// ra0 as in RetCC_Qpu.
+bool QpuFastISel::QpuSelectRet(const Instruction *I) {
+  const ReturnInst *RI = cast<ReturnInst>(I);
+  const Function &F = *I->getParent()->getParent();
+  if (F.isVarArg() || F.hasStructRetAttr())
+    return false;
+
+  if (RI->getNumOperands() == 0) {
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(Qpu::RetLR));
+    return true;
+  }
+
+  const Value *RV = RI->getOperand(0);
+  if (!RV->getType()->isIntegerTy(32))
+    return false;
+  unsigned Reg = getRegForValue(RV);
+  if (!Reg)
+    return false;
+
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(TargetOpcode::COPY),
+          Qpu::RA0).addReg(Reg);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DL, TII.get(Qpu::RetLR))
+    .addReg(Qpu::RA0, RegState::Implicit);
+  return true;
+}
+
+bool QpuFastISel::TargetSelectInstruction(const Instruction *I) {
+  switch (I->getOpcode()) {
+  default:                  break;
+  case Instruction::Load:   return QpuSelectLoad(I);
+  case Instruction::Store:  return QpuSelectStore(I);
+  case Instruction::Br:     return QpuSelectBranch(I);
+  case Instruction::Ret:    return QpuSelectRet(I);
+  }
+  return false;
+}
+
+namespace llvm {
+  FastISel *Qpu::createFastISel(FunctionLoweringInfo &funcInfo,
+                                const TargetLibraryInfo *libInfo) {
+    return new QpuFastISel(funcInfo, libInfo);
+  }
+}
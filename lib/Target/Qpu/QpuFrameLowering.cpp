@@ -24,6 +24,7 @@
 #include "llvm/IR/DataLayout.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 
 using namespace llvm;
 
@@ -86,6 +87,8 @@ using namespace llvm;
 // pointer register.  This is true if the function has variable sized allocas or
 // if frame pointer elimination is disabled.
 bool QpuFrameLowering::hasFP(const MachineFunction &MF) const {
+  if (STI.isKernelMode())
+    return false;
   const MachineFrameInfo *MFI = MF.getFrameInfo();
   return MF.getTarget().Options.DisableFramePointerElim(MF) ||
       MFI->hasVarSizedObjects() || MFI->isFrameAddressTaken();
@@ -158,6 +161,19 @@ void QpuFrameLowering::emitPrologue(MachineFunction &MF) const {
    // Update stack size
   MFI->setStackSize(StackSize);
 
+  // A kernel has nowhere to put a frame, so spills and allocas are fatal.
+  if (STI.isKernelMode()) {
+    for (int FI = MFI->getObjectIndexBegin(), FE = MFI->getObjectIndexEnd();
+         FI != FE; ++FI)
+      if (MFI->isSpillSlotObjectIndex(FI))
+        report_fatal_error("Qpu kernel '" + MF.getName() +
+                           "' requires spilling");
+    if (StackSize)
+      report_fatal_error("Qpu kernel '" + MF.getName() + "' needs " +
+                         Twine(StackSize) + " bytes of stack");
+    return;
+  }
+
   // No need to allocate space on the stack.
   if (StackSize == 0 && !MFI->adjustsStack()) return;
 
@@ -18,11 +18,13 @@
 #include "QpuSubtarget.h"
 #include "QpuTargetMachine.h"
 #include "MCTargetDesc/QpuBaseInfo.h"
+#include "llvm/Analysis/DivergenceAnalysis.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/IR/Type.h"
+#include "llvm/CodeGen/FunctionLoweringInfo.h"
 #include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
@@ -58,13 +60,20 @@ class QpuDAGToDAGISel : public SelectionDAGISel {
 public:
   explicit QpuDAGToDAGISel(QpuTargetMachine &tm) :
   SelectionDAGISel(tm),
-  TM(tm), Subtarget(tm.getSubtarget<QpuSubtarget>()) {}
+  TM(tm), Subtarget(tm.getSubtarget<QpuSubtarget>()) {
+    initializeDivergenceAnalysisPass(*PassRegistry::getPassRegistry());
+  }
 
   // Pass Name
   virtual const char *getPassName() const {
     return "QPU DAG->DAG Pattern Instruction Selection";
   }
 
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<DivergenceAnalysis>();
+    SelectionDAGISel::getAnalysisUsage(AU);
+  }
+
   virtual bool runOnMachineFunction(MachineFunction &MF);
 
 private:
@@ -89,6 +98,7 @@ private:
                                          EVT Ty, bool HasLo, bool HasHi);
 
   SDNode *Select(SDNode *N);
+  virtual void PreprocessISelDAG();
   // Complex Pattern.
   bool SelectAddr(SDNode *Parent, SDValue N, SDValue &Base, SDValue &Offset, SDValue &VPM);
   // getImm - Return a target constant with the specified value.
@@ -100,11 +110,59 @@ private:
 }
 
 bool QpuDAGToDAGISel::runOnMachineFunction(MachineFunction &MF) {
+  // Record the blocks whose branch every lane agrees on, so that
+  // PreprocessISelDAG can look them up as each block is selected.
+  DivergenceAnalysis &DA = getAnalysis<DivergenceAnalysis>();
+  QpuFunctionInfo *QFI = MF.getInfo<QpuFunctionInfo>();
+  for (Function::const_iterator BB = MF.getFunction()->begin(),
+       E = MF.getFunction()->end(); BB != E; ++BB) {
+    const TerminatorInst *TI = BB->getTerminator();
+    if (TI->getNumSuccessors() > 1 && DA.isUniform(TI))
+      QFI->addUniformBranch(BB);
+  }
+
   bool Ret = SelectionDAGISel::runOnMachineFunction(MF);
 
   return Ret;
 }
 
+/// PreprocessISelDAG - In a block whose IR branch is uniform, every
+/// compare-and-branch (including those that switches and split conditions
+/// were lowered to) only reads uniform values, so turn them into
+/// UniformBrcond, which branches on the compare flags of all lanes instead
+/// of broadcasting lane 0 first.  A spilled operand stays uniform, since
+/// its reload reads one stack address in every lane.  This is only done
+/// when optimizing; -O0, like FastISel, keeps the broadcast sequence.
+void QpuDAGToDAGISel::PreprocessISelDAG() {
+  if (OptLevel == CodeGenOpt::None)
+    return;
+
+  const BasicBlock *BB = FuncInfo->MBB->getBasicBlock();
+  if (!BB || !MF->getInfo<QpuFunctionInfo>()->hasUniformBranch(BB))
+    return;
+
+  bool Changed = false;
+  for (SelectionDAG::allnodes_iterator I = CurDAG->allnodes_begin(),
+       E = CurDAG->allnodes_end(); I != E; ) {
+    SDNode *N = I++;
+    if (N->getOpcode() != ISD::BRCOND)
+      continue;
+    SDValue Cond = N->getOperand(1);
+    if (Cond.getOpcode() != ISD::SETCC ||
+        Cond.getOperand(0).getValueType() != MVT::i32)
+      continue;
+
+    SDValue Ops[] = { N->getOperand(0), Cond, N->getOperand(2) };
+    SDValue Br = CurDAG->getNode(QpuISD::UniformBrcond, SDLoc(N), MVT::Other,
+                                 Ops, 3);
+    CurDAG->ReplaceAllUsesWith(N, Br.getNode());
+    Changed = true;
+  }
+
+  if (Changed)
+    CurDAG->RemoveDeadNodes();
+}
+
 /// getGlobalBaseReg - Output the instructions required to put the
 /// GOT address into a register.
 SDNode *QpuDAGToDAGISel::getGlobalBaseReg() {
@@ -116,6 +116,10 @@ const char *QpuTargetLowering::getTargetNodeName(unsigned Opcode) const {
 //  case QpuISD::DivRem:            return "QpuISD::DivRem";
 //  case QpuISD::DivRemU:           return "QpuISD::DivRemU";
   case QpuISD::Wrapper:           return "QpuISD::Wrapper";
+  case QpuISD::Uniform:           return "QpuISD::Uniform";
+  case QpuISD::VRotate:           return "QpuISD::VRotate";
+  case QpuISD::VSplat:            return "QpuISD::VSplat";
+  case QpuISD::UniformBrcond:     return "QpuISD::UniformBrcond";
   default:                         return NULL;
   }
 } // lbd document - mark - getTargetNodeName
@@ -155,6 +159,11 @@ QpuTargetLowering(QpuTargetMachine &TM)
   setOperationAction(ISD::BRCOND,             MVT::Other, Custom);
   setOperationAction(ISD::VASTART,            MVT::Other, Custom);
 
+  // Lane movement within a full vector goes through the mul-pipe rotator.
+  setOperationAction(ISD::VECTOR_SHUFFLE,     MVT::v16f32, Custom);
+  setOperationAction(ISD::EXTRACT_VECTOR_ELT, MVT::v16f32, Custom);
+  setOperationAction(ISD::BUILD_VECTOR,       MVT::v16f32, Custom);
+
   // Qpu doesn't have sext_inreg, replace them with shl/sra.
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i1 , Expand);
 
@@ -181,6 +190,8 @@ QpuTargetLowering(QpuTargetMachine &TM)
 
   //setTargetDAGCombine(ISD::SDIVREM);
   //setTargetDAGCombine(ISD::UDIVREM);
+  setTargetDAGCombine(ISD::FADD);
+  setTargetDAGCombine(ISD::FMUL);
 
   setMinFunctionAlignment(3);
 
@@ -230,21 +241,97 @@ QpuTargetLowering(QpuTargetMachine &TM)
   return SDValue();
 }*/
 
+// Number of lanes in a vector register.
+static const unsigned QpuVectorWidth = 16;
+
+// Collect the operands of a tree of Opc nodes.  Interior nodes must have no
+// other users since the whole tree is replaced.
+static void collectReductionLeaves(SDValue V, unsigned Opc, bool IsRoot,
+                                   SmallVectorImpl<SDValue> &Leaves) {
+  if (V.getOpcode() == Opc && (IsRoot || V.hasOneUse())) {
+    collectReductionLeaves(V.getOperand(0), Opc, false, Leaves);
+    collectReductionLeaves(V.getOperand(1), Opc, false, Leaves);
+    return;
+  }
+  Leaves.push_back(V);
+}
+
+// Turn a scalar fadd/fmul chain over all 16 lanes of one vector into a log2
+// tree of rotate + vector op steps.  After the last step every lane holds
+// the result, so lane 0 is read out.  This reassociates, so it is only done
+// under unsafe fp math.
+static SDValue PerformReductionCombine(SDNode *N, SelectionDAG &DAG,
+                                       TargetLowering::DAGCombinerInfo &DCI) {
+  if (!DCI.isBeforeLegalize() || !DAG.getTarget().Options.UnsafeFPMath)
+    return SDValue();
+
+  unsigned Opc = N->getOpcode();
+  if (N->getValueType(0) != MVT::f32)
+    return SDValue();
+  // Only match at the root of the tree.
+  if (N->hasOneUse() && N->use_begin()->getOpcode() == Opc)
+    return SDValue();
+
+  SmallVector<SDValue, 16> Leaves;
+  collectReductionLeaves(SDValue(N, 0), Opc, true, Leaves);
+  if (Leaves.size() != QpuVectorWidth)
+    return SDValue();
+
+  SDValue Vec;
+  unsigned SeenLanes = 0;
+  for (unsigned i = 0, e = Leaves.size(); i != e; ++i) {
+    SDValue L = Leaves[i];
+    if (L.getOpcode() != ISD::EXTRACT_VECTOR_ELT ||
+        L.getOperand(0).getValueType() != MVT::v16f32)
+      return SDValue();
+    ConstantSDNode *Idx = dyn_cast<ConstantSDNode>(L.getOperand(1));
+    if (!Idx || Idx->getZExtValue() >= QpuVectorWidth)
+      return SDValue();
+    if (!Vec.getNode())
+      Vec = L.getOperand(0);
+    else if (Vec != L.getOperand(0))
+      return SDValue();
+    unsigned Bit = 1U << Idx->getZExtValue();
+    if (SeenLanes & Bit)
+      return SDValue();
+    SeenLanes |= Bit;
+  }
+
+  SDLoc DL(N);
+  for (unsigned Amt = QpuVectorWidth / 2; Amt != 0; Amt /= 2) {
+    SDValue Rot = DAG.getNode(QpuISD::VRotate, DL, MVT::v16f32, Vec,
+                              DAG.getConstant(Amt, MVT::i32));
+    Vec = DAG.getNode(Opc, DL, MVT::v16f32, Vec, Rot);
+  }
+  const TargetLowering &TLI = DAG.getTargetLoweringInfo();
+  return DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, MVT::f32, Vec,
+                     DAG.getConstant(0, TLI.getVectorIdxTy()));
+}
+
 SDValue QpuTargetLowering::PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI)
   const {
-  //SelectionDAG &DAG = DCI.DAG;
-  //unsigned opc = N->getOpcode();
+  SelectionDAG &DAG = DCI.DAG;
+  unsigned opc = N->getOpcode();
 
-  /*switch (opc) {
+  switch (opc) {
   default: break;
-  case ISD::SDIVREM:
+  /*case ISD::SDIVREM:
   case ISD::UDIVREM:
-    return PerformDivRemCombine(N, DAG, DCI, Subtarget);
-  }*/
+    return PerformDivRemCombine(N, DAG, DCI, Subtarget);*/
+  case ISD::FADD:
+  case ISD::FMUL:
+    return PerformReductionCombine(N, DAG, DCI);
+  }
 
   return SDValue();
 }
 
+FastISel *
+QpuTargetLowering::createFastISel(FunctionLoweringInfo &funcInfo,
+                                  const TargetLibraryInfo *libInfo) const {
+  return Qpu::createFastISel(funcInfo, libInfo);
+}
+
 // lbd document - mark - LowerOperation - begin
 SDValue QpuTargetLowering::
 LowerOperation(SDValue Op, SelectionDAG &DAG) const
@@ -255,6 +342,9 @@ LowerOperation(SDValue Op, SelectionDAG &DAG) const
     case ISD::GlobalAddress:      return LowerGlobalAddress(Op, DAG);
     case ISD::SELECT:             return lowerSELECT(Op, DAG);
     case ISD::VASTART:            return LowerVASTART(Op, DAG);
+    case ISD::VECTOR_SHUFFLE:     return LowerVECTOR_SHUFFLE(Op, DAG);
+    case ISD::EXTRACT_VECTOR_ELT: return LowerEXTRACT_VECTOR_ELT(Op, DAG);
+    case ISD::BUILD_VECTOR:       return LowerBUILD_VECTOR(Op, DAG);
   }
   return SDValue();
 }
@@ -298,7 +388,9 @@ SDValue QpuTargetLowering::LowerGlobalAddress(SDValue Op,
 
   QpuTargetObjectFile &TLOF = (QpuTargetObjectFile&)getObjFileLowering();
 
-  if (getTargetMachine().getRelocationModel() != Reloc::PIC_) {
+  // Kernels have no $gp, so every global gets an absolute address.
+  if (getTargetMachine().getRelocationModel() != Reloc::PIC_ ||
+      Subtarget->isKernelMode()) {
     SDVTList VTs = DAG.getVTList(MVT::i32);
 
     // %gp_rel relocation
@@ -348,6 +440,91 @@ SDValue QpuTargetLowering::LowerVASTART(SDValue Op, SelectionDAG &DAG) const {
                       MachinePointerInfo(SV), false, false, 0);
 }
 
+// A single-source shuffle with mask <k, k+1, ..., k+15> (mod 16, undef lanes
+// match anything) is a rotation.  Other shuffles are left to the expander.
+SDValue QpuTargetLowering::LowerVECTOR_SHUFFLE(SDValue Op,
+                                               SelectionDAG &DAG) const {
+  ShuffleVectorSDNode *SVN = cast<ShuffleVectorSDNode>(Op.getNode());
+  EVT VT = Op.getValueType();
+  int NumElts = VT.getVectorNumElements();
+
+  SDValue Src;
+  int Offset = -1;
+  for (int i = 0; i != NumElts; ++i) {
+    int M = SVN->getMaskElt(i);
+    if (M < 0)
+      continue;
+    SDValue S = Op.getOperand(M / NumElts);
+    if (!Src.getNode())
+      Src = S;
+    else if (Src != S)
+      return SDValue();
+    int K = (M % NumElts - i + NumElts) % NumElts;
+    if (Offset < 0)
+      Offset = K;
+    else if (Offset != K)
+      return SDValue();
+  }
+
+  if (!Src.getNode())
+    return DAG.getUNDEF(VT);
+  if (Offset == 0)
+    return Src;
+  return DAG.getNode(QpuISD::VRotate, SDLoc(Op), VT, Src,
+                     DAG.getConstant(NumElts - Offset, MVT::i32));
+}
+
+// A vector with the same value in every lane, such as the uniforms of a
+// vectorized kernel, is broadcast through r5.  Anything else is left to the
+// expander.
+SDValue QpuTargetLowering::LowerBUILD_VECTOR(SDValue Op,
+                                             SelectionDAG &DAG) const {
+  SDValue Splat;
+  for (unsigned i = 0, e = Op.getNumOperands(); i != e; ++i) {
+    SDValue Elt = Op.getOperand(i);
+    if (Elt.getOpcode() == ISD::UNDEF)
+      continue;
+    if (!Splat.getNode())
+      Splat = Elt;
+    else if (Splat != Elt)
+      return SDValue();
+  }
+
+  if (!Splat.getNode())
+    return DAG.getUNDEF(Op.getValueType());
+  return DAG.getNode(QpuISD::VSplat, SDLoc(Op), Op.getValueType(), Splat);
+}
+
+// Only lane 0 can be read directly; any other lane is rotated down to it
+// first.  A variable lane rotates by a register amount.
+SDValue QpuTargetLowering::LowerEXTRACT_VECTOR_ELT(SDValue Op,
+                                                   SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  SDValue Vec = Op.getOperand(0);
+  SDValue Idx = Op.getOperand(1);
+  EVT VT = Vec.getValueType();
+  unsigned NumElts = VT.getVectorNumElements();
+  SDValue Amt;
+
+  if (ConstantSDNode *C = dyn_cast<ConstantSDNode>(Idx)) {
+    unsigned Lane = C->getZExtValue() % NumElts;
+    if (Lane == 0)
+      return Op;
+    Amt = DAG.getConstant(NumElts - Lane, MVT::i32);
+  } else {
+    // (NumElts - Idx) & (NumElts - 1)
+    Amt = DAG.getNode(ISD::SUB, DL, MVT::i32,
+                      DAG.getConstant(NumElts, MVT::i32),
+                      DAG.getZExtOrTrunc(Idx, DL, MVT::i32));
+    Amt = DAG.getNode(ISD::AND, DL, MVT::i32, Amt,
+                      DAG.getConstant(NumElts - 1, MVT::i32));
+  }
+
+  SDValue Rot = DAG.getNode(QpuISD::VRotate, DL, VT, Vec, Amt);
+  return DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, Op.getValueType(), Rot,
+                     DAG.getConstant(0, Idx.getValueType()));
+}
+
 #include "QpuGenCallingConv.inc"
 
 //===----------------------------------------------------------------------===//
@@ -406,6 +583,25 @@ QpuTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   // Qpu target does not yet support tail call optimization.
   isTailCall                            = false;
 
+  // A kernel has no stack and no return address to call through; anything
+  // the inliner could not remove is an error, apart from the id queries the
+  // SPMD vectorizer leaves behind.
+  if (Subtarget->isKernelMode()) {
+    SDValue Id = LowerWorkItemId(CLI);
+    if (Id.getNode()) {
+      InVals.push_back(Id);
+      return InChain;
+    }
+    std::string Name = "an indirect target";
+    if (GlobalAddressSDNode *G = dyn_cast<GlobalAddressSDNode>(Callee))
+      Name = "'" + G->getGlobal()->getName().str() + "'";
+    else if (ExternalSymbolSDNode *S = dyn_cast<ExternalSymbolSDNode>(Callee))
+      Name = "'" + std::string(S->getSymbol()) + "'";
+    report_fatal_error("Qpu kernel '" +
+                       DAG.getMachineFunction().getName() +
+                       "' cannot call " + Name);
+  }
+
   MachineFunction &MF = DAG.getMachineFunction();
   MachineFrameInfo *MFI = MF.getFrameInfo();
   const TargetFrameLowering *TFL = MF.getTarget().getFrameLowering();
@@ -627,6 +823,30 @@ QpuTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
                          Ins, DL, DAG, InVals);
 }
 
+/// LowerWorkItemId - In a kernel vectorized by the SPMD vectorizer,
+/// get_global_id(0) is the id of lane 0, which was read from the uniforms on
+/// entry.  Returns a null SDValue for any other call.
+SDValue
+QpuTargetLowering::LowerWorkItemId(TargetLowering::CallLoweringInfo &CLI) const {
+  SelectionDAG &DAG = CLI.DAG;
+  QpuFunctionInfo *QpuFI = DAG.getMachineFunction().getInfo<QpuFunctionInfo>();
+  if (!QpuFI->getWorkItemBaseReg() || !CLI.CS || CLI.Ins.size() != 1 ||
+      CLI.Ins[0].VT != MVT::i32)
+    return SDValue();
+
+  const Function *Callee = CLI.CS->getCalledFunction();
+  if (!Callee || Callee->getName() != "get_global_id" ||
+      CLI.CS->arg_size() > 1)
+    return SDValue();
+  if (CLI.CS->arg_size() == 1) {
+    const ConstantInt *Dim = dyn_cast<ConstantInt>(CLI.CS->getArgument(0));
+    if (!Dim || !Dim->isZero())
+      return SDValue();
+  }
+  return DAG.getCopyFromReg(CLI.Chain, CLI.DL, QpuFI->getWorkItemBaseReg(),
+                            MVT::i32);
+}
+
 /// LowerCallResult - Lower the result values of a call into the
 /// appropriate copies out of appropriate physical registers.
 SDValue
@@ -697,6 +917,33 @@ QpuTargetLowering::LowerFormalArguments(SDValue Chain,
 
   QpuFI->setVarArgsFrameIndex(0);
 
+  // Kernel arguments arrive in the uniform stream, one read per argument.
+  if (Subtarget->isKernelMode()) {
+    for (unsigned i = 0, e = Ins.size(); i != e; ++i) {
+      if (isVarArg || Ins[i].VT != MVT::i32 || Ins[i].Flags.isByVal())
+        report_fatal_error("Qpu kernel '" + MF.getName() +
+                           "' can only take 32-bit integer or pointer "
+                           "arguments");
+      SDValue Uniform = DAG.getNode(QpuISD::Uniform, DL,
+                                    DAG.getVTList(MVT::i32, MVT::Other),
+                                    Chain);
+      Chain = Uniform.getValue(1);
+      InVals.push_back(Uniform);
+    }
+
+    // A kernel running sixteen work items at once is also told which one
+    // its first lane is.
+    if (MF.getFunction()->hasFnAttribute("spmd-width")) {
+      SDValue Base = DAG.getNode(QpuISD::Uniform, DL,
+                                 DAG.getVTList(MVT::i32, MVT::Other), Chain);
+      unsigned Reg =
+        MF.getRegInfo().createVirtualRegister(&Qpu::CPURegsRegClass);
+      Chain = DAG.getCopyToReg(Base.getValue(1), DL, Reg, Base);
+      QpuFI->setWorkItemBaseReg(Reg);
+    }
+    return Chain;
+  }
+
   // Used with vargs to acumulate store chains.
   std::vector<SDValue> OutChains;
 
@@ -51,7 +51,19 @@ namespace llvm {
 
       Wrapper,
       DynAlloc,
-      Sync
+      Sync,
+
+      // Read the next value from the uniform stream
+      Uniform,
+
+      // Rotate the lanes of a vector register
+      VRotate,
+
+      // Copy a scalar into every lane of a vector register
+      VSplat,
+
+      // Conditional branch on a condition that is the same in every lane
+      UniformBrcond
     };
   }
 
@@ -73,6 +85,11 @@ namespace llvm {
 
     virtual SDValue PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI) const;
 
+    /// createFastISel - This method returns a target specific FastISel object,
+    /// or null if the target does not support "fast" ISel.
+    virtual FastISel *createFastISel(FunctionLoweringInfo &funcInfo,
+                                     const TargetLibraryInfo *libInfo) const;
+
   protected:
     SDValue getGlobalReg(SelectionDAG &DAG, EVT Ty) const;
 
@@ -93,12 +110,16 @@ namespace llvm {
                             const SmallVectorImpl<ISD::InputArg> &Ins,
                             SDLoc DL, SelectionDAG &DAG,
                             SmallVectorImpl<SDValue> &InVals) const;
+    SDValue LowerWorkItemId(TargetLowering::CallLoweringInfo &CLI) const;
 
     // Lower Operand specifics
     SDValue LowerBRCOND(SDValue Op, SelectionDAG &DAG) const;
     SDValue lowerSELECT(SDValue Op, SelectionDAG &DAG) const;
     SDValue LowerGlobalAddress(SDValue Op, SelectionDAG &DAG) const;
     SDValue LowerVASTART(SDValue Op, SelectionDAG &DAG) const;
+    SDValue LowerVECTOR_SHUFFLE(SDValue Op, SelectionDAG &DAG) const;
+    SDValue LowerEXTRACT_VECTOR_ELT(SDValue Op, SelectionDAG &DAG) const;
+    SDValue LowerBUILD_VECTOR(SDValue Op, SelectionDAG &DAG) const;
 
 	//- must be exist without function all
     virtual SDValue
@@ -124,6 +145,11 @@ namespace llvm {
 
     virtual bool isOffsetFoldingLegal(const GlobalAddressSDNode *GA) const;
   };
+
+  namespace Qpu {
+    FastISel *createFastISel(FunctionLoweringInfo &funcInfo,
+                             const TargetLibraryInfo *libInfo);
+  }
 }
 
 #endif // QpuISELLOWERING_H
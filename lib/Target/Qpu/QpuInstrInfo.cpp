@@ -15,6 +15,7 @@
 #include "QpuTargetMachine.h"
 #include "QpuMachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
 #define GET_INSTRINFO_CTOR_DTOR
 #include "QpuGenInstrInfo.inc"
 
@@ -30,6 +31,77 @@ const QpuRegisterInfo &QpuInstrInfo::getRegisterInfo() const {
   return RI;
 } // lbd document - mark - getRegisterInfo()
 
+/// isLoadFromStackSlot - If the specified machine instruction is a direct
+/// load from a stack slot, return the virtual or physical register number of
+/// the destination along with the FrameIndex of the loaded stack slot.  If
+/// not, return 0.  This predicate must return 0 if the instruction has
+/// any side effects other than loading from the stack slot.
+unsigned QpuInstrInfo::
+isLoadFromStackSlot(const MachineInstr *MI, int &FrameIndex) const
+{
+  if (MI->getOpcode() == Qpu::LD &&
+      MI->getOperand(1).isFI() && // is a stack slot
+      MI->getOperand(2).isImm() && MI->getOperand(2).getImm() == 0) {
+    FrameIndex = MI->getOperand(1).getIndex();
+    return MI->getOperand(0).getReg();
+  }
+  return 0;
+}
+
+/// isStoreToStackSlot - If the specified machine instruction is a direct
+/// store to a stack slot, return the virtual or physical register number of
+/// the source reg along with the FrameIndex of the stored stack slot.  If
+/// not, return 0.  This predicate must return 0 if the instruction has
+/// any side effects other than storing to the stack slot.
+unsigned QpuInstrInfo::
+isStoreToStackSlot(const MachineInstr *MI, int &FrameIndex) const
+{
+  if (MI->getOpcode() == Qpu::ST &&
+      MI->getOperand(1).isFI() && // is a stack slot
+      MI->getOperand(2).isImm() && MI->getOperand(2).getImm() == 0) {
+    FrameIndex = MI->getOperand(1).getIndex();
+    return MI->getOperand(0).getReg();
+  }
+  return 0;
+}
+
+/// A kernel reads each argument from the uniform stream exactly once, so the
+/// read itself can never be repeated.  The register it lands in usually
+/// stays live for most of the kernel though, and an unconditional immediate
+/// ALU op on it costs one instruction to redo, or an il and the op for a
+/// wide immediate.  In a kernel that beats the spill it cannot make at all.
+///
+/// The argument is a virtual register that is not available everywhere, so
+/// these ops are not trivially rematerializable: the coalescer, spill
+/// weights and MachineLICM would take them to be free to move anywhere.
+bool QpuInstrInfo::isReMaterializableWithLiveUses(const MachineInstr *MI,
+                                                  AliasAnalysis *AA) const {
+  switch (MI->getOpcode()) {
+  default:
+    return false;
+  // The _ns/_zs forms write under the current flags and are left out.
+  case Qpu::ADDiu: case Qpu::SUBiu: case Qpu::ANDi: case Qpu::ORi:
+  case Qpu::XORi:  case Qpu::SHLi:  case Qpu::SRAi: case Qpu::SRLi:
+  case Qpu::RORi:
+  case Qpu::ADDiu_unif: case Qpu::ANDi_unif: case Qpu::ORi_unif:
+  case Qpu::XORi_unif:
+    break;
+  }
+
+  const MachineOperand &Src = MI->getOperand(1);
+  if (!Src.isReg() || Src.getSubReg() ||
+      !TargetRegisterInfo::isVirtualRegister(Src.getReg()))
+    return false;
+
+  // Look through copies of the argument, e.g. the work item base.
+  const MachineRegisterInfo &MRI = MI->getParent()->getParent()->getRegInfo();
+  const MachineInstr *Def = MRI.getUniqueVRegDef(Src.getReg());
+  while (Def && Def->isFullCopy() &&
+         TargetRegisterInfo::isVirtualRegister(Def->getOperand(1).getReg()))
+    Def = MRI.getUniqueVRegDef(Def->getOperand(1).getReg());
+  return Def && Def->getOpcode() == Qpu::READ_UNIFORM;
+}
+
 void QpuInstrInfo::
 copyPhysReg(MachineBasicBlock &MBB,
             MachineBasicBlock::iterator I, DebugLoc DL,
@@ -93,6 +165,13 @@ copyPhysReg(MachineBasicBlock &MBB,
 	  MIB.addReg(DestReg, RegState::Define);
 	  MIB.addReg(SrcReg, getKillRegState(KillSrc));
   }
+  // r5 holds broadcast values and can be read like an accumulator.
+  else if (Qpu::GPRAccRARBRegClass.contains(DestReg) && SrcReg == Qpu::ACC5)
+  {
+	  MachineInstrBuilder MIB = BuildMI(MBB, I, DL, get(Qpu::MOVE));
+	  MIB.addReg(DestReg, RegState::Define);
+	  MIB.addReg(SrcReg, getKillRegState(KillSrc));
+  }
   else if (DestReg == Qpu::T9 && Qpu::CPURegsRegClass.contains(SrcReg))
   {
 	  MachineInstrBuilder MIB = BuildMI(MBB, I, DL, get(Qpu::MOVE));
@@ -129,7 +208,7 @@ storeRegToStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
   Opc = Qpu::ST;
   assert(Opc && "Register class not handled!");
   BuildMI(MBB, I, DL, get(Opc)).addReg(SrcReg, getKillRegState(isKill))
-    .addFrameIndex(FI).addImm(0).addMemOperand(MMO);
+    .addFrameIndex(FI).addImm(0).addImm(0).addMemOperand(MMO);
 } // lbd document - mark - storeRegToStackSlot
 
 void QpuInstrInfo:: // lbd document - mark - before loadRegFromStackSlot
@@ -146,7 +225,7 @@ loadRegFromStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
   Opc = Qpu::LD;
   assert(Opc && "Register class not handled!");
   BuildMI(MBB, I, DL, get(Opc), DestReg).addFrameIndex(FI).addImm(0)
-    .addMemOperand(MMO);
+    .addImm(0).addMemOperand(MMO);
 } // lbd document - mark - loadRegFromStackSlot
 
 MachineInstr*
@@ -169,6 +248,18 @@ bool QpuInstrInfo::expandPostRAPseudo(MachineBasicBlock::iterator MI) const {
   case Qpu::RetLR:
     ExpandRetLR(MBB, MI, Qpu::RET);
     break;
+  case Qpu::ADDiu_unif:
+    ExpandUniformWideI(MBB, MI, Qpu::ADDu);
+    break;
+  case Qpu::ANDi_unif:
+    ExpandUniformWideI(MBB, MI, Qpu::AND);
+    break;
+  case Qpu::ORi_unif:
+    ExpandUniformWideI(MBB, MI, Qpu::OR);
+    break;
+  case Qpu::XORi_unif:
+    ExpandUniformWideI(MBB, MI, Qpu::XOR);
+    break;
   }
 
   MBB.erase(MI);
@@ -181,6 +272,21 @@ void QpuInstrInfo::ExpandRetLR(MachineBasicBlock &MBB,
   BuildMI(MBB, I, I->getDebugLoc(), get(Opc)).addReg(Qpu::LR);
 }
 
+/// Load the immediate into the destination, which is never the source, and
+/// apply the register form of the op.
+void QpuInstrInfo::ExpandUniformWideI(MachineBasicBlock &MBB,
+                                      MachineBasicBlock::iterator I,
+                                      unsigned Opc) const {
+  unsigned DstReg = I->getOperand(0).getReg();
+  const MachineOperand &Src = I->getOperand(1);
+  DebugLoc DL = I->getDebugLoc();
+  BuildMI(MBB, I, DL, get(Qpu::LUi), DstReg)
+    .addImm(I->getOperand(2).getImm());
+  BuildMI(MBB, I, DL, get(Opc), DstReg)
+    .addReg(Src.getReg(), getKillRegState(Src.isKill()))
+    .addReg(DstReg, RegState::Kill);
+}
+
 unsigned QpuInstrInfo::
 InsertBranch(MachineBasicBlock &MBB, MachineBasicBlock *TBB,
              MachineBasicBlock *FBB,
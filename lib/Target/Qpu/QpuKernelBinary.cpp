@@ -0,0 +1,87 @@
+//===-- QpuKernelBinary.cpp - Qpu kernel container writer -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file writes the kernel container described in QpuKernelBinary.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QpuKernelBinary.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace QpuKernelBinary;
+
+void QpuKernelBinaryWriter::addKernel(StringRef Name, StringRef Code,
+                                      const KernelEntry &Entry) {
+  Kernel K;
+  K.Name = Name;
+  K.Code = Code;
+  K.Entry = Entry;
+  Kernels.push_back(K);
+}
+
+static void writeWord(raw_ostream &OS, uint32_t Value) {
+  char Bytes[4];
+  for (unsigned i = 0; i != 4; ++i)
+    Bytes[i] = char(Value >> (i * 8));
+  OS.write(Bytes, 4);
+}
+
+static uint32_t alignTo(uint32_t Value, uint32_t Align) {
+  return (Value + Align - 1) / Align * Align;
+}
+
+void QpuKernelBinaryWriter::write(raw_ostream &OS) const {
+  uint32_t NumKernels = Kernels.size();
+  uint32_t StringTableOffset = sizeof(Header) +
+                               NumKernels * sizeof(KernelEntry);
+
+  std::string Strings;
+  std::vector<KernelEntry> Entries;
+  for (unsigned i = 0; i != NumKernels; ++i) {
+    Entries.push_back(Kernels[i].Entry);
+    Entries.back().NameOffset = StringTableOffset + Strings.size();
+    Strings += Kernels[i].Name;
+    Strings += '\0';
+  }
+
+  uint32_t Offset = alignTo(StringTableOffset + Strings.size(), CodeAlign);
+  for (unsigned i = 0; i != NumKernels; ++i) {
+    Entries[i].CodeOffset = Offset;
+    Entries[i].CodeSize = Kernels[i].Code.size();
+    Offset = alignTo(Offset + Entries[i].CodeSize, CodeAlign);
+  }
+
+  writeWord(OS, Magic);
+  writeWord(OS, Version);
+  writeWord(OS, NumKernels);
+  writeWord(OS, StringTableOffset);
+  writeWord(OS, Strings.size());
+
+  for (unsigned i = 0; i != NumKernels; ++i) {
+    const KernelEntry &E = Entries[i];
+    writeWord(OS, E.NameOffset);
+    writeWord(OS, E.CodeOffset);
+    writeWord(OS, E.CodeSize);
+    writeWord(OS, E.NumUniforms);
+    writeWord(OS, E.Flags);
+    writeWord(OS, E.NumTMULoads);
+    writeWord(OS, E.NumVPMRows);
+    writeWord(OS, E.RegMask);
+  }
+
+  OS << Strings;
+  uint64_t Pos = StringTableOffset + Strings.size();
+  for (unsigned i = 0; i != NumKernels; ++i) {
+    for (; Pos != Entries[i].CodeOffset; ++Pos)
+      OS << '\0';
+    OS << Kernels[i].Code;
+    Pos = Entries[i].CodeOffset + Entries[i].CodeSize;
+  }
+}
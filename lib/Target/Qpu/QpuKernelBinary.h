@@ -0,0 +1,115 @@
+//===-- QpuKernelBinary.h - Qpu kernel container format -------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The kernel container is what the host runtime maps and launches directly:
+// fully resolved instruction words plus a fixed size table describing each
+// kernel.  There are no relocations and nothing to parse beyond the table.
+//
+// Layout, every field a little endian 32-bit word:
+//
+//   Header
+//   KernelEntry[NumKernels]
+//   string table (NUL terminated kernel names)
+//   code, each kernel starting on a CodeAlign byte boundary
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef QPUKERNELBINARY_H
+#define QPUKERNELBINARY_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+
+namespace QpuKernelBinary {
+  enum {
+    Magic = 0x4b555051, // "QPUK"
+    Version = 1,
+    CodeAlign = 16
+  };
+
+  // The VPM is addressed in rows of sixteen 32-bit words and has 12KB.
+  enum {
+    VPMRowSize = 64,
+    VPMRows = 192
+  };
+
+  enum KernelFlags {
+    UsesTMU    = 1 << 0,
+    ReadsVPM   = 1 << 1,
+    WritesVPM  = 1 << 2,
+    // Only the lower half of each register file is used, so the kernel can
+    // share the QPU with a second thread.
+    Threadable = 1 << 3,
+    // The kernel runs 16 work items at once, one per lane, and is launched
+    // once per 16 work items.
+    WorkItemVector = 1 << 4
+  };
+
+  // RegMask bits: acc0-acc5 are bits 0-5, ra0-ra7 bits 8-15, rb0-rb7 bits
+  // 16-23.
+  enum {
+    RegMaskAccShift = 0,
+    RegMaskRAShift = 8,
+    RegMaskRBShift = 16
+  };
+
+  struct Header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t NumKernels;
+    uint32_t StringTableOffset;
+    uint32_t StringTableSize;
+  };
+
+  // Offsets are from the start of the file.  Uniforms are read in argument
+  // order, one per argument, so NumUniforms is also the number of kernel
+  // arguments the host has to supply.  A WorkItemVector kernel takes one more
+  // uniform after its arguments: the id of the work item in lane 0.
+  // NumVPMRows is how many VPM rows the host has to set aside for the kernel;
+  // it is VPMRows when an access at a variable offset may reach any row.
+  struct KernelEntry {
+    uint32_t NameOffset;
+    uint32_t CodeOffset;
+    uint32_t CodeSize;
+    uint32_t NumUniforms;
+    uint32_t Flags;
+    uint32_t NumTMULoads;
+    uint32_t NumVPMRows;
+    uint32_t RegMask;
+  };
+}
+
+/// QpuKernelBinaryWriter - Collects the kernels of a module and writes them
+/// out as a single container.
+class QpuKernelBinaryWriter {
+  struct Kernel {
+    std::string Name;
+    std::string Code;
+    QpuKernelBinary::KernelEntry Entry;
+  };
+  std::vector<Kernel> Kernels;
+
+public:
+  /// addKernel - Add a kernel.  Code holds the encoded instructions with all
+  /// branches resolved; the offset fields of Entry are filled in by write().
+  void addKernel(StringRef Name, StringRef Code,
+                 const QpuKernelBinary::KernelEntry &Entry);
+
+  bool empty() const { return Kernels.empty(); }
+
+  void write(raw_ostream &OS) const;
+};
+}
+
+#endif
@@ -0,0 +1,114 @@
+//===-- QpuKernelInline.cpp - Inline all calls in Qpu kernels -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// In kernel mode a function has no stack and no link register to return
+// through, so every call to a function with a body is inlined before
+// instruction selection.  Calls that survive (recursion, external functions)
+// are rejected by call lowering.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "qpu-kernel-inline"
+
+#include "Qpu.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+
+using namespace llvm;
+
+STATISTIC(NumInlined, "Number of calls inlined into kernels");
+STATISTIC(NumDeleted, "Number of functions deleted after inlining");
+
+namespace {
+  struct QpuKernelInline : public ModulePass {
+
+    static char ID;
+    QpuKernelInline() : ModulePass(ID) { }
+
+    virtual const char *getPassName() const {
+      return "Qpu Kernel Inliner";
+    }
+
+    bool runOnModule(Module &M);
+
+  private:
+    bool inlineCalls(Function &F);
+  };
+  char QpuKernelInline::ID = 0;
+} // end of anonymous namespace
+
+// Inlining exposes the callee's own calls, so repeat until none are left.
+// A call chain that is still not flat after this many rounds is recursive.
+static const unsigned MaxInlineRounds = 16;
+
+bool QpuKernelInline::inlineCalls(Function &F) {
+  bool Changed = false;
+
+  for (unsigned Round = 0; Round != MaxInlineRounds; ++Round) {
+    SmallVector<CallSite, 8> Calls;
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+      CallSite CS(&*I);
+      if (!CS || isa<IntrinsicInst>(&*I))
+        continue;
+      Function *Callee = CS.getCalledFunction();
+      if (Callee && !Callee->isDeclaration() && Callee != &F)
+        Calls.push_back(CS);
+    }
+    if (Calls.empty())
+      break;
+
+    bool InlinedAny = false;
+    for (unsigned i = 0, e = Calls.size(); i != e; ++i) {
+      InlineFunctionInfo IFI;
+      if (InlineFunction(Calls[i], IFI)) {
+        ++NumInlined;
+        InlinedAny = true;
+      }
+    }
+    if (!InlinedAny)
+      break;
+    Changed = true;
+  }
+  return Changed;
+}
+
+bool QpuKernelInline::runOnModule(Module &M) {
+  bool Changed = false;
+
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    if (!F->isDeclaration())
+      Changed |= inlineCalls(*F);
+
+  // Local functions are only reachable through calls, which are gone now.
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ) {
+    Function *F = I++;
+    if (F->hasLocalLinkage() && !F->isDeclaration()) {
+      F->removeDeadConstantUsers();
+      if (F->use_empty()) {
+        F->eraseFromParent();
+        ++NumDeleted;
+        Changed = true;
+      }
+    }
+  }
+  return Changed;
+}
+
+/// createQpuKernelInlinePass - Returns a pass that inlines every call to a
+/// defined function.
+ModulePass *llvm::createQpuKernelInlinePass() {
+  return new QpuKernelInline();
+}
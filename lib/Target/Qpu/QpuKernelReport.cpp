@@ -0,0 +1,330 @@
+//===-- QpuKernelReport.cpp - Register pressure and stall report ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// With -qpu-report=<file> this pass writes one YAML document per function
+// describing the final code: register file usage, spills, and the cycle,
+// stall and delay slot numbers predicted from the itineraries.
+// The same figures are given for every loop so that regressions in hot code
+// are not hidden by the rest of the function.
+//
+// Stalls are counted within a block only; every value is assumed ready on
+// block entry.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "qpu-report"
+
+#include "Qpu.h"
+#include "QpuInstrInfo.h"
+#include "QpuSubtarget.h"
+#include "QpuTargetMachine.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/MC/MCInstrItineraries.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include <algorithm>
+#include <set>
+
+using namespace llvm;
+
+// Instructions after a branch that execute before it takes effect.
+static const unsigned QpuDelaySlots = 3;
+
+namespace {
+  /// Figures for a set of blocks, either a whole function or one loop.
+  struct ReportStats {
+    std::set<unsigned> RegsA, RegsB, RegsAcc;
+    unsigned Spills, Reloads;
+    unsigned Instructions, Cycles, Stalls;
+    unsigned DelaySlots, FilledDelaySlots;
+
+    ReportStats()
+      : Spills(0), Reloads(0), Instructions(0), Cycles(0), Stalls(0),
+        DelaySlots(0), FilledDelaySlots(0) { }
+
+    void add(const ReportStats &O) {
+      RegsA.insert(O.RegsA.begin(), O.RegsA.end());
+      RegsB.insert(O.RegsB.begin(), O.RegsB.end());
+      RegsAcc.insert(O.RegsAcc.begin(), O.RegsAcc.end());
+      Spills += O.Spills;
+      Reloads += O.Reloads;
+      Instructions += O.Instructions;
+      Cycles += O.Cycles;
+      Stalls += O.Stalls;
+      DelaySlots += O.DelaySlots;
+      FilledDelaySlots += O.FilledDelaySlots;
+    }
+  };
+
+  /// The YAML form of ReportStats.
+  struct ReportEntry {
+    std::string Name;
+    unsigned Depth;
+    unsigned RegsA, RegsB, RegsAcc;
+    unsigned Spills, Reloads;
+    unsigned Instructions, Cycles, Stalls;
+    double DelaySlotFill;
+
+    ReportEntry() { }
+    ReportEntry(StringRef N, unsigned D, const ReportStats &S)
+      : Name(N), Depth(D), RegsA(S.RegsA.size()), RegsB(S.RegsB.size()),
+        RegsAcc(S.RegsAcc.size()), Spills(S.Spills), Reloads(S.Reloads),
+        Instructions(S.Instructions), Cycles(S.Cycles), Stalls(S.Stalls) {
+      DelaySlotFill = S.DelaySlots ?
+        double(S.FilledDelaySlots) / S.DelaySlots : 0.0;
+    }
+  };
+
+  struct FunctionReport {
+    ReportEntry Function;
+    std::vector<ReportEntry> Loops;
+  };
+}
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ReportEntry)
+
+namespace llvm {
+namespace yaml {
+  template <> struct MappingTraits<ReportEntry> {
+    static void mapping(IO &IO, ReportEntry &E) {
+      StringRef Name(E.Name);
+      IO.mapRequired("Name", Name);
+      IO.mapOptional("Depth", E.Depth, 0U);
+      IO.mapRequired("RegsA", E.RegsA);
+      IO.mapRequired("RegsB", E.RegsB);
+      IO.mapRequired("RegsAcc", E.RegsAcc);
+      IO.mapRequired("Spills", E.Spills);
+      IO.mapRequired("Reloads", E.Reloads);
+      IO.mapRequired("Instructions", E.Instructions);
+      IO.mapRequired("Cycles", E.Cycles);
+      IO.mapRequired("Stalls", E.Stalls);
+      IO.mapRequired("DelaySlotFill", E.DelaySlotFill);
+    }
+  };
+
+  template <> struct MappingTraits<FunctionReport> {
+    static void mapping(IO &IO, FunctionReport &R) {
+      IO.mapRequired("Function", R.Function);
+      IO.mapOptional("Loops", R.Loops);
+    }
+  };
+}
+}
+
+namespace {
+  struct QpuKernelReport : public MachineFunctionPass {
+
+    std::string ReportFile;
+    const InstrItineraryData *Itins;
+    OwningPtr<tool_output_file> Out;
+    OwningPtr<yaml::Output> YOut;
+
+    static char ID;
+    QpuKernelReport(TargetMachine &tm, StringRef File)
+      : MachineFunctionPass(ID), ReportFile(File),
+        Itins(&tm.getSubtarget<QpuSubtarget>().getInstrItineraryData()) { }
+
+    virtual const char *getPassName() const {
+      return "Qpu Kernel Report";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<MachineLoopInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool doInitialization(Module &M);
+    bool doFinalization(Module &M);
+    bool runOnMachineFunction(MachineFunction &F);
+
+  private:
+    DenseMap<const MachineBasicBlock *, ReportStats> BlockStats;
+
+    void analyzeBlock(const MachineBasicBlock &MBB, ReportStats &S);
+    void countDelaySlots(const MachineBasicBlock &MBB,
+                         MachineBasicBlock::const_iterator MI,
+                         ReportStats &S);
+    void addLoop(const MachineLoop *L, FunctionReport &R);
+  };
+  char QpuKernelReport::ID = 0;
+} // end of anonymous namespace
+
+bool QpuKernelReport::doInitialization(Module &M) {
+  // The file is removed again unless it is written out completely.
+  std::string ErrorInfo;
+  Out.reset(new tool_output_file(ReportFile.c_str(), ErrorInfo,
+                                 sys::fs::F_None));
+  if (!ErrorInfo.empty())
+    report_fatal_error(Twine("cannot open Qpu report '") + ReportFile +
+                       "': " + ErrorInfo);
+  YOut.reset(new yaml::Output(Out->os()));
+  return false;
+}
+
+bool QpuKernelReport::doFinalization(Module &M) {
+  YOut.reset();
+  Out->os().close();
+  if (Out->os().has_error()) {
+    Out->os().clear_error();
+    report_fatal_error(Twine("cannot write Qpu report '") + ReportFile + "'");
+  }
+  Out->keep();
+  Out.reset();
+  return false;
+}
+
+static bool isNop(const MachineInstr *MI) {
+  return MI->getOpcode() == Qpu::NOP;
+}
+
+// A delay slot is filled when it holds useful work rather than a nop.  The
+// slots run on into the next block in layout order.
+void QpuKernelReport::countDelaySlots(const MachineBasicBlock &MBB,
+                                      MachineBasicBlock::const_iterator MI,
+                                      ReportStats &S) {
+  const MachineFunction &MF = *MBB.getParent();
+  MachineFunction::const_iterator Block = &MBB;
+  MachineBasicBlock::const_iterator I = llvm::next(MI);
+
+  for (unsigned Slot = 0; Slot != QpuDelaySlots; ++Slot) {
+    while (Block != MF.end() && (I == Block->end() || I->isDebugValue())) {
+      if (I != Block->end())
+        ++I;
+      else if (++Block != MF.end())
+        I = Block->begin();
+    }
+    ++S.DelaySlots;
+    if (Block == MF.end())
+      continue;
+    if (!isNop(I))
+      ++S.FilledDelaySlots;
+    ++I;
+  }
+}
+
+void QpuKernelReport::analyzeBlock(const MachineBasicBlock &MBB,
+                                   ReportStats &S) {
+  const MachineFrameInfo *MFI = MBB.getParent()->getFrameInfo();
+  // Cycle at which the value in each physical register becomes available.
+  DenseMap<unsigned, unsigned> ReadyAt;
+  unsigned Cycle = 0;
+
+  for (MachineBasicBlock::const_iterator MI = MBB.begin(), E = MBB.end();
+       MI != E; ++MI) {
+    if (MI->isDebugValue() || MI->isKill() || MI->isImplicitDef())
+      continue;
+    ++S.Instructions;
+
+    unsigned Issue = Cycle;
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.getReg())
+        continue;
+      unsigned Reg = MO.getReg();
+      if (Qpu::GPROnlyRARegClass.contains(Reg))
+        S.RegsA.insert(Reg);
+      else if (Qpu::GPROnlyRBRegClass.contains(Reg))
+        S.RegsB.insert(Reg);
+      else if (Qpu::GPROnlyAccRegClass.contains(Reg) ||
+               Qpu::GPRAcc5RegClass.contains(Reg))
+        S.RegsAcc.insert(Reg);
+
+      if (MO.isUse()) {
+        DenseMap<unsigned, unsigned>::iterator R = ReadyAt.find(Reg);
+        if (R != ReadyAt.end())
+          Issue = std::max(Issue, R->second);
+      }
+    }
+    S.Stalls += Issue - Cycle;
+
+    unsigned SchedClass = MI->getDesc().getSchedClass();
+    unsigned Latency = 1;
+    if (!Itins->isEmpty())
+      Latency = std::max(1U, Itins->getStageLatency(SchedClass));
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (MO.isReg() && MO.isDef() && MO.getReg())
+        ReadyAt[MO.getReg()] = Issue + Latency;
+    }
+    Cycle = Issue + 1;
+
+    for (MachineInstr::mmo_iterator I = MI->memoperands_begin(),
+         IE = MI->memoperands_end(); I != IE; ++I) {
+      const FixedStackPseudoSourceValue *FS =
+        dyn_cast_or_null<FixedStackPseudoSourceValue>((*I)->getValue());
+      if (!FS || !MFI->isSpillSlotObjectIndex(FS->getFrameIndex()))
+        continue;
+      if ((*I)->isStore())
+        ++S.Spills;
+      else
+        ++S.Reloads;
+    }
+
+    if (MI->hasDelaySlot())
+      countDelaySlots(MBB, MI, S);
+  }
+
+  S.Cycles = Cycle;
+}
+
+void QpuKernelReport::addLoop(const MachineLoop *L, FunctionReport &R) {
+  ReportStats S;
+  for (MachineLoop::block_iterator I = L->block_begin(), E = L->block_end();
+       I != E; ++I)
+    S.add(BlockStats[*I]);
+
+  std::string Name;
+  raw_string_ostream NameOS(Name);
+  NameOS << "BB#" << L->getHeader()->getNumber();
+  R.Loops.push_back(ReportEntry(NameOS.str(), L->getLoopDepth(), S));
+
+  for (MachineLoop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+    addLoop(*I, R);
+}
+
+bool QpuKernelReport::runOnMachineFunction(MachineFunction &F) {
+  if (!YOut)
+    return false;
+
+  BlockStats.clear();
+  ReportStats Total;
+  for (MachineFunction::const_iterator MBB = F.begin(), E = F.end();
+       MBB != E; ++MBB) {
+    ReportStats &S = BlockStats[MBB];
+    analyzeBlock(*MBB, S);
+    Total.add(S);
+  }
+
+  FunctionReport R;
+  R.Function = ReportEntry(F.getName(), 0, Total);
+  MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+  for (MachineLoopInfo::iterator I = MLI.begin(), E = MLI.end(); I != E; ++I)
+    addLoop(*I, R);
+
+  *YOut << R;
+  return false;
+}
+
+/// createQpuKernelReportPass - Returns a pass that writes the register
+/// pressure and stall report to File.
+FunctionPass *llvm::createQpuKernelReportPass(QpuTargetMachine &tm,
+                                              StringRef File) {
+  return new QpuKernelReport(tm, File);
+}
@@ -14,6 +14,7 @@
 #ifndef QPU_MACHINE_FUNCTION_INFO_H
 #define QPU_MACHINE_FUNCTION_INFO_H
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include <utility>
@@ -36,6 +37,22 @@ class QpuFunctionInfo : public MachineFunctionInfo {
   /// relocation models.
   unsigned GlobalBaseReg;
 
+  /// WorkItemBaseReg - In a kernel vectorized by the SPMD vectorizer, the
+  /// virtual register holding the work-item id of lane 0, which the runtime
+  /// passes in the uniform after the arguments.
+  unsigned WorkItemBaseReg;
+
+  /// UniformBranches - IR blocks ending in a conditional branch or switch
+  /// whose condition is the same in all lanes.  Instruction selection can
+  /// test the flags of such a compare directly instead of broadcasting
+  /// lane 0 first.
+  SmallPtrSet<const BasicBlock *, 16> UniformBranches;
+
+  /// PipelinedBlocks - Kernels written by the modulo scheduler.  Their
+  /// instruction order is the schedule, so the machine scheduler leaves it
+  /// alone.
+  SmallPtrSet<const MachineBasicBlock *, 4> PipelinedBlocks;
+
     /// VarArgsFrameIndex - FrameIndex for start of varargs area.
   int VarArgsFrameIndex;
 
@@ -56,6 +73,7 @@ public:
   : MF(MF), 
     SRetReturnReg(0),
     GlobalBaseReg(0),
+    WorkItemBaseReg(0),
     VarArgsFrameIndex(0), InArgFIRange(std::make_pair(-1, 0)),
     OutArgFIRange(std::make_pair(-1, 0)), GPFI(0), DynAllocFI(0),
     MaxCallFrameSize(0),
@@ -96,6 +114,21 @@ public:
   unsigned getSRetReturnReg() const { return SRetReturnReg; }
   void setSRetReturnReg(unsigned Reg) { SRetReturnReg = Reg; }
 
+  unsigned getWorkItemBaseReg() const { return WorkItemBaseReg; }
+  void setWorkItemBaseReg(unsigned Reg) { WorkItemBaseReg = Reg; }
+
+  bool hasUniformBranch(const BasicBlock *BB) const {
+    return UniformBranches.count(BB);
+  }
+  void addUniformBranch(const BasicBlock *BB) { UniformBranches.insert(BB); }
+
+  bool isPipelinedBlock(const MachineBasicBlock *MBB) const {
+    return PipelinedBlocks.count(MBB);
+  }
+  void addPipelinedBlock(const MachineBasicBlock *MBB) {
+    PipelinedBlocks.insert(MBB);
+  }
+
   bool globalBaseRegFixed() const;
   bool globalBaseRegSet() const;
   unsigned getGlobalBaseReg();
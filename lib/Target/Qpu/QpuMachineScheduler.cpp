@@ -0,0 +1,547 @@
+//===-- QpuMachineScheduler.cpp - Frequency guided scheduling regions -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The machine scheduler for Qpu picks a strategy per scheduling region from
+// the frequency of the region's block.  Kernels spend nearly all their time in
+// a few inner loops, while the straight-line setup and teardown code around
+// them is often much larger, so only regions whose block runs at least
+// -qpu-sched-hot-freq percent as often as the entry get the generic
+// bidirectional, pressure tracking scheduler.  Everything else gets a
+// top-down list schedule by critical path height, which builds no pressure
+// sets and keeps no second queue.
+//
+// Hot regions of at most -qpu-sched-exhaustive-size instructions are
+// scheduled optimally instead.  A branch and bound search over the
+// topological orders finds the order with the shortest in-order issue, where
+// an add pipe and a mul pipe instruction may share a cycle and every result
+// waits out its latency.  Its first complete order is the height list
+// schedule; the search then keeps any order that finishes earlier, cutting
+// off partial orders whose critical path or unit usage bound cannot beat the
+// best.  A search that has not finished after -qpu-sched-exhaustive-budget
+// steps is abandoned and the region goes to the generic strategy.
+//
+// Kernels written by the modulo scheduler are already in schedule order, and
+// that order is what bounds their register use, so they are listed in source
+// order.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "misched"
+
+#include "Qpu.h"
+#include "QpuMachineFunction.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineScheduler.h"
+#include "llvm/MC/MCInstrItineraries.h"
+#include "llvm/Support/BlockFrequency.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Statistic.h"
+#include <algorithm>
+#include <queue>
+
+using namespace llvm;
+
+STATISTIC(NumHotRegions,       "Number of regions scheduled by the generic "
+                               "strategy");
+STATISTIC(NumColdRegions,      "Number of regions list scheduled");
+STATISTIC(NumPipelinedRegions, "Number of pipelined regions kept in order");
+STATISTIC(NumOptimalRegions,   "Number of regions scheduled optimally");
+STATISTIC(NumOutOfBudget,      "Number of optimal searches abandoned");
+
+static cl::opt<unsigned> HotFreqPercent(
+  "qpu-sched-hot-freq", cl::Hidden, cl::init(200),
+  cl::desc("Schedule a region with the generic strategy if its block runs at "
+           "least this percentage of the entry frequency"));
+
+static cl::opt<bool> EnableExhaustive(
+  "qpu-sched-exhaustive", cl::Hidden, cl::init(true),
+  cl::desc("Search for the optimal schedule of small hot regions"));
+
+static cl::opt<unsigned> ExhaustiveSize(
+  "qpu-sched-exhaustive-size", cl::Hidden, cl::init(40),
+  cl::desc("Largest region to search for the optimal schedule"));
+
+static cl::opt<unsigned> ExhaustiveBudget(
+  "qpu-sched-exhaustive-budget", cl::Hidden, cl::init(20000),
+  cl::desc("Partial schedules the optimal search may visit before it gives "
+           "up"));
+
+namespace {
+/// Order ready nodes by the longest latency path below them, then by their
+/// original position.
+struct HeightOrder {
+  bool SourceOrder;
+
+  HeightOrder(): SourceOrder(false) {}
+
+  /// Return true if B should be picked before A.
+  bool operator()(const SUnit *A, const SUnit *B) const {
+    if (!SourceOrder && A->getHeight() != B->getHeight())
+      return A->getHeight() < B->getHeight();
+    return A->NodeNum > B->NodeNum;
+  }
+};
+
+/// QpuListScheduler - Top-down list scheduling from a single ready queue.
+class QpuListScheduler : public MachineSchedStrategy {
+  HeightOrder Cmp;
+  std::vector<SUnit*> ReadyQ;
+
+public:
+  void setSourceOrder(bool Enable) { Cmp.SourceOrder = Enable; }
+
+  virtual bool shouldTrackPressure() const { return false; }
+
+  virtual void initialize(ScheduleDAGMI *DAG) {
+    ReadyQ.clear();
+  }
+
+  virtual SUnit *pickNode(bool &IsTopNode) {
+    if (ReadyQ.empty()) return NULL;
+    std::pop_heap(ReadyQ.begin(), ReadyQ.end(), Cmp);
+    SUnit *SU = ReadyQ.back();
+    ReadyQ.pop_back();
+    IsTopNode = true;
+    DEBUG(dbgs() << "Pick Top SU(" << SU->NodeNum << ") height "
+          << SU->getHeight() << '\n');
+    return SU;
+  }
+
+  virtual void schedNode(SUnit *SU, bool IsTopNode) {
+    assert(IsTopNode && "list scheduling is top-down");
+  }
+
+  virtual void releaseTopNode(SUnit *SU) {
+    ReadyQ.push_back(SU);
+    std::push_heap(ReadyQ.begin(), ReadyQ.end(), Cmp);
+  }
+
+  virtual void releaseBottomNode(SUnit *) { /* top-down only */ }
+};
+
+/// QpuExhaustiveScheduler - Branch and bound search for the schedule of a
+/// region that issues in the fewest cycles.  The order is fixed in
+/// initialize, and pickNode replays it top-down.
+class QpuExhaustiveScheduler : public MachineSchedStrategy {
+  /// A dependence: the other node and the cycles between the two issues.
+  typedef std::pair<unsigned, unsigned> Edge;
+
+  struct ENode {
+    unsigned Units;    // Functional units the first itinerary stage may use.
+    unsigned Latency;  // Cycles until the result is ready, at least one.
+    SmallVector<Edge, 4> Preds, Succs;
+  };
+
+  ScheduleDAGMI *DAG;
+  std::vector<ENode> Nodes;
+  // Cycles from the issue of each node until the region may end.
+  std::vector<unsigned> Heights;
+
+  /// A partial order already extended in every promising way.
+  struct Visited {
+    unsigned Cycle, Used, Length;
+    std::vector<unsigned> ReadyAt;
+  };
+
+  // Search state.  ReadyAt is the earliest issue cycle allowed by the
+  // scheduled predecessors, and Done has a bit for each scheduled node.
+  std::vector<unsigned> Order, PredsLeft, ReadyAt;
+  uint64_t Done;
+  std::vector<unsigned> BestOrder;
+  DenseMap<uint64_t, std::vector<Visited> > VisitedSets;
+  unsigned BestLength, Steps;
+  bool OutOfBudget;
+
+  unsigned NextPick;
+
+public:
+  QpuExhaustiveScheduler(): DAG(0), Done(0), BestLength(0), Steps(0),
+                            OutOfBudget(false), NextPick(0) {}
+
+  /// Search for the best order of DAG's region.  Return false if the budget
+  /// ran out before the search finished.
+  bool solve(ScheduleDAGMI *DAG);
+
+  virtual bool shouldTrackPressure() const { return false; }
+
+  virtual void initialize(ScheduleDAGMI *dag) {
+    DAG = dag;
+    NextPick = 0;
+  }
+
+  virtual SUnit *pickNode(bool &IsTopNode) {
+    if (NextPick == BestOrder.size()) return NULL;
+    IsTopNode = true;
+    return &DAG->SUnits[BestOrder[NextPick++]];
+  }
+
+  virtual void schedNode(SUnit *SU, bool IsTopNode) {}
+  virtual void releaseTopNode(SUnit *) {}
+  virtual void releaseBottomNode(SUnit *) {}
+
+private:
+  void buildNodes();
+  unsigned lowerBound(unsigned Cycle, unsigned Used, unsigned Length) const;
+  unsigned issueCycle(unsigned I, unsigned Cycle, unsigned Used,
+                      unsigned &NewUsed) const;
+  bool isDominated(unsigned Cycle, unsigned Used, unsigned Length);
+  void search(unsigned Cycle, unsigned Used, unsigned Length);
+};
+
+/// Order candidates by height, then by original position.
+struct HigherNode {
+  const std::vector<unsigned> &Heights;
+  HigherNode(const std::vector<unsigned> &H): Heights(H) {}
+  bool operator()(unsigned A, unsigned B) const {
+    if (Heights[A] != Heights[B])
+      return Heights[A] > Heights[B];
+    return A < B;
+  }
+};
+
+/// QpuSchedStrategy - Hand each region to the strategy its block deserves.
+class QpuSchedStrategy : public MachineSchedStrategy {
+  const MachineSchedContext *Context;
+  OwningPtr<MachineSchedStrategy> Generic;
+  OwningPtr<QpuListScheduler> List;
+  OwningPtr<QpuExhaustiveScheduler> Exhaustive;
+  MachineSchedStrategy *Current;
+
+public:
+  QpuSchedStrategy(MachineSchedContext *C)
+    : Context(C), Generic(createGenericSchedStrategy(C)),
+      List(new QpuListScheduler()), Exhaustive(new QpuExhaustiveScheduler()),
+      Current(0) {}
+
+  virtual void initPolicy(MachineBasicBlock::iterator Begin,
+                          MachineBasicBlock::iterator End,
+                          unsigned NumRegionInstrs);
+
+  // The generic strategy takes over a region whose search runs out of
+  // budget, so it gets to build the DAG it needs.
+  virtual bool shouldTrackPressure() const {
+    if (Current == Exhaustive.get())
+      return Generic->shouldTrackPressure();
+    return Current->shouldTrackPressure();
+  }
+  virtual void initialize(ScheduleDAGMI *DAG);
+  virtual void registerRoots() { Current->registerRoots(); }
+  virtual SUnit *pickNode(bool &IsTopNode) {
+    return Current->pickNode(IsTopNode);
+  }
+  virtual void scheduleTree(unsigned SubtreeID) {
+    Current->scheduleTree(SubtreeID);
+  }
+  virtual void schedNode(SUnit *SU, bool IsTopNode) {
+    Current->schedNode(SU, IsTopNode);
+  }
+  virtual void releaseTopNode(SUnit *SU) { Current->releaseTopNode(SU); }
+  virtual void releaseBottomNode(SUnit *SU) {
+    Current->releaseBottomNode(SU);
+  }
+
+private:
+  bool isHot(const MachineBasicBlock *MBB) const;
+};
+} // end anonymous namespace
+
+/// A block is hot if it runs at least HotFreqPercent as often as the entry.
+/// Without frequencies every block is treated as hot.
+bool QpuSchedStrategy::isHot(const MachineBasicBlock *MBB) const {
+  if (!Context->MBFI)
+    return true;
+  uint64_t Freq = Context->MBFI->getBlockFreq(MBB).getFrequency();
+  return Freq * 100 >= BlockFrequency::getEntryFrequency() * HotFreqPercent;
+}
+
+void QpuSchedStrategy::initPolicy(MachineBasicBlock::iterator Begin,
+                                  MachineBasicBlock::iterator End,
+                                  unsigned NumRegionInstrs) {
+  const MachineBasicBlock *MBB = Begin->getParent();
+  const QpuFunctionInfo *QFI = Context->MF->getInfo<QpuFunctionInfo>();
+  if (QFI->isPipelinedBlock(MBB)) {
+    DEBUG(dbgs() << "BB#" << MBB->getNumber() << ": pipelined, source order\n");
+    List->setSourceOrder(true);
+    Current = List.get();
+    ++NumPipelinedRegions;
+  } else if (EnableExhaustive && NumRegionInstrs <= ExhaustiveSize &&
+             isHot(MBB)) {
+    DEBUG(dbgs() << "BB#" << MBB->getNumber() << ": hot, exhaustive\n");
+    Generic->initPolicy(Begin, End, NumRegionInstrs);
+    Current = Exhaustive.get();
+    return;
+  } else if (isHot(MBB)) {
+    DEBUG(dbgs() << "BB#" << MBB->getNumber() << ": hot, generic\n");
+    Current = Generic.get();
+    ++NumHotRegions;
+  } else {
+    DEBUG(dbgs() << "BB#" << MBB->getNumber() << ": cold, list\n");
+    List->setSourceOrder(false);
+    Current = List.get();
+    ++NumColdRegions;
+  }
+  Current->initPolicy(Begin, End, NumRegionInstrs);
+}
+
+void QpuSchedStrategy::initialize(ScheduleDAGMI *DAG) {
+  if (Current == Exhaustive.get()) {
+    if (Exhaustive->solve(DAG))
+      ++NumOptimalRegions;
+    else {
+      ++NumOutOfBudget;
+      ++NumHotRegions;
+      Current = Generic.get();
+    }
+  }
+  Current->initialize(DAG);
+}
+
+void QpuExhaustiveScheduler::buildNodes() {
+  const InstrItineraryData *Itins =
+    DAG->getSchedModel()->getInstrItineraries();
+  unsigned N = DAG->SUnits.size();
+  Nodes.assign(N, ENode());
+  Heights.assign(N, 0);
+  for (unsigned i = 0; i != N; ++i) {
+    const SUnit &SU = DAG->SUnits[i];
+    ENode &Node = Nodes[i];
+    Node.Units = 0;
+    if (Itins && !Itins->isEmpty()) {
+      unsigned SchedClass = SU.getInstr()->getDesc().getSchedClass();
+      if (Itins->beginStage(SchedClass) != Itins->endStage(SchedClass))
+        Node.Units = Itins->beginStage(SchedClass)->getUnits();
+    }
+    Node.Latency = std::max(1u, unsigned(SU.Latency));
+    // Weak edges only ask for clustering.
+    for (SUnit::const_pred_iterator I = SU.Preds.begin(), E = SU.Preds.end();
+         I != E; ++I)
+      if (!I->isWeak() && !I->getSUnit()->isBoundaryNode())
+        Node.Preds.push_back(Edge(I->getSUnit()->NodeNum, I->getLatency()));
+    for (SUnit::const_succ_iterator I = SU.Succs.begin(), E = SU.Succs.end();
+         I != E; ++I)
+      if (!I->isWeak() && !I->getSUnit()->isBoundaryNode())
+        Node.Succs.push_back(Edge(I->getSUnit()->NodeNum, I->getLatency()));
+  }
+
+  // Nodes are numbered in instruction order, so successors come later.
+  for (unsigned i = N; i-- != 0;) {
+    const ENode &Node = Nodes[i];
+    Heights[i] = Node.Latency;
+    for (unsigned s = 0, se = Node.Succs.size(); s != se; ++s) {
+      assert(Node.Succs[s].first > i && "DAG is not in instruction order");
+      Heights[i] = std::max(Heights[i], Node.Succs[s].second +
+                                        Heights[Node.Succs[s].first]);
+    }
+  }
+}
+
+/// No order completing the current partial one can finish before this.
+/// Every unscheduled node issues no earlier than its predecessors allow and
+/// still has its height ahead of it.  The nodes tied to one unit also issue
+/// at most one per cycle; for unit time jobs with release times, issuing
+/// the released job with the greatest height first gives the earliest
+/// finish, so that schedule of each unit bounds the rest.
+unsigned QpuExhaustiveScheduler::lowerBound(unsigned Cycle, unsigned Used,
+                                            unsigned Length) const {
+  unsigned N = Nodes.size();
+  unsigned Bound = Length;
+  SmallVector<unsigned, 64> Earliest(N, 0);
+  SmallVector<SmallVector<std::pair<unsigned, unsigned>, 32>, 2> UnitJobs;
+  for (unsigned i = 0; i != N; ++i) {
+    if (Done & (1ULL << i))
+      continue;
+    const ENode &Node = Nodes[i];
+    unsigned Est = std::max(Cycle, ReadyAt[i]);
+    for (unsigned p = 0, pe = Node.Preds.size(); p != pe; ++p) {
+      unsigned Pred = Node.Preds[p].first;
+      if (!(Done & (1ULL << Pred)))
+        Est = std::max(Est, Earliest[Pred] + Node.Preds[p].second);
+    }
+    Earliest[i] = Est;
+    Bound = std::max(Bound, Est + Heights[i]);
+    if (Node.Units && !(Node.Units & (Node.Units - 1))) {
+      unsigned Unit = countTrailingZeros(Node.Units);
+      if (UnitJobs.size() <= Unit)
+        UnitJobs.resize(Unit + 1);
+      UnitJobs[Unit].push_back(std::make_pair(Est, Heights[i]));
+    }
+  }
+
+  for (unsigned u = 0, ue = UnitJobs.size(); u != ue; ++u) {
+    SmallVectorImpl<std::pair<unsigned, unsigned> > &Jobs = UnitJobs[u];
+    std::sort(Jobs.begin(), Jobs.end());
+    std::priority_queue<unsigned> Released;
+    unsigned Slot = (Used & (1u << u)) ? Cycle + 1 : Cycle;
+    for (unsigned j = 0, je = Jobs.size(); j != je || !Released.empty();) {
+      if (Released.empty())
+        Slot = std::max(Slot, Jobs[j].first);
+      for (; j != je && Jobs[j].first <= Slot; ++j)
+        Released.push(Jobs[j].second);
+      Bound = std::max(Bound, Slot + Released.top());
+      Released.pop();
+      ++Slot;
+    }
+  }
+  return Bound;
+}
+
+/// Return the cycle node I issues in if it follows a node issued in Cycle,
+/// where the units in Used are taken, and set NewUsed to the units taken in
+/// that cycle afterwards.  Issue is in order: never before the last node,
+/// and in its cycle only if a unit is still free there.
+unsigned QpuExhaustiveScheduler::issueCycle(unsigned I, unsigned Cycle,
+                                            unsigned Used,
+                                            unsigned &NewUsed) const {
+  const ENode &Node = Nodes[I];
+  unsigned Issue = std::max(Cycle, ReadyAt[I]);
+  NewUsed = Issue == Cycle ? Used : 0;
+  if (Node.Units) {
+    unsigned Free = Node.Units & ~NewUsed;
+    if (!Free) {
+      ++Issue;
+      NewUsed = 0;
+      Free = Node.Units;
+    }
+    NewUsed |= Free & -Free;
+  }
+  return Issue;
+}
+
+/// Return true if the same nodes were scheduled before in a way that was at
+/// least as good in every respect: no later in issue, no longer, and with
+/// every remaining node ready no later.  Otherwise remember this way.
+bool QpuExhaustiveScheduler::isDominated(unsigned Cycle, unsigned Used,
+                                         unsigned Length) {
+  std::vector<Visited> &Seen = VisitedSets[Done];
+  for (unsigned v = 0, ve = Seen.size(); v != ve; ++v) {
+    const Visited &Old = Seen[v];
+    if (Old.Length > Length || Old.Cycle > Cycle ||
+        (Old.Cycle == Cycle && (Old.Used & ~Used)))
+      continue;
+    bool Earlier = true;
+    for (unsigned i = 0, e = Nodes.size(); i != e && Earlier; ++i)
+      if (!(Done & (1ULL << i)) && Old.ReadyAt[i] > ReadyAt[i])
+        Earlier = false;
+    if (Earlier)
+      return true;
+  }
+  Visited New;
+  New.Cycle = Cycle;
+  New.Used = Used;
+  New.Length = Length;
+  New.ReadyAt = ReadyAt;
+  Seen.push_back(New);
+  return false;
+}
+
+/// Extend the partial order in every way that might still beat the best.
+/// Cycle is the issue cycle of the last node placed and Used the units it
+/// has taken; Length is the cycle by which every placed node has finished.
+void QpuExhaustiveScheduler::search(unsigned Cycle, unsigned Used,
+                                    unsigned Length) {
+  if (Order.size() == Nodes.size()) {
+    if (Length < BestLength) {
+      BestLength = Length;
+      BestOrder = Order;
+    }
+    return;
+  }
+  if (++Steps > ExhaustiveBudget) {
+    OutOfBudget = true;
+    return;
+  }
+  if (isDominated(Cycle, Used, Length))
+    return;
+
+  SmallVector<unsigned, 16> Ready;
+  for (unsigned i = 0, e = Nodes.size(); i != e; ++i)
+    if (!(Done & (1ULL << i)) && !PredsLeft[i])
+      Ready.push_back(i);
+  std::sort(Ready.begin(), Ready.end(), HigherNode(Heights));
+
+  // A node that still fits in the current cycle is better placed there than
+  // after a node that needs a new one: moving it up delays nothing.  So when
+  // some node fits, only the nodes that fit are tried.
+  bool SomeFit = false;
+  for (unsigned r = 0, re = Ready.size(); r != re && !SomeFit; ++r) {
+    unsigned NewUsed;
+    SomeFit = issueCycle(Ready[r], Cycle, Used, NewUsed) == Cycle;
+  }
+
+  for (unsigned r = 0, re = Ready.size(); r != re && !OutOfBudget; ++r) {
+    unsigned i = Ready[r];
+    const ENode &Node = Nodes[i];
+    unsigned NewUsed;
+    unsigned Issue = issueCycle(i, Cycle, Used, NewUsed);
+    if (SomeFit && Issue != Cycle)
+      continue;
+    unsigned NewLength = std::max(Length, Issue + Node.Latency);
+
+    Done |= 1ULL << i;
+    Order.push_back(i);
+    SmallVector<unsigned, 4> OldReadyAt;
+    for (unsigned s = 0, se = Node.Succs.size(); s != se; ++s) {
+      unsigned Succ = Node.Succs[s].first;
+      OldReadyAt.push_back(ReadyAt[Succ]);
+      ReadyAt[Succ] = std::max(ReadyAt[Succ], Issue + Node.Succs[s].second);
+      --PredsLeft[Succ];
+    }
+
+    if (lowerBound(Issue, NewUsed, NewLength) < BestLength)
+      search(Issue, NewUsed, NewLength);
+
+    for (unsigned s = Node.Succs.size(); s-- != 0;) {
+      unsigned Succ = Node.Succs[s].first;
+      ReadyAt[Succ] = OldReadyAt[s];
+      ++PredsLeft[Succ];
+    }
+    Order.pop_back();
+    Done &= ~(1ULL << i);
+  }
+}
+
+bool QpuExhaustiveScheduler::solve(ScheduleDAGMI *dag) {
+  DAG = dag;
+  unsigned N = DAG->SUnits.size();
+  // The scheduled nodes are kept in a 64 bit mask that also keys the
+  // visited sets. DenseMap reserves ~0ULL and ~0ULL - 1 as its empty and
+  // tombstone keys, so a full 64 node mask could hit them.
+  if (N > 63)
+    return false;
+  buildNodes();
+  Order.clear();
+  BestOrder.clear();
+  Done = 0;
+  VisitedSets.clear();
+  ReadyAt.assign(N, 0);
+  PredsLeft.assign(N, 0);
+  for (unsigned i = 0; i != N; ++i)
+    PredsLeft[i] = Nodes[i].Preds.size();
+  BestLength = ~0u;
+  Steps = 0;
+  OutOfBudget = false;
+
+  search(0, 0, 0);
+
+  DEBUG(dbgs() << "Exhaustive search: " << Steps << " steps, "
+        << (OutOfBudget ? "out of budget" : "optimal") << " length "
+        << BestLength << '\n');
+  return !OutOfBudget;
+}
+
+ScheduleDAGInstrs *llvm::createQpuMachineScheduler(MachineSchedContext *C) {
+  ScheduleDAGMI *DAG = new ScheduleDAGMI(C, new QpuSchedStrategy(C));
+  addGenericSchedMutations(DAG);
+  return DAG;
+}
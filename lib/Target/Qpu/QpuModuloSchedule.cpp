@@ -0,0 +1,1002 @@
+//===-- QpuModuloSchedule.cpp - Software pipeline single block loops ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass software pipelines loops that consist of a single basic block.
+// The QPU issues in order, so a loop that requests a value from the TMU and
+// then computes with it waits out the whole round trip on every iteration.
+// Overlapping consecutive iterations hides that latency.
+//
+// The body is modulo scheduled against the itinerary functional units (the
+// add and mul pipes).  The initiation interval is bounded below by unit
+// usage, by recurrences and by the number of TMU requests the FIFO can hold.
+// The instructions computing the exit test are kept in the first stage, so
+// every prologue step can leave the loop early and the trip count never has
+// to be known.  The pass then emits, in SSA form, one prologue block per
+// extra stage, the kernel in place of the original block and an epilogue for
+// every way out of the loop.  Values that outlive a kernel iteration are
+// carried by chains of PHIs which the register allocator later coalesces.
+//
+// Loops whose schedule keeps more values live than the A, B and accumulator
+// files can hold are left untouched.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "qpu-modulo-sched"
+
+#include "Qpu.h"
+#include "QpuMachineFunction.h"
+#include "QpuTargetMachine.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/MachineSSAUpdater.h"
+#include "llvm/CodeGen/RegisterClassInfo.h"
+#include "llvm/MC/MCInstrItineraries.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+using namespace llvm;
+
+STATISTIC(NumPipelined,   "Number of loops software pipelined");
+STATISTIC(NumNoSchedule,  "Number of loops without a modulo schedule");
+STATISTIC(NumRegPressure, "Number of loops rejected for register pressure");
+
+static cl::opt<bool> EnableModuloSched(
+  "enable-qpu-modulo-sched",
+  cl::init(true),
+  cl::desc("Software pipeline single block loops."),
+  cl::Hidden);
+
+static cl::opt<unsigned> TMUFifoDepth(
+  "qpu-tmu-fifo-depth",
+  cl::init(4),
+  cl::desc("Number of TMU requests that can be outstanding at once."),
+  cl::Hidden);
+
+static cl::opt<unsigned> MaxLoopSize(
+  "qpu-modulo-sched-max-size",
+  cl::init(64),
+  cl::desc("Largest loop body considered for pipelining."),
+  cl::Hidden);
+
+static cl::opt<unsigned> MaxStages(
+  "qpu-modulo-sched-max-stages",
+  cl::init(6),
+  cl::desc("Largest number of overlapped iterations."),
+  cl::Hidden);
+
+static cl::opt<unsigned> MaxIISlack(
+  "qpu-modulo-sched-ii-slack",
+  cl::init(8),
+  cl::desc("How far past the minimum II to search for a schedule."),
+  cl::Hidden);
+
+static cl::opt<unsigned> RegLimit(
+  "qpu-modulo-sched-reg-limit",
+  cl::init(0),
+  cl::desc("Most values the kernel may keep live (0 means the number of "
+           "allocatable A, B and accumulator registers)."),
+  cl::Hidden);
+
+namespace {
+  /// A dependence between two instructions of the loop body.  Distance is
+  /// the number of iterations the edge crosses (0 or 1).
+  struct MSEdge {
+    unsigned Node;
+    unsigned Latency;
+    unsigned Distance;
+    MSEdge(unsigned N, unsigned L, unsigned D)
+      : Node(N), Latency(L), Distance(D) { }
+  };
+
+  struct MSNode {
+    MachineInstr *MI;
+    unsigned Latency;
+    unsigned Units;     // Functional units the first itinerary stage may use.
+    bool IsTMULoad;
+    bool InExitSlice;   // Feeds the loop exit test; must be in stage 0.
+    bool FeedsBranch;
+    int Cycle;
+    SmallVector<MSEdge, 4> Preds;
+    SmallVector<MSEdge, 4> Succs;
+  };
+
+  /// A PHI of the loop header: Init comes from the preheader, Next from the
+  /// loop body.
+  struct LoopPhi {
+    unsigned Init;
+    unsigned Next;
+  };
+
+  typedef DenseMap<unsigned, unsigned> ValueMap;
+
+  struct QpuModuloSchedule : public MachineFunctionPass {
+
+    TargetMachine &TM;
+    const TargetInstrInfo *TII;
+    const InstrItineraryData *Itins;
+    MachineRegisterInfo *MRI;
+    RegisterClassInfo RegClassInfo;
+
+    // State for the loop being pipelined.
+    MachineBasicBlock *Loop, *Preheader, *Exit;
+    SmallVector<MachineInstr*, 2> Terminators;
+    std::vector<MSNode> Nodes;
+    DenseMap<unsigned, unsigned> DefNode;   // vreg -> defining node
+    DenseMap<unsigned, LoopPhi> Phis;       // PHI result -> operands
+    unsigned II, NumStages;
+    std::vector<unsigned> Order;            // Kernel order of the nodes.
+
+    // State for code generation.
+    std::vector<ValueMap> PrologVals;       // Per iteration.
+    std::vector<ValueMap> EarlyVals;        // Per iteration.
+    std::vector<ValueMap> EpilogVals;       // Per epilogue step.
+    ValueMap KernelVals;
+    std::map<std::pair<unsigned, unsigned>, unsigned> KernelPhis;
+    std::vector<std::pair<MachineInstr*, std::pair<unsigned, unsigned> > >
+      PendingPhis;
+    MachineBasicBlock *LastProlog;
+
+    static char ID;
+    QpuModuloSchedule(TargetMachine &tm)
+      : MachineFunctionPass(ID), TM(tm), TII(tm.getInstrInfo()),
+        Itins(&tm.getSubtarget<QpuSubtarget>().getInstrItineraryData()) { }
+
+    virtual const char *getPassName() const {
+      return "Qpu Modulo Scheduler";
+    }
+
+    bool runOnMachineFunction(MachineFunction &F);
+
+  private:
+    bool analyzeLoop(MachineBasicBlock *MBB);
+    bool buildGraph();
+    unsigned computeMII();
+    bool scheduleForII();
+    bool checkRegPressure();
+    void generatePipeline();
+
+    int defStage(unsigned Reg) const;
+    unsigned stageOf(unsigned N) const { return Nodes[N].Cycle / II; }
+    unsigned concreteValue(unsigned Reg, int It, int Step);
+    unsigned kernelValue(unsigned Reg, unsigned Stage);
+    unsigned epilogValue(unsigned Reg, unsigned Stage, int Step);
+    unsigned finalValue(unsigned X, unsigned Reg, int Offset);
+    unsigned getKernelPhi(unsigned X, unsigned Delta);
+    unsigned liveOutFinal(unsigned Reg);
+
+    enum EmitKind { EK_Prolog, EK_Kernel, EK_Epilog, EK_EarlyEpilog };
+    void emitStep(MachineBasicBlock *MBB, EmitKind Kind, int Step, int Exit);
+    void emitPrologBranches(MachineBasicBlock *MBB, int Step,
+                            MachineBasicBlock *Next, MachineBasicBlock *ExitTo);
+  };
+  char QpuModuloSchedule::ID = 0;
+
+  /// Kernel order: by issue slot, older iterations first within a slot and
+  /// program order otherwise.
+  struct KernelOrder {
+    const std::vector<MSNode> &Nodes;
+    unsigned II;
+    KernelOrder(const std::vector<MSNode> &N, unsigned ii) : Nodes(N), II(ii) {}
+    bool operator()(unsigned A, unsigned B) const {
+      unsigned SlotA = Nodes[A].Cycle % II, SlotB = Nodes[B].Cycle % II;
+      if (SlotA != SlotB)
+        return SlotA < SlotB;
+      unsigned StageA = Nodes[A].Cycle / II, StageB = Nodes[B].Cycle / II;
+      if (StageA != StageB)
+        return StageA > StageB;
+      return A < B;
+    }
+  };
+} // end of anonymous namespace
+
+/// Conservatively decide whether two memory instructions may touch the same
+/// location.  TMU reads and VPM accesses live in different address spaces.
+static bool mayAlias(const MachineInstr *A, const MachineInstr *B) {
+  if (A->memoperands_empty() || B->memoperands_empty())
+    return true;
+  for (MachineInstr::mmo_iterator I = A->memoperands_begin(),
+       IE = A->memoperands_end(); I != IE; ++I)
+    for (MachineInstr::mmo_iterator J = B->memoperands_begin(),
+         JE = B->memoperands_end(); J != JE; ++J) {
+      if (!(*I)->getValue() || !(*J)->getValue())
+        return true;
+      if ((*I)->getPointerInfo().getAddrSpace() ==
+          (*J)->getPointerInfo().getAddrSpace())
+        return true;
+    }
+  return false;
+}
+
+static bool isVPMAccess(const MachineInstr *MI) {
+  for (MachineInstr::mmo_iterator I = MI->memoperands_begin(),
+       E = MI->memoperands_end(); I != E; ++I)
+    if ((*I)->getValue() && (*I)->getPointerInfo().getAddrSpace() == 1)
+      return true;
+  return false;
+}
+
+bool QpuModuloSchedule::runOnMachineFunction(MachineFunction &F) {
+  if (!EnableModuloSched || Itins->isEmpty())
+    return false;
+
+  MRI = &F.getRegInfo();
+  if (!MRI->isSSA())
+    return false;
+  RegClassInfo.runOnMachineFunction(F);
+
+  // Pipelining adds blocks, so collect the candidates first.
+  SmallVector<MachineBasicBlock*, 8> Candidates;
+  for (MachineFunction::iterator MFI = F.begin(), MFE = F.end();
+       MFI != MFE; ++MFI)
+    if (MFI->isSuccessor(MFI))
+      Candidates.push_back(MFI);
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Candidates.size(); i != e; ++i) {
+    if (!analyzeLoop(Candidates[i]) || !buildGraph())
+      continue;
+
+    unsigned MII = computeMII();
+    bool Scheduled = false;
+    for (II = MII; II <= MII + MaxIISlack; ++II)
+      if ((Scheduled = scheduleForII()))
+        break;
+    if (!Scheduled) {
+      ++NumNoSchedule;
+      continue;
+    }
+
+    NumStages = 0;
+    for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n)
+      NumStages = std::max(NumStages, stageOf(n) + 1);
+    DEBUG(dbgs() << "BB#" << Loop->getNumber() << ": MII " << MII << ", II "
+                 << II << ", " << NumStages << " stages\n");
+
+    // A single stage overlaps nothing.
+    if (NumStages < 2 || NumStages > MaxStages)
+      continue;
+    if (!checkRegPressure()) {
+      ++NumRegPressure;
+      continue;
+    }
+
+    generatePipeline();
+    F.getInfo<QpuFunctionInfo>()->addPipelinedBlock(Loop);
+    ++NumPipelined;
+    Changed = true;
+  }
+  return Changed;
+}
+
+/// Check the shape of the loop: the block is its own latch, it is entered
+/// from one preheader, it ends in a conditional branch (plus an optional
+/// unconditional one) and its body has nothing that cannot be reordered.
+bool QpuModuloSchedule::analyzeLoop(MachineBasicBlock *MBB) {
+  Loop = MBB;
+  if (MBB->pred_size() != 2 || MBB->succ_size() != 2)
+    return false;
+
+  Preheader = *MBB->pred_begin() == MBB ? *llvm::next(MBB->pred_begin())
+                                        : *MBB->pred_begin();
+  Exit = *MBB->succ_begin() == MBB ? *llvm::next(MBB->succ_begin())
+                                   : *MBB->succ_begin();
+  if (Preheader == MBB || Exit == MBB)
+    return false;
+
+  Terminators.clear();
+  for (MachineBasicBlock::iterator I = MBB->getFirstTerminator(),
+       E = MBB->end(); I != E; ++I)
+    Terminators.push_back(I);
+  if (Terminators.empty() || Terminators.size() > 2 ||
+      !Terminators[0]->isConditionalBranch())
+    return false;
+  if (Terminators.size() == 2 && !Terminators[1]->isUnconditionalBranch())
+    return false;
+  // Without an unconditional branch the exit must be the fall through.
+  if (Terminators.size() == 1 &&
+      MachineFunction::iterator(Exit) != llvm::next(MachineFunction::iterator(MBB)))
+    return false;
+
+  for (unsigned i = 0, e = Terminators.size(); i != e; ++i)
+    for (unsigned j = 0, je = Terminators[i]->getNumOperands(); j != je; ++j) {
+      const MachineOperand &MO = Terminators[i]->getOperand(j);
+      if (MO.isReg() && (MO.isDef() ||
+          TargetRegisterInfo::isPhysicalRegister(MO.getReg())))
+        return false;
+    }
+  return true;
+}
+
+int QpuModuloSchedule::defStage(unsigned Reg) const {
+  DenseMap<unsigned, unsigned>::const_iterator I = DefNode.find(Reg);
+  if (I == DefNode.end())
+    return -1;
+  return stageOf(I->second);
+}
+
+/// Build the dependence graph of the loop body.  In SSA form register
+/// dependences are def-use edges only; a use of a header PHI is a use of
+/// its next value one iteration later.
+bool QpuModuloSchedule::buildGraph() {
+  Nodes.clear();
+  DefNode.clear();
+  Phis.clear();
+
+  for (MachineBasicBlock::iterator I = Loop->begin(), E = Loop->end();
+       I != E && I->isPHI(); ++I) {
+    LoopPhi P;
+    P.Init = P.Next = 0;
+    for (unsigned i = 1, e = I->getNumOperands(); i != e; i += 2) {
+      if (I->getOperand(i + 1).getMBB() == Loop)
+        P.Next = I->getOperand(i).getReg();
+      else
+        P.Init = I->getOperand(i).getReg();
+    }
+    if (!P.Init || !P.Next)
+      return false;
+    Phis[I->getOperand(0).getReg()] = P;
+  }
+
+  for (MachineBasicBlock::iterator I = Loop->getFirstNonPHI(),
+       E = Loop->getFirstTerminator(); I != E; ++I) {
+    if (I->isCall() || I->hasUnmodeledSideEffects() || I->isDebugValue() ||
+        I->isInlineAsm() || I->isLabel() || I->hasOrderedMemoryRef())
+      return false;
+    for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = I->getOperand(i);
+      if (MO.isRegMask())
+        return false;
+      if (MO.isReg() && MO.getReg() &&
+          TargetRegisterInfo::isPhysicalRegister(MO.getReg()))
+        return false;
+    }
+    if (Nodes.size() == MaxLoopSize)
+      return false;
+
+    MSNode N;
+    N.MI = I;
+    N.Units = 0;
+    N.Latency = 1;
+    unsigned SchedClass = I->getDesc().getSchedClass();
+    if (Itins->beginStage(SchedClass) != Itins->endStage(SchedClass)) {
+      N.Units = Itins->beginStage(SchedClass)->getUnits();
+      N.Latency = std::max(1u, Itins->getStageLatency(SchedClass));
+    }
+    N.IsTMULoad = I->mayLoad() && !isVPMAccess(I);
+    N.InExitSlice = N.FeedsBranch = false;
+    N.Cycle = -1;
+
+    unsigned Idx = Nodes.size();
+    for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = I->getOperand(i);
+      if (MO.isReg() && MO.isDef())
+        DefNode[MO.getReg()] = Idx;
+    }
+    Nodes.push_back(N);
+  }
+  if (Nodes.empty())
+    return false;
+
+  // The next value of every PHI must be computed by the body.
+  for (DenseMap<unsigned, LoopPhi>::iterator I = Phis.begin(),
+       E = Phis.end(); I != E; ++I)
+    if (!DefNode.count(I->second.Next))
+      return false;
+
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n) {
+    MachineInstr *MI = Nodes[n].MI;
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.isUse() || !MO.getReg())
+        continue;
+      unsigned Reg = MO.getReg(), Distance = 0;
+      DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+      if (P != Phis.end()) {
+        Reg = P->second.Next;
+        Distance = 1;
+      }
+      DenseMap<unsigned, unsigned>::iterator D = DefNode.find(Reg);
+      if (D == DefNode.end())
+        continue;
+      unsigned Def = D->second;
+      Nodes[Def].Succs.push_back(MSEdge(n, Nodes[Def].Latency, Distance));
+      Nodes[n].Preds.push_back(MSEdge(Def, Nodes[Def].Latency, Distance));
+    }
+
+    // Keep memory operations that may conflict in order, both within an
+    // iteration and against the next one.
+    if (!MI->mayLoad() && !MI->mayStore())
+      continue;
+    for (unsigned m = n + 1; m != ne; ++m) {
+      MachineInstr *Other = Nodes[m].MI;
+      if (!Other->mayLoad() && !Other->mayStore())
+        continue;
+      if (!MI->mayStore() && !Other->mayStore())
+        continue;
+      if (!mayAlias(MI, Other))
+        continue;
+      Nodes[n].Succs.push_back(MSEdge(m, 1, 0));
+      Nodes[m].Preds.push_back(MSEdge(n, 1, 0));
+      Nodes[m].Succs.push_back(MSEdge(n, 1, 1));
+      Nodes[n].Preds.push_back(MSEdge(m, 1, 1));
+    }
+  }
+
+  // Everything the exit test depends on within the iteration is pinned to
+  // the first stage.
+  SmallVector<unsigned, 8> Worklist;
+  for (unsigned i = 0, e = Terminators.size(); i != e; ++i)
+    for (unsigned j = 0, je = Terminators[i]->getNumOperands(); j != je; ++j) {
+      const MachineOperand &MO = Terminators[i]->getOperand(j);
+      if (!MO.isReg())
+        continue;
+      unsigned Reg = MO.getReg();
+      DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+      if (P != Phis.end())
+        Reg = P->second.Next;
+      DenseMap<unsigned, unsigned>::iterator D = DefNode.find(Reg);
+      if (D == DefNode.end())
+        continue;
+      Nodes[D->second].FeedsBranch |= P == Phis.end();
+      Worklist.push_back(D->second);
+    }
+  while (!Worklist.empty()) {
+    unsigned N = Worklist.pop_back_val();
+    if (Nodes[N].InExitSlice)
+      continue;
+    Nodes[N].InExitSlice = true;
+    for (unsigned i = 0, e = Nodes[N].Preds.size(); i != e; ++i)
+      if (Nodes[N].Preds[i].Distance == 0)
+        Worklist.push_back(Nodes[N].Preds[i].Node);
+  }
+  return true;
+}
+
+/// The minimum initiation interval is the largest of the unit usage bound,
+/// the TMU FIFO bound and the recurrence bound.
+unsigned QpuModuloSchedule::computeMII() {
+  unsigned ResMII = 1, TMUCycles = 0;
+  DenseMap<unsigned, unsigned> UnitUses;
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n) {
+    if (Nodes[n].Units)
+      ResMII = std::max(ResMII, ++UnitUses[Nodes[n].Units]);
+    if (Nodes[n].IsTMULoad)
+      TMUCycles += Nodes[n].Latency;
+  }
+  // A request occupies a FIFO entry until its result is read back, so at
+  // most TMUFifoDepth loads may be in flight during any II cycles.
+  unsigned Depth = std::max(1u, (unsigned)TMUFifoDepth);
+  ResMII = std::max(ResMII, (TMUCycles + Depth - 1) / Depth);
+
+  // Raise II until no recurrence has a positive length, measured as the sum
+  // of latency - distance * II along the cycle.
+  unsigned NumNodes = Nodes.size();
+  for (unsigned MII = ResMII; ; ++MII) {
+    const int Unreachable = -(1 << 30);
+    std::vector<int> Dist(NumNodes * NumNodes, Unreachable);
+    for (unsigned n = 0; n != NumNodes; ++n)
+      for (unsigned i = 0, e = Nodes[n].Succs.size(); i != e; ++i) {
+        const MSEdge &S = Nodes[n].Succs[i];
+        int W = (int)S.Latency - (int)(S.Distance * MII);
+        int &D = Dist[n * NumNodes + S.Node];
+        D = std::max(D, W);
+      }
+    for (unsigned k = 0; k != NumNodes; ++k)
+      for (unsigned i = 0; i != NumNodes; ++i) {
+        if (Dist[i * NumNodes + k] == Unreachable)
+          continue;
+        for (unsigned j = 0; j != NumNodes; ++j) {
+          if (Dist[k * NumNodes + j] == Unreachable)
+            continue;
+          int W = Dist[i * NumNodes + k] + Dist[k * NumNodes + j];
+          if (W > Dist[i * NumNodes + j])
+            Dist[i * NumNodes + j] = W;
+        }
+      }
+    bool Positive = false;
+    for (unsigned n = 0; n != NumNodes && !Positive; ++n)
+      Positive = Dist[n * NumNodes + n] > 0;
+    if (!Positive)
+      return MII;
+  }
+}
+
+/// Place the nodes in program order, each in the first cycle that satisfies
+/// its in-iteration dependences and has a free unit in the modulo
+/// reservation table, then check the loop carried dependences and the
+/// first-stage constraint on the exit test.
+bool QpuModuloSchedule::scheduleForII() {
+  std::vector<unsigned> Reserved(II, 0);
+
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n) {
+    MSNode &N = Nodes[n];
+    int Earliest = 0;
+    for (unsigned i = 0, e = N.Preds.size(); i != e; ++i)
+      if (N.Preds[i].Distance == 0)
+        Earliest = std::max(Earliest, Nodes[N.Preds[i].Node].Cycle +
+                                      (int)N.Preds[i].Latency);
+    N.Cycle = -1;
+    for (int C = Earliest; C != Earliest + (int)II; ++C) {
+      unsigned &Slot = Reserved[C % II];
+      unsigned Free = N.Units & ~Slot;
+      if (N.Units && !Free)
+        continue;
+      Slot |= Free & -Free;
+      N.Cycle = C;
+      break;
+    }
+    if (N.Cycle < 0)
+      return false;
+    if (N.InExitSlice && N.Cycle >= (int)II)
+      return false;
+    if (N.FeedsBranch && N.Cycle + N.Latency > II)
+      return false;
+  }
+
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n)
+    for (unsigned i = 0, e = Nodes[n].Succs.size(); i != e; ++i) {
+      const MSEdge &S = Nodes[n].Succs[i];
+      if (Nodes[S.Node].Cycle + (int)(S.Distance * II) <
+          Nodes[n].Cycle + (int)S.Latency)
+        return false;
+    }
+
+  Order.clear();
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n)
+    Order.push_back(n);
+  std::sort(Order.begin(), Order.end(), KernelOrder(Nodes, II));
+  return true;
+}
+
+/// Estimate the number of registers the kernel needs: every value is live
+/// from its definition to its last use, folded modulo II, and loop
+/// invariants are live throughout.
+bool QpuModuloSchedule::checkRegPressure() {
+  std::vector<unsigned> Live(II, 0);
+  DenseMap<unsigned, bool> Invariants;
+  int LoopEnd = NumStages * II;
+
+  for (unsigned n = 0, ne = Nodes.size(); n != ne; ++n) {
+    MachineInstr *MI = Nodes[n].MI;
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      const MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.getReg())
+        continue;
+      unsigned Reg = MO.getReg();
+      if (MO.isUse()) {
+        if (!DefNode.count(Reg) && !Phis.count(Reg))
+          Invariants[Reg] = true;
+        continue;
+      }
+
+      int Start = Nodes[n].Cycle, End = Start + 1;
+      for (MachineRegisterInfo::use_iterator UI = MRI->use_begin(Reg),
+           UE = MRI->use_end(); UI != UE; ++UI) {
+        MachineInstr *UseMI = &*UI;
+        if (UseMI->getParent() != Loop || UseMI->isTerminator()) {
+          End = std::max(End, UseMI->isTerminator() ? (int)II : LoopEnd);
+          continue;
+        }
+        if (!UseMI->isPHI()) {
+          for (unsigned u = 0, ue = Nodes.size(); u != ue; ++u)
+            if (Nodes[u].MI == UseMI)
+              End = std::max(End, Nodes[u].Cycle);
+          continue;
+        }
+        // Carried into the next iteration through a header PHI.
+        unsigned PhiReg = UseMI->getOperand(0).getReg();
+        End = std::max(End, Start + 1);
+        for (MachineRegisterInfo::use_iterator PI = MRI->use_begin(PhiReg),
+             PE = MRI->use_end(); PI != PE; ++PI) {
+          if (PI->getParent() != Loop || PI->isTerminator()) {
+            End = std::max(End, LoopEnd + (int)II);
+            continue;
+          }
+          for (unsigned u = 0, ue = Nodes.size(); u != ue; ++u)
+            if (Nodes[u].MI == &*PI)
+              End = std::max(End, Nodes[u].Cycle + (int)II);
+        }
+      }
+      for (int C = Start; C < End; ++C)
+        ++Live[C % II];
+    }
+  }
+
+  unsigned MaxLive = 0;
+  for (unsigned i = 0; i != II; ++i)
+    MaxLive = std::max(MaxLive, Live[i]);
+  MaxLive += Invariants.size();
+
+  unsigned Limit = RegLimit;
+  if (!Limit)
+    Limit = RegClassInfo.getNumAllocatableRegs(&Qpu::GPRAccRARBRegClass);
+  DEBUG(dbgs() << "  MaxLive " << MaxLive << ", limit " << Limit << "\n");
+  return MaxLive <= Limit;
+}
+
+/// Value of Reg for iteration It in the prologue or in the epilogue taken
+/// after prologue step Step.  Values produced at a virtual step beyond Step
+/// were computed by that epilogue.
+unsigned QpuModuloSchedule::concreteValue(unsigned Reg, int It, int Step) {
+  DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+  if (P != Phis.end()) {
+    if (It == 0)
+      return P->second.Init;
+    Reg = P->second.Next;
+    --It;
+  }
+  int Stage = defStage(Reg);
+  if (Stage < 0)
+    return Reg;
+  assert(It >= 0 && "Value from before the first iteration");
+  ValueMap &Vals = It + Stage <= Step ? PrologVals[It] : EarlyVals[It];
+  assert(Vals.count(Reg) && "Value used before it is computed");
+  return Vals[Reg];
+}
+
+/// A kernel PHI holding the value of X (a body def or a header PHI) that
+/// was produced Delta kernel iterations ago.
+unsigned QpuModuloSchedule::getKernelPhi(unsigned X, unsigned Delta) {
+  std::pair<unsigned, unsigned> Key(X, Delta);
+  std::map<std::pair<unsigned, unsigned>, unsigned>::iterator I =
+    KernelPhis.find(Key);
+  if (I != KernelPhis.end())
+    return I->second;
+
+  // On entry to the kernel the newest iteration is NumStages - 1.
+  int It;
+  DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(X);
+  if (P != Phis.end())
+    It = NumStages - Delta - defStage(P->second.Next);
+  else
+    It = NumStages - 1 - Delta - defStage(X);
+  unsigned Init = concreteValue(X, It, NumStages - 2);
+
+  unsigned NewReg = MRI->createVirtualRegister(MRI->getRegClass(X));
+  MachineInstr *Phi =
+    BuildMI(*Loop, Loop->begin(), Terminators[0]->getDebugLoc(),
+            TII->get(TargetOpcode::PHI), NewReg)
+    .addReg(Init).addMBB(LastProlog);
+  PendingPhis.push_back(std::make_pair(Phi, Key));
+  KernelPhis[Key] = NewReg;
+  return NewReg;
+}
+
+/// Value of Reg as read by an instruction in stage Stage of the kernel.
+unsigned QpuModuloSchedule::kernelValue(unsigned Reg, unsigned Stage) {
+  unsigned X = Reg;
+  int Delta;
+  DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+  if (P != Phis.end()) {
+    Reg = P->second.Next;
+    Delta = Stage + 1 - defStage(Reg);
+  } else {
+    if (defStage(Reg) < 0)
+      return Reg;
+    Delta = Stage - defStage(Reg);
+  }
+  assert(Delta >= 0 && "Use scheduled before its definition");
+  if (Delta == 0)
+    return KernelVals[Reg];
+  return getKernelPhi(X, Delta);
+}
+
+/// Value of X (or of Reg, its body definition) produced Offset steps after
+/// the last kernel iteration; a negative Offset reaches back into the
+/// kernel.
+unsigned QpuModuloSchedule::finalValue(unsigned X, unsigned Reg, int Offset) {
+  if (Offset > 0) {
+    assert(EpilogVals[Offset].count(Reg) && "Value not computed yet");
+    return EpilogVals[Offset][Reg];
+  }
+  if (Offset == 0)
+    return KernelVals[Reg];
+  return getKernelPhi(X, -Offset);
+}
+
+/// Value of Reg as read by an instruction in stage Stage of step Step of
+/// the epilogue after the kernel.
+unsigned QpuModuloSchedule::epilogValue(unsigned Reg, unsigned Stage,
+                                        int Step) {
+  unsigned X = Reg;
+  int Delta;
+  DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+  if (P != Phis.end()) {
+    Reg = P->second.Next;
+    Delta = Stage + 1 - defStage(Reg);
+  } else {
+    if (defStage(Reg) < 0)
+      return Reg;
+    Delta = Stage - defStage(Reg);
+  }
+  return finalValue(X, Reg, Step - Delta);
+}
+
+/// Value of Reg for the last iteration once the kernel epilogue is done.
+unsigned QpuModuloSchedule::liveOutFinal(unsigned Reg) {
+  DenseMap<unsigned, LoopPhi>::iterator P = Phis.find(Reg);
+  if (P != Phis.end())
+    return finalValue(Reg, P->second.Next, defStage(P->second.Next) - 1);
+  if (defStage(Reg) < 0)
+    return Reg;
+  return finalValue(Reg, Reg, defStage(Reg));
+}
+
+/// Emit one step of the pipeline: the instructions of every stage that is
+/// active in that step, renamed for the iteration each stage works on.
+void QpuModuloSchedule::emitStep(MachineBasicBlock *MBB, EmitKind Kind,
+                                 int Step, int Exit) {
+  MachineFunction &MF = *MBB->getParent();
+  for (unsigned o = 0, oe = Order.size(); o != oe; ++o) {
+    unsigned N = Order[o];
+    int Stage = stageOf(N);
+    // The iteration this stage works on, relative to the exit iteration
+    // for the kernel epilogue.
+    int It;
+    switch (Kind) {
+    case EK_Prolog:
+      It = Step - Stage;
+      if (It < 0)
+        continue;
+      break;
+    case EK_EarlyEpilog:
+      It = Exit + Step - Stage;
+      if (It < 0 || It > Exit)
+        continue;
+      break;
+    case EK_Epilog:
+      if (Stage < Step)
+        continue;
+      It = 0;
+      break;
+    default:
+      It = 0;
+      break;
+    }
+
+    MachineInstr *MI = MF.CloneMachineInstr(Nodes[N].MI);
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.getReg() || !MO.isUse())
+        continue;
+      unsigned Reg = MO.getReg(), NewReg;
+      switch (Kind) {
+      case EK_Prolog:      NewReg = concreteValue(Reg, It, Step); break;
+      case EK_EarlyEpilog: NewReg = concreteValue(Reg, It, Exit); break;
+      case EK_Kernel:      NewReg = kernelValue(Reg, Stage); break;
+      default:             NewReg = epilogValue(Reg, Stage, Step); break;
+      }
+      MO.setReg(NewReg);
+      MO.setIsKill(false);
+    }
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (!MO.isReg() || !MO.getReg() || !MO.isDef())
+        continue;
+      unsigned Reg = MO.getReg();
+      unsigned NewReg = MRI->createVirtualRegister(MRI->getRegClass(Reg));
+      switch (Kind) {
+      case EK_Prolog:      PrologVals[It][Reg] = NewReg; break;
+      case EK_EarlyEpilog: EarlyVals[It][Reg] = NewReg; break;
+      case EK_Kernel:      KernelVals[Reg] = NewReg; break;
+      default:             EpilogVals[Step][Reg] = NewReg; break;
+      }
+      MO.setReg(NewReg);
+    }
+    MBB->push_back(MI);
+  }
+}
+
+/// Copy the loop branches to the end of prologue step Step, sending the back
+/// edge to Next and the exit edge to ExitTo.
+void QpuModuloSchedule::emitPrologBranches(MachineBasicBlock *MBB, int Step,
+                                           MachineBasicBlock *Next,
+                                           MachineBasicBlock *ExitTo) {
+  MachineFunction &MF = *MBB->getParent();
+  for (unsigned t = 0, te = Terminators.size(); t != te; ++t) {
+    MachineInstr *MI = MF.CloneMachineInstr(Terminators[t]);
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (MO.isMBB())
+        MO.setMBB(MO.getMBB() == Loop ? Next : ExitTo);
+      else if (MO.isReg() && MO.getReg()) {
+        MO.setReg(concreteValue(MO.getReg(), Step, Step));
+        MO.setIsKill(false);
+      }
+    }
+    MBB->push_back(MI);
+  }
+  // The original loop fell through to its exit.
+  if (Terminators.size() == 1 &&
+      MachineFunction::iterator(ExitTo) != llvm::next(MachineFunction::iterator(MBB)))
+    TII->InsertBranch(*MBB, ExitTo, 0, SmallVector<MachineOperand, 0>(),
+                      Terminators[0]->getDebugLoc());
+  MBB->addSuccessor(Next);
+  MBB->addSuccessor(ExitTo);
+}
+
+/// Rewrite the loop as prologue, kernel and epilogues.
+void QpuModuloSchedule::generatePipeline() {
+  MachineFunction &MF = *Loop->getParent();
+  const BasicBlock *BB = Loop->getBasicBlock();
+  DebugLoc DL = Terminators[0]->getDebugLoc();
+  unsigned NumProlog = NumStages - 1;
+
+  PrologVals.assign(NumProlog, ValueMap());
+  EpilogVals.assign(NumStages, ValueMap());
+  KernelVals.clear();
+  KernelPhis.clear();
+  PendingPhis.clear();
+
+  SmallVector<MachineInstr*, 16> Originals;
+  for (MachineBasicBlock::iterator I = Loop->begin(), E = Loop->end();
+       I != E; ++I)
+    Originals.push_back(I);
+
+  // Layout: prologue steps, kernel, kernel epilogue, early epilogues.
+  SmallVector<MachineBasicBlock*, 4> Prologs, Earlys;
+  for (unsigned p = 0; p != NumProlog; ++p) {
+    MachineBasicBlock *MBB = MF.CreateMachineBasicBlock(BB);
+    MF.insert(MachineFunction::iterator(Loop), MBB);
+    Prologs.push_back(MBB);
+  }
+  MachineFunction::iterator InsertPos = llvm::next(MachineFunction::iterator(Loop));
+  MachineBasicBlock *Epilog = MF.CreateMachineBasicBlock(BB);
+  MF.insert(InsertPos, Epilog);
+  for (unsigned p = 0; p != NumProlog; ++p) {
+    MachineBasicBlock *MBB = MF.CreateMachineBasicBlock(BB);
+    MF.insert(InsertPos, MBB);
+    Earlys.push_back(MBB);
+  }
+  LastProlog = Prologs.back();
+
+  Preheader->ReplaceUsesOfBlockWith(Loop, Prologs[0]);
+  Loop->replaceSuccessor(Exit, Epilog);
+
+  // Prologue step p starts iteration p; each may leave for its epilogue.
+  for (unsigned p = 0; p != NumProlog; ++p) {
+    emitStep(Prologs[p], EK_Prolog, p, 0);
+    MachineBasicBlock *Next = p + 1 == NumProlog ? Loop : Prologs[p + 1];
+    emitPrologBranches(Prologs[p], p, Next, Earlys[p]);
+  }
+
+  // The kernel is appended after the original instructions, which are
+  // deleted once everything has been renamed.
+  emitStep(Loop, EK_Kernel, 0, 0);
+  for (unsigned t = 0, te = Terminators.size(); t != te; ++t) {
+    MachineInstr *MI = MF.CloneMachineInstr(Terminators[t]);
+    for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+      MachineOperand &MO = MI->getOperand(i);
+      if (MO.isMBB() && MO.getMBB() == Exit)
+        MO.setMBB(Epilog);
+      else if (MO.isReg() && MO.getReg()) {
+        MO.setReg(kernelValue(MO.getReg(), 0));
+        MO.setIsKill(false);
+      }
+    }
+    Loop->push_back(MI);
+  }
+
+  // Finish the iterations still in flight when the kernel exits.
+  for (unsigned e = 1; e != NumStages; ++e)
+    emitStep(Epilog, EK_Epilog, e, 0);
+  Epilog->addSuccessor(Exit);
+
+  std::vector<std::vector<ValueMap> > EarlyLiveVals(NumProlog);
+  for (unsigned p = 0; p != NumProlog; ++p) {
+    EarlyVals.assign(p + 1, ValueMap());
+    for (unsigned e = 1; e != NumStages; ++e)
+      emitStep(Earlys[p], EK_EarlyEpilog, e, p);
+    Earlys[p]->addSuccessor(Exit);
+    EarlyLiveVals[p] = EarlyVals;
+  }
+
+  // Branch to the exit where it is not the layout successor.
+  SmallVector<MachineBasicBlock*, 4> Tails;
+  Tails.push_back(Epilog);
+  Tails.append(Earlys.begin(), Earlys.end());
+  for (unsigned i = 0, e = Tails.size(); i != e; ++i)
+    if (MachineFunction::iterator(Exit) !=
+        llvm::next(MachineFunction::iterator(Tails[i])))
+      TII->InsertBranch(*Tails[i], Exit, 0, SmallVector<MachineOperand, 0>(),
+                        DL);
+
+  // Values used after the loop come from whichever epilogue was taken.
+  SmallVector<unsigned, 16> LoopDefs;
+  for (DenseMap<unsigned, LoopPhi>::iterator I = Phis.begin(),
+       E = Phis.end(); I != E; ++I)
+    LoopDefs.push_back(I->first);
+  for (DenseMap<unsigned, unsigned>::iterator I = DefNode.begin(),
+       E = DefNode.end(); I != E; ++I)
+    LoopDefs.push_back(I->first);
+
+  for (unsigned d = 0, de = LoopDefs.size(); d != de; ++d) {
+    unsigned Reg = LoopDefs[d];
+    SmallVector<std::pair<MachineInstr*, unsigned>, 4> OutsideUses;
+    for (MachineRegisterInfo::use_iterator UI = MRI->use_begin(Reg),
+         UE = MRI->use_end(); UI != UE; ++UI)
+      if (UI->getParent() != Loop)
+        OutsideUses.push_back(std::make_pair(&*UI, UI.getOperandNo()));
+    if (OutsideUses.empty())
+      continue;
+
+    SmallVector<unsigned, 4> Vals;
+    Vals.push_back(liveOutFinal(Reg));
+    for (unsigned p = 0; p != NumProlog; ++p) {
+      EarlyVals = EarlyLiveVals[p];
+      Vals.push_back(concreteValue(Reg, p, p));
+    }
+
+    MachineSSAUpdater SSAUpdate(MF);
+    SSAUpdate.Initialize(Reg);
+    for (unsigned i = 0, e = Tails.size(); i != e; ++i)
+      SSAUpdate.AddAvailableValue(Tails[i], Vals[i]);
+
+    for (unsigned u = 0, ue = OutsideUses.size(); u != ue; ++u) {
+      MachineInstr *UseMI = OutsideUses[u].first;
+      unsigned OpNo = OutsideUses[u].second;
+      // PHIs in the exit block get one incoming value per epilogue.
+      if (UseMI->isPHI() && UseMI->getParent() == Exit &&
+          UseMI->getOperand(OpNo + 1).getMBB() == Loop) {
+        UseMI->getOperand(OpNo).setReg(Vals[0]);
+        UseMI->getOperand(OpNo + 1).setMBB(Epilog);
+        MachineInstrBuilder MIB(MF, UseMI);
+        for (unsigned p = 0; p != NumProlog; ++p)
+          MIB.addReg(Vals[p + 1]).addMBB(Earlys[p]);
+        continue;
+      }
+      SSAUpdate.RewriteUse(UseMI->getOperand(OpNo));
+    }
+  }
+
+  // Exit PHIs of loop invariants gain the new predecessors too.
+  for (MachineBasicBlock::iterator I = Exit->begin(), E = Exit->end();
+       I != E && I->isPHI(); ++I)
+    for (unsigned i = 1, e = I->getNumOperands(); i != e; i += 2) {
+      if (I->getOperand(i + 1).getMBB() != Loop)
+        continue;
+      unsigned Reg = I->getOperand(i).getReg();
+      I->getOperand(i + 1).setMBB(Epilog);
+      MachineInstrBuilder MIB(MF, I);
+      for (unsigned p = 0; p != NumProlog; ++p)
+        MIB.addReg(Reg).addMBB(Earlys[p]);
+      break;
+    }
+
+  // Close the PHI chains, which may create further links.
+  for (unsigned i = 0; i != PendingPhis.size(); ++i) {
+    MachineInstr *Phi = PendingPhis[i].first;
+    unsigned X = PendingPhis[i].second.first;
+    unsigned Delta = PendingPhis[i].second.second;
+    unsigned Latch;
+    if (Delta > 1)
+      Latch = getKernelPhi(X, Delta - 1);
+    else if (Phis.count(X))
+      Latch = KernelVals[Phis[X].Next];
+    else
+      Latch = KernelVals[X];
+    MachineInstrBuilder(MF, Phi).addReg(Latch).addMBB(Loop);
+  }
+
+  for (unsigned i = Originals.size(); i != 0; --i)
+    Originals[i - 1]->eraseFromParent();
+}
+
+/// createQpuModuloSchedulePass - Returns a pass that software pipelines
+/// single block loops.
+FunctionPass *llvm::createQpuModuloSchedulePass(QpuTargetMachine &tm) {
+  return new QpuModuloSchedule(tm);
+}
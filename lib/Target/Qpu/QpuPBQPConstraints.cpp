@@ -0,0 +1,246 @@
+//===-- QpuPBQPConstraints.cpp - Qpu costs for PBQP allocation ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// With -regalloc=pbqp the allocator hands every problem it builds to these
+// constraints, which add the QPU register file rules that the register
+// classes cannot express:
+//
+//  * Regfiles A and B each have one read port, so an instruction may read at
+//    most one register of each.  Two operands read from different registers
+//    of the same file cost infinity.
+//
+//  * A register file write is not readable by the next instruction, while an
+//    accumulator is.  A value read by the instruction right after its def
+//    pays the cost of a nop in its block for every regfile option, scaled
+//    like its spill weight and kept well below it.
+//
+//  * Kernels have no stack, so their values may not be spilled.  A value
+//    that no register can hold is reported instead of spilled.
+//
+//  * r5 is written by broadcasts only; every other write replicates one
+//    value per quad.  Values not defined by an r5 operand may not use it.
+//
+// The QPU's r4, which receives TMU and SFU results, is not modelled as a
+// register in this backend, so it needs no rule here.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "regalloc"
+
+#include "Qpu.h"
+#include "QpuInstrInfo.h"
+#include "QpuSubtarget.h"
+#include "llvm/CodeGen/CalcSpillWeights.h"
+#include "llvm/CodeGen/LiveIntervalAnalysis.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/RegAllocPBQP.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <limits>
+
+using namespace llvm;
+
+namespace {
+  enum RegBank { BankA, BankB, BankAcc, BankOther };
+
+  class QpuPBQPConstraint : public PBQPRAConstraint {
+  public:
+    virtual void apply(PBQPRAProblem &P, MachineFunction &MF,
+                       const LiveIntervals &LIS,
+                       const MachineBlockFrequencyInfo &MBFI);
+
+  private:
+    void addReadPortCosts(PBQPRAProblem &P, const MachineInstr *MI);
+    void addWriteReadCosts(PBQPRAProblem &P, const MachineInstr *MI,
+                           const MachineInstr *Next, float UseWeight);
+    void addR5Costs(PBQPRAProblem &P, unsigned VReg,
+                    const MachineRegisterInfo &MRI);
+
+    const TargetInstrInfo *TII;
+    const TargetRegisterInfo *TRI;
+    const LiveIntervals *LIS;
+  };
+}
+
+static const PBQP::PBQPNum Infinity =
+  std::numeric_limits<PBQP::PBQPNum>::infinity();
+
+static RegBank getBank(unsigned Reg) {
+  if (Qpu::GPROnlyRARegClass.contains(Reg))
+    return BankA;
+  if (Qpu::GPROnlyRBRegClass.contains(Reg))
+    return BankB;
+  if (Qpu::GPROnlyAccRegClass.contains(Reg) || Reg == Qpu::ACC5)
+    return BankAcc;
+  return BankOther;
+}
+
+static bool isRegfile(RegBank Bank) {
+  return Bank == BankA || Bank == BankB;
+}
+
+/// Forbid reading two different registers of one regfile in MI.
+void QpuPBQPConstraint::addReadPortCosts(PBQPRAProblem &P,
+                                         const MachineInstr *MI) {
+  SmallVector<unsigned, 4> Reads;
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isUse() || MO.isImplicit() || !MO.getReg())
+      continue;
+    if (std::find(Reads.begin(), Reads.end(), MO.getReg()) == Reads.end())
+      Reads.push_back(MO.getReg());
+  }
+
+  for (unsigned i = 0, e = Reads.size(); i != e; ++i) {
+    unsigned R1 = Reads[i];
+    bool Virt1 = TargetRegisterInfo::isVirtualRegister(R1);
+    if (Virt1 && !P.hasNodeForVReg(R1))
+      continue;
+    for (unsigned j = i + 1; j != e; ++j) {
+      unsigned R2 = Reads[j];
+      bool Virt2 = TargetRegisterInfo::isVirtualRegister(R2);
+      if ((Virt2 && !P.hasNodeForVReg(R2)) || (!Virt1 && !Virt2))
+        continue;
+
+      if (Virt1 && Virt2) {
+        const PBQPRAProblem::AllowedSet &A1 = P.getAllowedSet(R1);
+        const PBQPRAProblem::AllowedSet &A2 = P.getAllowedSet(R2);
+        PBQP::Matrix Costs(A1.size() + 1, A2.size() + 1, 0);
+        for (unsigned o1 = 0, oe1 = A1.size(); o1 != oe1; ++o1) {
+          RegBank Bank = getBank(A1[o1]);
+          if (!isRegfile(Bank))
+            continue;
+          for (unsigned o2 = 0, oe2 = A2.size(); o2 != oe2; ++o2)
+            if (A1[o1] != A2[o2] && getBank(A2[o2]) == Bank)
+              Costs[o1 + 1][o2 + 1] = Infinity;
+        }
+        P.addEdgeCosts(R1, R2, Costs);
+        continue;
+      }
+
+      // One side is already a physical register.
+      unsigned VReg = Virt1 ? R1 : R2;
+      unsigned PReg = Virt1 ? R2 : R1;
+      RegBank Bank = getBank(PReg);
+      if (!isRegfile(Bank))
+        continue;
+      const PBQPRAProblem::AllowedSet &Allowed = P.getAllowedSet(VReg);
+      PBQP::Vector &Costs = P.getGraph().getNodeCosts(P.getNodeForVReg(VReg));
+      for (unsigned o = 0, oe = Allowed.size(); o != oe; ++o)
+        if (Allowed[o] != PReg && getBank(Allowed[o]) == Bank)
+          Costs[o + 1] = Infinity;
+    }
+  }
+}
+
+/// Charge a nop to the regfile options of the values MI defines and Next
+/// reads straight away.  UseWeight is what a read in the block adds to a
+/// spill weight before it is normalized.
+void QpuPBQPConstraint::addWriteReadCosts(PBQPRAProblem &P,
+                                          const MachineInstr *MI,
+                                          const MachineInstr *Next,
+                                          float UseWeight) {
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (!MO.isReg() || !MO.isDef() || !MO.getReg() ||
+        !TargetRegisterInfo::isVirtualRegister(MO.getReg()) ||
+        !P.hasNodeForVReg(MO.getReg()) ||
+        !Next->readsVirtualRegister(MO.getReg()))
+      continue;
+    unsigned VReg = MO.getReg();
+    // The spill weight counts this def and read, halved at worst when the
+    // def can be rematerialized, so a quarter of the read stays well below
+    // it: a nop is cheaper than a spill.
+    PBQP::PBQPNum Cost = 0.25 *
+      normalizeSpillWeight(UseWeight, LIS->getInterval(VReg).getSize());
+    const PBQPRAProblem::AllowedSet &Allowed = P.getAllowedSet(VReg);
+    PBQP::Vector &Costs = P.getGraph().getNodeCosts(P.getNodeForVReg(VReg));
+    for (unsigned o = 0, oe = Allowed.size(); o != oe; ++o)
+      if (isRegfile(getBank(Allowed[o])))
+        Costs[o + 1] += Cost;
+  }
+}
+
+/// Keep VReg out of r5 unless every def writes an operand that must be r5.
+void QpuPBQPConstraint::addR5Costs(PBQPRAProblem &P, unsigned VReg,
+                                   const MachineRegisterInfo &MRI) {
+  const PBQPRAProblem::AllowedSet &Allowed = P.getAllowedSet(VReg);
+  PBQPRAProblem::AllowedSet::const_iterator I =
+    std::find(Allowed.begin(), Allowed.end(), unsigned(Qpu::ACC5));
+  if (I == Allowed.end())
+    return;
+
+  for (MachineRegisterInfo::def_iterator DI = MRI.def_begin(VReg),
+       DE = MRI.def_end(); DI != DE; ++DI) {
+    const TargetRegisterClass *RC =
+      DI->getRegClassConstraint(DI.getOperandNo(), TII, TRI);
+    if (!RC || RC->getNumRegs() != 1 || !RC->contains(Qpu::ACC5)) {
+      P.getGraph().getNodeCosts(P.getNodeForVReg(VReg))
+        [I - Allowed.begin() + 1] = Infinity;
+      return;
+    }
+  }
+}
+
+void QpuPBQPConstraint::apply(PBQPRAProblem &P, MachineFunction &MF,
+                              const LiveIntervals &LIS,
+                              const MachineBlockFrequencyInfo &MBFI) {
+  TII = MF.getTarget().getInstrInfo();
+  TRI = MF.getTarget().getRegisterInfo();
+  this->LIS = &LIS;
+  const MachineRegisterInfo &MRI = MF.getRegInfo();
+
+  for (MachineFunction::const_iterator MBB = MF.begin(), MBBE = MF.end();
+       MBB != MBBE; ++MBB) {
+    float UseWeight =
+      LiveIntervals::getSpillWeight(false, true, MBFI.getBlockFreq(MBB));
+
+    const MachineInstr *Prev = 0;
+    for (MachineBasicBlock::const_iterator MI = MBB->begin(), E = MBB->end();
+         MI != E; ++MI) {
+      if (MI->isDebugValue())
+        continue;
+      addReadPortCosts(P, MI);
+      if (Prev)
+        addWriteReadCosts(P, Prev, MI, UseWeight);
+      Prev = MI;
+    }
+  }
+
+  bool KernelMode = MF.getTarget().getSubtarget<QpuSubtarget>().isKernelMode();
+  for (unsigned i = 0, e = MRI.getNumVirtRegs(); i != e; ++i) {
+    unsigned VReg = TargetRegisterInfo::index2VirtReg(i);
+    if (!P.hasNodeForVReg(VReg))
+      continue;
+    addR5Costs(P, VReg, MRI);
+    if (!KernelMode)
+      continue;
+
+    // An infinite spill cost only ties spilling with the other infinite
+    // options, and the solver breaks that tie towards spilling.  A value
+    // with no register left must be caught here; spills chosen because the
+    // registers conflict with each other are caught by the frame lowering.
+    PBQP::Vector &Costs = P.getGraph().getNodeCosts(P.getNodeForVReg(VReg));
+    Costs[0] = Infinity;
+    bool HasReg = false;
+    for (unsigned o = 1, oe = Costs.getLength(); o != oe && !HasReg; ++o)
+      HasReg = Costs[o] != Infinity;
+    if (!HasReg)
+      report_fatal_error("Qpu kernel '" + MF.getName() +
+                         "' requires spilling: no register can hold %vreg" +
+                         Twine(TargetRegisterInfo::virtReg2Index(VReg)));
+  }
+}
+
+PBQPRAConstraint *llvm::createQpuPBQPConstraint() {
+  return new QpuPBQPConstraint();
+}
@@ -56,6 +56,10 @@ QpuRegisterInfo::QpuRegisterInfo(const QpuSubtarget &ST,
 const uint16_t* QpuRegisterInfo::
 getCalleeSavedRegs(const MachineFunction *MF) const
 {
+  // A kernel never returns to a caller, so it has nothing to preserve.
+  static const uint16_t NoCalleeSavedRegs[] = { 0 };
+  if (Subtarget.isKernelMode())
+    return NoCalleeSavedRegs;
   return CSR_O32_SaveList;
 }
 
@@ -35,6 +35,12 @@ static cl::opt<bool> NoCploadOpt
                 ("qpu-no-cpload", cl::Hidden, cl::init(false),
                  cl::desc("No issue .cpload"));
 
+static cl::opt<bool> KernelModeOpt
+                ("qpu-kernel", cl::Hidden, cl::init(false),
+                 cl::desc("Compile functions as frameless leaf kernels: calls "
+                 "are inlined, arguments are read from uniforms and globals "
+                 "are addressed absolutely."));
+
 bool QpuReserveGP;
 bool QpuNoCpload;
 
@@ -42,6 +48,10 @@ extern bool FixGlobalBaseReg;
 
 void QpuSubtarget::anchor() { }
 
+PBQPRAConstraint *QpuSubtarget::getCustomPBQPConstraints() const {
+  return createQpuPBQPConstraint();
+}
+
 QpuSubtarget::QpuSubtarget(const std::string &TT, const std::string &CPU,
                              const std::string &FS, bool little, 
                              Reloc::Model _RM) :
@@ -63,10 +73,13 @@ QpuSubtarget::QpuSubtarget(const std::string &TT, const std::string &CPU,
     QpuABI = O32;
 
   // Set UseSmallSection.
-  UseSmallSection = UseSmallSectionOpt;
+  KernelMode = KernelModeOpt;
+  UseSmallSection = UseSmallSectionOpt && !KernelMode;
   QpuReserveGP = ReserveGPOpt;
   QpuNoCpload = NoCploadOpt;
-  if (RM == Reloc::Static && !UseSmallSection && !QpuReserveGP)
+  if (KernelMode)
+    FixGlobalBaseReg = false;
+  else if (RM == Reloc::Static && !UseSmallSection && !QpuReserveGP)
     FixGlobalBaseReg = false;
   else
     FixGlobalBaseReg = true;
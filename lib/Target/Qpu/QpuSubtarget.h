@@ -63,6 +63,9 @@ protected:
   // UseSmallSection - Small section is used.
   bool UseSmallSection;
 
+  // KernelMode - Functions are leaf kernels without stack, $gp or calls.
+  bool KernelMode;
+
 public:
   unsigned getTargetABI() const { return QpuABI; }
 
@@ -76,6 +79,13 @@ public:
   /// subtarget options.  Definition of function is auto generated by tblgen.
   void ParseSubtargetFeatures(StringRef CPU, StringRef FS);
 
+  /// The machine scheduler picks a strategy per region from the block
+  /// frequencies; see QpuMachineScheduler.cpp.
+  virtual bool enableMachineScheduler() const { return true; }
+
+  /// Register file rules for the PBQP allocator; see QpuPBQPConstraints.cpp.
+  virtual PBQPRAConstraint *getCustomPBQPConstraints() const;
+
   bool isLittle() const { return IsLittle; }
   bool hasQpu32I() const { return QpuArchVersion >= Qpu32I; }
   bool isQpu32I() const { return QpuArchVersion == Qpu32I; }
@@ -85,6 +95,9 @@ public:
   bool hasSlt()   const { return HasSlt; }
 
   bool useSmallSection() const { return UseSmallSection; }
+  bool isKernelMode() const { return KernelMode; }
+
+  const InstrItineraryData &getInstrItineraryData() const { return InstrItins; }
 };
 } // End llvm namespace
 
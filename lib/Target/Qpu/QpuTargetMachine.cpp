@@ -14,10 +14,25 @@
 #include "QpuTargetMachine.h"
 #include "Qpu.h"
 #include "llvm/PassManager.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Vectorize.h"
 using namespace llvm;
 
+static cl::opt<bool> EnableSPMDVectorize
+                ("qpu-spmd-vectorize", cl::Hidden, cl::init(false),
+                 cl::desc("Vectorize kernels written for one work item so "
+                 "that each QPU runs sixteen of them, one per lane. Only "
+                 "used with -qpu-kernel."));
+
+static cl::opt<std::string> ReportFile(
+  "qpu-report",
+  cl::desc("Write a YAML register pressure and stall report to this file."),
+  cl::value_desc("filename"), cl::init(""));
+
 extern "C" void LLVMInitializeQpuTarget() {
   // Register the target.
   //- Little endian Target Machine
@@ -51,6 +66,14 @@ QpuTargetMachine(const Target &T, StringRef TT,
 
 void QpuelTargetMachine::anchor() { }
 
+void QpuTargetMachine::addAnalysisPasses(PassManagerBase &PM) {
+  // Add first the target-independent BasicTTI pass, then our Qpu pass. This
+  // allows the Qpu pass to delegate to the target independent layer when
+  // appropriate.
+  PM.add(createBasicTargetTransformInfoPass(this));
+  PM.add(createQpuTargetTransformInfoPass(this));
+}
+
 QpuelTargetMachine::
 QpuelTargetMachine(const Target &T, StringRef TT,
                     StringRef CPU, StringRef FS, const TargetOptions &Options,
@@ -62,7 +85,11 @@ namespace {
 class QpuPassConfig : public TargetPassConfig {
 public:
   QpuPassConfig(QpuTargetMachine *TM, PassManagerBase &PM)
-    : TargetPassConfig(TM, PM) {}
+    : TargetPassConfig(TM, PM) {
+    // The machine scheduler picks a strategy per region from the block
+    // frequencies, which it only sees if they are computed right before it.
+    insertPass(&RegisterCoalescerID, &MachineBlockFrequencyInfo::ID);
+  }
 
   QpuTargetMachine &getQpuTargetMachine() const {
     return getTM<QpuTargetMachine>();
@@ -71,6 +98,11 @@ public:
   const QpuSubtarget &getQpuSubtarget() const {
     return *getQpuTargetMachine().getSubtargetImpl();
   } // lbd document - mark - getQpuSubtarget()
+  virtual void addIRPasses();
+  virtual ScheduleDAGInstrs *
+  createMachineScheduler(MachineSchedContext *C) const {
+    return createQpuMachineScheduler(C);
+  }
   virtual bool addInstSelector();
   virtual bool addPreRegAlloc();
   virtual bool addPreEmitPass();
@@ -81,6 +113,22 @@ TargetPassConfig *QpuTargetMachine::createPassConfig(PassManagerBase &PM) {
   return new QpuPassConfig(this, PM);
 } // lbd document - mark - createPassConfig
 
+void QpuPassConfig::addIRPasses() {
+  // Kernels cannot make calls, so flatten them before anything else.
+  if (getQpuSubtarget().isKernelMode()) {
+    addPass(createQpuKernelInlinePass());
+    // With everything inlined, the work-item id calls are all in the kernel.
+    if (EnableSPMDVectorize) {
+      addPass(createLoopSimplifyPass());
+      addPass(createLCSSAPass());
+      // Only the global id of the first lane is passed in, so the other id
+      // queries are left alone and rejected by call lowering.
+      addPass(createSPMDVectorizerPass(16, "get_global_id"));
+    }
+  }
+  TargetPassConfig::addIRPasses();
+}
+
 // Install an instruction selector pass using
 // the ISelDag to gen Qpu code.
 bool QpuPassConfig::addInstSelector() {
@@ -89,9 +137,13 @@ bool QpuPassConfig::addInstSelector() {
 } // lbd document - mark - addInstSelector()
 
 bool QpuPassConfig::addPreRegAlloc() {
-  // $gp is a caller-saved register.
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createQpuModuloSchedulePass(getQpuTargetMachine()));
 
-  addPass(createQpuEmitGPRestorePass(getQpuTargetMachine()));
+  // $gp is a caller-saved register.  Kernels make no calls and never set up
+  // $gp, so there is nothing to restore.
+  if (!getQpuSubtarget().isKernelMode())
+    addPass(createQpuEmitGPRestorePass(getQpuTargetMachine()));
   return true;
 }
 
@@ -102,5 +154,7 @@ bool QpuPassConfig::addPreEmitPass() {
 	QpuTargetMachine &TM = getQpuTargetMachine();
 //	addPass(createQpuNopperPass(TM));
 //	addPass(createQpuDelJmpPass(TM));
+	if (!ReportFile.empty())
+	  addPass(createQpuKernelReportPass(TM, ReportFile));
 	return true;
 }
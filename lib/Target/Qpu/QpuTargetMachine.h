@@ -64,6 +64,9 @@ namespace llvm {
 
     // Pass Pipeline Configuration
     virtual TargetPassConfig *createPassConfig(PassManagerBase &PM);
+
+    /// \brief Register Qpu analysis passes with a pass manager.
+    virtual void addAnalysisPasses(PassManagerBase &PM);
   };
 
 /// QpuelTargetMachine - Qpu32 little endian target machine.
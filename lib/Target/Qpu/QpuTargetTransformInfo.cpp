@@ -0,0 +1,133 @@
+//===-- QpuTargetTransformInfo.cpp - Qpu specific TTI pass ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a TargetTransformInfo analysis pass specific to the
+// Qpu target machine.  A QPU runs every instruction on all sixteen lanes of
+// its registers, and a scalar is lane 0 of a full register, so a branch can
+// only test lane 0 directly if all lanes hold the same value.  This pass
+// tells the divergence analysis which values may differ between lanes, and
+// the inliner and the loop unroller how much code fits in the instruction
+// cache.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "qputti"
+#include "Qpu.h"
+#include "QpuTargetMachine.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/Debug.h"
+using namespace llvm;
+
+// Declare the pass initialization routine locally as target-specific passes
+// don't have a target-wide initialization entry point, and so we rely on the
+// pass constructor initialization.
+namespace llvm {
+void initializeQpuTTIPass(PassRegistry &);
+}
+
+namespace {
+
+class QpuTTI : public ImmutablePass, public TargetTransformInfo {
+  const QpuSubtarget *ST;
+
+public:
+  QpuTTI() : ImmutablePass(ID), ST(0) {
+    llvm_unreachable("This pass cannot be directly constructed");
+  }
+
+  QpuTTI(const QpuTargetMachine *TM)
+      : ImmutablePass(ID), ST(TM->getSubtargetImpl()) {
+    initializeQpuTTIPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual void initializePass() { pushTTIStack(this); }
+
+  virtual void finalizePass() { popTTIStack(); }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    TargetTransformInfo::getAnalysisUsage(AU);
+  }
+
+  /// Pass identification.
+  static char ID;
+
+  /// Provide necessary pointer adjustments for the two base classes.
+  virtual void *getAdjustedAnalysisPointer(const void *ID) {
+    if (ID == &TargetTransformInfo::ID)
+      return (TargetTransformInfo *)this;
+    return this;
+  }
+
+  virtual bool hasBranchDivergence() const;
+
+  virtual bool isSourceOfDivergence(const Value *V) const;
+
+  virtual void getUnrollingPreferences(Loop *L,
+                                       UnrollingPreferences &UP) const;
+
+  virtual unsigned getCodeSizeBudget() const;
+};
+
+} // end anonymous namespace
+
+// The instruction cache shared by the QPUs of a slice holds 4 KB, or 512
+// instructions.  A kernel that outgrows it fetches from memory on every trip
+// around its loops, which costs far more than the loop overhead unrolling
+// removes.
+static const unsigned ICacheInstructions = 512;
+
+INITIALIZE_AG_PASS(QpuTTI, TargetTransformInfo, "qputti",
+                   "Qpu Target Transform Info", true, true, false)
+char QpuTTI::ID = 0;
+
+ImmutablePass *
+llvm::createQpuTargetTransformInfoPass(const QpuTargetMachine *TM) {
+  return new QpuTTI(TM);
+}
+
+bool QpuTTI::hasBranchDivergence() const { return true; }
+
+/// Values computed lane by lane from uniform operands stay uniform.  The
+/// lanes disagree for memory reads, which fill each lane separately, for
+/// scalars taken out of a vector, and for anything a caller or callee
+/// computed.  Kernel arguments come from the uniform stream and are the
+/// same in every lane.
+bool QpuTTI::isSourceOfDivergence(const Value *V) const {
+  if (isa<Argument>(V))
+    return !ST->isKernelMode();
+
+  if (isa<LoadInst>(V) || isa<AtomicRMWInst>(V) ||
+      isa<AtomicCmpXchgInst>(V) || isa<VAArgInst>(V))
+    return true;
+
+  if (isa<ExtractElementInst>(V))
+    return true;
+  if (const BitCastInst *BC = dyn_cast<BitCastInst>(V))
+    return BC->getSrcTy()->isVectorTy() && !BC->getDestTy()->isVectorTy();
+
+  if (isa<CallInst>(V) && !isa<IntrinsicInst>(V))
+    return true;
+
+  return false;
+}
+
+/// Unroll as far as the code size budget allows, partially if need be.
+void QpuTTI::getUnrollingPreferences(Loop *L, UnrollingPreferences &UP) const {
+  UP.Partial = true;
+  UP.Threshold = getCodeSizeBudget();
+}
+
+/// An IR instruction becomes about one and a half QPU instructions once its
+/// operands are moved through the accumulators and the branch delay slots are
+/// filled, so leave that much headroom.
+unsigned QpuTTI::getCodeSizeBudget() const {
+  return ICacheInstructions * 2 / 3;
+}
@@ -19,6 +19,8 @@
 #include "AMDGPU.h"
 #include "AMDGPUTargetMachine.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Target/TargetLowering.h"
 #include "llvm/Target/CostTable.h"
@@ -73,6 +75,8 @@ public:
 
   virtual bool hasBranchDivergence() const;
 
+  virtual bool isSourceOfDivergence(const Value *V) const;
+
   /// @}
 };
 
@@ -88,3 +92,24 @@ llvm::createAMDGPUTargetTransformInfoPass(const AMDGPUTargetMachine *TM) {
 }
 
 bool AMDGPUTTI::hasBranchDivergence() const { return true; }
+
+/// The thread index within the work group differs for every thread of a
+/// wavefront.  Private memory belongs to each thread, and atomics return a
+/// different old value to each thread.
+bool AMDGPUTTI::isSourceOfDivergence(const Value *V) const {
+  if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(V)) {
+    switch (II->getIntrinsicID()) {
+    case Intrinsic::r600_read_tidig_x:
+    case Intrinsic::r600_read_tidig_y:
+    case Intrinsic::r600_read_tidig_z:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  if (const LoadInst *LI = dyn_cast<LoadInst>(V))
+    return LI->getPointerAddressSpace() == AMDGPUAS::PRIVATE_ADDRESS;
+
+  return isa<AtomicRMWInst>(V) || isa<AtomicCmpXchgInst>(V);
+}
@@ -22,6 +22,7 @@
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Target/CodeGenSession.h"
 #include "llvm/Target/TargetMachine.h"
 #include <cassert>
 #include <cstdlib>
@@ -59,6 +60,13 @@ inline LLVMTargetMachineRef wrap(const TargetMachine *P) {
 inline LLVMTargetRef wrap(const Target * P) {
   return reinterpret_cast<LLVMTargetRef>(const_cast<Target*>(P));
 }
+inline CodeGenSession *unwrap(LLVMCodeGenSessionRef P) {
+  return reinterpret_cast<CodeGenSession*>(P);
+}
+inline LLVMCodeGenSessionRef wrap(const CodeGenSession *P) {
+  return reinterpret_cast<LLVMCodeGenSessionRef>(
+    const_cast<CodeGenSession*>(P));
+}
 
 LLVMTargetRef LLVMGetFirstTarget() {
   if(TargetRegistry::begin() == TargetRegistry::end()) {
@@ -196,6 +204,16 @@ void LLVMSetTargetMachineAsmVerbosity(LLVMTargetMachineRef T,
   unwrap(T)->setAsmVerbosityDefault(VerboseAsm);
 }
 
+static TargetMachine::CodeGenFileType
+unwrapFileType(LLVMCodeGenFileType codegen) {
+  switch (codegen) {
+    case LLVMAssemblyFile:
+      return TargetMachine::CGFT_AssemblyFile;
+    default:
+      return TargetMachine::CGFT_ObjectFile;
+  }
+}
+
 static LLVMBool LLVMTargetMachineEmit(LLVMTargetMachineRef T, LLVMModuleRef M,
   formatted_raw_ostream &OS, LLVMCodeGenFileType codegen, char **ErrorMessage) {
   TargetMachine* TM = unwrap(T);
@@ -214,15 +232,7 @@ static LLVMBool LLVMTargetMachineEmit(LLVMTargetMachineRef T, LLVMModuleRef M,
   }
   pass.add(new DataLayout(*td));
 
-  TargetMachine::CodeGenFileType ft;
-  switch (codegen) {
-    case LLVMAssemblyFile:
-      ft = TargetMachine::CGFT_AssemblyFile;
-      break;
-    default:
-      ft = TargetMachine::CGFT_ObjectFile;
-      break;
-  }
+  TargetMachine::CodeGenFileType ft = unwrapFileType(codegen);
   if (TM->addPassesToEmitFile(pass, OS, ft)) {
     error = "TargetMachine can't emit a file of this type";
     *ErrorMessage = strdup(error.c_str());
@@ -264,6 +274,27 @@ LLVMBool LLVMTargetMachineEmitToMemoryBuffer(LLVMTargetMachineRef T,
   return Result;
 }
 
+LLVMCodeGenSessionRef LLVMCreateCodeGenSession(LLVMTargetMachineRef T,
+  LLVMCodeGenFileType codegen, char **ErrorMessage) {
+  std::string error;
+  CodeGenSession *S =
+    CodeGenSession::create(*unwrap(T), unwrapFileType(codegen), error);
+  if (!S)
+    *ErrorMessage = strdup(error.c_str());
+  return wrap(S);
+}
+
+LLVMMemoryBufferRef LLVMCodeGenSessionEmitToMemoryBuffer(
+  LLVMCodeGenSessionRef S, LLVMModuleRef M) {
+  StringRef Data = unwrap(S)->emit(*unwrap(M));
+  return LLVMCreateMemoryBufferWithMemoryRangeCopy(Data.data(), Data.size(),
+                                                   "");
+}
+
+void LLVMDisposeCodeGenSession(LLVMCodeGenSessionRef S) {
+  delete unwrap(S);
+}
+
 char *LLVMGetDefaultTargetTriple(void) {
   return strdup(sys::getDefaultTargetTriple().c_str());
 }
@@ -15,10 +15,13 @@
 
 #define DEBUG_TYPE "inline"
 #include "llvm/Transforms/IPO/InlinerPass.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/CodeMetrics.h"
 #include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -36,6 +39,8 @@ STATISTIC(NumInlined, "Number of functions inlined");
 STATISTIC(NumCallsDeleted, "Number of call sites deleted, not inlined");
 STATISTIC(NumDeleted, "Number of functions deleted because all callers found");
 STATISTIC(NumMergedAllocas, "Number of allocas merged together");
+STATISTIC(NumOverBudget, "Number of calls not inlined to stay within the "
+                         "target's code size budget");
 
 // This weirdly named statistic tracks the number of times that, when attempting
 // to inline a function A into B, we analyze the callers of B in order to see
@@ -65,6 +70,7 @@ Inliner::Inliner(char &ID, int Threshold, bool InsertLifetime)
 /// the call graph.  If the derived class implements this method, it should
 /// always explicitly call the implementation here.
 void Inliner::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<TargetTransformInfo>();
   CallGraphSCCPass::getAnalysisUsage(AU);
 }
 
@@ -380,6 +386,21 @@ bool Inliner::shouldInline(CallSite CS) {
   return true;
 }
 
+/// getEstimatedSize - Return the size of F as the code size budget counts it,
+/// measuring it the first time it is asked for.
+static unsigned getEstimatedSize(Function *F,
+                                 DenseMap<Function*, unsigned> &Sizes,
+                                 const TargetTransformInfo &TTI) {
+  DenseMap<Function*, unsigned>::iterator I = Sizes.find(F);
+  if (I != Sizes.end())
+    return I->second;
+
+  CodeMetrics Metrics;
+  Metrics.analyzeFunction(F, TTI);
+  Sizes[F] = Metrics.NumInsts;
+  return Metrics.NumInsts;
+}
+
 /// InlineHistoryIncludes - Return true if the specified inline history ID
 /// indicates an inline history that includes the specified function.
 static bool InlineHistoryIncludes(Function *F, int InlineHistoryID,
@@ -398,6 +419,12 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
   CallGraph &CG = getAnalysis<CallGraph>();
   const DataLayout *TD = getAnalysisIfAvailable<DataLayout>();
   const TargetLibraryInfo *TLI = getAnalysisIfAvailable<TargetLibraryInfo>();
+  const TargetTransformInfo &TTI = getAnalysis<TargetTransformInfo>();
+
+  // If the target limits the size of a function, keep an estimate of the
+  // size of each caller, grown by the size of each callee inlined into it.
+  unsigned CodeSizeBudget = TTI.getCodeSizeBudget();
+  DenseMap<Function*, unsigned> EstimatedSizes;
 
   SmallPtrSet<Function*, 8> SCCFunctions;
   DEBUG(dbgs() << "Inliner visiting SCC:");
@@ -503,11 +530,30 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
         if (!shouldInline(CS))
           continue;
 
+        // Don't grow the caller past the code size budget, unless the callee
+        // has to be inlined.
+        unsigned NewCallerSize = 0;
+        if (CodeSizeBudget) {
+          unsigned CallerSize = getEstimatedSize(Caller, EstimatedSizes, TTI);
+          unsigned CalleeSize = getEstimatedSize(Callee, EstimatedSizes, TTI);
+          NewCallerSize = CallerSize + CalleeSize;
+          if (NewCallerSize > CodeSizeBudget &&
+              !Callee->hasFnAttribute(Attribute::AlwaysInline)) {
+            DEBUG(dbgs() << "    NOT Inlining: size " << CallerSize << " + "
+                  << CalleeSize << " > budget " << CodeSizeBudget
+                  << ", Call: " << *CS.getInstruction() << '\n');
+            ++NumOverBudget;
+            continue;
+          }
+        }
+
         // Attempt to inline the function.
         if (!InlineCallIfPossible(CS, InlineInfo, InlinedArrayAllocas,
                                   InlineHistoryID, InsertLifetime, TD))
           continue;
         ++NumInlined;
+        if (CodeSizeBudget)
+          EstimatedSizes[Caller] = NewCallerSize;
         
         // If inlining this function gave us any new call sites, throw them
         // onto our worklist to process.  They are useful inline candidates.
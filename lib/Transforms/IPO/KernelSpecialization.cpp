@@ -0,0 +1,332 @@
+//===-- KernelSpecialization.cpp - Clone functions for constant arguments -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass clones a function for each distinct tuple of constant arguments
+// its direct call sites pass, when the constants let enough of the body fold
+// to pay for the copy.  The calls with that tuple are redirected to the clone,
+// in which the arguments are replaced by the constants; the rest of the
+// pipeline (IPSCCP, dead argument elimination, instcombine, the loop passes)
+// then folds strides, sizes and trip counts.  IPConstantPropagation only does
+// this when every call site agrees.
+//
+// The cost model:
+//  - A clone costs the number of instructions in the function.
+//  - The benefit of a tuple is found by folding the function with the
+//    constants substituted: an instruction that folds counts 2, one that only
+//    gains a constant operand (a multiply by a stride, a compare against a
+//    trip count) counts 1, and both are scaled by a guess of how often their
+//    loop runs.
+//  - That benefit is multiplied by how often the calls with the tuple run,
+//    from block frequency (and so from a profile, when the branch weights
+//    come from one), relative to the entry of their callers.
+// A tuple is specialized when its benefit reaches -specialize-threshold
+// percent of the cost.  At most -specialize-max-clones tuples, the most
+// profitable first, are cloned per function.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "specialize-kernels"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <limits>
+using namespace llvm;
+
+STATISTIC(NumSpecialized, "Number of specialized clones created");
+STATISTIC(NumCallsRedirected, "Number of calls redirected to a clone");
+
+static cl::opt<unsigned>
+SpecializeThreshold("specialize-threshold", cl::Hidden, cl::init(25),
+                    cl::desc("Benefit, as a percentage of the function size, "
+                             "a constant argument tuple needs to be cloned "
+                             "for (default = 25)"));
+
+static cl::opt<unsigned>
+SpecializeMaxClones("specialize-max-clones", cl::Hidden, cl::init(4),
+                    cl::desc("Maximum number of specialized clones of one "
+                             "function (default = 4)"));
+
+// Iterations assumed for each loop around an instruction, up to three deep.
+static const uint64_t LoopIterationsGuess = 8;
+static const unsigned MaxLoopDepth = 3;
+
+// Products of benefit, frequency and size clamp at the largest uint64_t
+// instead of wrapping: block frequencies in hot loops can use most of the 64
+// bits already.
+static uint64_t saturatingAdd(uint64_t A, uint64_t B) {
+  uint64_t Max = std::numeric_limits<uint64_t>::max();
+  return A > Max - B ? Max : A + B;
+}
+
+static uint64_t saturatingMultiply(uint64_t A, uint64_t B) {
+  uint64_t Max = std::numeric_limits<uint64_t>::max();
+  return A && B > Max / A ? Max : A * B;
+}
+
+namespace {
+  /// SpecializationCandidate - The calls of a function that pass the same
+  /// constants, and what cloning for them would gain.
+  struct SpecializationCandidate {
+    std::vector<Constant*> Args;    // Null for an argument that varies.
+    SmallVector<CallSite, 4> Calls;
+    uint64_t CallFreq;              // In units of BlockFrequency entry freq.
+    uint64_t Benefit;
+    unsigned Order;                 // For a deterministic sort.
+
+    SpecializationCandidate() : CallFreq(0), Benefit(0), Order(0) {}
+  };
+
+  /// KernelSpecialization - The constant argument specialization pass.
+  ///
+  struct KernelSpecialization : public ModulePass {
+    static char ID; // Pass identification, replacement for typeid
+    KernelSpecialization() : ModulePass(ID), TD(0) {
+      initializeKernelSpecializationPass(*PassRegistry::getPassRegistry());
+    }
+
+    bool runOnModule(Module &M);
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      // LoopInfo goes first: the on-the-fly manager for this pass cannot be
+      // asked for an analysis it already runs for BlockFrequencyInfo.
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<BlockFrequencyInfo>();
+    }
+
+  private:
+    const DataLayout *TD;
+
+    bool specializeFunction(Function &F);
+    uint64_t computeBenefit(Function &F, const std::vector<Constant*> &Args,
+                            LoopInfo &LI);
+  };
+
+  bool isMoreProfitable(const SpecializationCandidate *A,
+                        const SpecializationCandidate *B) {
+    uint64_t WA = saturatingMultiply(A->Benefit, A->CallFreq);
+    uint64_t WB = saturatingMultiply(B->Benefit, B->CallFreq);
+    if (WA != WB)
+      return WA > WB;
+    return A->Order < B->Order;
+  }
+}
+
+char KernelSpecialization::ID = 0;
+INITIALIZE_PASS_BEGIN(KernelSpecialization, "specialize-kernels",
+                "Specialize functions for constant arguments", false, false)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfo)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_END(KernelSpecialization, "specialize-kernels",
+                "Specialize functions for constant arguments", false, false)
+
+ModulePass *llvm::createKernelSpecializationPass() {
+  return new KernelSpecialization();
+}
+
+bool KernelSpecialization::runOnModule(Module &M) {
+  TD = getAnalysisIfAvailable<DataLayout>();
+
+  // Clones are added to the module as we go, so pick the functions first.
+  SmallVector<Function*, 16> Worklist;
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    if (!I->isDeclaration() && !I->mayBeOverridden() && !I->isVarArg() &&
+        !I->hasFnAttribute(Attribute::NoDuplicate))
+      Worklist.push_back(I);
+
+  bool Changed = false;
+  for (unsigned i = 0, e = Worklist.size(); i != e; ++i)
+    Changed |= specializeFunction(*Worklist[i]);
+  return Changed;
+}
+
+/// specializeFunction - Group the direct calls of F by the constants they
+/// pass, and clone F for the groups that pay off.
+bool KernelSpecialization::specializeFunction(Function &F) {
+  SmallVector<SpecializationCandidate, 4> Candidates;
+  // The block and candidate of each call, by caller, so that the block
+  // frequencies of a caller are computed once however many calls it makes.
+  typedef SmallVector<std::pair<BasicBlock*, unsigned>, 4> CallBlockList;
+  MapVector<Function*, CallBlockList> CallsByCaller;
+  for (Value::use_iterator UI = F.use_begin(), E = F.use_end(); UI != E; ++UI) {
+    CallSite CS(*UI);
+    if (!CS || !CS.isCallee(UI) || CS.arg_size() != F.arg_size())
+      continue;
+
+    std::vector<Constant*> Args;
+    bool AnyConstant = false;
+    for (CallSite::arg_iterator AI = CS.arg_begin(), AE = CS.arg_end();
+         AI != AE; ++AI) {
+      Constant *C = 0;
+      if (isa<ConstantInt>(*AI) || isa<ConstantFP>(*AI))
+        C = cast<Constant>(*AI);
+      AnyConstant |= C != 0;
+      Args.push_back(C);
+    }
+    if (!AnyConstant)
+      continue;
+
+    unsigned i = 0, e = Candidates.size();
+    while (i != e && Candidates[i].Args != Args)
+      ++i;
+    if (i == e) {
+      Candidates.push_back(SpecializationCandidate());
+      Candidates.back().Args = Args;
+      Candidates.back().Order = i;
+    }
+
+    Candidates[i].Calls.push_back(CS);
+    BasicBlock *CallBB = CS.getInstruction()->getParent();
+    CallsByCaller[CallBB->getParent()].push_back(std::make_pair(CallBB, i));
+  }
+  if (Candidates.empty())
+    return false;
+
+  // Weigh each call by how often it runs relative to its caller's entry.
+  for (MapVector<Function*, CallBlockList>::iterator
+       CI = CallsByCaller.begin(), CE = CallsByCaller.end(); CI != CE; ++CI) {
+    BlockFrequencyInfo &BFI = getAnalysis<BlockFrequencyInfo>(*CI->first);
+    for (unsigned c = 0, ce = CI->second.size(); c != ce; ++c) {
+      uint64_t &CallFreq = Candidates[CI->second[c].second].CallFreq;
+      CallFreq = saturatingAdd(
+        CallFreq, BFI.getBlockFreq(CI->second[c].first).getFrequency());
+    }
+  }
+
+  uint64_t Size = 0;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    Size += BB->size();
+
+  LoopInfo &LI = getAnalysis<LoopInfo>(F);
+  SmallVector<SpecializationCandidate*, 4> Profitable;
+  for (unsigned i = 0, e = Candidates.size(); i != e; ++i) {
+    SpecializationCandidate &SC = Candidates[i];
+    SC.Benefit = computeBenefit(F, SC.Args, LI);
+    uint64_t Weighted =
+      saturatingMultiply(saturatingMultiply(SC.Benefit, SC.CallFreq), 100);
+    uint64_t Cost =
+      saturatingMultiply(saturatingMultiply(Size, SpecializeThreshold),
+                         BlockFrequency::getEntryFrequency());
+    DEBUG(dbgs() << "SPECIALIZE: " << F.getName() << " tuple " << i
+                 << ": benefit " << SC.Benefit << " x freq " << SC.CallFreq
+                 << ", size " << Size << '\n');
+    if (SC.Benefit && Weighted >= Cost)
+      Profitable.push_back(&SC);
+  }
+
+  std::sort(Profitable.begin(), Profitable.end(), isMoreProfitable);
+  if (Profitable.size() > SpecializeMaxClones)
+    Profitable.resize(SpecializeMaxClones);
+
+  for (unsigned i = 0, e = Profitable.size(); i != e; ++i) {
+    SpecializationCandidate &SC = *Profitable[i];
+
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(&F, VMap, /*ModuleLevelChanges=*/false);
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setName(F.getName() + ".spec");
+    F.getParent()->getFunctionList().push_back(Clone);
+
+    // Keep the arguments; dead argument elimination removes them once the
+    // calls are all redirected.
+    Function::arg_iterator AI = Clone->arg_begin();
+    for (unsigned a = 0, ae = SC.Args.size(); a != ae; ++a, ++AI)
+      if (SC.Args[a])
+        AI->replaceAllUsesWith(SC.Args[a]);
+
+    for (unsigned c = 0, ce = SC.Calls.size(); c != ce; ++c)
+      SC.Calls[c].setCalledFunction(Clone);
+
+    DEBUG(dbgs() << "SPECIALIZE: cloned " << Clone->getName() << " for "
+                 << SC.Calls.size() << " calls\n");
+    ++NumSpecialized;
+    NumCallsRedirected += SC.Calls.size();
+  }
+
+  return !Profitable.empty();
+}
+
+/// computeBenefit - Fold F as if its arguments were the non-null constants of
+/// Args, and weigh the instructions that fold or gain a constant operand.
+uint64_t
+KernelSpecialization::computeBenefit(Function &F,
+                                     const std::vector<Constant*> &Args,
+                                     LoopInfo &LI) {
+  DenseMap<Value*, Constant*> Known;
+  Function::arg_iterator AI = F.arg_begin();
+  for (unsigned i = 0, e = Args.size(); i != e; ++i, ++AI)
+    if (Args[i])
+      Known[AI] = Args[i];
+
+  uint64_t Benefit = 0;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    uint64_t Weight = 1;
+    for (unsigned d = 0, de = std::min(LI.getLoopDepth(BB), MaxLoopDepth);
+         d != de; ++d)
+      Weight *= LoopIterationsGuess;
+
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      SmallVector<Constant*, 4> Ops;
+      bool AnyKnown = false, AllConstant = true;
+      for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+           OI != OE; ++OI) {
+        Constant *C = dyn_cast<Constant>(*OI);
+        if (!C) {
+          C = Known.lookup(*OI);
+          AnyKnown |= C != 0;
+        }
+        AllConstant &= C != 0;
+        Ops.push_back(C);
+      }
+      if (!AnyKnown)
+        continue;
+
+      // A branch or switch on a known condition folds away.  Anything else
+      // that is not a plain computation at most gains a constant operand.
+      if (isa<BranchInst>(I) || isa<SwitchInst>(I)) {
+        Benefit += (Ops[0] ? 2 : 1) * Weight;
+        continue;
+      }
+      if (isa<TerminatorInst>(I) || isa<PHINode>(I) ||
+          I->mayReadFromMemory() || I->mayHaveSideEffects() || !AllConstant) {
+        Benefit += Weight;
+        continue;
+      }
+
+      Constant *C;
+      if (CmpInst *CI = dyn_cast<CmpInst>(I))
+        C = ConstantFoldCompareInstOperands(CI->getPredicate(), Ops[0], Ops[1],
+                                            TD);
+      else
+        C = ConstantFoldInstOperands(I->getOpcode(), I->getType(), Ops, TD);
+      if (C) {
+        Known[I] = C;
+        Benefit += 2 * Weight;
+      } else {
+        Benefit += Weight;
+      }
+    }
+  }
+  return Benefit;
+}
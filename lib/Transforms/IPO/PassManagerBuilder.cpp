@@ -58,6 +58,11 @@ static cl::opt<bool>
 RunLoopRerolling("reroll-loops", cl::Hidden,
                  cl::desc("Run the loop rerolling pass"));
 
+static cl::opt<bool>
+RunKernelSpecialization("enable-kernel-specialization", cl::Hidden,
+  cl::desc("Clone functions for the constant arguments of their calls before "
+           "IPSCCP"));
+
 PassManagerBuilder::PassManagerBuilder() {
     OptLevel = 2;
     SizeLevel = 0;
@@ -158,6 +163,8 @@ void PassManagerBuilder::populateModulePassManager(PassManagerBase &MPM) {
 
     MPM.add(createGlobalOptimizerPass());     // Optimize out global vars
 
+    if (RunKernelSpecialization)
+      MPM.add(createKernelSpecializationPass()); // Clone for constant args
     MPM.add(createIPSCCPPass());              // IP SCCP
     MPM.add(createDeadArgEliminationPass());  // Dead argument elimination
 
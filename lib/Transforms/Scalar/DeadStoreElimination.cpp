@@ -10,8 +10,9 @@
 // This file implements a trivial dead store elimination that only considers
 // basic-block local redundant stores.
 //
-// FIXME: This should eventually be extended to be a post-dominator tree
-// traversal.  Doing so would be pretty trivial.
+// With -enable-dse-memoryssa the overwrites are found on the memory SSA form
+// instead, walking down from each store to the writes that kill it in later
+// blocks; the post-dominator tree proves that every path hits one of them.
 //
 //===----------------------------------------------------------------------===//
 
@@ -19,12 +20,15 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
@@ -33,6 +37,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -40,37 +45,60 @@ using namespace llvm;
 
 STATISTIC(NumFastStores, "Number of stores deleted");
 STATISTIC(NumFastOther , "Number of other instrs removed");
+STATISTIC(NumCrossBlock, "Number of stores deleted by a later block's write");
+
+static cl::opt<bool>
+EnableMemorySSA("enable-dse-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Find dead stores using MemorySSA instead of "
+                         "MemoryDependenceAnalysis (no free handling)"));
+
+// Maximum number of accesses visited below one store.
+static cl::opt<unsigned>
+MemorySSAScanLimit("dse-memoryssa-scan-limit", cl::Hidden, cl::init(250),
+                   cl::desc("Max accesses walked below a store "
+                            "(default = 250)"));
 
 namespace {
   struct DSE : public FunctionPass {
     AliasAnalysis *AA;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
+    PostDominatorTree *PDT;
     const TargetLibraryInfo *TLI;
 
     static char ID; // Pass identification, replacement for typeid
-    DSE() : FunctionPass(ID), AA(0), MD(0), DT(0) {
+    DSE() : FunctionPass(ID), AA(0), MD(0), MSSA(0), DT(0), PDT(0) {
       initializeDSEPass(*PassRegistry::getPassRegistry());
     }
 
     virtual bool runOnFunction(Function &F) {
       AA = &getAnalysis<AliasAnalysis>();
-      MD = &getAnalysis<MemoryDependenceAnalysis>();
       DT = &getAnalysis<DominatorTree>();
       TLI = AA->getTargetLibraryInfo();
+      if (EnableMemorySSA) {
+        MSSA = &getAnalysis<MemorySSA>();
+        PDT = &getAnalysis<PostDominatorTree>();
+      } else {
+        MD = &getAnalysis<MemoryDependenceAnalysis>();
+      }
 
       bool Changed = false;
       for (Function::iterator I = F.begin(), E = F.end(); I != E; ++I)
         // Only check non-dead blocks.  Dead blocks may have strange pointer
         // cycles that will confuse alias analysis.
         if (DT->isReachableFromEntry(I))
-          Changed |= runOnBasicBlock(*I);
+          Changed |= MSSA ? runOnBasicBlockWithMemorySSA(*I)
+                          : runOnBasicBlock(*I);
 
-      AA = 0; MD = 0; DT = 0;
+      AA = 0; MD = 0; MSSA = 0; DT = 0; PDT = 0;
       return Changed;
     }
 
     bool runOnBasicBlock(BasicBlock &BB);
+    bool runOnBasicBlockWithMemorySSA(BasicBlock &BB);
+    Instruction *findKillerWithMemorySSA(Instruction *Inst,
+                                         const AliasAnalysis::Location &Loc);
     bool HandleFree(CallInst *F);
     bool handleEndBlock(BasicBlock &BB);
     void RemoveAccessedObjects(const AliasAnalysis::Location &LoadedLoc,
@@ -80,7 +108,12 @@ namespace {
       AU.setPreservesCFG();
       AU.addRequired<DominatorTree>();
       AU.addRequired<AliasAnalysis>();
-      AU.addRequired<MemoryDependenceAnalysis>();
+      if (EnableMemorySSA) {
+        AU.addRequired<MemorySSA>();
+        AU.addRequired<PostDominatorTree>();
+      } else {
+        AU.addRequired<MemoryDependenceAnalysis>();
+      }
       AU.addPreserved<AliasAnalysis>();
       AU.addPreserved<DominatorTree>();
       AU.addPreserved<MemoryDependenceAnalysis>();
@@ -92,6 +125,8 @@ char DSE::ID = 0;
 INITIALIZE_PASS_BEGIN(DSE, "dse", "Dead Store Elimination", false, false)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
 INITIALIZE_PASS_END(DSE, "dse", "Dead Store Elimination", false, false)
 
@@ -108,7 +143,8 @@ FunctionPass *llvm::createDeadStoreEliminationPass() { return new DSE(); }
 /// If ValueSet is non-null, remove any deleted instructions from it as well.
 ///
 static void DeleteDeadInstruction(Instruction *I,
-                                  MemoryDependenceAnalysis &MD,
+                                  MemoryDependenceAnalysis *MD,
+                                  MemorySSA *MSSA,
                                   const TargetLibraryInfo *TLI,
                                   SmallSetVector<Value*, 16> *ValueSet = 0) {
   SmallVector<Instruction*, 32> NowDeadInsts;
@@ -124,7 +160,8 @@ static void DeleteDeadInstruction(Instruction *I,
     // This instruction is dead, zap it, in stages.  Start by removing it from
     // MemDep, which needs to know the operands and needs it to be in the
     // function.
-    MD.removeInstruction(DeadInst);
+    if (MD) MD->removeInstruction(DeadInst);
+    if (MSSA) MSSA->removeMemoryAccess(DeadInst);
 
     for (unsigned op = 0, e = DeadInst->getNumOperands(); op != e; ++op) {
       Value *Op = DeadInst->getOperand(op);
@@ -525,7 +562,7 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
           // in case we need it.
           WeakVH NextInst(BBI);
 
-          DeleteDeadInstruction(SI, *MD, TLI);
+          DeleteDeadInstruction(SI, MD, MSSA, TLI);
 
           if (NextInst == 0)  // Next instruction deleted.
             BBI = BB.begin();
@@ -572,7 +609,7 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
                 << *DepWrite << "\n  KILLER: " << *Inst << '\n');
 
           // Delete the store and now-dead instructions that feed it.
-          DeleteDeadInstruction(DepWrite, *MD, TLI);
+          DeleteDeadInstruction(DepWrite, MD, MSSA, TLI);
           ++NumFastStores;
           MadeChange = true;
 
@@ -636,6 +673,133 @@ bool DSE::runOnBasicBlock(BasicBlock &BB) {
   return MadeChange;
 }
 
+/// runOnBasicBlockWithMemorySSA - The memory SSA version of runOnBasicBlock.
+/// Rather than searching up from each write for the stores it overwrites,
+/// each store searches down for the writes that overwrite it, which may be
+/// in any later block.  Frees are not handled.
+bool DSE::runOnBasicBlockWithMemorySSA(BasicBlock &BB) {
+  bool MadeChange = false;
+
+  for (BasicBlock::iterator BBI = BB.begin(), BBE = BB.end(); BBI != BBE; ) {
+    Instruction *Inst = BBI++;
+
+    if (!hasMemoryWrite(Inst, TLI) || !isRemovable(Inst))
+      continue;
+
+    MemoryUseOrDef *MA = MSSA->getMemoryAccess(Inst);
+    if (!MA)
+      continue;
+
+    // If we're storing the same value back to a pointer that we loaded from,
+    // and both see the same memory state, then the store can be removed.
+    if (StoreInst *SI = dyn_cast<StoreInst>(Inst)) {
+      if (LoadInst *DepLoad = dyn_cast<LoadInst>(SI->getValueOperand())) {
+        MemoryUseOrDef *LoadMA = MSSA->getMemoryAccess(DepLoad);
+        if (LoadMA && isa<MemoryUse>(LoadMA) &&
+            SI->getPointerOperand() == DepLoad->getPointerOperand() &&
+            LoadMA->getDefiningAccess() == MA->getDefiningAccess()) {
+          DEBUG(dbgs() << "DSE: Remove Store Of Load from same pointer:\n  "
+                       << "LOAD: " << *DepLoad << "\n  STORE: " << *SI << '\n');
+
+          DeleteDeadInstruction(SI, MD, MSSA, TLI);
+          ++NumFastStores;
+          MadeChange = true;
+          continue;
+        }
+      }
+    }
+
+    // Figure out what location is being stored to.
+    AliasAnalysis::Location Loc = getLocForWrite(Inst, *AA);
+
+    // If we didn't get a useful location, fail.
+    if (Loc.Ptr == 0)
+      continue;
+
+    Instruction *Killer = findKillerWithMemorySSA(Inst, Loc);
+    if (!Killer)
+      continue;
+
+    DEBUG(dbgs() << "DSE: Remove Dead Store:\n  DEAD: "
+          << *Inst << "\n  KILLER: " << *Killer << '\n');
+
+    if (Killer->getParent() != &BB)
+      ++NumCrossBlock;
+    DeleteDeadInstruction(Inst, MD, MSSA, TLI);
+    ++NumFastStores;
+    MadeChange = true;
+  }
+
+  // If this block ends in a return, unwind, or unreachable, all allocas are
+  // dead at its end, which means stores to them are also dead.
+  if (BB.getTerminator()->getNumSuccessors() == 0)
+    MadeChange |= handleEndBlock(BB);
+
+  return MadeChange;
+}
+
+/// findKillerWithMemorySSA - Walk down the memory SSA users of 'Inst', which
+/// writes 'Loc', stopping at the writes that completely overwrite it.  If no
+/// access on the way may read 'Loc', return one of those writes that
+/// post-dominates 'Inst', so every path out of 'Inst' overwrites the memory
+/// before it is read.  Otherwise return null.
+///
+/// Only writes that 'Inst' dominates may overwrite it: a path from 'Inst' to
+/// them cannot go around a loop that redefines the pointers, short of coming
+/// back to 'Inst', which gives up.
+Instruction *
+DSE::findKillerWithMemorySSA(Instruction *Inst,
+                             const AliasAnalysis::Location &Loc) {
+  MemoryAccess *Def = MSSA->getMemoryAccess(Inst);
+  SmallVector<MemoryAccess *, 16> Worklist(Def->user_begin(),
+                                           Def->user_end());
+  SmallPtrSet<MemoryAccess *, 16> Visited;
+  Instruction *Killer = 0;
+  unsigned NumVisited = 0;
+
+  while (!Worklist.empty()) {
+    MemoryAccess *MA = Worklist.pop_back_val();
+    if (MA == Def)
+      return 0;
+    if (!Visited.insert(MA))
+      continue;
+    if (++NumVisited > MemorySSAScanLimit)
+      return 0;
+
+    // Phis and the defs of erased instructions pass the state through.
+    Instruction *I = 0;
+    if (MemoryUseOrDef *UseOrDef = dyn_cast<MemoryUseOrDef>(MA))
+      I = UseOrDef->getMemoryInst();
+
+    if (I && isa<MemoryUse>(MA)) {
+      if (AA->getModRefInfo(I, Loc) & AliasAnalysis::Ref)
+        return 0;
+      continue;
+    }
+
+    if (I && hasMemoryWrite(I, TLI) && DT->dominates(Inst, I)) {
+      AliasAnalysis::Location KillLoc = getLocForWrite(I, *AA);
+      int64_t InstOffset, KillOffset;
+      if (KillLoc.Ptr && !isPossibleSelfRead(I, KillLoc, Inst, *AA) &&
+          isOverwrite(KillLoc, Loc, *AA, InstOffset, KillOffset) ==
+            OverwriteComplete) {
+        // A later write in the same block post-dominates 'Inst'.
+        if (!Killer && (I->getParent() == Inst->getParent() ||
+                        PDT->dominates(I->getParent(), Inst->getParent())))
+          Killer = I;
+        continue;
+      }
+    }
+
+    if (I && (AA->getModRefInfo(I, Loc) & AliasAnalysis::Ref))
+      return 0;
+
+    Worklist.append(MA->user_begin(), MA->user_end());
+  }
+
+  return Killer;
+}
+
 /// Find all blocks that will unconditionally lead to the block BB and append
 /// them to F.
 static void FindUnconditionalPreds(SmallVectorImpl<BasicBlock *> &Blocks,
@@ -682,7 +846,7 @@ bool DSE::HandleFree(CallInst *F) {
       Instruction *Next = llvm::next(BasicBlock::iterator(Dependency));
 
       // DCE instructions only used to calculate that store
-      DeleteDeadInstruction(Dependency, *MD, TLI);
+      DeleteDeadInstruction(Dependency, MD, MSSA, TLI);
       ++NumFastStores;
       MadeChange = true;
 
@@ -782,7 +946,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
               dbgs() << '\n');
 
         // DCE instructions only used to calculate that store.
-        DeleteDeadInstruction(Dead, *MD, TLI, &DeadStackObjects);
+        DeleteDeadInstruction(Dead, MD, MSSA, TLI, &DeadStackObjects);
         ++NumFastStores;
         MadeChange = true;
         continue;
@@ -792,7 +956,7 @@ bool DSE::handleEndBlock(BasicBlock &BB) {
     // Remove any dead non-memory-mutating instructions.
     if (isInstructionTriviallyDead(BBI, TLI)) {
       Instruction *Inst = BBI++;
-      DeleteDeadInstruction(Inst, *MD, TLI, &DeadStackObjects);
+      DeleteDeadInstruction(Inst, MD, MSSA, TLI, &DeadStackObjects);
       ++NumFastOther;
       MadeChange = true;
       continue;
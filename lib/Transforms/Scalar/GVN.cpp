@@ -31,6 +31,7 @@
 #include "llvm/Analysis/Loads.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/MemorySSA.h"
 #include "llvm/Analysis/PHITransAddr.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Assembly/Writer.h"
@@ -62,6 +63,10 @@ STATISTIC(NumPRELoad,   "Number of loads PRE'd");
 static cl::opt<bool> EnablePRE("enable-pre",
                                cl::init(true), cl::Hidden);
 static cl::opt<bool> EnableLoadPRE("enable-load-pre", cl::init(true));
+static cl::opt<bool>
+EnableMemorySSA("enable-gvn-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Eliminate loads using MemorySSA instead of "
+                         "MemoryDependenceAnalysis (no load PRE)"));
 
 // Maximum allowed recursion depth.
 static cl::opt<uint32_t>
@@ -107,6 +112,7 @@ namespace {
     DenseMap<Expression, uint32_t> expressionNumbering;
     AliasAnalysis *AA;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
 
     uint32_t nextValueNumber;
@@ -116,9 +122,10 @@ namespace {
                                      CmpInst::Predicate Predicate,
                                      Value *LHS, Value *RHS);
     Expression create_extractvalue_expression(ExtractValueInst* EI);
+    Expression create_load_expression(LoadInst *LI);
     uint32_t lookup_or_add_call(CallInst* C);
   public:
-    ValueTable() : nextValueNumber(1) { }
+    ValueTable() : MSSA(0), nextValueNumber(1) { }
     uint32_t lookup_or_add(Value *V);
     uint32_t lookup(Value *V) const;
     uint32_t lookup_or_add_cmp(unsigned Opcode, CmpInst::Predicate Pred,
@@ -129,6 +136,7 @@ namespace {
     void setAliasAnalysis(AliasAnalysis* A) { AA = A; }
     AliasAnalysis *getAliasAnalysis() const { return AA; }
     void setMemDep(MemoryDependenceAnalysis* M) { MD = M; }
+    void setMemorySSA(MemorySSA *M) { MSSA = M; }
     void setDomTree(DominatorTree* D) { DT = D; }
     uint32_t getNextUnusedValueNumber() { return nextValueNumber; }
     void verifyRemoved(const Value *) const;
@@ -265,6 +273,18 @@ Expression ValueTable::create_extractvalue_expression(ExtractValueInst *EI) {
   return e;
 }
 
+/// create_load_expression - With memory SSA, two loads of the same type from
+/// the same pointer have the same value if no store can have changed it in
+/// between, which is the case when they see the same clobbering access.
+Expression ValueTable::create_load_expression(LoadInst *LI) {
+  Expression e;
+  e.type = LI->getType();
+  e.opcode = LI->getOpcode();
+  e.varargs.push_back(lookup_or_add(LI->getPointerOperand()));
+  e.varargs.push_back(MSSA->getClobberingMemoryAccess(LI)->getID());
+  return e;
+}
+
 //===----------------------------------------------------------------------===//
 //                     ValueTable External Functions
 //===----------------------------------------------------------------------===//
@@ -283,12 +303,21 @@ uint32_t ValueTable::lookup_or_add_call(CallInst *C) {
     return e;
   } else if (AA->onlyReadsMemory(C)) {
     Expression exp = create_expression(C);
+    // With memory SSA, like loads, calls that see the same memory state
+    // compute the same value.
+    bool SeesMemoryState = MSSA && MSSA->getMemoryAccess(C);
+    if (SeesMemoryState)
+      exp.varargs.push_back(MSSA->getClobberingMemoryAccess(C)->getID());
     uint32_t &e = expressionNumbering[exp];
     if (!e) {
       e = nextValueNumber++;
       valueNumbering[C] = e;
       return e;
     }
+    if (SeesMemoryState) {
+      valueNumbering[C] = e;
+      return e;
+    }
     if (!MD) {
       e = nextValueNumber++;
       valueNumbering[C] = e;
@@ -443,6 +472,14 @@ uint32_t ValueTable::lookup_or_add(Value *V) {
     case Instruction::ExtractValue:
       exp = create_extractvalue_expression(cast<ExtractValueInst>(I));
       break;
+    case Instruction::Load:
+      if (MSSA && cast<LoadInst>(I)->isSimple() &&
+          MSSA->getMemoryAccess(I)) {
+        exp = create_load_expression(cast<LoadInst>(I));
+        break;
+      }
+      valueNumbering[V] = nextValueNumber;
+      return nextValueNumber++;
     default:
       valueNumbering[V] = nextValueNumber;
       return nextValueNumber++;
@@ -586,6 +623,7 @@ namespace {
   class GVN : public FunctionPass {
     bool NoLoads;
     MemoryDependenceAnalysis *MD;
+    MemorySSA *MSSA;
     DominatorTree *DT;
     const DataLayout *TD;
     const TargetLibraryInfo *TLI;
@@ -612,7 +650,7 @@ namespace {
   public:
     static char ID; // Pass identification, replacement for typeid
     explicit GVN(bool noloads = false)
-        : FunctionPass(ID), NoLoads(noloads), MD(0) {
+        : FunctionPass(ID), NoLoads(noloads), MD(0), MSSA(0) {
       initializeGVNPass(*PassRegistry::getPassRegistry());
     }
 
@@ -680,7 +718,9 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.addRequired<DominatorTree>();
       AU.addRequired<TargetLibraryInfo>();
-      if (!NoLoads)
+      if (!NoLoads && EnableMemorySSA)
+        AU.addRequired<MemorySSA>();
+      else if (!NoLoads)
         AU.addRequired<MemoryDependenceAnalysis>();
       AU.addRequired<AliasAnalysis>();
 
@@ -691,6 +731,7 @@ namespace {
 
     // Helper fuctions of redundant load elimination 
     bool processLoad(LoadInst *L);
+    bool processLoadWithMemorySSA(LoadInst *L);
     bool processNonLocalLoad(LoadInst *L);
     void AnalyzeLoadAvailability(LoadInst *LI, LoadDepVect &Deps, 
                                  AvailValInBlkVect &ValuesPerBlock,
@@ -727,6 +768,7 @@ FunctionPass *llvm::createGVNPass(bool NoLoads) {
 
 INITIALIZE_PASS_BEGIN(GVN, "gvn", "Global Value Numbering", false, false)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(MemorySSA)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfo)
 INITIALIZE_AG_DEPENDENCY(AliasAnalysis)
@@ -1804,10 +1846,75 @@ static void patchAndReplaceAllUsesWith(Instruction *I, Value *Repl) {
   I->replaceAllUsesWith(Repl);
 }
 
+/// processLoadWithMemorySSA - Eliminate a load using the access the memory SSA
+/// walker finds to clobber it: forward the value of a store or memory
+/// intrinsic that writes the loaded bytes, or reuse a dominating load that
+/// sees the same clobber.  The walk looks through blocks and loops without
+/// scanning them, but partially redundant loads are not PRE'd.
+bool GVN::processLoadWithMemorySSA(LoadInst *L) {
+  MemoryAccess *Clobber = MSSA->getClobberingMemoryAccess(L);
+  if (!Clobber)
+    return false;
+
+  Value *AvailVal = 0;
+  Instruction *DepInst = 0;
+  if (MemoryDef *Def = dyn_cast<MemoryDef>(Clobber))
+    DepInst = Def->getMemoryInst();
+
+  if (StoreInst *DepSI = dyn_cast_or_null<StoreInst>(DepInst)) {
+    AliasAnalysis *AA = VN.getAliasAnalysis();
+    Value *StoredVal = DepSI->getValueOperand();
+    if (AA->alias(AA->getLocation(DepSI), AA->getLocation(L)) ==
+        AliasAnalysis::MustAlias) {
+      if (StoredVal->getType() == L->getType())
+        AvailVal = StoredVal;
+      else if (TD)
+        AvailVal = CoerceAvailableValueToLoadType(StoredVal, L->getType(),
+                                                  L, *TD);
+    }
+    if (!AvailVal && TD) {
+      int Offset = AnalyzeLoadFromClobberingStore(L->getType(),
+                                                  L->getPointerOperand(),
+                                                  DepSI, *TD);
+      if (Offset != -1)
+        AvailVal = GetStoreValueForLoad(StoredVal, Offset, L->getType(), L,
+                                        *TD);
+    }
+  } else if (MemIntrinsic *DepMI = dyn_cast_or_null<MemIntrinsic>(DepInst)) {
+    if (TD) {
+      int Offset = AnalyzeLoadFromClobberingMemInst(L->getType(),
+                                                    L->getPointerOperand(),
+                                                    DepMI, *TD);
+      if (Offset != -1)
+        AvailVal = GetMemInstValueForLoad(DepMI, Offset, L->getType(), L,
+                                          *TD);
+    }
+  }
+
+  if (AvailVal) {
+    DEBUG(dbgs() << "GVN FORWARDED:\n" << *DepInst << '\n' << *AvailVal
+                 << '\n' << *L << "\n\n\n");
+    L->replaceAllUsesWith(AvailVal);
+    markInstructionForDeletion(L);
+    ++NumGVNLoad;
+    return true;
+  }
+
+  // Loads that see the same clobber get the same value number.
+  Value *Leader = findLeader(L->getParent(), VN.lookup_or_add(L));
+  if (!Leader)
+    return false;
+
+  patchAndReplaceAllUsesWith(L, Leader);
+  markInstructionForDeletion(L);
+  ++NumGVNLoad;
+  return true;
+}
+
 /// processLoad - Attempt to eliminate a load, first by eliminating it
 /// locally, and then attempting non-local elimination if that fails.
 bool GVN::processLoad(LoadInst *L) {
-  if (!MD)
+  if (!MD && !MSSA)
     return false;
 
   if (!L->isSimple())
@@ -1818,6 +1925,9 @@ bool GVN::processLoad(LoadInst *L) {
     return true;
   }
 
+  if (MSSA)
+    return processLoadWithMemorySSA(L);
+
   // ... to a pointer that has been loaded from before...
   MemDepResult Dep = MD->getDependency(L);
 
@@ -2314,13 +2424,16 @@ bool GVN::processInstruction(Instruction *I) {
 
 /// runOnFunction - This is the main transformation entry point for a function.
 bool GVN::runOnFunction(Function& F) {
-  if (!NoLoads)
+  if (!NoLoads && EnableMemorySSA)
+    MSSA = &getAnalysis<MemorySSA>();
+  else if (!NoLoads)
     MD = &getAnalysis<MemoryDependenceAnalysis>();
   DT = &getAnalysis<DominatorTree>();
   TD = getAnalysisIfAvailable<DataLayout>();
   TLI = &getAnalysis<TargetLibraryInfo>();
   VN.setAliasAnalysis(&getAnalysis<AliasAnalysis>());
   VN.setMemDep(MD);
+  VN.setMemorySSA(MSSA);
   VN.setDomTree(DT);
 
   bool Changed = false;
@@ -2400,6 +2513,7 @@ bool GVN::processBlock(BasicBlock *BB) {
          E = InstrsToErase.end(); I != E; ++I) {
       DEBUG(dbgs() << "GVN removed: " << **I << '\n');
       if (MD) MD->removeInstruction(*I);
+      if (MSSA) MSSA->removeMemoryAccess(*I);
       DEBUG(verifyRemoved(*I));
       (*I)->eraseFromParent();
     }
@@ -205,12 +205,15 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     Count = TripCount;
   }
 
+  bool AllowPartial = UserAllowPartial ? CurrentAllowPartial : UP.Partial;
+
   // Enforce the threshold.
+  unsigned LoopSize = 0;
   if (Threshold != NoThreshold) {
     unsigned NumInlineCandidates;
     bool notDuplicatable;
-    unsigned LoopSize = ApproximateLoopSize(L, NumInlineCandidates,
-                                            notDuplicatable, TTI);
+    LoopSize = ApproximateLoopSize(L, NumInlineCandidates, notDuplicatable,
+                                   TTI);
     DEBUG(dbgs() << "  Loop Size = " << LoopSize << "\n");
     if (notDuplicatable) {
       DEBUG(dbgs() << "  Not unrolling loop which contains non duplicatable"
@@ -225,7 +228,6 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     if (TripCount != 1 && Size > Threshold) {
       DEBUG(dbgs() << "  Too large to fully unroll with count: " << Count
             << " because size: " << Size << ">" << Threshold << "\n");
-      bool AllowPartial = UserAllowPartial ? CurrentAllowPartial : UP.Partial;
       if (!AllowPartial && !(Runtime && TripCount == 0)) {
         DEBUG(dbgs() << "  will not try to unroll partially because "
               << "-unroll-allow-partial not given\n");
@@ -252,6 +254,41 @@ bool LoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     }
   }
 
+  // The copies of the body must also leave the whole function within the
+  // target's code size budget.  Take the largest count that does.
+  unsigned CodeSizeBudget = TTI.getCodeSizeBudget();
+  if (CodeSizeBudget && LoopSize && Count > 1) {
+    CodeMetrics Metrics;
+    Metrics.analyzeFunction(Header->getParent(), TTI);
+    unsigned FunctionSize = Metrics.NumInsts;
+    unsigned MaxCount = 1;
+    if (FunctionSize < CodeSizeBudget)
+      MaxCount += (CodeSizeBudget - FunctionSize) / LoopSize;
+    if (Count > MaxCount) {
+      DEBUG(dbgs() << "  Function size " << FunctionSize << " leaves room for"
+            << " count " << MaxCount << " within budget " << CodeSizeBudget
+            << "\n");
+      if (!AllowPartial && !(Runtime && TripCount == 0)) {
+        DEBUG(dbgs() << "  will not try to unroll partially because "
+              << "-unroll-allow-partial not given\n");
+        return false;
+      }
+      if (TripCount) {
+        Count = MaxCount;
+        while (Count != 0 && TripCount%Count != 0)
+          Count--;
+      } else {
+        while (Count > MaxCount)
+          Count >>= 1;
+      }
+      if (Count < 2) {
+        DEBUG(dbgs() << "  could not unroll within the code size budget\n");
+        return false;
+      }
+      DEBUG(dbgs() << "  partially unrolling with count: " << Count << "\n");
+    }
+  }
+
   // Unroll the loop.
   if (!UnrollLoop(L, Count, TripCount, Runtime, TripMultiple, LI, &LPM))
     return false;
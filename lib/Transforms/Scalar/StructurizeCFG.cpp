@@ -11,16 +11,26 @@
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/DivergenceAnalysis.h"
 #include "llvm/Analysis/RegionInfo.h"
 #include "llvm/Analysis/RegionIterator.h"
 #include "llvm/Analysis/RegionPass.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/PatternMatch.h"
 #include "llvm/Transforms/Utils/SSAUpdater.h"
 
 using namespace llvm;
 using namespace llvm::PatternMatch;
 
+static cl::opt<bool>
+SkipUniformRegionsOpt("structurizecfg-skip-uniform-regions", cl::Hidden,
+                      cl::init(false),
+                      cl::desc("Leave regions whose branches are all uniform "
+                               "according to the divergence analysis "
+                               "unstructured"));
+
 namespace {
 
 // Definition of the complex types used in this pass.
@@ -156,6 +166,8 @@ public:
 /// consist of a network of PHI nodes where the true incoming values expresses
 /// breaks and the false values expresses continue states.
 class StructurizeCFG : public RegionPass {
+  bool SkipUniformRegions;
+
   Type *Boolean;
   ConstantInt *BoolTrue;
   ConstantInt *BoolFalse;
@@ -181,6 +193,8 @@ class StructurizeCFG : public RegionPass {
 
   RegionNode *PrevNode;
 
+  bool hasOnlyUniformBranches(Region *R);
+
   void orderNodes();
 
   void analyzeLoops(RegionNode *N);
@@ -229,8 +243,9 @@ class StructurizeCFG : public RegionPass {
 public:
   static char ID;
 
-  StructurizeCFG() :
-    RegionPass(ID) {
+  StructurizeCFG(bool SkipUniformRegions = false) :
+    RegionPass(ID),
+    SkipUniformRegions(SkipUniformRegions || SkipUniformRegionsOpt) {
     initializeStructurizeCFGPass(*PassRegistry::getPassRegistry());
   }
 
@@ -244,6 +259,13 @@ public:
   }
 
   void getAnalysisUsage(AnalysisUsage &AU) const {
+    // Structurizing a region only adds flow blocks and phis that later
+    // queries never ask about, so the divergence of the original branches
+    // stays valid for the enclosing regions.
+    if (SkipUniformRegions) {
+      AU.addRequired<DivergenceAnalysis>();
+      AU.addPreserved<DivergenceAnalysis>();
+    }
     AU.addRequiredID(LowerSwitchID);
     AU.addRequired<DominatorTree>();
     AU.addPreserved<DominatorTree>();
@@ -257,6 +279,7 @@ char StructurizeCFG::ID = 0;
 
 INITIALIZE_PASS_BEGIN(StructurizeCFG, "structurizecfg", "Structurize the CFG",
                       false, false)
+INITIALIZE_PASS_DEPENDENCY(DivergenceAnalysis)
 INITIALIZE_PASS_DEPENDENCY(LowerSwitch)
 INITIALIZE_PASS_DEPENDENCY(DominatorTree)
 INITIALIZE_PASS_DEPENDENCY(RegionInfo)
@@ -275,6 +298,22 @@ bool StructurizeCFG::doInitialization(Region *R, RGPassManager &RGM) {
   return false;
 }
 
+/// \brief Are all branches that belong directly to \p R uniform?
+///
+/// Subregions are structurized on their own before \p R is visited, so only
+/// the blocks of \p R that are not part of a subregion matter here.
+bool StructurizeCFG::hasOnlyUniformBranches(Region *R) {
+  DivergenceAnalysis &DA = getAnalysis<DivergenceAnalysis>();
+  for (Region::element_iterator E = R->element_begin(),
+       EE = R->element_end(); E != EE; ++E) {
+    if (E->isSubRegion())
+      continue;
+    if (DA.isDivergent(E->getNodeAs<BasicBlock>()->getTerminator()))
+      return false;
+  }
+  return true;
+}
+
 /// \brief Build up the general order of nodes
 void StructurizeCFG::orderNodes() {
   scc_iterator<Region *> I = scc_begin(ParentRegion),
@@ -873,6 +912,14 @@ bool StructurizeCFG::runOnRegion(Region *R, RGPassManager &RGM) {
   if (R->isTopLevelRegion())
     return false;
 
+  // Threads never split up at a uniform branch, so the target can keep it
+  // as a plain scalar branch.
+  if (SkipUniformRegions && hasOnlyUniformBranches(R)) {
+    DEBUG(dbgs() << "Skipping region with uniform control flow: "
+                 << R->getNameStr() << '\n');
+    return false;
+  }
+
   Func = R->getEntry()->getParent();
   ParentRegion = R;
 
@@ -901,6 +948,6 @@ bool StructurizeCFG::runOnRegion(Region *R, RGPassManager &RGM) {
 }
 
 /// \brief Create the pass
-Pass *llvm::createStructurizeCFGPass() {
-  return new StructurizeCFG();
+Pass *llvm::createStructurizeCFGPass(bool SkipUniformRegions) {
+  return new StructurizeCFG(SkipUniformRegions);
 }
@@ -0,0 +1,300 @@
+//===-- SplitModule.cpp - Split a module into partitions ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements extractModulePartition.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "split-module"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/IntEqClasses.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+
+/// isDuplicable - Return true if \p GV is a local constant that may be
+/// copied into each partition that uses it rather than tying its users
+/// together.
+static bool isDuplicable(const GlobalValue *GV) {
+  const GlobalVariable *Var = dyn_cast<GlobalVariable>(GV);
+  if (!Var || !Var->hasLocalLinkage() || !Var->isConstant() ||
+      !Var->hasUnnamedAddr() || !Var->hasInitializer())
+    return false;
+
+  SmallVector<const Constant *, 8> Worklist(1, Var->getInitializer());
+  SmallPtrSet<const Constant *, 8> Visited;
+  while (!Worklist.empty()) {
+    const Constant *C = Worklist.pop_back_val();
+    if (isa<GlobalValue>(C) || isa<BlockAddress>(C))
+      return false;
+    for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E;
+         ++I)
+      if (Visited.insert(cast<Constant>(*I)))
+        Worklist.push_back(cast<Constant>(*I));
+  }
+  return true;
+}
+
+namespace {
+/// ModulePartitioner - Assigns each definition in a module to a partition.
+class ModulePartitioner {
+  /// Values - Every global value in the module, in module order.
+  std::vector<GlobalValue *> Values;
+  DenseMap<const GlobalValue *, unsigned> Index;
+  std::vector<bool> Duplicable;
+
+  /// Groups - Definitions that must be in the same partition.
+  IntEqClasses Groups;
+
+  void addValue(GlobalValue *GV);
+  void joinReferences(unsigned Idx, const Constant *C,
+                      SmallPtrSet<const Constant *, 16> &Visited);
+  void joinGroups();
+
+public:
+  explicit ModulePartitioner(Module &M);
+
+  /// Assignment - The partition of each group.
+  std::vector<unsigned> Assignment;
+
+  void assign(unsigned NumPartitions);
+
+  bool isOwned(const GlobalValue *GV, unsigned Partition) const {
+    unsigned Idx = Index.lookup(GV);
+    return !GV->isDeclaration() && !Duplicable[Idx] &&
+           Assignment[Groups[Idx]] == Partition;
+  }
+};
+}
+
+ModulePartitioner::ModulePartitioner(Module &M) {
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I)
+    addValue(I);
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    addValue(I);
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end(); I != E;
+       ++I)
+    addValue(I);
+  Groups.grow(Values.size());
+  joinGroups();
+  Groups.compress();
+}
+
+void ModulePartitioner::addValue(GlobalValue *GV) {
+  Index[GV] = Values.size();
+  Values.push_back(GV);
+  Duplicable.push_back(isDuplicable(GV));
+}
+
+/// joinReferences - Put the global values in \p C that cannot be referenced
+/// from another partition into the group of Values[Idx].
+void ModulePartitioner::joinReferences(unsigned Idx, const Constant *C,
+                                       SmallPtrSet<const Constant *, 16>
+                                         &Visited) {
+  if (!Visited.insert(C))
+    return;
+
+  if (const BlockAddress *BA = dyn_cast<BlockAddress>(C)) {
+    Groups.join(Idx, Index.lookup(BA->getFunction()));
+    return;
+  }
+
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    unsigned Ref = Index.lookup(GV);
+    if (GV->isDeclaration() || Duplicable[Ref])
+      return;
+    const GlobalVariable *Var = dyn_cast<GlobalVariable>(GV);
+    if (GV->hasLocalLinkage() || GV->hasAppendingLinkage() ||
+        (Var && Var->isThreadLocal()) || isa<GlobalAlias>(Values[Idx]))
+      Groups.join(Idx, Ref);
+    return;
+  }
+
+  for (User::const_op_iterator I = C->op_begin(), E = C->op_end(); I != E;
+       ++I)
+    joinReferences(Idx, cast<Constant>(*I), Visited);
+}
+
+void ModulePartitioner::joinGroups() {
+  for (unsigned Idx = 0, E = Values.size(); Idx != E; ++Idx) {
+    GlobalValue *GV = Values[Idx];
+    SmallPtrSet<const Constant *, 16> Visited;
+    if (GlobalVariable *Var = dyn_cast<GlobalVariable>(GV)) {
+      if (Var->hasInitializer())
+        joinReferences(Idx, Var->getInitializer(), Visited);
+    } else if (GlobalAlias *GA = dyn_cast<GlobalAlias>(GV)) {
+      joinReferences(Idx, GA->getAliasee(), Visited);
+    } else {
+      Function *F = cast<Function>(GV);
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+             ++I)
+          for (User::op_iterator OI = I->op_begin(), OE = I->op_end();
+               OI != OE; ++OI)
+            if (Constant *C = dyn_cast<Constant>(*OI))
+              joinReferences(Idx, C, Visited);
+    }
+  }
+}
+
+namespace {
+struct GroupCost {
+  unsigned Group;
+  uint64_t Cost;
+
+  /// Largest first, then in module order.
+  bool operator<(const GroupCost &RHS) const {
+    if (Cost != RHS.Cost)
+      return Cost > RHS.Cost;
+    return Group < RHS.Group;
+  }
+};
+}
+
+/// assign - Hand the groups out largest first, each to the partition with
+/// the least code so far.
+void ModulePartitioner::assign(unsigned NumPartitions) {
+  unsigned NumGroups = Groups.getNumClasses();
+  std::vector<GroupCost> Costs(NumGroups);
+  std::vector<bool> HasDefinition(NumGroups);
+  for (unsigned G = 0; G != NumGroups; ++G) {
+    Costs[G].Group = G;
+    Costs[G].Cost = 0;
+  }
+  for (unsigned Idx = 0, E = Values.size(); Idx != E; ++Idx) {
+    GlobalValue *GV = Values[Idx];
+    if (GV->isDeclaration() || Duplicable[Idx])
+      continue;
+    unsigned G = Groups[Idx];
+    HasDefinition[G] = true;
+    ++Costs[G].Cost;
+    if (Function *F = dyn_cast<Function>(GV))
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+        Costs[G].Cost += BB->size();
+  }
+  std::sort(Costs.begin(), Costs.end());
+
+  Assignment.assign(NumGroups, 0);
+  std::vector<uint64_t> Load(NumPartitions);
+  for (unsigned I = 0; I != NumGroups; ++I) {
+    if (!HasDefinition[Costs[I].Group])
+      continue;
+    unsigned Min = std::min_element(Load.begin(), Load.end()) - Load.begin();
+    Assignment[Costs[I].Group] = Min;
+    Load[Min] += Costs[I].Cost;
+  }
+
+  DEBUG({
+    dbgs() << "Split " << NumGroups << " groups into partitions of size";
+    for (unsigned P = 0; P != NumPartitions; ++P)
+      dbgs() << ' ' << Load[P];
+    dbgs() << '\n';
+  });
+}
+
+/// replaceWithDeclaration - Replace the alias \p GA with a declaration of
+/// the same name.
+static void replaceWithDeclaration(Module &M, GlobalAlias *GA) {
+  std::string Name = GA->getName();
+  GA->setName("");
+  Type *Ty = GA->getType()->getElementType();
+  GlobalValue *Decl;
+  if (FunctionType *FTy = dyn_cast<FunctionType>(Ty)) {
+    Decl = Function::Create(FTy, GlobalValue::ExternalLinkage, Name, &M);
+  } else {
+    const GlobalVariable *Aliasee =
+      dyn_cast_or_null<GlobalVariable>(GA->resolveAliasedGlobal(false));
+    Decl = new GlobalVariable(M, Ty, false, GlobalValue::ExternalLinkage, 0,
+                              Name, 0,
+                              Aliasee ? Aliasee->getThreadLocalMode()
+                                      : GlobalVariable::NotThreadLocal,
+                              GA->getType()->getAddressSpace());
+  }
+  Decl->setVisibility(GA->getVisibility());
+  GA->replaceAllUsesWith(ConstantExpr::getBitCast(Decl, GA->getType()));
+  GA->eraseFromParent();
+}
+
+void llvm::extractModulePartition(Module &M, unsigned Partition,
+                                  unsigned NumPartitions) {
+  assert(Partition < NumPartitions && "Partition out of range");
+  ModulePartitioner MP(M);
+  MP.assign(NumPartitions);
+
+  // Decide everything up front; aliases stop looking like definitions once
+  // their targets lose their bodies.
+  std::vector<GlobalVariable *> Vars;
+  std::vector<Function *> Funcs;
+  std::vector<GlobalAlias *> Aliases;
+  for (Module::global_iterator I = M.global_begin(), E = M.global_end();
+       I != E; ++I)
+    if (!I->isDeclaration() && !MP.isOwned(I, Partition))
+      Vars.push_back(I);
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I)
+    if (!I->isDeclaration() && !MP.isOwned(I, Partition))
+      Funcs.push_back(I);
+  for (Module::alias_iterator I = M.alias_begin(), E = M.alias_end(); I != E;
+       ++I)
+    if (!MP.isOwned(I, Partition))
+      Aliases.push_back(I);
+
+  // Drop the definitions owned elsewhere, which leaves the local symbols
+  // among them unused.
+  std::vector<GlobalValue *> Dead;
+  for (unsigned I = 0, E = Vars.size(); I != E; ++I) {
+    GlobalVariable *Var = Vars[I];
+    if (Var->hasLocalLinkage() || Var->hasAppendingLinkage()) {
+      Dead.push_back(Var);
+      if (isDuplicable(Var))
+        continue;
+    }
+    Var->setInitializer(0);
+    Var->setLinkage(GlobalValue::ExternalLinkage);
+  }
+  for (unsigned I = 0, E = Funcs.size(); I != E; ++I) {
+    if (Funcs[I]->hasLocalLinkage())
+      Dead.push_back(Funcs[I]);
+    Funcs[I]->deleteBody();
+  }
+  for (unsigned I = 0, E = Aliases.size(); I != E; ++I) {
+    if (Aliases[I]->hasLocalLinkage()) {
+      Dead.push_back(Aliases[I]);
+      Aliases[I]->setAliasee(0);
+    } else {
+      replaceWithDeclaration(M, Aliases[I]);
+    }
+  }
+
+  // Local symbols used by a definition in this partition are in it too,
+  // apart from the duplicable constants, which are kept while used.
+  for (unsigned I = 0, E = Dead.size(); I != E; ++I)
+    Dead[I]->removeDeadConstantUsers();
+  for (unsigned I = 0, E = Dead.size(); I != E; ++I) {
+    if (Dead[I]->use_empty())
+      Dead[I]->eraseFromParent();
+    else
+      assert(isDuplicable(Dead[I]) && "Local symbol used across partitions");
+  }
+
+  if (Partition != 0)
+    M.setModuleInlineAsm("");
+}
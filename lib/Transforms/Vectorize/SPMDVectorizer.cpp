@@ -0,0 +1,1549 @@
+//===- SPMDVectorizer.cpp - Whole-function SPMD vectorizer ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass rewrites a kernel written for a single work item so that it runs
+// Width consecutive work items side by side, one per vector lane.  A kernel is
+// a function returning void that asks for its work-item id through one of the
+// -spmd-id-function functions (get_global_id and get_local_id by default).
+// In the vectorized kernel a call for dimension 0 returns the id of lane 0, so
+// the runtime launches it once for every group of Width work items.  Other
+// dimensions are the same in every lane.
+//
+// Values that are the same in every lane stay scalar.  Values that are a
+// uniform base plus a constant step per lane, such as the work-item id and
+// addresses computed from it, are tracked as consecutive; loads and stores
+// through them become plain vector accesses.  Any other varying access
+// becomes a gather or scatter made of one scalar access per lane, and calls
+// with varying arguments are made once per lane unless a vector form of the
+// intrinsic exists.
+//
+// If every branch is uniform the CFG is kept as it is.  Otherwise the whole
+// kernel is linearized: each block runs under a mask of the lanes that reached
+// it, phis become selects on the edge masks, and each loop keeps iterating
+// while any lane is still in it.  Stores, calls with side effects and
+// operations that might trap only take effect for active lanes.
+//
+// Helper functions that ask for the work-item id must have been inlined into
+// the kernel first.  Kernels with divergent control flow are only handled if
+// their loops are in the form left by -loop-simplify and -lcssa.
+//
+//===----------------------------------------------------------------------===//
+#define SV_NAME "spmd-vectorize"
+#define DEBUG_TYPE SV_NAME
+
+#include "llvm/Transforms/Vectorize.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<unsigned>
+SPMDWidth("spmd-width", cl::init(16), cl::Hidden,
+          cl::desc("Number of work items an SPMD-vectorized kernel runs side "
+                   "by side"));
+
+static cl::list<std::string>
+SPMDIdFunctions("spmd-id-function", cl::CommaSeparated, cl::Hidden,
+                cl::desc("Functions returning the id of the calling work "
+                         "item (default: get_global_id,get_local_id)"));
+
+STATISTIC(NumKernels, "Number of kernels vectorized");
+STATISTIC(NumLinearized, "Number of kernels linearized under lane masks");
+STATISTIC(NumContiguous, "Number of vector loads and stores");
+STATISTIC(NumGathers, "Number of gathers and scatters");
+
+namespace {
+
+/// Returns true if the call is to an intrinsic with a vector overload that
+/// works lane by lane.
+static bool isVectorizableIntrinsic(const CallInst *CI) {
+  const IntrinsicInst *II = dyn_cast<IntrinsicInst>(CI);
+  if (!II || !II->getType()->isFloatingPointTy())
+    return false;
+  switch (II->getIntrinsicID()) {
+  case Intrinsic::sqrt:
+  case Intrinsic::sin:
+  case Intrinsic::cos:
+  case Intrinsic::exp:
+  case Intrinsic::exp2:
+  case Intrinsic::log:
+  case Intrinsic::log10:
+  case Intrinsic::log2:
+  case Intrinsic::fabs:
+  case Intrinsic::copysign:
+  case Intrinsic::floor:
+  case Intrinsic::ceil:
+  case Intrinsic::trunc:
+  case Intrinsic::rint:
+  case Intrinsic::nearbyint:
+  case Intrinsic::round:
+  case Intrinsic::pow:
+  case Intrinsic::fma:
+  case Intrinsic::fmuladd:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Returns true for instructions that have no meaning once vectorized and are
+/// simply dropped.
+static bool isDropped(const Instruction *I) {
+  if (isa<DbgInfoIntrinsic>(I))
+    return true;
+  if (const IntrinsicInst *II = dyn_cast<IntrinsicInst>(I))
+    return II->getIntrinsicID() == Intrinsic::lifetime_start ||
+           II->getIntrinsicID() == Intrinsic::lifetime_end;
+  return false;
+}
+
+/// KernelVectorizer - Analyzes one kernel and, if it can be handled, rewrites
+/// its body in place.
+class KernelVectorizer {
+public:
+  KernelVectorizer(Function &F, const DataLayout &DL, DominatorTree &DT,
+                   PostDominatorTree &PDT, LoopInfo &LI, unsigned Width,
+                   const std::vector<std::string> &IdNames)
+    : F(F), DL(DL), DT(DT), PDT(PDT), LI(LI), Width(Width), IdNames(IdNames),
+      B(F.getContext()), Linearize(false) {
+    MaskTy = VectorType::get(B.getInt1Ty(), Width);
+  }
+
+  /// Returns true if the function asks for its work-item id.
+  bool isKernel();
+
+  /// Decide how every value varies across lanes and check that the kernel
+  /// can be vectorized.
+  bool analyze();
+
+  /// Replace the body with the vectorized one.
+  void vectorize();
+
+private:
+  enum IdKind { NotId, LaneId, GroupId, UnknownId };
+
+  /// An edge between two nodes of the linearized CFG: the lanes taking it
+  /// and the values it brings to the phis of the target block.
+  struct Edge {
+    Value *Mask; // Null means every lane.
+    SmallVector<Value *, 4> Vals;
+  };
+
+  /// Lanes that left a loop through one exit block, and the values they
+  /// carry to the phis there.
+  struct ExitState {
+    PHINode *MaskPhi;
+    Value *Mask;
+    SmallVector<PHINode *, 4> ValPhis;
+    SmallVector<Value *, 4> Vals;
+  };
+
+  /// The loop being linearized.
+  struct LoopState {
+    Loop *L;
+    BasicBlock *Header;
+    PHINode *Active;
+    SmallVector<PHINode *, 4> HeaderPhis;
+    SmallVector<Edge, 2> BackEdges;
+    SmallVector<BasicBlock *, 4> ExitBlocks;
+    SmallVector<ExitState, 4> Exits;
+  };
+
+  /// A conditional region created while emitting code.
+  struct IfRegion {
+    BasicBlock *Head, *Then, *ThenEnd, *Else, *ElseEnd;
+    Value *Cond;
+    IfRegion() : Head(0), Then(0), ThenEnd(0), Else(0), ElseEnd(0), Cond(0) {}
+  };
+
+  // Analysis.
+  IdKind classifyIdCall(const CallInst *CI) const;
+  void markVarying(Instruction *I, SmallVectorImpl<Instruction *> &Worklist);
+  void propagate(SmallVectorImpl<Instruction *> &Worklist);
+  bool isVarying(const Value *V) const {
+    const Instruction *I = dyn_cast<Instruction>(V);
+    return I && Varying.count(I);
+  }
+  bool getStride(const Value *V, int64_t &Stride) const;
+  void computeStride(Instruction *I);
+  bool checkInstruction(Instruction *I) const;
+  bool computeOrder(Loop *L);
+  bool visitNode(BasicBlock *N, Loop *L, DenseMap<BasicBlock *, char> &State,
+                 std::vector<BasicBlock *> &PostOrder);
+  void getNodeSuccessors(BasicBlock *N, Loop *L,
+                         SmallVectorImpl<BasicBlock *> &Succs) const;
+  BasicBlock *getNode(BasicBlock *BB, Loop *L) const;
+
+  // Values.
+  std::string getOldName(const Value *V) const { return OldNames.lookup(V); }
+  VectorType *getVectorType(Type *Ty) const {
+    return VectorType::get(Ty, Width);
+  }
+  Value *getScalar(Value *V);
+  Value *getVector(Value *V);
+  Value *getStepVector(Type *Ty, int64_t Stride);
+  Value *materializeConsecutive(Value *Base, int64_t Stride);
+
+  // Masks.
+  Value *getMaskVector(Value *Mask) {
+    return Mask ? Mask : Constant::getAllOnesValue(MaskTy);
+  }
+  Value *maskIf(Value *Mask, Value *Cond, bool Negate);
+  Value *orMask(Value *A, Value *B);
+  Value *reduceMask(Value *Mask, bool All);
+
+  // Control flow inside the emitted code.
+  BasicBlock *createBlock(const Twine &Name);
+  IfRegion beginIf(Value *Cond, const Twine &Name);
+  void beginElse(IfRegion &R, const Twine &Name);
+  void endIf(IfRegion &R, const Twine &Name);
+  PHINode *joinValues(IfRegion &R, Value *ThenV, Value *ElseV);
+
+  // Instructions.
+  void emitInstruction(Instruction *I, Value *Mask);
+  Instruction *cloneScalar(Instruction *I);
+  void emitUniform(Instruction *I, Value *Mask);
+  void emitConsecutive(Instruction *I);
+  void emitBinary(BinaryOperator *BO, Value *Mask);
+  void emitGEP(GetElementPtrInst *GEP);
+  void emitLoad(LoadInst *LI, Value *Mask);
+  void emitStore(StoreInst *SI, Value *Mask);
+  void emitCall(CallInst *CI, Value *Mask);
+  Value *emitGather(LoadInst *LI, Value *Mask);
+  void emitScatter(StoreInst *SI, Value *Mask);
+  bool isContiguous(Value *Ptr, Type *Ty, bool IsVolatile);
+
+  // Kernels with uniform control flow.
+  void emitStructured(ArrayRef<BasicBlock *> Blocks);
+
+  // Kernels with divergent control flow.
+  void emitLevel(Loop *L);
+  bool isReachedByAllLanes(BasicBlock *BB) const;
+  void emitBlockNode(BasicBlock *BB);
+  void emitLoop(Loop *L);
+  void emitEdges(BasicBlock *BB, Value *Mask);
+  void makeEdge(BasicBlock *To, BasicBlock *From, Value *Mask, Edge &E);
+  void recordEdge(BasicBlock *To, const Edge &E);
+  Value *blend(ArrayRef<Edge> Edges, unsigned Idx);
+
+  Function &F;
+  const DataLayout &DL;
+  DominatorTree &DT;
+  PostDominatorTree &PDT;
+  LoopInfo &LI;
+  unsigned Width;
+  const std::vector<std::string> &IdNames;
+  IRBuilder<> B;
+  VectorType *MaskTy;
+
+  /// Reachable blocks in reverse post order.
+  std::vector<BasicBlock *> RPO;
+  /// Instructions whose value differs between lanes.
+  DenseSet<const Instruction *> Varying;
+  /// Varying integers and pointers that step by a constant amount from one
+  /// lane to the next (in bytes for pointers).
+  DenseMap<const Value *, int64_t> Strides;
+  /// Whether some branch is divergent, so the kernel must be linearized.
+  bool Linearize;
+  /// Topological order of the blocks and child loops (by header) of each
+  /// loop, and of the function for a null loop.
+  DenseMap<Loop *, std::vector<BasicBlock *> > Orders;
+
+  /// Names of the original blocks and instructions, which give them up to
+  /// the new ones.
+  DenseMap<const Value *, std::string> OldNames;
+
+  /// The scalar value (lane 0 for consecutive values) and the vector value
+  /// standing for each original value.
+  DenseMap<Value *, Value *> Scalars, Vectors;
+
+  /// Uniform control flow: the first and last emitted block for each block.
+  DenseMap<BasicBlock *, BasicBlock *> BlockBegin, BlockEnd;
+
+  /// Divergent control flow: edges waiting for their target to be emitted,
+  /// and the loops being emitted.
+  DenseMap<BasicBlock *, SmallVector<Edge, 2> > Incoming;
+  std::vector<LoopState> Loops;
+};
+
+} // end anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// Analysis
+//===----------------------------------------------------------------------===//
+
+KernelVectorizer::IdKind
+KernelVectorizer::classifyIdCall(const CallInst *CI) const {
+  const Function *Callee = CI->getCalledFunction();
+  if (!Callee)
+    return NotId;
+  StringRef Name = Callee->getName();
+  bool Found = false;
+  for (unsigned i = 0, e = IdNames.size(); i != e && !Found; ++i)
+    Found = Name == IdNames[i];
+  if (!Found)
+    return NotId;
+  if (!CI->getType()->isIntegerTy())
+    return UnknownId;
+  if (CI->getNumArgOperands() == 0)
+    return LaneId;
+  const ConstantInt *Dim = dyn_cast<ConstantInt>(CI->getArgOperand(0));
+  if (!Dim)
+    return UnknownId;
+  return Dim->isZero() ? LaneId : GroupId;
+}
+
+bool KernelVectorizer::isKernel() {
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (CallInst *CI = dyn_cast<CallInst>(I))
+        if (classifyIdCall(CI) != NotId)
+          return true;
+  return false;
+}
+
+void KernelVectorizer::markVarying(Instruction *I,
+                                   SmallVectorImpl<Instruction *> &Worklist) {
+  if (Varying.insert(I).second)
+    Worklist.push_back(I);
+}
+
+// Anything computed from a varying value is varying.
+void KernelVectorizer::propagate(SmallVectorImpl<Instruction *> &Worklist) {
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    for (Value::use_iterator UI = I->use_begin(), UE = I->use_end();
+         UI != UE; ++UI) {
+      Instruction *U = cast<Instruction>(*UI);
+      if (!isDropped(U))
+        markVarying(U, Worklist);
+    }
+  }
+}
+
+bool KernelVectorizer::getStride(const Value *V, int64_t &Stride) const {
+  if (!isVarying(V)) {
+    Stride = 0;
+    return true;
+  }
+  DenseMap<const Value *, int64_t>::const_iterator It = Strides.find(V);
+  if (It == Strides.end())
+    return false;
+  Stride = It->second;
+  return true;
+}
+
+// Record the stride of I if it is a uniform base plus a constant step per
+// lane.  Operands are visited first since blocks are in reverse post order
+// and phis are never consecutive.
+void KernelVectorizer::computeStride(Instruction *I) {
+  int64_t S0 = 0, S1 = 0;
+  switch (I->getOpcode()) {
+  case Instruction::Call:
+    if (classifyIdCall(cast<CallInst>(I)) == LaneId)
+      Strides[I] = 1;
+    return;
+  case Instruction::Add:
+  case Instruction::Sub:
+    if (getStride(I->getOperand(0), S0) && getStride(I->getOperand(1), S1))
+      Strides[I] = I->getOpcode() == Instruction::Add ? S0 + S1 : S0 - S1;
+    return;
+  case Instruction::Mul:
+  case Instruction::Shl: {
+    ConstantInt *C = dyn_cast<ConstantInt>(I->getOperand(1));
+    Value *Other = I->getOperand(0);
+    if (!C && I->getOpcode() == Instruction::Mul) {
+      C = dyn_cast<ConstantInt>(I->getOperand(0));
+      Other = I->getOperand(1);
+    }
+    if (!C || C->getBitWidth() > 64 || !getStride(Other, S0))
+      return;
+    if (I->getOpcode() == Instruction::Mul)
+      Strides[I] = S0 * C->getSExtValue();
+    else if (C->getZExtValue() < 63)
+      Strides[I] = S0 << C->getZExtValue();
+    return;
+  }
+  case Instruction::BitCast:
+    if (!I->getType()->isPointerTy())
+      return;
+    // FALL THROUGH
+  case Instruction::Trunc:
+  case Instruction::SExt:
+    // Sign extension is exact as long as the ids of a group do not straddle
+    // the largest signed value.
+    if (getStride(I->getOperand(0), S0))
+      Strides[I] = S0;
+    return;
+  case Instruction::ZExt: {
+    // Zero extension is only exact if the lanes cannot wrap around zero.
+    Instruction *Op = dyn_cast<Instruction>(I->getOperand(0));
+    bool NoWrap = false;
+    if (CallInst *CI = dyn_cast_or_null<CallInst>(Op))
+      NoWrap = classifyIdCall(CI) == LaneId;
+    else if (OverflowingBinaryOperator *OBO =
+               dyn_cast_or_null<OverflowingBinaryOperator>(Op))
+      NoWrap = OBO->hasNoUnsignedWrap();
+    if (NoWrap && getStride(Op, S0))
+      Strides[I] = S0;
+    return;
+  }
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+    if (DL.getTypeSizeInBits(I->getType()) ==
+          DL.getTypeSizeInBits(I->getOperand(0)->getType()) &&
+        getStride(I->getOperand(0), S0))
+      Strides[I] = S0;
+    return;
+  case Instruction::GetElementPtr: {
+    GetElementPtrInst *GEP = cast<GetElementPtrInst>(I);
+    if (!getStride(GEP->getPointerOperand(), S0))
+      return;
+    for (gep_type_iterator GTI = gep_type_begin(GEP), E = gep_type_end(GEP);
+         GTI != E; ++GTI) {
+      if (isa<StructType>(*GTI))
+        continue;
+      if (!getStride(GTI.getOperand(), S1))
+        return;
+      S0 += S1 * (int64_t)DL.getTypeAllocSize(GTI.getIndexedType());
+    }
+    Strides[I] = S0;
+    return;
+  }
+  default:
+    return;
+  }
+}
+
+// Check that a reachable instruction can be handled.
+bool KernelVectorizer::checkInstruction(Instruction *I) const {
+  switch (I->getOpcode()) {
+  case Instruction::Alloca:
+  case Instruction::Invoke:
+  case Instruction::IndirectBr:
+  case Instruction::Resume:
+  case Instruction::LandingPad:
+  case Instruction::Fence:
+  case Instruction::AtomicCmpXchg:
+  case Instruction::AtomicRMW:
+  case Instruction::VAArg:
+    return false;
+  case Instruction::Load:
+    if (cast<LoadInst>(I)->isAtomic())
+      return false;
+    break;
+  case Instruction::Store:
+    if (cast<StoreInst>(I)->isAtomic())
+      return false;
+    break;
+  case Instruction::Call: {
+    CallInst *CI = cast<CallInst>(I);
+    if (CI->cannotDuplicate() || classifyIdCall(CI) == UnknownId ||
+        isVarying(CI->getCalledValue()))
+      return false;
+    break;
+  }
+  default:
+    break;
+  }
+
+  if (!isVarying(I))
+    return true;
+
+  Type *Ty = I->getType();
+  if (!Ty->isVoidTy() &&
+      (Ty->isVectorTy() || !VectorType::isValidElementType(Ty)))
+    return false;
+
+  switch (I->getOpcode()) {
+  case Instruction::PHI:
+  case Instruction::Br:
+  case Instruction::Switch:
+  case Instruction::Select:
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+  case Instruction::GetElementPtr:
+  case Instruction::Load:
+  case Instruction::Store:
+  case Instruction::Call:
+    break;
+  default:
+    if (!isa<BinaryOperator>(I) && !isa<CastInst>(I))
+      return false;
+  }
+
+  // Varying operands become vectors, so they need a valid element type too.
+  for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i) {
+    Value *Op = I->getOperand(i);
+    if (isVarying(Op) && (Op->getType()->isVectorTy() ||
+                          !VectorType::isValidElementType(Op->getType())))
+      return false;
+  }
+  return true;
+}
+
+// Map a block to the node standing for it among the children of L: itself,
+// or the header of the child loop containing it.
+BasicBlock *KernelVectorizer::getNode(BasicBlock *BB, Loop *L) const {
+  Loop *BL = LI.getLoopFor(BB);
+  if (BL == L)
+    return BB;
+  while (BL->getParentLoop() != L)
+    BL = BL->getParentLoop();
+  return BL->getHeader();
+}
+
+void KernelVectorizer::getNodeSuccessors(
+    BasicBlock *N, Loop *L, SmallVectorImpl<BasicBlock *> &Succs) const {
+  SmallVector<BasicBlock *, 8> Targets;
+  Loop *NL = LI.getLoopFor(N);
+  if (NL != L)
+    NL->getUniqueExitBlocks(Targets);
+  else
+    Targets.append(succ_begin(N), succ_end(N));
+
+  for (unsigned i = 0, e = Targets.size(); i != e; ++i) {
+    BasicBlock *T = Targets[i];
+    if (L && (!L->contains(T) || T == L->getHeader()))
+      continue;
+    Succs.push_back(getNode(T, L));
+  }
+}
+
+bool KernelVectorizer::visitNode(BasicBlock *N, Loop *L,
+                                 DenseMap<BasicBlock *, char> &State,
+                                 std::vector<BasicBlock *> &PostOrder) {
+  State[N] = 1;
+  SmallVector<BasicBlock *, 8> Succs;
+  getNodeSuccessors(N, L, Succs);
+  for (unsigned i = 0, e = Succs.size(); i != e; ++i) {
+    char S = State.lookup(Succs[i]);
+    if (S == 1)
+      return false; // A cycle that is not a natural loop.
+    if (S == 0 && !visitNode(Succs[i], L, State, PostOrder))
+      return false;
+  }
+  State[N] = 2;
+  PostOrder.push_back(N);
+  return true;
+}
+
+// Order the children of L topologically, and do the same for every loop
+// nested in it.
+bool KernelVectorizer::computeOrder(Loop *L) {
+  if (L && (!L->getLoopPreheader() || !L->hasDedicatedExits() ||
+            !L->isLCSSAForm(DT)))
+    return false;
+
+  DenseMap<BasicBlock *, char> State;
+  std::vector<BasicBlock *> PostOrder;
+  BasicBlock *Entry = L ? L->getHeader() : &F.getEntryBlock();
+  if (!visitNode(Entry, L, State, PostOrder))
+    return false;
+  Orders[L].assign(PostOrder.rbegin(), PostOrder.rend());
+
+  const std::vector<Loop *> &SubLoops = L ? L->getSubLoops()
+                                          : std::vector<Loop *>(LI.begin(),
+                                                                LI.end());
+  for (unsigned i = 0, e = SubLoops.size(); i != e; ++i)
+    if (!computeOrder(SubLoops[i]))
+      return false;
+  return true;
+}
+
+bool KernelVectorizer::analyze() {
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  RPO.assign(RPOT.begin(), RPOT.end());
+
+  SmallVector<Instruction *, 32> Worklist;
+  for (unsigned i = 0, e = RPO.size(); i != e; ++i) {
+    BasicBlock *BB = RPO[i];
+    if (BB->hasAddressTaken())
+      return false;
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+      CallInst *CI = dyn_cast<CallInst>(I);
+      if (!CI || isDropped(CI))
+        continue;
+      // Each work item makes its own calls with side effects.
+      IdKind Kind = classifyIdCall(CI);
+      if (Kind == LaneId || (Kind == NotId && CI->mayWriteToMemory()))
+        markVarying(CI, Worklist);
+    }
+  }
+  propagate(Worklist);
+
+  for (unsigned i = 0, e = RPO.size(); i != e && !Linearize; ++i)
+    Linearize = isVarying(RPO[i]->getTerminator());
+
+  if (Linearize) {
+    if (!computeOrder(0))
+      return false;
+    // Phis become selects on the edge masks, apart from those in the header
+    // of a loop with one latch, which stay phis.  Lanes leave loops at
+    // different times, so phis in loop exits always differ between lanes.
+    for (unsigned i = 0, e = RPO.size(); i != e; ++i) {
+      BasicBlock *BB = RPO[i];
+      Loop *L = LI.getLoopFor(BB);
+      if (L && L->getHeader() == BB && L->getLoopLatch() &&
+          LI.getLoopFor(L->getLoopPreheader()) == L->getParentLoop())
+        continue;
+      for (BasicBlock::iterator I = BB->begin(); isa<PHINode>(I); ++I)
+        markVarying(I, Worklist);
+    }
+    propagate(Worklist);
+  }
+
+  for (unsigned i = 0, e = RPO.size(); i != e; ++i)
+    for (BasicBlock::iterator I = RPO[i]->begin(), IE = RPO[i]->end();
+         I != IE; ++I) {
+      if (!checkInstruction(I)) {
+        DEBUG(dbgs() << "SPMD: cannot vectorize " << F.getName() << ": "
+                     << *I << "\n");
+        return false;
+      }
+      if (isVarying(I))
+        computeStride(I);
+    }
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Values and masks
+//===----------------------------------------------------------------------===//
+
+Value *KernelVectorizer::getScalar(Value *V) {
+  if (!isa<Instruction>(V))
+    return V;
+  DenseMap<Value *, Value *>::iterator It = Scalars.find(V);
+  assert(It != Scalars.end() && "No scalar form for value!");
+  return It->second;
+}
+
+Value *KernelVectorizer::getVector(Value *V) {
+  if (isVarying(V)) {
+    DenseMap<Value *, Value *>::iterator It = Vectors.find(V);
+    assert(It != Vectors.end() && "Varying value used before definition!");
+    return It->second;
+  }
+  Value *S = getScalar(V);
+  if (Constant *C = dyn_cast<Constant>(S))
+    return ConstantVector::getSplat(Width, C);
+  return B.CreateVectorSplat(Width, S);
+}
+
+/// Returns <0, Stride, 2*Stride, ...> of integer type Ty.
+Value *KernelVectorizer::getStepVector(Type *Ty, int64_t Stride) {
+  SmallVector<Constant *, 16> Steps;
+  for (unsigned i = 0; i != Width; ++i)
+    Steps.push_back(ConstantInt::get(Ty, i * Stride, true));
+  return ConstantVector::get(Steps);
+}
+
+Value *KernelVectorizer::materializeConsecutive(Value *Base, int64_t Stride) {
+  Type *Ty = Base->getType();
+  if (!Ty->isPointerTy())
+    return B.CreateAdd(B.CreateVectorSplat(Width, Base),
+                       getStepVector(Ty, Stride));
+  Type *IntPtrTy = DL.getIntPtrType(Ty);
+  Value *Addr = B.CreatePtrToInt(Base, IntPtrTy);
+  Value *Lanes = B.CreateAdd(B.CreateVectorSplat(Width, Addr),
+                             getStepVector(IntPtrTy, Stride));
+  return B.CreateIntToPtr(Lanes, getVectorType(Ty));
+}
+
+/// The lanes of Mask for which the i1 or <Width x i1> Cond holds (or does not
+/// hold, if Negate).
+Value *KernelVectorizer::maskIf(Value *Mask, Value *Cond, bool Negate) {
+  if (Negate)
+    Cond = B.CreateNot(Cond);
+  if (!Cond->getType()->isVectorTy())
+    Cond = B.CreateVectorSplat(Width, Cond);
+  return Mask ? B.CreateAnd(Mask, Cond) : Cond;
+}
+
+Value *KernelVectorizer::orMask(Value *A, Value *C) {
+  if (!A || !C)
+    return 0;
+  return B.CreateOr(A, C);
+}
+
+/// Returns an i1 that is true if any (or all) of the lanes in Mask are set.
+Value *KernelVectorizer::reduceMask(Value *Mask, bool All) {
+  if (!Mask)
+    return B.getTrue();
+  if (Constant *C = dyn_cast<Constant>(Mask)) {
+    if (C->isAllOnesValue())
+      return B.getTrue();
+    if (C->isNullValue())
+      return B.getFalse();
+  }
+  SmallVector<Value *, 16> Lanes;
+  for (unsigned i = 0; i != Width; ++i)
+    Lanes.push_back(B.CreateExtractElement(Mask, B.getInt32(i)));
+  while (Lanes.size() > 1) {
+    SmallVector<Value *, 16> Next;
+    for (unsigned i = 0, e = Lanes.size(); i + 1 < e; i += 2)
+      Next.push_back(All ? B.CreateAnd(Lanes[i], Lanes[i + 1])
+                         : B.CreateOr(Lanes[i], Lanes[i + 1]));
+    if (Lanes.size() % 2)
+      Next.push_back(Lanes.back());
+    Lanes.swap(Next);
+  }
+  return Lanes[0];
+}
+
+//===----------------------------------------------------------------------===//
+// Control flow inside emitted code
+//===----------------------------------------------------------------------===//
+
+/// Create a block right after the one being emitted into.
+BasicBlock *KernelVectorizer::createBlock(const Twine &Name) {
+  BasicBlock *Next = 0;
+  if (BasicBlock *Cur = B.GetInsertBlock()) {
+    Function::iterator It = Cur;
+    if (++It != F.end())
+      Next = It;
+  }
+  return BasicBlock::Create(F.getContext(), Name, &F, Next);
+}
+
+/// Start code that only runs if Cond holds.  The branch into it is created
+/// by endIf.
+KernelVectorizer::IfRegion KernelVectorizer::beginIf(Value *Cond,
+                                                     const Twine &Name) {
+  IfRegion R;
+  R.Head = B.GetInsertBlock();
+  R.Cond = Cond;
+  R.Then = createBlock(Name);
+  R.ThenEnd = R.Else = R.ElseEnd = 0;
+  B.SetInsertPoint(R.Then);
+  return R;
+}
+
+void KernelVectorizer::beginElse(IfRegion &R, const Twine &Name) {
+  R.ThenEnd = B.GetInsertBlock();
+  R.Else = createBlock(Name);
+  B.SetInsertPoint(R.Else);
+}
+
+void KernelVectorizer::endIf(IfRegion &R, const Twine &Name) {
+  if (R.Else) {
+    R.ElseEnd = B.GetInsertBlock();
+  } else {
+    R.ThenEnd = B.GetInsertBlock();
+    R.ElseEnd = R.Head;
+  }
+  BasicBlock *Join = createBlock(Name);
+  B.CreateBr(Join);
+  if (R.Else)
+    BranchInst::Create(Join, R.ThenEnd);
+  BranchInst::Create(R.Then, R.Else ? R.Else : Join, R.Cond, R.Head);
+  B.SetInsertPoint(Join);
+}
+
+PHINode *KernelVectorizer::joinValues(IfRegion &R, Value *ThenV,
+                                      Value *ElseV) {
+  PHINode *PN = B.CreatePHI(ThenV->getType(), 2);
+  PN->addIncoming(ThenV, R.ThenEnd);
+  PN->addIncoming(ElseV, R.ElseEnd);
+  return PN;
+}
+
+//===----------------------------------------------------------------------===//
+// Instructions
+//===----------------------------------------------------------------------===//
+
+Instruction *KernelVectorizer::cloneScalar(Instruction *I) {
+  Instruction *C = I->clone();
+  for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+    C->setOperand(i, getScalar(C->getOperand(i)));
+  B.Insert(C, getOldName(I));
+  return C;
+}
+
+void KernelVectorizer::emitInstruction(Instruction *I, Value *Mask) {
+  if (isDropped(I))
+    return;
+  B.SetCurrentDebugLocation(I->getDebugLoc());
+  if (!isVarying(I))
+    return emitUniform(I, Mask);
+  if (Strides.count(I))
+    return emitConsecutive(I);
+
+  switch (I->getOpcode()) {
+  case Instruction::Load:
+    return emitLoad(cast<LoadInst>(I), Mask);
+  case Instruction::Store:
+    return emitStore(cast<StoreInst>(I), Mask);
+  case Instruction::Call:
+    return emitCall(cast<CallInst>(I), Mask);
+  case Instruction::GetElementPtr:
+    return emitGEP(cast<GetElementPtrInst>(I));
+  case Instruction::ICmp:
+    Vectors[I] = B.CreateICmp(cast<ICmpInst>(I)->getPredicate(),
+                              getVector(I->getOperand(0)),
+                              getVector(I->getOperand(1)), getOldName(I));
+    return;
+  case Instruction::FCmp:
+    Vectors[I] = B.CreateFCmp(cast<FCmpInst>(I)->getPredicate(),
+                              getVector(I->getOperand(0)),
+                              getVector(I->getOperand(1)), getOldName(I));
+    return;
+  case Instruction::Select: {
+    Value *Cond = I->getOperand(0);
+    Cond = isVarying(Cond) ? getVector(Cond) : getScalar(Cond);
+    Vectors[I] = B.CreateSelect(Cond, getVector(I->getOperand(1)),
+                                getVector(I->getOperand(2)), getOldName(I));
+    return;
+  }
+  default:
+    break;
+  }
+
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(I))
+    return emitBinary(BO, Mask);
+  CastInst *CI = cast<CastInst>(I);
+  Vectors[I] = B.CreateCast(CI->getOpcode(), getVector(CI->getOperand(0)),
+                            getVectorType(CI->getType()), getOldName(CI));
+}
+
+static bool mayTrapOnDivisor(const BinaryOperator *BO) {
+  switch (BO->getOpcode()) {
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+    break;
+  default:
+    return false;
+  }
+  const ConstantInt *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+  return !C || C->isZero() || C->isAllOnesValue();
+}
+
+void KernelVectorizer::emitUniform(Instruction *I, Value *Mask) {
+  // In linearized code a block may be reached with no lane active, so loads,
+  // calls that read memory and stores only happen if some lane is.
+  bool Guard = false;
+  if (Mask) {
+    if (isa<LoadInst>(I) || isa<StoreInst>(I))
+      Guard = true;
+    else if (CallInst *CI = dyn_cast<CallInst>(I))
+      Guard = !CI->doesNotAccessMemory();
+  }
+
+  if (Guard) {
+    IfRegion R = beginIf(reduceMask(Mask, false), "spmd.any");
+    Instruction *C = cloneScalar(I);
+    endIf(R, "spmd.any.end");
+    if (!I->getType()->isVoidTy())
+      Scalars[I] = joinValues(R, C, UndefValue::get(C->getType()));
+    return;
+  }
+
+  Instruction *C = cloneScalar(I);
+  Scalars[I] = C;
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(I);
+  if (Mask && BO && mayTrapOnDivisor(BO))
+    C->setOperand(1, B.CreateSelect(reduceMask(Mask, false),
+                                    C->getOperand(1),
+                                    ConstantInt::get(BO->getType(), 1)));
+}
+
+void KernelVectorizer::emitConsecutive(Instruction *I) {
+  Value *Base = cloneScalar(I);
+  Scalars[I] = Base;
+  Vectors[I] = materializeConsecutive(Base, Strides.lookup(I));
+}
+
+void KernelVectorizer::emitBinary(BinaryOperator *BO, Value *Mask) {
+  Value *LHS = getVector(BO->getOperand(0));
+  Value *RHS = getVector(BO->getOperand(1));
+  // Inactive lanes divide by one.
+  if (Mask && mayTrapOnDivisor(BO))
+    RHS = B.CreateSelect(Mask, RHS,
+                         ConstantVector::getSplat(
+                             Width, ConstantInt::get(BO->getType(), 1)));
+  Value *V = B.CreateBinOp(BO->getOpcode(), LHS, RHS, getOldName(BO));
+  if (BinaryOperator *VBO = dyn_cast<BinaryOperator>(V)) {
+    if (isa<OverflowingBinaryOperator>(BO)) {
+      VBO->setHasNoSignedWrap(BO->hasNoSignedWrap());
+      VBO->setHasNoUnsignedWrap(BO->hasNoUnsignedWrap());
+    }
+    if (isa<PossiblyExactOperator>(BO))
+      VBO->setIsExact(BO->isExact());
+    if (isa<FPMathOperator>(BO))
+      VBO->copyFastMathFlags(BO);
+  }
+  Vectors[BO] = V;
+}
+
+// A varying address that is not consecutive is computed in integers, lane by
+// lane.
+void KernelVectorizer::emitGEP(GetElementPtrInst *GEP) {
+  Type *IntPtrTy = DL.getIntPtrType(GEP->getPointerOperandType());
+  Type *VecIntPtrTy = getVectorType(IntPtrTy);
+  Value *Addr = B.CreatePtrToInt(getVector(GEP->getPointerOperand()),
+                                 VecIntPtrTy);
+  for (gep_type_iterator GTI = gep_type_begin(GEP), E = gep_type_end(GEP);
+       GTI != E; ++GTI) {
+    Value *Idx = GTI.getOperand();
+    int64_t Offset = 0;
+    if (StructType *STy = dyn_cast<StructType>(*GTI)) {
+      unsigned Field = cast<ConstantInt>(Idx)->getZExtValue();
+      Offset = DL.getStructLayout(STy)->getElementOffset(Field);
+    } else if (ConstantInt *C = dyn_cast<ConstantInt>(Idx)) {
+      Offset = C->getSExtValue() * DL.getTypeAllocSize(GTI.getIndexedType());
+    } else {
+      Value *V = B.CreateIntCast(getVector(Idx), VecIntPtrTy, true);
+      uint64_t Size = DL.getTypeAllocSize(GTI.getIndexedType());
+      if (Size != 1)
+        V = B.CreateMul(V, ConstantVector::getSplat(
+                               Width, ConstantInt::get(IntPtrTy, Size)));
+      Addr = B.CreateAdd(Addr, V);
+      continue;
+    }
+    if (Offset)
+      Addr = B.CreateAdd(Addr, ConstantVector::getSplat(
+                                   Width, ConstantInt::get(IntPtrTy, Offset,
+                                                           true)));
+  }
+  Vectors[GEP] = B.CreateIntToPtr(Addr, getVectorType(GEP->getType()),
+                                  getOldName(GEP));
+}
+
+/// Returns true if lane i accesses the Ty just after lane i - 1, so the
+/// access can be done with one vector load or store.
+bool KernelVectorizer::isContiguous(Value *Ptr, Type *Ty, bool IsVolatile) {
+  int64_t Stride;
+  if (IsVolatile || !getStride(Ptr, Stride))
+    return false;
+  uint64_t Size = DL.getTypeAllocSize(Ty);
+  return Stride == (int64_t)Size &&
+         DL.getTypeSizeInBits(Ty) == DL.getTypeAllocSizeInBits(Ty);
+}
+
+Value *KernelVectorizer::emitGather(LoadInst *LI, Value *Mask) {
+  ++NumGathers;
+  Value *Ptrs = getVector(LI->getPointerOperand());
+  Value *Result = UndefValue::get(getVectorType(LI->getType()));
+  for (unsigned i = 0; i != Width; ++i) {
+    Value *Lane = B.getInt32(i);
+    IfRegion R;
+    if (Mask)
+      R = beginIf(B.CreateExtractElement(Mask, Lane), "spmd.lane");
+    LoadInst *L = B.CreateAlignedLoad(B.CreateExtractElement(Ptrs, Lane),
+                                      LI->getAlignment(), LI->isVolatile());
+    Value *V = B.CreateInsertElement(Result, L, Lane);
+    if (Mask) {
+      endIf(R, "spmd.lane.end");
+      V = joinValues(R, V, Result);
+    }
+    Result = V;
+  }
+  return Result;
+}
+
+void KernelVectorizer::emitScatter(StoreInst *SI, Value *Mask) {
+  ++NumGathers;
+  Value *Ptrs = getVector(SI->getPointerOperand());
+  Value *Vals = getVector(SI->getValueOperand());
+  for (unsigned i = 0; i != Width; ++i) {
+    Value *Lane = B.getInt32(i);
+    IfRegion R;
+    if (Mask)
+      R = beginIf(B.CreateExtractElement(Mask, Lane), "spmd.lane");
+    B.CreateAlignedStore(B.CreateExtractElement(Vals, Lane),
+                         B.CreateExtractElement(Ptrs, Lane),
+                         SI->getAlignment(), SI->isVolatile());
+    if (Mask)
+      endIf(R, "spmd.lane.end");
+  }
+}
+
+void KernelVectorizer::emitLoad(LoadInst *LI, Value *Mask) {
+  Value *Ptr = LI->getPointerOperand();
+  Type *Ty = LI->getType();
+  int64_t Stride;
+
+  // Every lane reads the same address.
+  if (!LI->isVolatile() && getStride(Ptr, Stride) && Stride == 0) {
+    Value *V;
+    if (Mask) {
+      IfRegion R = beginIf(reduceMask(Mask, false), "spmd.any");
+      Value *L = B.CreateAlignedLoad(getScalar(Ptr), LI->getAlignment());
+      endIf(R, "spmd.any.end");
+      V = joinValues(R, L, UndefValue::get(Ty));
+    } else {
+      V = B.CreateAlignedLoad(getScalar(Ptr), LI->getAlignment());
+    }
+    Vectors[LI] = B.CreateVectorSplat(Width, V, getOldName(LI));
+    return;
+  }
+
+  if (!isContiguous(Ptr, Ty, LI->isVolatile())) {
+    Vectors[LI] = emitGather(LI, Mask);
+    return;
+  }
+
+  // When only some lanes are active the lanes past the end of an array must
+  // not be touched, so fall back to a gather.
+  unsigned Align = LI->getAlignment();
+  if (!Align)
+    Align = DL.getABITypeAlignment(Ty);
+  IfRegion R;
+  if (Mask)
+    R = beginIf(reduceMask(Mask, true), "spmd.all");
+  Value *VecPtr = B.CreateBitCast(
+      getScalar(Ptr),
+      getVectorType(Ty)->getPointerTo(Ptr->getType()->getPointerAddressSpace()));
+  Value *V = B.CreateAlignedLoad(VecPtr, Align, getOldName(LI));
+  ++NumContiguous;
+  if (Mask) {
+    beginElse(R, "spmd.some");
+    Value *G = emitGather(LI, Mask);
+    endIf(R, "spmd.all.end");
+    V = joinValues(R, V, G);
+  }
+  Vectors[LI] = V;
+}
+
+void KernelVectorizer::emitStore(StoreInst *SI, Value *Mask) {
+  Value *Ptr = SI->getPointerOperand();
+  Value *Val = SI->getValueOperand();
+  int64_t Stride;
+
+  // Every lane stores the same value to the same address.
+  if (!SI->isVolatile() && !isVarying(Val) && getStride(Ptr, Stride) &&
+      Stride == 0) {
+    IfRegion R;
+    if (Mask)
+      R = beginIf(reduceMask(Mask, false), "spmd.any");
+    B.CreateAlignedStore(getScalar(Val), getScalar(Ptr), SI->getAlignment());
+    if (Mask)
+      endIf(R, "spmd.any.end");
+    return;
+  }
+
+  if (!isContiguous(Ptr, Val->getType(), SI->isVolatile()))
+    return emitScatter(SI, Mask);
+
+  unsigned Align = SI->getAlignment();
+  if (!Align)
+    Align = DL.getABITypeAlignment(Val->getType());
+  IfRegion R;
+  if (Mask)
+    R = beginIf(reduceMask(Mask, true), "spmd.all");
+  Value *VecPtr = B.CreateBitCast(
+      getScalar(Ptr), getVectorType(Val->getType())->getPointerTo(
+                          Ptr->getType()->getPointerAddressSpace()));
+  B.CreateAlignedStore(getVector(Val), VecPtr, Align);
+  ++NumContiguous;
+  if (Mask) {
+    beginElse(R, "spmd.some");
+    emitScatter(SI, Mask);
+    endIf(R, "spmd.all.end");
+  }
+}
+
+void KernelVectorizer::emitCall(CallInst *CI, Value *Mask) {
+  Type *RetTy = CI->getType();
+
+  if (isVectorizableIntrinsic(CI)) {
+    Intrinsic::ID ID = cast<IntrinsicInst>(CI)->getIntrinsicID();
+    Type *VecTy = getVectorType(RetTy);
+    SmallVector<Value *, 4> Args;
+    for (unsigned i = 0, e = CI->getNumArgOperands(); i != e; ++i)
+      Args.push_back(getVector(CI->getArgOperand(i)));
+    Function *Decl = Intrinsic::getDeclaration(F.getParent(), ID, VecTy);
+    Vectors[CI] = B.CreateCall(Decl, Args, getOldName(CI));
+    return;
+  }
+
+  // Otherwise each lane makes its own call.
+  bool Guard = Mask && !CI->doesNotAccessMemory();
+  Value *Result = RetTy->isVoidTy() ? 0 : UndefValue::get(getVectorType(RetTy));
+  Value *Callee = getScalar(CI->getCalledValue());
+  for (unsigned i = 0; i != Width; ++i) {
+    Value *Lane = B.getInt32(i);
+    IfRegion R;
+    if (Guard)
+      R = beginIf(B.CreateExtractElement(Mask, Lane), "spmd.lane");
+    SmallVector<Value *, 4> Args;
+    for (unsigned a = 0, e = CI->getNumArgOperands(); a != e; ++a) {
+      Value *Arg = CI->getArgOperand(a);
+      Args.push_back(isVarying(Arg)
+                         ? B.CreateExtractElement(getVector(Arg), Lane)
+                         : getScalar(Arg));
+    }
+    CallInst *C = B.CreateCall(Callee, Args);
+    C->setCallingConv(CI->getCallingConv());
+    C->setAttributes(CI->getAttributes());
+    Value *V = Result ? B.CreateInsertElement(Result, C, Lane) : 0;
+    if (Guard) {
+      endIf(R, "spmd.lane.end");
+      if (V)
+        V = joinValues(R, V, Result);
+    }
+    Result = V;
+  }
+  if (Result)
+    Vectors[CI] = Result;
+}
+
+//===----------------------------------------------------------------------===//
+// Uniform control flow
+//===----------------------------------------------------------------------===//
+
+// Every branch is uniform, so the CFG stays as it is and each block just gets
+// the vectorized version of its instructions.
+void KernelVectorizer::emitStructured(ArrayRef<BasicBlock *> Blocks) {
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i)
+    BlockBegin[Blocks[i]] =
+        BasicBlock::Create(F.getContext(), getOldName(Blocks[i]), &F);
+
+  SmallVector<PHINode *, 16> Phis;
+  for (unsigned i = 0, e = Blocks.size(); i != e; ++i) {
+    BasicBlock *BB = Blocks[i];
+    B.SetInsertPoint(BlockBegin[BB]);
+    BasicBlock::iterator I = BB->begin();
+    for (; PHINode *PN = dyn_cast<PHINode>(I); ++I) {
+      bool V = isVarying(PN);
+      Type *Ty = V ? getVectorType(PN->getType()) : PN->getType();
+      PHINode *NewPN = B.CreatePHI(Ty, PN->getNumIncomingValues(),
+                                   getOldName(PN));
+      (V ? Vectors : Scalars)[PN] = NewPN;
+      Phis.push_back(PN);
+    }
+    for (TerminatorInst *T = BB->getTerminator(); &*I != T; ++I)
+      emitInstruction(I, 0);
+
+    BlockEnd[BB] = B.GetInsertBlock();
+    TerminatorInst *T = BB->getTerminator();
+    B.SetCurrentDebugLocation(T->getDebugLoc());
+    if (BranchInst *Br = dyn_cast<BranchInst>(T)) {
+      if (Br->isUnconditional())
+        B.CreateBr(BlockBegin[Br->getSuccessor(0)]);
+      else
+        B.CreateCondBr(getScalar(Br->getCondition()),
+                       BlockBegin[Br->getSuccessor(0)],
+                       BlockBegin[Br->getSuccessor(1)]);
+    } else if (SwitchInst *SI = dyn_cast<SwitchInst>(T)) {
+      SwitchInst *NewSI = B.CreateSwitch(getScalar(SI->getCondition()),
+                                         BlockBegin[SI->getDefaultDest()],
+                                         SI->getNumCases());
+      for (SwitchInst::CaseIt C = SI->case_begin(), CE = SI->case_end();
+           C != CE; ++C)
+        NewSI->addCase(C.getCaseValue(), BlockBegin[C.getCaseSuccessor()]);
+    } else if (isa<ReturnInst>(T)) {
+      B.CreateRetVoid();
+    } else {
+      B.CreateUnreachable();
+    }
+  }
+
+  for (unsigned i = 0, e = Phis.size(); i != e; ++i) {
+    PHINode *PN = Phis[i];
+    bool V = isVarying(PN);
+    PHINode *NewPN = cast<PHINode>(V ? Vectors[PN] : Scalars[PN]);
+    for (unsigned j = 0, je = PN->getNumIncomingValues(); j != je; ++j) {
+      DenseMap<BasicBlock *, BasicBlock *>::iterator It =
+          BlockEnd.find(PN->getIncomingBlock(j));
+      if (It == BlockEnd.end())
+        continue; // Unreachable predecessor.
+      B.SetInsertPoint(It->second->getTerminator());
+      Value *In = PN->getIncomingValue(j);
+      NewPN->addIncoming(V ? getVector(In) : getScalar(In), It->second);
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Divergent control flow
+//===----------------------------------------------------------------------===//
+
+/// Compute the values an edge From -> To brings to the phis of To.
+void KernelVectorizer::makeEdge(BasicBlock *To, BasicBlock *From, Value *Mask,
+                                Edge &E) {
+  E.Mask = Mask;
+  for (BasicBlock::iterator I = To->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+       ++I) {
+    Value *V = PN->getIncomingValueForBlock(From);
+    E.Vals.push_back(isVarying(PN) ? getVector(V) : getScalar(V));
+  }
+}
+
+/// Hand an edge to its target: a block or loop still to be emitted at this
+/// level, the header of the current loop, or an exit of the current loop.
+void KernelVectorizer::recordEdge(BasicBlock *To, const Edge &E) {
+  if (Loops.empty() || Loops.back().L->contains(To)) {
+    if (!Loops.empty() && To == Loops.back().Header)
+      Loops.back().BackEdges.push_back(E);
+    else
+      Incoming[To].push_back(E);
+    return;
+  }
+
+  // Lanes leaving the loop keep the values from the iteration they left in.
+  LoopState &LS = Loops.back();
+  unsigned Idx = std::find(LS.ExitBlocks.begin(), LS.ExitBlocks.end(), To) -
+                 LS.ExitBlocks.begin();
+  assert(Idx != LS.ExitBlocks.size() && "Edge leaves more than one loop?");
+  ExitState &ES = LS.Exits[Idx];
+  Value *M = getMaskVector(E.Mask);
+  ES.Mask = B.CreateOr(ES.Mask, M);
+  for (unsigned i = 0, e = ES.Vals.size(); i != e; ++i)
+    ES.Vals[i] = B.CreateSelect(M, E.Vals[i], ES.Vals[i]);
+}
+
+/// Merge the values for phi Idx from edges that no lane takes twice.
+Value *KernelVectorizer::blend(ArrayRef<Edge> Edges, unsigned Idx) {
+  Value *V = Edges.back().Vals[Idx];
+  for (unsigned i = Edges.size() - 1; i-- != 0;)
+    V = Edges[i].Mask ? B.CreateSelect(Edges[i].Mask, Edges[i].Vals[Idx], V)
+                      : Edges[i].Vals[Idx];
+  return V;
+}
+
+void KernelVectorizer::emitEdges(BasicBlock *BB, Value *Mask) {
+  TerminatorInst *T = BB->getTerminator();
+  B.SetCurrentDebugLocation(T->getDebugLoc());
+
+  // The lanes taking each distinct successor.
+  SmallVector<std::pair<BasicBlock *, Value *>, 4> Succs;
+  if (BranchInst *Br = dyn_cast<BranchInst>(T)) {
+    if (Br->isUnconditional() || Br->getSuccessor(0) == Br->getSuccessor(1)) {
+      Succs.push_back(std::make_pair(Br->getSuccessor(0), Mask));
+    } else {
+      Value *C = Br->getCondition();
+      C = isVarying(C) ? getVector(C) : getScalar(C);
+      Succs.push_back(std::make_pair(Br->getSuccessor(0),
+                                     maskIf(Mask, C, false)));
+      Succs.push_back(std::make_pair(Br->getSuccessor(1),
+                                     maskIf(Mask, C, true)));
+    }
+  } else if (SwitchInst *SI = dyn_cast<SwitchInst>(T)) {
+    Value *C = SI->getCondition();
+    bool V = isVarying(C);
+    C = V ? getVector(C) : getScalar(C);
+    Value *AnyCase = 0;
+    for (SwitchInst::CaseIt CI = SI->case_begin(), CE = SI->case_end();
+         CI != CE; ++CI) {
+      Value *CaseVal = CI.getCaseValue();
+      if (V)
+        CaseVal = ConstantVector::getSplat(Width, cast<Constant>(CaseVal));
+      Value *Match = B.CreateICmpEQ(C, CaseVal);
+      AnyCase = AnyCase ? B.CreateOr(AnyCase, Match) : Match;
+      BasicBlock *Dest = CI.getCaseSuccessor();
+      Value *M = maskIf(Mask, Match, false);
+      unsigned j = 0;
+      while (j != Succs.size() && Succs[j].first != Dest)
+        ++j;
+      if (j == Succs.size())
+        Succs.push_back(std::make_pair(Dest, M));
+      else
+        Succs[j].second = orMask(Succs[j].second, M);
+    }
+    Value *M = AnyCase ? maskIf(Mask, AnyCase, true) : Mask;
+    BasicBlock *Dest = SI->getDefaultDest();
+    unsigned j = 0;
+    while (j != Succs.size() && Succs[j].first != Dest)
+      ++j;
+    if (j == Succs.size())
+      Succs.push_back(std::make_pair(Dest, M));
+    else
+      Succs[j].second = orMask(Succs[j].second, M);
+  } else {
+    // Lanes that return or reach unreachable are done.
+    return;
+  }
+
+  for (unsigned i = 0, e = Succs.size(); i != e; ++i) {
+    Edge E;
+    makeEdge(Succs[i].first, BB, Succs[i].second, E);
+    recordEdge(Succs[i].first, E);
+  }
+}
+
+/// Returns true if every lane that enters the current loop iteration, or the
+/// kernel, goes through BB before leaving it.
+bool KernelVectorizer::isReachedByAllLanes(BasicBlock *BB) const {
+  if (Loops.empty())
+    return PDT.dominates(BB, &F.getEntryBlock());
+  Loop *L = Loops.back().L;
+  BasicBlock *Latch = L->getLoopLatch();
+  return Latch && PDT.dominates(BB, L->getHeader()) &&
+         DT.dominates(BB, Latch);
+}
+
+void KernelVectorizer::emitBlockNode(BasicBlock *BB) {
+  Value *Mask = 0;
+  BasicBlock::iterator I = BB->begin();
+  if (!Loops.empty() && Loops.back().L->getHeader() == BB) {
+    // The header phis were created by emitLoop.
+    Mask = Loops.back().Active;
+    while (isa<PHINode>(I))
+      ++I;
+  } else if (BB != &F.getEntryBlock()) {
+    SmallVector<Edge, 2> In;
+    In.swap(Incoming[BB]);
+    Incoming.erase(BB);
+    assert(!In.empty() && "Block emitted before its predecessors!");
+    if (isReachedByAllLanes(BB)) {
+      Mask = Loops.empty() ? 0 : Loops.back().Active;
+    } else {
+      Mask = In[0].Mask;
+      for (unsigned i = 1, e = In.size(); i != e; ++i)
+        Mask = orMask(Mask, In[i].Mask);
+    }
+    for (unsigned Idx = 0; PHINode *PN = dyn_cast<PHINode>(I); ++I, ++Idx) {
+      B.SetCurrentDebugLocation(PN->getDebugLoc());
+      Vectors[PN] = blend(In, Idx);
+    }
+  }
+
+  for (TerminatorInst *T = BB->getTerminator(); &*I != T; ++I)
+    emitInstruction(I, Mask);
+  emitEdges(BB, Mask);
+}
+
+// Lay a loop out as a straight run of its blocks that repeats while any lane
+// is still in the loop.
+void KernelVectorizer::emitLoop(Loop *L) {
+  BasicBlock *OldHeader = L->getHeader();
+  SmallVector<Edge, 2> In;
+  In.swap(Incoming[OldHeader]);
+  Incoming.erase(OldHeader);
+  assert(In.size() == 1 && "Loop without a preheader!");
+
+  BasicBlock *Pre = B.GetInsertBlock();
+  BasicBlock *Header = createBlock(getOldName(OldHeader));
+  B.CreateBr(Header);
+  B.SetInsertPoint(Header);
+
+  Loops.push_back(LoopState());
+  LoopState &LS = Loops.back();
+  LS.L = L;
+  LS.Header = OldHeader;
+  LS.Active = B.CreatePHI(MaskTy, 2, "spmd.active");
+  LS.Active->addIncoming(getMaskVector(In[0].Mask), Pre);
+
+  unsigned Idx = 0;
+  for (BasicBlock::iterator I = OldHeader->begin();
+       PHINode *PN = dyn_cast<PHINode>(I); ++I, ++Idx) {
+    bool V = isVarying(PN);
+    PHINode *NewPN = B.CreatePHI(V ? getVectorType(PN->getType())
+                                   : PN->getType(), 2, getOldName(PN));
+    NewPN->addIncoming(In[0].Vals[Idx], Pre);
+    (V ? Vectors : Scalars)[PN] = NewPN;
+    LS.HeaderPhis.push_back(NewPN);
+  }
+
+  L->getUniqueExitBlocks(LS.ExitBlocks);
+  for (unsigned i = 0, e = LS.ExitBlocks.size(); i != e; ++i) {
+    BasicBlock *X = LS.ExitBlocks[i];
+    LS.Exits.push_back(ExitState());
+    ExitState &ES = LS.Exits.back();
+    ES.MaskPhi = B.CreatePHI(MaskTy, 2, "spmd.exit");
+    ES.MaskPhi->addIncoming(Constant::getNullValue(MaskTy), Pre);
+    ES.Mask = ES.MaskPhi;
+    for (BasicBlock::iterator I = X->begin(); PHINode *PN = dyn_cast<PHINode>(I);
+         ++I) {
+      Type *Ty = getVectorType(PN->getType());
+      PHINode *Acc = B.CreatePHI(Ty, 2, getOldName(PN) + ".spmd.exit");
+      Acc->addIncoming(UndefValue::get(Ty), Pre);
+      ES.ValPhis.push_back(Acc);
+      ES.Vals.push_back(Acc);
+    }
+  }
+
+  emitLevel(L);
+
+  // Nested loops have been popped again, so the state is still at the back.
+  LoopState &Done = Loops.back();
+  BasicBlock *Latch = B.GetInsertBlock();
+  Value *BackMask = Done.BackEdges[0].Mask;
+  for (unsigned i = 1, e = Done.BackEdges.size(); i != e; ++i)
+    BackMask = orMask(BackMask, Done.BackEdges[i].Mask);
+  for (unsigned i = 0, e = Done.HeaderPhis.size(); i != e; ++i)
+    Done.HeaderPhis[i]->addIncoming(blend(Done.BackEdges, i), Latch);
+  BackMask = getMaskVector(BackMask);
+  Done.Active->addIncoming(BackMask, Latch);
+  for (unsigned i = 0, e = Done.Exits.size(); i != e; ++i) {
+    ExitState &ES = Done.Exits[i];
+    ES.MaskPhi->addIncoming(ES.Mask, Latch);
+    for (unsigned j = 0, je = ES.ValPhis.size(); j != je; ++j)
+      ES.ValPhis[j]->addIncoming(ES.Vals[j], Latch);
+  }
+
+  Value *Continue = reduceMask(BackMask, false);
+  BasicBlock *Exit = createBlock(getOldName(OldHeader) + ".spmd.exit");
+  B.CreateCondBr(Continue, Header, Exit);
+  B.SetInsertPoint(Exit);
+
+  // Everything that left the loop moves on from here.
+  LoopState Finished = Done;
+  Loops.pop_back();
+  for (unsigned i = 0, e = Finished.Exits.size(); i != e; ++i) {
+    Edge E;
+    E.Mask = Finished.Exits[i].Mask;
+    E.Vals.append(Finished.Exits[i].Vals.begin(), Finished.Exits[i].Vals.end());
+    recordEdge(Finished.ExitBlocks[i], E);
+  }
+}
+
+void KernelVectorizer::emitLevel(Loop *L) {
+  const std::vector<BasicBlock *> &Order = Orders[L];
+  for (unsigned i = 0, e = Order.size(); i != e; ++i) {
+    BasicBlock *N = Order[i];
+    Loop *NL = LI.getLoopFor(N);
+    if (NL != L)
+      emitLoop(NL);
+    else
+      emitBlockNode(N);
+  }
+}
+
+void KernelVectorizer::vectorize() {
+  std::vector<BasicBlock *> OldBlocks;
+  for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
+    OldBlocks.push_back(BB);
+    OldNames[BB] = BB->getName();
+    BB->setName("");
+    for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+      if (I->hasName()) {
+        OldNames[I] = I->getName();
+        I->setName("");
+      }
+  }
+
+  if (Linearize) {
+    ++NumLinearized;
+    B.SetInsertPoint(BasicBlock::Create(F.getContext(), "entry", &F));
+    emitLevel(0);
+    B.CreateRetVoid();
+  } else {
+    emitStructured(RPO);
+  }
+
+  for (unsigned i = 0, e = OldBlocks.size(); i != e; ++i)
+    OldBlocks[i]->dropAllReferences();
+  for (unsigned i = 0, e = OldBlocks.size(); i != e; ++i)
+    OldBlocks[i]->eraseFromParent();
+
+  // Clean up vector forms and splats nobody used.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+      for (BasicBlock::iterator I = BB->begin(); I != BB->end();) {
+        Instruction *Inst = I++;
+        if (isInstructionTriviallyDead(Inst)) {
+          Inst->eraseFromParent();
+          Changed = true;
+        }
+      }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// The pass
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+class SPMDVectorizer : public FunctionPass {
+public:
+  static char ID;
+
+  explicit SPMDVectorizer(unsigned W = 0, const char *IdName = 0)
+    : FunctionPass(ID), Width(W ? W : unsigned(SPMDWidth)) {
+    initializeSPMDVectorizerPass(*PassRegistry::getPassRegistry());
+    if (IdName) {
+      IdNames.push_back(IdName);
+    } else if (SPMDIdFunctions.empty()) {
+      IdNames.push_back("get_global_id");
+      IdNames.push_back("get_local_id");
+    } else {
+      IdNames.assign(SPMDIdFunctions.begin(), SPMDIdFunctions.end());
+    }
+  }
+
+  virtual bool runOnFunction(Function &F);
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<DominatorTree>();
+    AU.addRequired<PostDominatorTree>();
+    AU.addRequired<LoopInfo>();
+  }
+
+private:
+  unsigned Width;
+  std::vector<std::string> IdNames;
+};
+
+} // end anonymous namespace
+
+bool SPMDVectorizer::runOnFunction(Function &F) {
+  if (Width < 2 || F.isDeclaration() || !F.getReturnType()->isVoidTy() ||
+      F.hasFnAttribute("spmd-width"))
+    return false;
+  const DataLayout *DL = getAnalysisIfAvailable<DataLayout>();
+  if (!DL)
+    return false;
+
+  KernelVectorizer KV(F, *DL, getAnalysis<DominatorTree>(),
+                      getAnalysis<PostDominatorTree>(), getAnalysis<LoopInfo>(),
+                      Width, IdNames);
+  if (!KV.isKernel() || !KV.analyze())
+    return false;
+
+  DEBUG(dbgs() << "SPMD: vectorizing " << F.getName() << " by " << Width
+               << "\n");
+  KV.vectorize();
+  F.addFnAttr("spmd-width", utostr(Width));
+  ++NumKernels;
+  return true;
+}
+
+char SPMDVectorizer::ID = 0;
+static const char sv_name[] = "SPMD Vectorizer";
+INITIALIZE_PASS_BEGIN(SPMDVectorizer, SV_NAME, sv_name, false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTree)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopInfo)
+INITIALIZE_PASS_END(SPMDVectorizer, SV_NAME, sv_name, false, false)
+
+namespace llvm {
+Pass *createSPMDVectorizerPass(unsigned Width, const char *IdName) {
+  return new SPMDVectorizer(Width, IdName);
+}
+}
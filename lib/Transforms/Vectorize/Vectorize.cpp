@@ -29,6 +29,7 @@ void llvm::initializeVectorization(PassRegistry &Registry) {
   initializeBBVectorizePass(Registry);
   initializeLoopVectorizePass(Registry);
   initializeSLPVectorizerPass(Registry);
+  initializeSPMDVectorizerPass(Registry);
 }
 
 void LLVMInitializeVectorization(LLVMPassRegistryRef R) {
@@ -46,3 +47,7 @@ void LLVMAddLoopVectorizePass(LLVMPassManagerRef PM) {
 void LLVMAddSLPVectorizePass(LLVMPassManagerRef PM) {
   unwrap(PM)->add(createSLPVectorizerPass());
 }
+
+void LLVMAddSPMDVectorizePass(LLVMPassManagerRef PM) {
+  unwrap(PM)->add(createSPMDVectorizerPass());
+}
@@ -0,0 +1,195 @@
+; RUN: opt < %s -analyze -divergence | FileCheck %s
+
+target triple = "r600--"
+
+declare i32 @llvm.r600.read.tidig.x() nounwind readnone
+
+; The thread index is divergent, and so is everything computed from it.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'data':
+; CHECK: DIVERGENT: %tid = call i32 @llvm.r600.read.tidig.x()
+; CHECK: DIVERGENT: %idx = add i32 %tid, %n
+; CHECK-NOT: DIVERGENT: %base
+; CHECK: DIVERGENT: %p = getelementptr
+; CHECK: DIVERGENT: %v = load
+define void @data(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %idx = add i32 %tid, %n
+  %base = mul i32 %n, 4
+  %p = getelementptr i32 addrspace(1)* %out, i32 %idx
+  %v = load i32 addrspace(1)* %p
+  %q = getelementptr i32 addrspace(1)* %out, i32 %base
+  store i32 %v, i32 addrspace(1)* %q
+  ret void
+}
+
+; A phi at the join of a divergent branch is divergent; the uniform branch
+; inside the divergent one, and the phi at its join, are not.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'join':
+; CHECK: DIVERGENT: %cond = icmp slt i32 %tid, 16
+; CHECK: DIVERGENT: br i1 %cond, label %then, label %join
+; CHECK-NOT: DIVERGENT: br i1 %ucond
+; CHECK-NOT: DIVERGENT: %inner
+; CHECK: DIVERGENT: %r = phi i32
+define i32 @join(i32 %a, i32 %b) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %cond = icmp slt i32 %tid, 16
+  br i1 %cond, label %then, label %join
+
+then:
+  %ucond = icmp eq i32 %a, 0
+  br i1 %ucond, label %t1, label %t2
+
+t1:
+  br label %tjoin
+
+t2:
+  br label %tjoin
+
+tjoin:
+  %inner = phi i32 [ %a, %t1 ], [ %b, %t2 ]
+  br label %join
+
+join:
+  %r = phi i32 [ %inner, %tjoin ], [ 0, %entry ]
+  ret i32 %r
+}
+
+; A phi whose incoming values are all the same stays uniform.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'same':
+; CHECK-NOT: DIVERGENT: %r
+define i32 @same(i32 %a) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %cond = icmp slt i32 %tid, 16
+  br i1 %cond, label %then, label %join
+
+then:
+  br label %join
+
+join:
+  %r = phi i32 [ %a, %then ], [ %a, %entry ]
+  ret i32 %r
+}
+
+; A loop with a uniform trip count inside a divergent branch runs in step
+; for all threads that enter it.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'uniform_loop':
+; CHECK-NOT: DIVERGENT: %i =
+; CHECK-NOT: DIVERGENT: %i.next
+; CHECK-NOT: DIVERGENT: br i1 %again
+; CHECK: DIVERGENT: %r = phi i32
+define i32 @uniform_loop(i32 %n) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %cond = icmp slt i32 %tid, 16
+  br i1 %cond, label %loop, label %exit
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %again = icmp slt i32 %i.next, %n
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r = phi i32 [ %i.next, %loop ], [ 0, %entry ]
+  ret i32 %r
+}
+
+; With a divergent exit condition the induction variable is still uniform
+; inside the loop, but threads leave at different iterations, so its value
+; after the loop is divergent.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'divergent_exit':
+; CHECK-NOT: DIVERGENT: %i =
+; CHECK-NOT: DIVERGENT: %i.next =
+; CHECK: DIVERGENT: %again = icmp slt i32 %i.next, %tid
+; CHECK: DIVERGENT: br i1 %again
+; CHECK: DIVERGENT: %r = mul i32 %i.next, 2
+define i32 @divergent_exit() {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %again = icmp slt i32 %i.next, %tid
+  br i1 %again, label %loop, label %exit
+
+exit:
+  %r = mul i32 %i.next, 2
+  ret i32 %r
+}
+
+; Private memory and atomics differ between threads.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'memory':
+; CHECK: DIVERGENT: %priv = load i32* %slot
+; CHECK-NOT: DIVERGENT: %glob = load
+; CHECK: DIVERGENT: %old = atomicrmw add
+define i32 @memory(i32 addrspace(1)* %g) {
+entry:
+  %slot = alloca i32
+  store i32 1, i32* %slot
+  %priv = load i32* %slot
+  %glob = load i32 addrspace(1)* %g
+  %old = atomicrmw add i32 addrspace(1)* %g, i32 1 seq_cst
+  %s = add i32 %priv, %glob
+  %r = add i32 %s, %old
+  ret i32 %r
+}
+
+; Paths from both sides of a divergent branch can also meet before its
+; post-dominator.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'inner_join':
+; CHECK-NOT: DIVERGENT: br i1 %ucond
+; CHECK: DIVERGENT: %m = phi i32 [ %a, %left ], [ %b, %right ]
+; CHECK: DIVERGENT: %r = phi i32
+define i32 @inner_join(i32 %a, i32 %b) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %cond = icmp slt i32 %tid, 16
+  br i1 %cond, label %left, label %right
+
+left:
+  %ucond = icmp eq i32 %a, %b
+  br i1 %ucond, label %merge, label %skip
+
+right:
+  br label %merge
+
+merge:
+  %m = phi i32 [ %a, %left ], [ %b, %right ]
+  br label %end
+
+skip:
+  br label %end
+
+end:
+  %r = phi i32 [ %m, %merge ], [ 0, %skip ]
+  ret i32 %r
+}
+
+; An invoke is a terminator, but the users of its result are as divergent
+; as the result itself.
+; CHECK-LABEL: Printing analysis 'Divergence Analysis' for function 'invoke':
+; CHECK: DIVERGENT: %r = invoke i32 @callee(i32 %tid)
+; CHECK: DIVERGENT: %s = add i32 %r, 1
+declare i32 @callee(i32)
+declare i32 @personality(...)
+
+define i32 @invoke() {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %r = invoke i32 @callee(i32 %tid)
+          to label %ok unwind label %lpad
+
+ok:
+  %s = add i32 %r, 1
+  ret i32 %s
+
+lpad:
+  %lp = landingpad { i8*, i32 } personality i32 (...)* @personality
+          cleanup
+  ret i32 0
+}
@@ -0,0 +1,82 @@
+; RUN: opt < %s -basicaa -analyze -memoryssa | FileCheck %s
+
+declare void @f(i32*)
+declare i32 @g(i32*) readonly
+
+; Stores are defs, loads and read-only calls are uses; every access names
+; the def before it.
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'straight':
+; CHECK: ; 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i32 0, i32* %p
+; CHECK: ; MemoryUse(1)
+; CHECK-NEXT: %v = load i32* %p
+; CHECK: ; MemoryUse(1)
+; CHECK-NEXT: %w = call i32 @g(i32* %p)
+; CHECK: ; 2 = MemoryDef(1)
+; CHECK-NEXT: call void @f(i32* %p)
+; CHECK: ; MemoryUse(2)
+; CHECK-NEXT: %x = load i32* %p
+; CHECK-NOT: Memory
+; CHECK: ret i32
+define i32 @straight(i32* %p) {
+entry:
+  store i32 0, i32* %p
+  %v = load i32* %p
+  %w = call i32 @g(i32* %p)
+  call void @f(i32* %p)
+  %x = load i32* %p
+  %y = add i32 %v, %w
+  %z = add i32 %y, %x
+  ret i32 %z
+}
+
+; A block where different memory states meet gets a phi.
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'diamond':
+; CHECK: then:
+; CHECK: ; 2 = MemoryDef(1)
+; CHECK: join:
+; CHECK: ; 3 = MemoryPhi({%entry,1},{%then,2})
+; CHECK: ; MemoryUse(3)
+; CHECK-NEXT: %v = load i32* %p
+define i32 @diamond(i1 %c, i32* %p, i32* %q) {
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 1, i32* %q
+  br label %join
+
+join:
+  %v = load i32* %p
+  ret i32 %v
+}
+
+; A loop that writes memory gets a phi in its header.
+; CHECK-LABEL: Printing analysis 'Memory SSA' for function 'loop':
+; CHECK: loop:
+; CHECK: ; 1 = MemoryPhi({%entry,liveOnEntry},{%loop,2})
+; CHECK: ; MemoryUse(1)
+; CHECK-NEXT: %v = load i32* %p
+; CHECK: ; 2 = MemoryDef(1)
+; CHECK-NEXT: store i32 %i, i32* %q
+; CHECK: exit:
+; CHECK-NOT: MemoryPhi
+; CHECK: ; MemoryUse(2)
+; CHECK-NEXT: %w = load i32* %p
+define i32 @loop(i32* %p, i32* %q, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32* %p
+  store i32 %i, i32* %q
+  %i.next = add i32 %i, %v
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %w = load i32* %p
+  ret i32 %w
+}
@@ -0,0 +1,25 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s
+; RUN: llvm-as < %s > %t.bc
+; RUN: llvm-extract -func=g %t.bc -S -o - | FileCheck --check-prefix=EXTRACT %s
+
+; The function index comes before the function bodies.
+; CHECK: <FUNCTION_INDEX_BLOCK
+; CHECK-NEXT: <OFFSETS abbrevid=4/> blob data = {{.*}}8 bytes
+; CHECK-NEXT: </FUNCTION_INDEX_BLOCK>
+; CHECK: <FUNCTION_BLOCK
+; CHECK: <FUNCTION_BLOCK
+
+; EXTRACT: define i32 @g(i32 %x)
+; EXTRACT-NEXT: %r = mul i32 %x, 3
+
+declare void @h()
+
+define i32 @f(i32 %x) {
+  %r = add i32 %x, 1
+  ret i32 %r
+}
+
+define i32 @g(i32 %x) {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
@@ -0,0 +1,77 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -O0 -fast-isel -fast-isel-abort | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -O0 -fast-isel -o /dev/null -stats 2>&1 | FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; Everything past the argument lowering is selected by FastISel; with
+; -fast-isel-abort a fallback to SelectionDAG would be fatal.
+
+; STATS: 7 isel - Number of blocks selected entirely by fast isel
+; STATS: 16 isel - Number of insts selected by target-specific selector
+
+; CHECK-LABEL: // @arith
+; CHECK: add [[S:acc[0-9]]], [[A:acc[0-9]]], [[B:acc[0-9]]]
+; CHECK-NEXT: mul24 [[M:acc[0-9]]], [[S]], [[B]]
+; CHECK-NEXT: xor ra0, [[M]], [[A]]
+define i32 @arith(i32 %a, i32 %b) {
+  %s = add i32 %a, %b
+  %m = mul i32 %s, %b
+  %x = xor i32 %m, %a
+  ret i32 %x
+}
+
+; Address space 1 is the VPM.
+; CHECK-LABEL: // @mem
+; CHECK: load_word [[V:acc[0-9]]], {{acc[0-9]}}, 0{{$}}
+; CHECK-NEXT: store_word [[V]], {{acc[0-9]}}, 0 vpm, 1
+define void @mem(i32* %p, i32 addrspace(1)* %q) {
+  %v = load i32* %p
+  store i32 %v, i32 addrspace(1)* %q
+  ret void
+}
+
+; CHECK-LABEL: // @fvec
+; CHECK: fadd [[S:acc[0-9]]]
+; CHECK-NEXT: fmul [[M:acc[0-9]]], [[S]]
+; CHECK-NEXT: store_word [[M]], {{acc[0-9]}}, 0, 16
+define void @fvec(<16 x float>* %p, <16 x float>* %q) {
+  %a = load <16 x float>* %p
+  %b = load <16 x float>* %q
+  %s = fadd <16 x float> %a, %b
+  %m = fmul <16 x float> %s, %a
+  store <16 x float> %m, <16 x float>* %q
+  ret void
+}
+
+; CHECK-LABEL: // @conv
+; CHECK: itof [[F:acc[0-9]]], [[I:acc[0-9]]], [[I]]
+; CHECK-NEXT: store_word [[F]]
+; CHECK: ftoi [[J:acc[0-9]]], [[G:acc[0-9]]], [[G]]
+; CHECK-NEXT: store_word [[J]]
+define void @conv(i32* %p, float* %q) {
+  %v = load i32* %p
+  %f = sitofp i32 %v to float
+  store float %f, float* %q
+  %g = load float* %q
+  %i = fptosi float %g to i32
+  store i32 %i, i32* %p
+  ret void
+}
+
+; The compare sets the flags, which pick the branch.  Values live across the
+; blocks are spilled at -O0.
+; CHECK-LABEL: // @branch
+; CHECK: subs wra_nop, [[A:acc[0-9]]], [[B:acc[0-9]]]
+; CHECK: store_word {{acc[0-9]}}, sp, {{[0-9]+}}, 1 // 4-byte Folded Spill
+; CHECK: blaallzc wra_nop, wrb_nop, #$BB4_1#
+; CHECK-NEXT: bla wra_nop, wrb_nop, #$BB4_2#
+; CHECK: $BB4_1:
+; CHECK-NEXT: load_word ra0, sp, {{[0-9]+}} // 4-byte Folded Reload
+define i32 @branch(i32 %a, i32 %b) {
+entry:
+  %c = icmp slt i32 %a, %b
+  br i1 %c, label %then, label %else
+then:
+  ret i32 %a
+else:
+  ret i32 %b
+}
@@ -0,0 +1,9 @@
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel 2>&1 | FileCheck %s
+
+; Kernel arguments are read from the uniform stream one 32-bit word each.
+
+; CHECK: LLVM ERROR: Qpu kernel 'kernel' can only take 32-bit integer or pointer arguments
+define void @kernel(float %x, float* %out) {
+  store float %x, float* %out
+  ret void
+}
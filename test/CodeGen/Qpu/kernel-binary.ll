@@ -0,0 +1,40 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -qpu-kernel-binary=%t | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel | FileCheck %s -check-prefix=NOBIN
+
+; The launch metadata written to the kernel binary is echoed in the assembly.
+; VPM rows are counted from the start of each object to the last byte used.
+
+; NOBIN-NOT: kernel entry
+
+; The vector access reaches rows 0-2 of %p and the scalar bytes 80-83 of %q,
+; which is in row 1.
+; CHECK-LABEL: // @rows
+; CHECK: // kernel entry: 2 uniforms, 0 TMU loads, 5 VPM rows, flags 0xe, registers 0x{{[0-9a-f]+}}
+define void @rows(<16 x float> addrspace(1)* %p, float addrspace(1)* %q) {
+  %a = getelementptr <16 x float> addrspace(1)* %p, i32 2
+  %v = load <16 x float> addrspace(1)* %a
+  store <16 x float> %v, <16 x float> addrspace(1)* %p
+  %b = getelementptr float addrspace(1)* %q, i32 20
+  %e = extractelement <16 x float> %v, i32 0
+  store float %e, float addrspace(1)* %b
+  ret void
+}
+
+; A variable offset may reach any of the 192 rows.
+; CHECK-LABEL: // @indexed
+; CHECK: // kernel entry: 3 uniforms, 0 TMU loads, 192 VPM rows, flags 0xc, registers 0x{{[0-9a-f]+}}
+define void @indexed(i32 addrspace(1)* %p, i32 %i, i32 %x) {
+  %a = getelementptr i32 addrspace(1)* %p, i32 %i
+  store i32 %x, i32 addrspace(1)* %a
+  ret void
+}
+
+; Loads outside the VPM go through the TMU.
+; CHECK-LABEL: // @tmu
+; CHECK: // kernel entry: 2 uniforms, 1 TMU loads, 0 VPM rows, flags 0xd, registers 0x{{[0-9a-f]+}}
+define void @tmu(i32* %p, i32* %q) {
+  %v = load i32* %p
+  %w = add i32 %v, 1
+  store i32 %w, i32* %q
+  ret void
+}
@@ -0,0 +1,36 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -relocation-model=pic | FileCheck %s
+
+; A kernel is a frameless leaf: its callees are inlined, its arguments come
+; from the uniform stream, and even with PIC its globals are addressed
+; absolutely, so $gp is never set up or restored.
+
+; CHECK-NOT: @helper
+; CHECK-LABEL: // @kernel
+; CHECK-NOT: cpload
+; CHECK-NOT: cprestore
+; CHECK-NOT: sp
+; CHECK: mov {{acc[0-9]}}, unif
+; CHECK-NEXT: mov {{acc[0-9]}}, unif
+; CHECK-NEXT: mov {{acc[0-9]}}, unif
+; CHECK: il {{acc[0-9]}}, #table#
+; CHECK: load_word
+; CHECK: store_word
+; CHECK-NOT: sp
+; CHECK: bla wra_nop, wrb_nop, lr
+; CHECK-NOT: @helper
+
+@table = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+
+define internal i32 @helper(i32 %x, i32 %i) {
+  %p = getelementptr [4 x i32]* @table, i32 0, i32 %i
+  %t = load i32* %p
+  %r = add i32 %x, %t
+  ret i32 %r
+}
+
+define void @kernel(i32* %out, i32 %x, i32 %i) {
+entry:
+  %r = call i32 @helper(i32 %x, i32 %i)
+  store i32 %r, i32* %out
+  ret void
+}
@@ -0,0 +1,13 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -debug-pass=Structure 2>&1 | FileCheck %s -check-prefix=KERNEL
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -o /dev/null -debug-pass=Structure 2>&1 | FileCheck %s
+
+; Kernels never set up $gp, so they do not run the pass that restores it
+; after calls.
+
+; KERNEL-NOT: Qpu Emit GP Restore
+; CHECK: Qpu Emit GP Restore
+define void @kernel(i32* %out, i32 %x) {
+entry:
+  store i32 %x, i32* %out
+  ret void
+}
@@ -0,0 +1,62 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -qpu-report=%t
+; RUN: FileCheck %s < %t
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -qpu-report=%t.dir/missing/report.yaml 2>&1 | FileCheck %s -check-prefix=ERR
+
+; One YAML document per function, with a nested entry for every loop.
+
+; CHECK: ---
+; CHECK-NEXT: Function:
+; CHECK-NEXT:   Name: scale
+; CHECK-NEXT:   RegsA: 2
+; CHECK-NEXT:   RegsB: 1
+; CHECK-NEXT:   RegsAcc: 4
+; CHECK-NEXT:   Spills: 0
+; CHECK-NEXT:   Reloads: 0
+; CHECK-NEXT:   Instructions: 14
+; CHECK-NEXT:   Cycles: {{[0-9]+}}
+; CHECK-NEXT:   Stalls: {{[0-9]+}}
+; CHECK-NEXT:   DelaySlotFill: 0.333333
+; CHECK-NEXT: Loops:
+; CHECK-NEXT:   - Name: 'BB#1'
+; CHECK-NEXT:     Depth: 1
+; CHECK:          Instructions: 9
+; CHECK:          DelaySlotFill: 0.5
+; CHECK-NEXT: ...
+
+; CHECK-NEXT: ---
+; CHECK-NEXT: Function:
+; CHECK-NEXT:   Name: flat
+; CHECK-NEXT:   RegsA: 0
+; CHECK-NEXT:   RegsB: 0
+; CHECK-NEXT:   RegsAcc: 2
+; CHECK:        Instructions: 5
+; CHECK-NEXT:   Cycles: 5
+; CHECK-NEXT:   Stalls: 0
+; CHECK-NEXT:   DelaySlotFill: 0
+; CHECK-NEXT: ...
+
+; ERR: cannot open Qpu report
+
+define void @scale(i32 addrspace(1)* %p, i32 %n, i32 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %a = getelementptr i32 addrspace(1)* %p, i32 %i
+  %v = load i32 addrspace(1)* %a
+  %m = mul i32 %v, %k
+  store i32 %m, i32 addrspace(1)* %a
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define void @flat(i32* %p, i32 %x) {
+  %y = add i32 %x, 7
+  store i32 %y, i32* %p
+  ret void
+}
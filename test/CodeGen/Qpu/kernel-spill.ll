@@ -0,0 +1,95 @@
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel 2>&1 | FileCheck %s
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -regalloc=pbqp 2>&1 | FileCheck %s
+
+; A kernel has no stack to spill to.  Twenty-eight values live at once do not fit
+; in its registers, and even though PBQP gives spilling an infinite cost, its
+; solver still picks it once the registers conflict with each other.
+
+; CHECK: LLVM ERROR: Qpu kernel 'pressure' requires spilling{{$}}
+define void @pressure(i32* %p, i32* %q) {
+  %a0 = getelementptr i32* %p, i32 0
+  %v0 = load volatile i32* %a0
+  %a1 = getelementptr i32* %p, i32 1
+  %v1 = load volatile i32* %a1
+  %a2 = getelementptr i32* %p, i32 2
+  %v2 = load volatile i32* %a2
+  %a3 = getelementptr i32* %p, i32 3
+  %v3 = load volatile i32* %a3
+  %a4 = getelementptr i32* %p, i32 4
+  %v4 = load volatile i32* %a4
+  %a5 = getelementptr i32* %p, i32 5
+  %v5 = load volatile i32* %a5
+  %a6 = getelementptr i32* %p, i32 6
+  %v6 = load volatile i32* %a6
+  %a7 = getelementptr i32* %p, i32 7
+  %v7 = load volatile i32* %a7
+  %a8 = getelementptr i32* %p, i32 8
+  %v8 = load volatile i32* %a8
+  %a9 = getelementptr i32* %p, i32 9
+  %v9 = load volatile i32* %a9
+  %a10 = getelementptr i32* %p, i32 10
+  %v10 = load volatile i32* %a10
+  %a11 = getelementptr i32* %p, i32 11
+  %v11 = load volatile i32* %a11
+  %a12 = getelementptr i32* %p, i32 12
+  %v12 = load volatile i32* %a12
+  %a13 = getelementptr i32* %p, i32 13
+  %v13 = load volatile i32* %a13
+  %a14 = getelementptr i32* %p, i32 14
+  %v14 = load volatile i32* %a14
+  %a15 = getelementptr i32* %p, i32 15
+  %v15 = load volatile i32* %a15
+  %a16 = getelementptr i32* %p, i32 16
+  %v16 = load volatile i32* %a16
+  %a17 = getelementptr i32* %p, i32 17
+  %v17 = load volatile i32* %a17
+  %a18 = getelementptr i32* %p, i32 18
+  %v18 = load volatile i32* %a18
+  %a19 = getelementptr i32* %p, i32 19
+  %v19 = load volatile i32* %a19
+  %a20 = getelementptr i32* %p, i32 20
+  %v20 = load volatile i32* %a20
+  %a21 = getelementptr i32* %p, i32 21
+  %v21 = load volatile i32* %a21
+  %a22 = getelementptr i32* %p, i32 22
+  %v22 = load volatile i32* %a22
+  %a23 = getelementptr i32* %p, i32 23
+  %v23 = load volatile i32* %a23
+  %a24 = getelementptr i32* %p, i32 24
+  %v24 = load volatile i32* %a24
+  %a25 = getelementptr i32* %p, i32 25
+  %v25 = load volatile i32* %a25
+  %a26 = getelementptr i32* %p, i32 26
+  %v26 = load volatile i32* %a26
+  %a27 = getelementptr i32* %p, i32 27
+  %v27 = load volatile i32* %a27
+  %s26 = mul i32 %v27, %v26
+  %s25 = mul i32 %s26, %v25
+  %s24 = mul i32 %s25, %v24
+  %s23 = mul i32 %s24, %v23
+  %s22 = mul i32 %s23, %v22
+  %s21 = mul i32 %s22, %v21
+  %s20 = mul i32 %s21, %v20
+  %s19 = mul i32 %s20, %v19
+  %s18 = mul i32 %s19, %v18
+  %s17 = mul i32 %s18, %v17
+  %s16 = mul i32 %s17, %v16
+  %s15 = mul i32 %s16, %v15
+  %s14 = mul i32 %s15, %v14
+  %s13 = mul i32 %s14, %v13
+  %s12 = mul i32 %s13, %v12
+  %s11 = mul i32 %s12, %v11
+  %s10 = mul i32 %s11, %v10
+  %s9 = mul i32 %s10, %v9
+  %s8 = mul i32 %s9, %v8
+  %s7 = mul i32 %s8, %v7
+  %s6 = mul i32 %s7, %v6
+  %s5 = mul i32 %s6, %v5
+  %s4 = mul i32 %s5, %v4
+  %s3 = mul i32 %s4, %v3
+  %s2 = mul i32 %s3, %v2
+  %s1 = mul i32 %s2, %v1
+  %s0 = mul i32 %s1, %v0
+  store i32 %s0, i32* %q
+  ret void
+}
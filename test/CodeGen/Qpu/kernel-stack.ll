@@ -0,0 +1,15 @@
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel 2>&1 | FileCheck %s
+
+; A kernel has no stack, so one that needs a frame is rejected.
+
+; CHECK: LLVM ERROR: Qpu kernel 'kernel' needs 32 bytes of stack
+define void @kernel(i32 %n) {
+entry:
+  %buf = alloca [8 x i32]
+  %p = getelementptr [8 x i32]* %buf, i32 0, i32 %n
+  store volatile i32 %n, i32* %p
+  %v = load volatile i32* %p
+  %q = getelementptr [8 x i32]* %buf, i32 0, i32 0
+  store volatile i32 %v, i32* %q
+  ret void
+}
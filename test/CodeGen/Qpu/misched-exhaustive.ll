@@ -0,0 +1,59 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -enable-qpu-modulo-sched=false | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -enable-qpu-modulo-sched=false -qpu-sched-exhaustive=false | FileCheck %s -check-prefix=GENERIC
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -enable-qpu-modulo-sched=false -o /dev/null -stats 2>&1 | FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; The loop body is a small hot region with two independent chains. The
+; optimal schedule hides the integer chain in the latency of the float one,
+; where the generic strategy finishes the float chain first.
+
+; STATS: 1 misched {{.*}} Number of regions scheduled optimally
+
+; CHECK-LABEL: // @interleave
+; CHECK: Inner Loop Header
+; CHECK: load_word
+; CHECK: load_word
+; CHECK-NEXT: fmul
+; CHECK-NEXT: fmul
+; CHECK-NEXT: add
+; CHECK-NEXT: fadd
+; CHECK-NEXT: shl
+; CHECK-NEXT: store_word
+; CHECK-NEXT: store_word
+
+; GENERIC-LABEL: // @interleave
+; GENERIC: Inner Loop Header
+; GENERIC: load_word
+; GENERIC: load_word
+; GENERIC-NEXT: fmul
+; GENERIC-NEXT: fmul
+; GENERIC-NEXT: fadd
+; GENERIC-NEXT: store_word
+; GENERIC-NEXT: add
+; GENERIC-NEXT: shl
+; GENERIC-NEXT: store_word
+define void @interleave(float* noalias %a, i32* noalias %b, i32 %n, i32 %ki) {
+entry:
+  %k = bitcast i32 %ki to float
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr float* %a, i32 %i
+  %x = load float* %p, align 4
+  %m1 = fmul float %x, %k
+  %m2 = fmul float %m1, %m1
+  %m3 = fadd float %m2, %k
+  store float %m3, float* %p, align 4
+  %q = getelementptr i32* %b, i32 %i
+  %y = load i32* %q, align 4
+  %y1 = add i32 %y, %ki
+  %y2 = shl i32 %y1, 3
+  store i32 %y2, i32* %q, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,75 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -debug-only=misched 2>&1 | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -stats 2>&1 | FileCheck %s -check-prefix=STATS
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -stats -qpu-sched-exhaustive=false 2>&1 | FileCheck %s -check-prefix=GENERIC
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -stats -qpu-sched-hot-freq=100000 2>&1 | FileCheck %s -check-prefix=COLD
+; REQUIRES: asserts
+
+; The scheduler picks a strategy per region from the block frequency. The
+; software pipelined kernel keeps its order, the blocks of the second loop
+; are hot and scheduled optimally, and the entry, the pipeline prologue and
+; epilogue, and the exit are cold and list scheduled.
+
+; CHECK: BB#0: cold, list
+; CHECK: BB#3: pipelined, source order
+; CHECK: BB#4: cold, list
+; CHECK: BB#7: hot, exhaustive
+; CHECK: BB#8: hot, exhaustive
+; CHECK: BB#9: hot, exhaustive
+; CHECK: BB#10: cold, list
+
+; STATS: 2 misched {{.*}} Number of pipelined regions kept in order
+; STATS: 9 misched {{.*}} Number of regions list scheduled
+; STATS: 3 misched {{.*}} Number of regions scheduled optimally
+
+; GENERIC: 2 misched {{.*}} Number of pipelined regions kept in order
+; GENERIC: 9 misched {{.*}} Number of regions list scheduled
+; GENERIC: 5 misched {{.*}} Number of regions scheduled by the generic
+; GENERIC-NOT: scheduled optimally
+
+; The pipelined kernel is kept in order however cold it is.
+; COLD: 2 misched {{.*}} Number of pipelined regions kept in order
+; COLD: 14 misched {{.*}} Number of regions list scheduled
+; COLD-NOT: scheduled optimally
+
+define void @strategy(i32* %a, i32 addrspace(1)* %b0, i32* %b, i32 %n, i32 %k) {
+entry:
+  %k2 = mul i32 %k, %k
+  %k3 = add i32 %k2, 7
+  br label %pipe
+
+pipe:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %pipe ]
+  %p = getelementptr i32* %a, i32 %i
+  %v = load i32* %p, align 4
+  %m = mul i32 %v, %k3
+  %s = add i32 %m, %k
+  %pb = getelementptr i32 addrspace(1)* %b0, i32 %i
+  store i32 %s, i32 addrspace(1)* %pb, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %pipe, label %mid
+
+mid:
+  br label %body
+
+body:
+  %j = phi i32 [ 0, %mid ], [ %j.next, %latch ]
+  %q = getelementptr i32* %b, i32 %j
+  %w = load i32* %q, align 4
+  %isodd = icmp slt i32 %w, %k
+  br i1 %isodd, label %then, label %latch
+
+then:
+  %w2 = mul i32 %w, %k
+  %w3 = add i32 %w2, %k3
+  store i32 %w3, i32* %q, align 4
+  br label %latch
+
+latch:
+  %j.next = add i32 %j, 1
+  %c2 = icmp slt i32 %j.next, %n
+  br i1 %c2, label %body, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,38 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -stats 2>&1 | FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; The loop ends in a compare, which has no selection pattern and so looks
+; like it touches memory; it must not keep the loop from being pipelined.
+; The kernel stores the product of an earlier iteration after issuing the
+; load of the current one, and the prologue only loads.
+
+; STATS: 1 qpu-modulo-sched - Number of loops software pipelined
+
+; CHECK-LABEL: // @scale
+; CHECK: load_word
+; CHECK-NOT: store_word
+; CHECK: Inner Loop Header
+; CHECK: mul24
+; CHECK: load_word
+; CHECK: store_word {{.*}} vpm
+; CHECK: blaallns
+; CHECK: store_word {{.*}} vpm
+define void @scale(i32* %a, i32 addrspace(1)* %b, i32 %n, i32 %k) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr i32* %a, i32 %i
+  %v = load i32* %p, align 4
+  %m = mul i32 %v, %k
+  %q = getelementptr i32 addrspace(1)* %b, i32 %i
+  store i32 %m, i32 addrspace(1)* %q, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
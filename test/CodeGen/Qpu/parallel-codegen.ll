@@ -0,0 +1,36 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -filetype=obj -j2 -o %t
+; RUN: llvm-nm %t | FileCheck %s
+; RUN: llvm-readobj -s %t | FileCheck --check-prefix=SECTIONS %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -filetype=obj -j2 -o %t2
+; RUN: cmp %t %t2
+
+; Generate the kernels on two threads and check that the combined Qpu
+; object keeps each kernel and the COMDAT group of the linkonce one.
+
+; CHECK:      T f
+; CHECK-NEXT: W g
+; CHECK-NEXT: T h
+
+; SECTIONS:     Name: .text (
+; SECTIONS:     Name: .group (
+; SECTIONS-NOT: Name: .group (
+; SECTIONS:     Name: .text (
+; SECTIONS:     Name: .text.g (
+; SECTIONS-NOT: Name: .text
+
+define void @f(i32* %p, i32* %q) {
+  %v = load i32* %p
+  %w = add i32 %v, 1
+  store i32 %w, i32* %q
+  ret void
+}
+
+define linkonce_odr void @g(i32* %p) {
+  store i32 7, i32* %p
+  ret void
+}
+
+define void @h(i32* %p) {
+  store i32 3, i32* %p
+  ret void
+}
@@ -0,0 +1,13 @@
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -regalloc=pbqp 2>&1 | FileCheck %s
+
+; Every register is clobbered while %v is live, so the only option left in its
+; PBQP cost vector is a spill, which a kernel cannot do.
+
+; CHECK: LLVM ERROR: Qpu kernel 'clobber' requires spilling: no register can hold %vreg{{[0-9]+}}
+
+define void @clobber(i32* %p, i32* %q) {
+  %v = load i32* %p
+  call void asm sideeffect "", "~{acc0},~{acc1},~{acc2},~{acc3},~{acc5},~{ra0},~{ra1},~{ra2},~{ra3},~{ra4},~{ra5},~{ra6},~{ra7},~{rb0},~{rb1},~{rb2},~{rb3},~{rb4},~{rb5},~{rb6},~{rb7}"()
+  store i32 %v, i32* %q
+  ret void
+}
@@ -0,0 +1,69 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -regalloc=pbqp | FileCheck %s
+
+; With PBQP the Qpu constraints keep every instruction to one register of
+; each regfile, and keep kernel values out of the stack they do not have:
+; neither kernel spills.
+
+; CHECK-LABEL: // @stream
+; CHECK-NOT: {{ [a-z0-9_]+, ra[0-9]+, ra[0-9]+}}
+; CHECK-NOT: {{ [a-z0-9_]+, rb[0-9]+, rb[0-9]+}}
+; CHECK-NOT: {{store_word ra[0-9]+, ra[0-9]+}}
+; CHECK-NOT: {{store_word rb[0-9]+, rb[0-9]+}}
+; CHECK: .size stream
+define void @stream(float* noalias %a, float* noalias %b, i32 %n, i32 %ki) {
+entry:
+  %k = bitcast i32 %ki to float
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr float* %a, i32 %i
+  %x = load float* %p, align 4
+  %q = getelementptr float* %b, i32 %i
+  %y = load float* %q, align 4
+  %m = fmul float %x, %k
+  %s = fadd float %m, %y
+  %t = fmul float %s, %y
+  store float %t, float* %q, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; Two loop carried values are read together with a loop invariant one.
+; CHECK-LABEL: // @ports
+; CHECK-NOT: {{ [a-z0-9_]+, ra[0-9]+, ra[0-9]+}}
+; CHECK-NOT: {{ [a-z0-9_]+, rb[0-9]+, rb[0-9]+}}
+; CHECK-NOT: {{store_word ra[0-9]+, ra[0-9]+}}
+; CHECK-NOT: {{store_word rb[0-9]+, rb[0-9]+}}
+; CHECK: .size ports
+define void @ports(float* noalias %a, float* noalias %b, i32 %n, i32 %ki, i32 %kj) {
+entry:
+  %k = bitcast i32 %ki to float
+  %j = bitcast i32 %kj to float
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi float [ %k, %entry ], [ %s.next, %loop ]
+  %t = phi float [ %j, %entry ], [ %t.next, %loop ]
+  %p = getelementptr float* %a, i32 %i
+  %x = load float* %p, align 4
+  %m = fmul float %x, %k
+  %s.next = fadd float %s, %m
+  %t.next = fmul float %t, %s
+  %u = fadd float %t.next, %j
+  %q = getelementptr float* %b, i32 %i
+  store float %u, float* %q, align 4
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = fadd float %s.next, %t.next
+  store float %r, float* %a, align 4
+  ret void
+}
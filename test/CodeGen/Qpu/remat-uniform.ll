@@ -0,0 +1,182 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -o /dev/null -stats 2>&1 | FileCheck %s -check-prefix=STATS
+; REQUIRES: asserts
+
+; A kernel has no stack to spill to. The values an immediate away from an
+; argument that is still live are recomputed at their uses instead, with an
+; il first when the immediate does not fit the small immediate field.
+
+; STATS: 56 regalloc {{.*}} Number of rematerialized defs for spilling
+
+; CHECK-LABEL: // @spread
+; CHECK: %exit
+; CHECK-NEXT: add [[V:[a-z0-9]+]], [[U:[a-z0-9]+]], -16
+; CHECK-NEXT: store_word [[V]]
+; CHECK: add [[V:[a-z0-9]+]], [[U]], 8
+; CHECK-NEXT: store_word [[V]]
+; CHECK: il [[V:[a-z0-9]+]], 100
+; CHECK-NEXT: add [[V]], [[U]], [[V]]
+; CHECK-NEXT: store_word [[V]]
+; CHECK: il [[V:[a-z0-9]+]], 131
+; CHECK-NEXT: add [[V]], [[U]], [[V]]
+; CHECK-NEXT: store_word [[V]]
+define void @spread(i32* %a, i32 %n, i32 %u) {
+entry:
+  %v0 = add i32 %u, -16
+  %v1 = add i32 %u, -15
+  %v2 = add i32 %u, -14
+  %v3 = add i32 %u, -13
+  %v4 = add i32 %u, -12
+  %v5 = add i32 %u, -11
+  %v6 = add i32 %u, -10
+  %v7 = add i32 %u, -9
+  %v8 = add i32 %u, -8
+  %v9 = add i32 %u, -7
+  %v10 = add i32 %u, -6
+  %v11 = add i32 %u, -5
+  %v12 = add i32 %u, -4
+  %v13 = add i32 %u, -3
+  %v14 = add i32 %u, -2
+  %v15 = add i32 %u, -1
+  %v16 = add i32 %u, 0
+  %v17 = add i32 %u, 1
+  %v18 = add i32 %u, 2
+  %v19 = add i32 %u, 3
+  %v20 = add i32 %u, 4
+  %v21 = add i32 %u, 5
+  %v22 = add i32 %u, 6
+  %v23 = add i32 %u, 7
+  %v24 = add i32 %u, 8
+  %v25 = add i32 %u, 9
+  %v26 = add i32 %u, 10
+  %v27 = add i32 %u, 11
+  %v28 = add i32 %u, 12
+  %v29 = add i32 %u, 13
+  %v30 = add i32 %u, 14
+  %v31 = add i32 %u, 15
+  %v32 = add i32 %u, 100
+  %v33 = add i32 %u, 101
+  %v34 = add i32 %u, 102
+  %v35 = add i32 %u, 103
+  %v36 = add i32 %u, 104
+  %v37 = add i32 %u, 105
+  %v38 = add i32 %u, 106
+  %v39 = add i32 %u, 107
+  %v40 = add i32 %u, 108
+  %v41 = add i32 %u, 109
+  %v42 = add i32 %u, 110
+  %v43 = add i32 %u, 111
+  %v44 = add i32 %u, 112
+  %v45 = add i32 %u, 113
+  %v46 = add i32 %u, 114
+  %v47 = add i32 %u, 115
+  %v48 = add i32 %u, 116
+  %v49 = add i32 %u, 117
+  %v50 = add i32 %u, 118
+  %v51 = add i32 %u, 119
+  %v52 = add i32 %u, 120
+  %v53 = add i32 %u, 121
+  %v54 = add i32 %u, 122
+  %v55 = add i32 %u, 123
+  %v56 = add i32 %u, 124
+  %v57 = add i32 %u, 125
+  %v58 = add i32 %u, 126
+  %v59 = add i32 %u, 127
+  %v60 = add i32 %u, 128
+  %v61 = add i32 %u, 129
+  %v62 = add i32 %u, 130
+  %v63 = add i32 %u, 131
+  %v64 = add i32 %u, 132
+  %v65 = add i32 %u, 133
+  %v66 = add i32 %u, 134
+  %v67 = add i32 %u, 135
+  %v68 = add i32 %u, 136
+  %v69 = add i32 %u, 137
+  %v70 = add i32 %u, 138
+  %v71 = add i32 %u, 139
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr i32* %a, i32 %i
+  store volatile i32 %i, i32* %p
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  store volatile i32 %v0, i32* %a
+  store volatile i32 %v1, i32* %a
+  store volatile i32 %v2, i32* %a
+  store volatile i32 %v3, i32* %a
+  store volatile i32 %v4, i32* %a
+  store volatile i32 %v5, i32* %a
+  store volatile i32 %v6, i32* %a
+  store volatile i32 %v7, i32* %a
+  store volatile i32 %v8, i32* %a
+  store volatile i32 %v9, i32* %a
+  store volatile i32 %v10, i32* %a
+  store volatile i32 %v11, i32* %a
+  store volatile i32 %v12, i32* %a
+  store volatile i32 %v13, i32* %a
+  store volatile i32 %v14, i32* %a
+  store volatile i32 %v15, i32* %a
+  store volatile i32 %v16, i32* %a
+  store volatile i32 %v17, i32* %a
+  store volatile i32 %v18, i32* %a
+  store volatile i32 %v19, i32* %a
+  store volatile i32 %v20, i32* %a
+  store volatile i32 %v21, i32* %a
+  store volatile i32 %v22, i32* %a
+  store volatile i32 %v23, i32* %a
+  store volatile i32 %v24, i32* %a
+  store volatile i32 %v25, i32* %a
+  store volatile i32 %v26, i32* %a
+  store volatile i32 %v27, i32* %a
+  store volatile i32 %v28, i32* %a
+  store volatile i32 %v29, i32* %a
+  store volatile i32 %v30, i32* %a
+  store volatile i32 %v31, i32* %a
+  store volatile i32 %v32, i32* %a
+  store volatile i32 %v33, i32* %a
+  store volatile i32 %v34, i32* %a
+  store volatile i32 %v35, i32* %a
+  store volatile i32 %v36, i32* %a
+  store volatile i32 %v37, i32* %a
+  store volatile i32 %v38, i32* %a
+  store volatile i32 %v39, i32* %a
+  store volatile i32 %v40, i32* %a
+  store volatile i32 %v41, i32* %a
+  store volatile i32 %v42, i32* %a
+  store volatile i32 %v43, i32* %a
+  store volatile i32 %v44, i32* %a
+  store volatile i32 %v45, i32* %a
+  store volatile i32 %v46, i32* %a
+  store volatile i32 %v47, i32* %a
+  store volatile i32 %v48, i32* %a
+  store volatile i32 %v49, i32* %a
+  store volatile i32 %v50, i32* %a
+  store volatile i32 %v51, i32* %a
+  store volatile i32 %v52, i32* %a
+  store volatile i32 %v53, i32* %a
+  store volatile i32 %v54, i32* %a
+  store volatile i32 %v55, i32* %a
+  store volatile i32 %v56, i32* %a
+  store volatile i32 %v57, i32* %a
+  store volatile i32 %v58, i32* %a
+  store volatile i32 %v59, i32* %a
+  store volatile i32 %v60, i32* %a
+  store volatile i32 %v61, i32* %a
+  store volatile i32 %v62, i32* %a
+  store volatile i32 %v63, i32* %a
+  store volatile i32 %v64, i32* %a
+  store volatile i32 %v65, i32* %a
+  store volatile i32 %v66, i32* %a
+  store volatile i32 %v67, i32* %a
+  store volatile i32 %v68, i32* %a
+  store volatile i32 %v69, i32* %a
+  store volatile i32 %v70, i32* %a
+  store volatile i32 %v71, i32* %a
+  store volatile i32 %u, i32* %a
+  ret void
+}
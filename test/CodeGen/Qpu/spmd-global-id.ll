@@ -0,0 +1,25 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -qpu-spmd-vectorize | FileCheck %s
+
+; get_global_id(0) of a vectorized kernel is the lane 0 id, read from the
+; uniform after the arguments.
+
+declare i32 @get_global_id(i32) nounwind readnone
+
+; CHECK-LABEL: // @square
+; CHECK: mov [[IN:acc[0-9]]], unif
+; CHECK-NEXT: mov [[OUT:acc[0-9]]], unif
+; CHECK-NEXT: mov [[ID:acc[0-9]]], unif
+; CHECK: shl [[OFF:acc[0-9]]], [[ID]], 2
+; CHECK: load_word
+; CHECK: fmul
+; CHECK: store_word {{.*}}, 16
+define void @square(float* %in, float* %out) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %pin = getelementptr inbounds float* %in, i32 %id
+  %x = load float* %pin, align 64
+  %y = fmul float %x, %x
+  %pout = getelementptr inbounds float* %out, i32 %id
+  store float %y, float* %pout, align 64
+  ret void
+}
@@ -0,0 +1,18 @@
+; RUN: not llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -qpu-spmd-vectorize 2>&1 | FileCheck %s
+
+; Only the global id of lane 0 is passed to a kernel, so a kernel asking for
+; its local id is not vectorized and the call is rejected.
+
+declare i32 @get_local_id(i32) nounwind readnone
+
+; CHECK: LLVM ERROR: Qpu kernel 'square' cannot call 'get_local_id'
+define void @square(float* %in, float* %out) {
+entry:
+  %id = call i32 @get_local_id(i32 0)
+  %pin = getelementptr inbounds float* %in, i32 %id
+  %x = load float* %pin, align 64
+  %y = fmul float %x, %x
+  %pout = getelementptr inbounds float* %out, i32 %id
+  store float %y, float* %pout, align 64
+  ret void
+}
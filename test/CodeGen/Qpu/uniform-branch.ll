@@ -0,0 +1,72 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel | FileCheck %s
+
+; Kernel arguments are the same in every lane, so a branch on a compare of
+; them tests the flags of all lanes directly.  A branch on a loaded value
+; goes through the lane 0 broadcast instead.
+
+; CHECK-LABEL: // @loop
+; CHECK: add [[I:acc[0-9]]], [[I]], 1
+; CHECK-NEXT: subs wra_nop, [[I]], {{acc[0-9]}}
+; CHECK-NEXT: blaallns wra_nop, wrb_nop, #$BB0_1#
+; CHECK-NOT: v8min
+; CHECK: .size loop
+define void @loop(i32* %p, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %q = getelementptr i32* %p, i32 %i
+  store i32 %i, i32* %q
+  %i.next = add i32 %i, 1
+  %cc = icmp slt i32 %i.next, %n
+  br i1 %cc, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; Each case of a switch on an argument is a uniform compare and branch.
+; CHECK-LABEL: // @sw
+; CHECK: il [[FIVE:acc[0-9]]], 5
+; CHECK-NEXT: subs wra_nop, [[K:acc[0-9]]], [[FIVE]]
+; CHECK-NEXT: blaallzs
+; CHECK: il [[ONE:acc[0-9]]], 1
+; CHECK-NEXT: subs wra_nop, [[K]], [[ONE]]
+; CHECK-NEXT: blaallzc
+; CHECK-NOT: v8min
+; CHECK: .size sw
+define void @sw(i32* %p, i32 %k) {
+entry:
+  switch i32 %k, label %def [ i32 1, label %one
+                              i32 5, label %five ]
+one:
+  store i32 10, i32* %p
+  br label %exit
+five:
+  store i32 50, i32* %p
+  br label %exit
+def:
+  store i32 0, i32* %p
+  br label %exit
+exit:
+  ret void
+}
+
+; CHECK-LABEL: // @divergent
+; CHECK: subs wra_nop
+; CHECK: ilns
+; CHECK-NEXT: v8min acc5
+; CHECK-NEXT: ors wra_nop, acc5, acc5
+; CHECK-NEXT: blaallzs
+define void @divergent(i32* %p, i32 %n) {
+entry:
+  %v = load i32* %p
+  %cc = icmp slt i32 %v, %n
+  br i1 %cc, label %then, label %exit
+then:
+  store i32 1, i32* %p
+  br label %exit
+exit:
+  ret void
+}
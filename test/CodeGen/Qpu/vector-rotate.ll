@@ -0,0 +1,95 @@
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel -enable-unsafe-fp-math | FileCheck %s
+; RUN: llc < %s -march=qpu -mcpu=qpu32I -qpu-kernel | FileCheck %s -check-prefix=STRICT
+
+; Vector rotates are done on the mul pipe; a register amount goes through r5
+; written at its replicate address.
+
+; CHECK-LABEL: // @rot
+; CHECK: v8min [[R:acc[0-9]]], [[V:acc[0-9]]], [[V]] >> 3
+; CHECK: store_word [[R]]
+define void @rot(<16 x float>* %p, <16 x float>* %q) {
+  %v = load <16 x float>* %p
+  %r = shufflevector <16 x float> %v, <16 x float> undef, <16 x i32> <i32 13, i32 14, i32 15, i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 10, i32 11, i32 12>
+  store <16 x float> %r, <16 x float>* %q
+  ret void
+}
+
+; CHECK-LABEL: // @lane
+; CHECK: and [[A:acc[0-9]]], {{acc[0-9]}}, 15
+; CHECK-NEXT: mov r5rep, [[A]]
+; CHECK-NEXT: v8min [[R:acc[0-9]]], [[V:acc[0-9]]], [[V]] >> r5
+; CHECK-NEXT: store_word [[R]]
+define void @lane(<16 x float>* %p, i32 %i, float* %q) {
+  %v = load <16 x float>* %p
+  %e = extractelement <16 x float> %v, i32 %i
+  store float %e, float* %q
+  ret void
+}
+
+; CHECK-LABEL: // @splat
+; CHECK: mov [[S:acc[0-9]]], unif
+; CHECK: mov r5rep, [[S]]
+; CHECK-NEXT: mov [[R:acc[0-9]]], acc5
+; CHECK-NEXT: store_word [[R]], {{acc[0-9]}}, 0, 16
+define void @splat(i32 %x, <16 x float>* %q) {
+  %s = bitcast i32 %x to float
+  %i = insertelement <16 x float> undef, float %s, i32 0
+  %v = shufflevector <16 x float> %i, <16 x float> undef, <16 x i32> zeroinitializer
+  store <16 x float> %v, <16 x float>* %q
+  ret void
+}
+
+; A horizontal sum is four rotate and add steps once reassociation is allowed,
+; and a rotate per lane otherwise.
+
+; CHECK-LABEL: // @sum
+; CHECK: v8min [[T:acc[0-9]]], [[S:acc[0-9]]], [[S]] >> 8
+; CHECK-NEXT: fadd [[S]], [[S]], [[T]]
+; CHECK-NEXT: v8min [[T]], [[S]], [[S]] >> 4
+; CHECK-NEXT: fadd [[S]], [[S]], [[T]]
+; CHECK-NEXT: v8min [[T]], [[S]], [[S]] >> 2
+; CHECK-NEXT: fadd [[S]], [[S]], [[T]]
+; CHECK-NEXT: v8min [[T]], [[S]], [[S]] >> 1
+; CHECK-NEXT: fadd [[S]], [[S]], [[T]]
+; CHECK-NEXT: store_word [[S]]
+
+; STRICT-LABEL: // @sum
+; STRICT: >> 15
+; STRICT: >> 1{{$}}
+; STRICT: store_word
+define void @sum(<16 x float>* %p, float* %q) {
+  %v = load <16 x float>* %p
+  %e0 = extractelement <16 x float> %v, i32 0
+  %e1 = extractelement <16 x float> %v, i32 1
+  %e2 = extractelement <16 x float> %v, i32 2
+  %e3 = extractelement <16 x float> %v, i32 3
+  %e4 = extractelement <16 x float> %v, i32 4
+  %e5 = extractelement <16 x float> %v, i32 5
+  %e6 = extractelement <16 x float> %v, i32 6
+  %e7 = extractelement <16 x float> %v, i32 7
+  %e8 = extractelement <16 x float> %v, i32 8
+  %e9 = extractelement <16 x float> %v, i32 9
+  %e10 = extractelement <16 x float> %v, i32 10
+  %e11 = extractelement <16 x float> %v, i32 11
+  %e12 = extractelement <16 x float> %v, i32 12
+  %e13 = extractelement <16 x float> %v, i32 13
+  %e14 = extractelement <16 x float> %v, i32 14
+  %e15 = extractelement <16 x float> %v, i32 15
+  %s1 = fadd float %e0, %e1
+  %s2 = fadd float %s1, %e2
+  %s3 = fadd float %s2, %e3
+  %s4 = fadd float %s3, %e4
+  %s5 = fadd float %s4, %e5
+  %s6 = fadd float %s5, %e6
+  %s7 = fadd float %s6, %e7
+  %s8 = fadd float %s7, %e8
+  %s9 = fadd float %s8, %e9
+  %s10 = fadd float %s9, %e10
+  %s11 = fadd float %s10, %e11
+  %s12 = fadd float %s11, %e12
+  %s13 = fadd float %s12, %e13
+  %s14 = fadd float %s13, %e14
+  %s15 = fadd float %s14, %e15
+  store float %s15, float* %q
+  ret void
+}
@@ -0,0 +1,10 @@
+; RUN: echo stale > %t.o
+; RUN: not llc -mtriple=x86_64-linux -filetype=obj -stop-after=no-such-pass < %s -o %t.o
+; RUN: not test -f %t.o
+
+; A failed object file run must not leave the output of an earlier run in
+; place.
+
+define i32 @f(i32 %x) {
+  ret i32 %x
+}
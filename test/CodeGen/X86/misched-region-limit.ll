@@ -0,0 +1,29 @@
+; REQUIRES: asserts
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -enable-misched -verify-misched -debug-only=misched -o /dev/null 2>&1 | FileCheck %s
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -enable-misched -verify-misched -misched-region-limit=4 -debug-only=misched -o /dev/null 2>&1 | FileCheck %s -check-prefix=WINDOW
+;
+; Large regions are scheduled in windows, each topped by an instruction that
+; stays in place.
+;
+; CHECK: RegionInstrs: 19 Remaining: 0
+;
+; WINDOW: RegionInstrs: 3 Remaining: 16
+; WINDOW: RegionInstrs: 3 Remaining: 12
+; WINDOW: RegionInstrs: 3 Remaining: 8
+; WINDOW: RegionInstrs: 3 Remaining: 4
+; WINDOW: RegionInstrs: 3 Remaining: 0
+define i32 @window(i32 %a, i32 %b, i32 %c, i32 %d) nounwind {
+entry:
+  %x0 = mul i32 %a, %b
+  %x1 = mul i32 %b, %c
+  %x2 = mul i32 %c, %d
+  %x3 = mul i32 %d, %a
+  %x4 = mul i32 %a, %c
+  %x5 = mul i32 %b, %d
+  %s0 = add i32 %x0, %x1
+  %s1 = add i32 %x2, %x3
+  %s2 = add i32 %x4, %x5
+  %s3 = xor i32 %s0, %s1
+  %s4 = xor i32 %s3, %s2
+  ret i32 %s4
+}
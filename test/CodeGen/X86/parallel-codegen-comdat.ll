@@ -0,0 +1,47 @@
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -relocation-model=pic \
+; RUN:   -filetype=obj -j2 -o %t
+; RUN: llvm-nm %t | FileCheck %s
+; RUN: llvm-readobj -s %t | FileCheck --check-prefix=SECTIONS %s
+
+; Both halves of the module refer to the personality through the same
+; COMDAT group.  The combined object keeps the first copy of the group and
+; one .note.GNU-stack.
+
+; CHECK:      V DW.ref.__gxx_personality_v0
+; CHECK-NOT:  DW.ref.__gxx_personality_v0
+; CHECK:      T a
+; CHECK-NEXT: T b
+
+; SECTIONS:     Name: .group (
+; SECTIONS:     Name: .text (
+; SECTIONS:     Name: .data.DW.ref.__gxx_personality_v0 (
+; SECTIONS:     Name: .rela.data.DW.ref.__gxx_personality_v0 (
+; SECTIONS:     Name: .note.GNU-stack (
+; SECTIONS:     Name: .text (
+; SECTIONS-NOT: Name: .group (
+; SECTIONS-NOT: Name: .data.DW.ref
+; SECTIONS-NOT: Name: .note.GNU-stack
+; SECTIONS:     Name: .symtab (
+
+declare void @may_throw()
+declare i32 @__gxx_personality_v0(...)
+
+define void @a() {
+entry:
+  invoke void @may_throw() to label %ok unwind label %lpad
+ok:
+  ret void
+lpad:
+  %l = landingpad { i8*, i32 } personality i32 (...)* @__gxx_personality_v0 cleanup
+  resume { i8*, i32 } %l
+}
+
+define void @b() {
+entry:
+  invoke void @may_throw() to label %ok unwind label %lpad
+ok:
+  ret void
+lpad:
+  %l = landingpad { i8*, i32 } personality i32 (...)* @__gxx_personality_v0 cleanup
+  resume { i8*, i32 } %l
+}
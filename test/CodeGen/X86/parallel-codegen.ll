@@ -0,0 +1,76 @@
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -filetype=obj -j3 -o %t
+; RUN: llvm-nm %t | FileCheck %s
+; RUN: llvm-readobj -s %t | FileCheck --check-prefix=SECTIONS %s
+; RUN: llvm-readobj -s %t | FileCheck --check-prefix=NOTE %s
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -filetype=obj -j3 -o %t2
+; RUN: cmp %t %t2
+; RUN: llc < %s -mtriple=x86_64-linux-gnu -j3 -o /dev/null 2>&1 \
+; RUN:   | FileCheck --check-prefix=ASM %s
+
+; Generate code for pieces of the module on three threads and check that
+; the combined object defines every symbol once.
+
+; CHECK:      T a
+; CHECK-NEXT: T a_alias
+; CHECK-NEXT: T b
+; CHECK-NEXT: T c
+; CHECK-NEXT: d counter
+; CHECK-NEXT: t helper
+; CHECK-NEXT: W lo
+; CHECK-NEXT: D shared
+; CHECK-NEXT: U use
+
+; The functions are spread over three .text sections.
+; SECTIONS: Name: .text
+; SECTIONS: Name: .text
+; SECTIONS: Name: .text
+; SECTIONS-NOT: Name: .text (
+
+; Every piece marks the stack non-executable; the object keeps one marker.
+; NOTE:      Name: .note.GNU-stack (
+; NOTE-NEXT: Type: SHT_PROGBITS
+; NOTE-NEXT: Flags [ (0x0)
+; NOTE-NOT: Name: .note.GNU-stack (
+
+; ASM: warning: ignoring -j because filetype != obj
+
+@counter = internal global i32 1
+@shared = global i32 2
+@.str = private unnamed_addr constant [4 x i8] c"abc\00"
+@a_alias = alias i32 (i32)* @a
+
+declare void @use(i8*)
+
+define internal i32 @helper(i32 %x) {
+  %v = load i32* @counter
+  %r = add i32 %v, %x
+  store i32 %r, i32* @counter
+  ret i32 %r
+}
+
+define i32 @a(i32 %x) {
+  %r = call i32 @helper(i32 %x)
+  %s = mul i32 %r, %r
+  %t = mul i32 %s, %r
+  ret i32 %t
+}
+
+define linkonce_odr i32 @lo(i32 %x) {
+  %r = call i32 @b(i32 %x)
+  call void @use(i8* getelementptr ([4 x i8]* @.str, i32 0, i32 0))
+  ret i32 %r
+}
+
+define i32 @b(i32 %x) {
+  %v = load i32* @shared
+  %r = add i32 %v, %x
+  call void @use(i8* getelementptr ([4 x i8]* @.str, i32 0, i32 0))
+  ret i32 %r
+}
+
+define i32 @c(i32 %x) {
+  %r = call i32 @a_alias(i32 %x)
+  %s = call i32 @lo(i32 %r)
+  %t = call i32 @helper(i32 %s)
+  ret i32 %t
+}
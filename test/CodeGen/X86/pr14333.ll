@@ -1,4 +1,5 @@
 ; RUN: llc -mtriple=x86_64-unknown-unknown < %s
+; RUN: llc -mtriple=x86_64-unknown-unknown -combiner-topological-threshold=0 < %s
 %foo = type { i64, i64 }
 define void @bar(%foo* %zed) {
   %tmp = getelementptr inbounds %foo* %zed, i64 0, i32 0
@@ -0,0 +1,115 @@
+; RUN: lli -force-interpreter %s | FileCheck %s
+; RUN: lli -force-interpreter -interpreter-predecode %s | FileCheck %s
+
+; The pre-decoded interpreter must give the same results as the IR walker.
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+@fmt = private unnamed_addr constant [4 x i8] c"%d\0A\00"
+@ffmt = private unnamed_addr constant [4 x i8] c"%f\0A\00"
+@table = internal global [4 x i16] [i16 3, i16 -5, i16 7, i16 11]
+
+declare i32 @printf(i8*, ...)
+
+define internal void @print(i32 %v) {
+  %f = getelementptr [4 x i8]* @fmt, i32 0, i32 0
+  %r = call i32 (i8*, ...)* @printf(i8* %f, i32 %v)
+  ret void
+}
+
+; Swapping two values through phis needs the copies done in parallel.
+define internal i32 @swap(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %a = phi i32 [ 1, %entry ], [ %b, %loop ]
+  %b = phi i32 [ 2, %entry ], [ %a, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %c = icmp ult i32 %i.next, %n
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %r = mul i32 %a, 10
+  %s = add i32 %r, %b
+  ret i32 %s
+}
+
+define internal i32 @classify(i32 %x) {
+entry:
+  switch i32 %x, label %other [ i32 0, label %zero
+                                i32 7, label %seven ]
+zero:
+  ret i32 100
+seven:
+  ret i32 107
+other:
+  %neg = icmp slt i32 %x, 0
+  %r = select i1 %neg, i32 -1, i32 1
+  ret i32 %r
+}
+
+define internal i32 @sumtable() {
+entry:
+  %buf = alloca [4 x i32]
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %p = getelementptr [4 x i16]* @table, i64 0, i64 %i
+  %v = load i16* %p
+  %w = sext i16 %v to i32
+  %q = getelementptr [4 x i32]* %buf, i64 0, i64 %i
+  store i32 %w, i32* %q
+  %x = load i32* %q
+  %sum.next = add i32 %sum, %x
+  %i.next = add i64 %i, 1
+  %c = icmp eq i64 %i.next, 4
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
+
+define internal double @mean(double %a, double %b) {
+  %s = fadd double %a, %b
+  %m = fmul double %s, 5.000000e-01
+  %lt = fcmp olt double %m, 0.000000e+00
+  %n = fsub double -0.000000e+00, %m
+  %r = select i1 %lt, double %n, double %m
+  ret double %r
+}
+
+define i32 @main() {
+  %s0 = call i32 @swap(i32 1)
+  call void @print(i32 %s0)
+  %s1 = call i32 @swap(i32 4)
+  call void @print(i32 %s1)
+  %c0 = call i32 @classify(i32 0)
+  call void @print(i32 %c0)
+  %c1 = call i32 @classify(i32 7)
+  call void @print(i32 %c1)
+  %c2 = call i32 @classify(i32 -3)
+  call void @print(i32 %c2)
+  %t = call i32 @sumtable()
+  call void @print(i32 %t)
+  %m = call double @mean(double 1.500000e+00, double -4.500000e+00)
+  %f = getelementptr [4 x i8]* @ffmt, i32 0, i32 0
+  %r = call i32 (i8*, ...)* @printf(i8* %f, double %m)
+  %u = fptoui double %m to i32
+  %sh = shl i32 %u, 4
+  %x = xor i32 %sh, 1
+  call void @print(i32 %x)
+  ret i32 0
+}
+
+; CHECK: 12
+; CHECK-NEXT: 21
+; CHECK-NEXT: 100
+; CHECK-NEXT: 107
+; CHECK-NEXT: -1
+; CHECK-NEXT: 16
+; CHECK-NEXT: 1.500000
+; CHECK-NEXT: 17
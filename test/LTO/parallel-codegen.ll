@@ -0,0 +1,52 @@
+; RUN: llvm-as < %s > %t1
+; RUN: llvm-lto -j3 -o %t2 -exported-symbol=a -exported-symbol=b \
+; RUN:     -exported-symbol=c -exported-symbol=counter %t1
+; RUN: llvm-nm %t2 | FileCheck %s
+; RUN: llvm-readobj -s %t2 | FileCheck --check-prefix=SECTIONS %s
+
+; Generate code for three partitions of the merged module and check that
+; they are combined into one object that defines every symbol once.
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK: T a
+; CHECK: T b
+; CHECK: T c
+; CHECK: D counter
+; CHECK: t helper
+; CHECK: U use
+
+; SECTIONS: Name: .text
+; SECTIONS: Name: .text
+; SECTIONS: Name: .text
+; SECTIONS-NOT: Name: .text (
+
+@counter = global i32 1
+
+declare void @use(i32)
+
+define internal void @helper(i32 %x) noinline {
+  %v = load i32* @counter
+  %r = add i32 %v, %x
+  store i32 %r, i32* @counter
+  call void @use(i32 %r)
+  ret void
+}
+
+define void @a(i32 %x) {
+  call void @helper(i32 %x)
+  ret void
+}
+
+define void @b(i32 %x) {
+  %y = mul i32 %x, %x
+  call void @use(i32 %y)
+  ret void
+}
+
+define void @c(i32 %x) {
+  %y = add i32 %x, 7
+  call void @use(i32 %y)
+  ret void
+}
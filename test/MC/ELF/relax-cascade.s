@@ -0,0 +1,45 @@
+// RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu %s -o - \
+// RUN:   | llvm-objdump -d - | FileCheck %s
+
+// Test relaxations that only become necessary after other fragments have
+// been relaxed.
+
+// Each jump fits until the one after it, which lies between it and its
+// target, is relaxed.
+
+// CHECK-LABEL: cascade:
+// CHECK: 0: e9 80 00 00 00 jmpq 128
+// CHECK: 80: e9 80 00 00 00 jmpq 128
+// CHECK: 100: e9 80 00 00 00 jmpq 128
+// CHECK: 180: e9 82 00 00 00 jmpq 130
+
+cascade:
+        jmp .L1
+        .fill 123, 1, 0xcc
+        jmp .L2
+.L1:    .fill 123, 1, 0xcc
+        jmp .L3
+.L2:    .fill 123, 1, 0xcc
+        jmp .Lend
+.L3:    .fill 130, 1, 0xcc
+.Lend:  ret
+
+// The second jump fits until the first one is relaxed, which only happens
+// after the third one is. The first jump is outside the range of the second,
+// but moves the alignment padding before .Lt by three bytes.
+
+// CHECK-LABEL: align:
+// CHECK: 213: e9 8d 00 00 00 jmpq 141
+// CHECK: 218: e9 83 00 00 00 jmpq 131
+// CHECK: 2a0: e9 c8 00 00 00 jmpq 200
+
+        .p2align 4
+align:
+        .fill 3, 1, 0xcc
+        jmp .Lz
+        jmp .Lt
+        .fill 121, 1, 0xcc
+        .p2align 4
+.Lt:    jmp .Lfar
+.Lz:    .fill 200, 1, 0xcc
+.Lfar:  ret
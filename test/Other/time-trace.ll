@@ -0,0 +1,24 @@
+; RUN: opt < %s -instcombine -time-passes -time-trace-file=%t -disable-output 2>/dev/null
+; RUN: FileCheck %s < %t
+; RUN: rm -f %t
+; RUN: opt < %s -instcombine -time-trace-file=%t -disable-output 2>/dev/null
+; RUN: FileCheck %s < %t
+
+; Every pass run is a begin event naming the pass and the function it ran
+; on, followed by its end event.
+
+; CHECK: {"traceEvents":[
+; CHECK: {"ph":"B","pid":1,"tid":1,"ts":{{[0-9]+}},"name":"Combine redundant instructions","cat":"... Pass execution timing report ...","args":{"detail":"first"}},
+; CHECK-NEXT: {"ph":"E","pid":1,"tid":1,"ts":{{[0-9]+}}},
+; CHECK: "name":"Combine redundant instructions",{{.*}}"detail":"sec\"ond"
+; CHECK: ]}
+
+define i32 @first(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
+
+define i32 @"sec\22ond"(i32 %x) {
+  %a = mul i32 %x, 1
+  ret i32 %a
+}
@@ -0,0 +1,133 @@
+; RUN: opt < %s -basicaa -dse -enable-dse-memoryssa -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+declare void @use(i32*) readonly
+
+; The store in the entry block is overwritten in the join block, past a
+; store to other memory on one of the paths.
+; CHECK-LABEL: @diamond(
+; CHECK-NOT: store i32 1
+; CHECK: store i32 0, i32* %q
+; CHECK: store i32 2, i32* %p
+define void @diamond(i32* noalias %p, i32* noalias %q, i1 %c) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 0, i32* %q
+  br label %join
+
+join:
+  store i32 2, i32* %p
+  ret void
+}
+
+; Only one of the paths overwrites the store.
+; CHECK-LABEL: @one_path(
+; CHECK: store i32 1, i32* %p
+; CHECK: store i32 2, i32* %p
+define void @one_path(i32* %p, i1 %c) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 2, i32* %p
+  br label %join
+
+join:
+  ret void
+}
+
+; The store is read on one of the paths.
+; CHECK-LABEL: @read_on_path(
+; CHECK: store i32 1, i32* %p
+; CHECK: store i32 2, i32* %p
+define i32 @read_on_path(i32* %p, i1 %c) {
+entry:
+  store i32 1, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  %v = load i32* %p
+  br label %join
+
+join:
+  %r = phi i32 [ %v, %then ], [ 0, %entry ]
+  store i32 2, i32* %p
+  ret i32 %r
+}
+
+; A loop that does not touch the stored memory lies between the store and
+; the overwrite.
+; CHECK-LABEL: @past_loop(
+; CHECK-NOT: store i32 1
+; CHECK: store i32 %i, i32* %q
+; CHECK: store i32 2, i32* %p
+define void @past_loop(i32* noalias %p, i32* noalias %q, i32 %n) {
+entry:
+  store i32 1, i32* %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  store i32 %i, i32* %q
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  store i32 2, i32* %p
+  ret void
+}
+
+; The loop calls a function that may read the stored memory.
+; CHECK-LABEL: @loop_reads(
+; CHECK: store i32 1, i32* %p
+; CHECK: call void @use(i32* %p)
+; CHECK: store i32 2, i32* %p
+define void @loop_reads(i32* %p, i32 %n) {
+entry:
+  store i32 1, i32* %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  call void @use(i32* %p)
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  store i32 2, i32* %p
+  ret void
+}
+
+; The pointer of the header store is a different element on the next trip,
+; so the latch store is not overwritten by it.
+; CHECK-LABEL: @loop_carried(
+; CHECK: header:
+; CHECK: store i32 0, i32* %x
+; CHECK: latch:
+; CHECK: store i32 1, i32* %x
+define void @loop_carried(i32* %a, i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %x = getelementptr i32* %a, i32 %i
+  store i32 0, i32* %x
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %latch, label %exit
+
+latch:
+  store i32 1, i32* %x
+  %i.next = add i32 %i, 1
+  br label %header
+
+exit:
+  ret void
+}
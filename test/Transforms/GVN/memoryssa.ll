@@ -0,0 +1,104 @@
+; RUN: opt < %s -basicaa -gvn -enable-gvn-memoryssa -S | FileCheck %s
+
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:64:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-s0:64:64-f80:128:128-n8:16:32:64-S128"
+
+; The stored value reaches the load across a store that cannot alias it.
+; CHECK-LABEL: @forward(
+; CHECK-NOT: load
+; CHECK: ret i32 %v
+define i32 @forward(i32* noalias %p, i32* noalias %q, i32 %v, i1 %c) {
+entry:
+  store i32 %v, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 0, i32* %q
+  br label %join
+
+join:
+  %l = load i32* %p
+  ret i32 %l
+}
+
+; A load after a loop that only writes other memory is the load before it.
+; CHECK-LABEL: @loop(
+; CHECK: %a = load i32* %p
+; CHECK-NOT: load
+; CHECK: ret i32
+define i32 @loop(i32* noalias %p, i32* noalias %q, i32 %n) {
+entry:
+  %a = load i32* %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  store i32 %i, i32* %q
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %b = load i32* %p
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+; A store that may alias on one path keeps the load.
+; CHECK-LABEL: @clobbered(
+; CHECK: %a = load i32* %p
+; CHECK: join:
+; CHECK-NEXT: %b = load i32* %p
+define i32 @clobbered(i32* %p, i32* %q, i1 %c) {
+entry:
+  %a = load i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 0, i32* %q
+  br label %join
+
+join:
+  %b = load i32* %p
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+; A store inside the loop that may alias keeps the load in the loop.
+; CHECK-LABEL: @loop_clobbered(
+; CHECK: loop:
+; CHECK: %b = load i32* %p
+define i32 @loop_clobbered(i32* %p, i32* %q, i32 %n) {
+entry:
+  %a = load i32* %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %b = load i32* %p
+  store i32 %i, i32* %q
+  %i.next = add i32 %i, %b
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %a
+}
+
+; Read-only calls that see the same memory state are equal.
+; CHECK-LABEL: @calls(
+; CHECK: %a = call i32 @get(i32* %p)
+; CHECK-NOT: call
+; CHECK: store i32 0, i32* %p
+; CHECK: %c = call i32 @get(i32* %p)
+declare i32 @get(i32*) readonly
+
+define i32 @calls(i32* %p) {
+entry:
+  %a = call i32 @get(i32* %p)
+  %b = call i32 @get(i32* %p)
+  store i32 0, i32* %p
+  %c = call i32 @get(i32* %p)
+  %r = add i32 %a, %b
+  %s = add i32 %r, %c
+  ret i32 %s
+}
@@ -0,0 +1,51 @@
+; RUN: opt < %s -inline -code-size-budget=24 -S | FileCheck %s
+; RUN: opt < %s -inline -S | FileCheck %s -check-prefix=NOBUDGET
+
+; @work is cheap enough to inline at both calls, but with a budget of 24 only
+; the first copy fits in @caller.  The always_inline callee is inlined
+; regardless.
+
+; CHECK-LABEL: define i32 @caller(
+; CHECK-NOT: call i32 @work(i32 %x)
+; CHECK: call i32 @work(i32 %y)
+; CHECK-NOT: call i32 @must
+; CHECK: ret i32
+
+; NOBUDGET-LABEL: define i32 @caller(
+; NOBUDGET-NOT: call i32 @work
+; NOBUDGET: ret i32
+define i32 @caller(i32 %x, i32 %y) {
+  %a = call i32 @work(i32 %x)
+  %b = call i32 @work(i32 %y)
+  %c = call i32 @must(i32 %a)
+  %s = add i32 %b, %c
+  ret i32 %s
+}
+
+define i32 @work(i32 %v) {
+  %1 = mul i32 %v, %v
+  %2 = add i32 %1, 7
+  %3 = mul i32 %2, %v
+  %4 = xor i32 %3, 12345
+  %5 = sub i32 %4, %1
+  %6 = mul i32 %5, %2
+  %7 = add i32 %6, %3
+  %8 = lshr i32 %7, 3
+  %9 = or i32 %8, %4
+  %10 = mul i32 %9, %5
+  ret i32 %10
+}
+
+define i32 @must(i32 %v) alwaysinline {
+  %1 = mul i32 %v, %v
+  %2 = add i32 %1, 7
+  %3 = mul i32 %2, %v
+  %4 = xor i32 %3, 12345
+  %5 = sub i32 %4, %1
+  %6 = mul i32 %5, %2
+  %7 = add i32 %6, %3
+  %8 = lshr i32 %7, 3
+  %9 = or i32 %8, %4
+  %10 = mul i32 %9, %5
+  ret i32 %10
+}
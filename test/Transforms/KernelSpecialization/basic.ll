@@ -0,0 +1,70 @@
+; RUN: opt < %s -specialize-kernels -S | FileCheck %s
+; RUN: opt < %s -specialize-kernels -S | FileCheck %s -check-prefix=NOBIG
+
+; @kernel is launched with two different strides and once with a stride that
+; is not known.  Each constant stride gets its own clone; the unknown one
+; keeps calling the original.
+
+; CHECK-LABEL: define void @launch(
+; CHECK: call void @kernel.spec(float* %a, i32 4, i32 %n)
+; CHECK: call void @kernel.spec(float* %b, i32 4, i32 %n)
+; CHECK: call void @kernel.spec1(float* %a, i32 8, i32 %n)
+; CHECK: call void @kernel(float* %b, i32 %s, i32 %n)
+define void @launch(float* %a, float* %b, i32 %s, i32 %n) {
+entry:
+  call void @kernel(float* %a, i32 4, i32 %n)
+  call void @kernel(float* %b, i32 4, i32 %n)
+  call void @kernel(float* %a, i32 8, i32 %n)
+  call void @kernel(float* %b, i32 %s, i32 %n)
+  ret void
+}
+
+; A constant that only feeds one instruction outside any loop is not worth
+; a copy of a large function.  The NOBIG prefix has nothing but a NOT, so it
+; checks the whole output.
+; NOBIG-NOT: @big.spec
+; CHECK-LABEL: define i32 @caller(
+; CHECK: call i32 @big(i32 %x, i32 3)
+define i32 @caller(i32 %x) {
+entry:
+  %r = call i32 @big(i32 %x, i32 3)
+  ret i32 %r
+}
+
+define i32 @big(i32 %x, i32 %k) {
+entry:
+  %a1 = add i32 %x, 1
+  %a2 = mul i32 %a1, %a1
+  %a3 = add i32 %a2, %a1
+  %a4 = mul i32 %a3, %a2
+  %a5 = add i32 %a4, %a3
+  %a6 = mul i32 %a5, %a4
+  %a7 = add i32 %a6, %a5
+  %a8 = mul i32 %a7, %a6
+  %a9 = add i32 %a8, %k
+  ret i32 %a9
+}
+
+; The stride multiplies the index inside the loop.
+; CHECK-LABEL: define internal void @kernel.spec(
+; CHECK: %idx = mul i32 %i, 4
+; CHECK-LABEL: define internal void @kernel.spec1(
+; CHECK: %idx = mul i32 %i, 8
+define void @kernel(float* %p, i32 %stride, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %idx = mul i32 %i, %stride
+  %addr = getelementptr float* %p, i32 %idx
+  %v = load float* %addr
+  %v2 = fmul float %v, 2.0
+  store float %v2, float* %addr
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
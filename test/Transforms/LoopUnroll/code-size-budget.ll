@@ -0,0 +1,51 @@
+; RUN: opt < %s -S -loop-unroll -unroll-allow-partial -code-size-budget=20 | FileCheck %s
+; RUN: opt < %s -S -loop-unroll -code-size-budget=20 | FileCheck %s -check-prefix=NOPARTIAL
+
+; Loop size = 3 and the function has 2 more instructions, so a budget of 20
+; leaves room for 5 more copies of the body.  The largest count up to 6 that
+; divides the trip count is 4, well short of the 32 -unroll-threshold allows.
+; CHECK-LABEL: @partial(
+; CHECK:      add
+; CHECK-NEXT: add
+; CHECK-NEXT: add
+; CHECK-NEXT: add
+; CHECK-NEXT: icmp
+define void @partial() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %iv = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %inc = add i32 %iv, 1
+  %exitcnd = icmp uge i32 %inc, 1024
+  br i1 %exitcnd, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Unrolling this loop completely needs 10 copies of its body, more than fit;
+; it is only unrolled partially, and only if that is allowed.
+; CHECK-LABEL: @full(
+; CHECK:      add
+; CHECK-NEXT: add
+; CHECK-NEXT: add
+; CHECK-NEXT: add
+; CHECK-NEXT: add
+; CHECK-NEXT: icmp
+; NOPARTIAL-LABEL: @full(
+; NOPARTIAL:      add
+; NOPARTIAL-NEXT: icmp
+define void @full() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %iv = phi i32 [ 0, %entry ], [ %inc, %loop ]
+  %inc = add i32 %iv, 1
+  %exitcnd = icmp uge i32 %inc, 10
+  br i1 %exitcnd, label %exit, label %loop
+
+exit:
+  ret void
+}
@@ -0,0 +1,118 @@
+; RUN: opt < %s -spmd-vectorize -spmd-width=4 -S | FileCheck %s
+
+target datalayout = "e-p:32:32:32-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:32:64-v64:64:64-v128:128:128-a0:0:64-n32-S32"
+
+declare i32 @get_global_id(i32) nounwind readnone
+
+; A branch on the work-item id is linearized: both sides run under masks and
+; the phi becomes a select.
+; The store in the join block is reached by every lane, so it needs no mask.
+; CHECK-LABEL: @clamp(
+; CHECK: %neg = fcmp olt <4 x float>
+; CHECK: [[NOT:%[0-9]+]] = xor <4 x i1> %neg, <i1 true, i1 true, i1 true, i1 true>
+; CHECK: [[R:%[0-9]+]] = select <4 x i1> [[NOT]], <4 x float> %x, <4 x float> zeroinitializer
+; CHECK-NOT: br
+; CHECK: store <4 x float> [[R]]
+; CHECK-NEXT: ret void
+define void @clamp(float* %a) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %p = getelementptr inbounds float* %a, i32 %id
+  %x = load float* %p, align 4
+  %neg = fcmp olt float %x, 0.0
+  br i1 %neg, label %then, label %join
+
+then:
+  br label %join
+
+join:
+  %r = phi float [ 0.0, %then ], [ %x, %entry ]
+  store float %r, float* %p, align 4
+  ret void
+}
+
+; Stores under a partial mask use a vector store only when every lane is
+; active, and a per-lane scatter otherwise.
+; CHECK-LABEL: @masked(
+; CHECK: spmd.all:
+; CHECK: store <4 x i32>
+; CHECK: spmd.some:
+; CHECK: spmd.lane:
+; CHECK: store i32
+define void @masked(i32* %a, i32 %lim) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %c = icmp slt i32 %id, %lim
+  br i1 %c, label %then, label %exit
+
+then:
+  %p = getelementptr inbounds i32* %a, i32 %id
+  store i32 %id, i32* %p, align 4
+  br label %exit
+
+exit:
+  ret void
+}
+
+; A loop whose trip count depends on the lane runs until no lane is left in
+; it, and each lane keeps the value it had when it left.
+; CHECK-LABEL: @collatz(
+; CHECK: loop:
+; CHECK: %spmd.active = phi <4 x i1> [ <i1 true, i1 true, i1 true, i1 true>, %entry ], [ [[BACK:%[0-9]+]], %loop ]
+; CHECK: %n = phi <4 x i32>
+; CHECK: %steps = phi i32
+; CHECK: %s.spmd.exit = phi <4 x i32> [ undef, %entry ], [ [[S:%[0-9]+]], %loop ]
+; CHECK: %steps.next = add i32 %steps, 1
+; CHECK: [[BACK]] = and <4 x i1> %spmd.active, %more
+; CHECK: [[LEAVE:%[0-9]+]] = and <4 x i1> %spmd.active
+; CHECK: [[S]] = select <4 x i1> [[LEAVE]], <4 x i32> %.splat{{[0-9]*}}, <4 x i32> %s.spmd.exit
+; CHECK: br i1 {{%[0-9]+}}, label %loop, label %loop.spmd.exit
+; CHECK: loop.spmd.exit:
+; CHECK-NOT: br
+; CHECK: store <4 x i32> [[S]]
+define void @collatz(i32* %out) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %start = add i32 %id, 1
+  br label %loop
+
+loop:
+  %n = phi i32 [ %start, %entry ], [ %n.next, %loop ]
+  %steps = phi i32 [ 0, %entry ], [ %steps.next, %loop ]
+  %odd = and i32 %n, 1
+  %isodd = icmp ne i32 %odd, 0
+  %half = lshr i32 %n, 1
+  %tri = mul i32 %n, 3
+  %tri1 = add i32 %tri, 1
+  %n.next = select i1 %isodd, i32 %tri1, i32 %half
+  %steps.next = add i32 %steps, 1
+  %more = icmp ugt i32 %n.next, 1
+  br i1 %more, label %loop, label %exit
+
+exit:
+  %s = phi i32 [ %steps.next, %loop ]
+  %p = getelementptr inbounds i32* %out, i32 %id
+  store i32 %s, i32* %p, align 4
+  ret void
+}
+
+; Irreducible control flow is left alone.
+; CHECK-LABEL: @irreducible(
+; CHECK: br i1 %c, label %a, label %b
+define void @irreducible(i32* %p) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %c = icmp eq i32 %id, 0
+  br i1 %c, label %a, label %b
+
+a:
+  store i32 1, i32* %p
+  br i1 %c, label %b, label %exit
+
+b:
+  store i32 2, i32* %p
+  br i1 %c, label %a, label %exit
+
+exit:
+  ret void
+}
@@ -0,0 +1,71 @@
+; RUN: opt < %s -spmd-vectorize -spmd-width=4 -S | FileCheck %s
+
+target datalayout = "e-p:32:32:32-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:32:64-v64:64:64-v128:128:128-a0:0:64-n32-S32"
+
+declare i32 @get_global_id(i32) nounwind readnone
+
+; out[id] = in[id] * k becomes one vector load and one vector store per group
+; of four work items.
+; CHECK: define void @scale(float* %in, float* %out, float %k) [[ATTR:#[0-9]+]]
+; CHECK: %id = call i32 @get_global_id(i32 0)
+; CHECK: [[IN:%[a-z0-9.]+]] = getelementptr inbounds float* %in, i32 %id
+; CHECK: [[INV:%[0-9]+]] = bitcast float* [[IN]] to <4 x float>*
+; CHECK: [[X:%[a-z0-9.]+]] = load <4 x float>* [[INV]], align 4
+; CHECK: fmul <4 x float> [[X]]
+; CHECK: bitcast float* {{%[a-z0-9.]+}} to <4 x float>*
+; CHECK: store <4 x float>
+; CHECK: ret void
+define void @scale(float* %in, float* %out, float %k) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  %pin = getelementptr inbounds float* %in, i32 %id
+  %x = load float* %pin, align 4
+  %y = fmul float %x, %k
+  %pout = getelementptr inbounds float* %out, i32 %id
+  store float %y, float* %pout, align 4
+  ret void
+}
+
+; A strided read is a gather; the loop over a uniform bound keeps its CFG.
+; CHECK-LABEL: @sumcol(
+; CHECK: loop:
+; CHECK: %acc = phi <4 x float>
+; CHECK: %i = phi i32
+; CHECK: extractelement <4 x float*>
+; CHECK: load float*
+; CHECK: br i1 %done, label %exit, label %loop
+; CHECK: exit:
+; CHECK: store <4 x float>
+define void @sumcol(float* %m, float* %out, i32 %n) {
+entry:
+  %id = call i32 @get_global_id(i32 0)
+  br label %loop
+
+loop:
+  %acc = phi float [ 0.0, %entry ], [ %acc.next, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %row = mul i32 %i, 16
+  %idx.off = mul i32 %id, 16
+  %idx = add i32 %idx.off, %i
+  %p = getelementptr inbounds float* %m, i32 %idx
+  %v = load float* %p, align 4
+  %acc.next = fadd float %acc, %v
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %pout = getelementptr inbounds float* %out, i32 %id
+  store float %acc.next, float* %pout, align 4
+  ret void
+}
+
+; Functions that never ask for their id are left alone.
+; CHECK: define void @notkernel(float* %p, float %x) {
+; CHECK-NEXT: store float %x, float* %p
+define void @notkernel(float* %p, float %x) {
+  store float %x, float* %p
+  ret void
+}
+
+; CHECK: attributes [[ATTR]] = { "spmd-width"="4" }
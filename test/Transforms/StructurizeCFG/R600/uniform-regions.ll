@@ -0,0 +1,57 @@
+; RUN: opt -S -structurizecfg -structurizecfg-skip-uniform-regions < %s | FileCheck %s
+; RUN: opt -S -structurizecfg < %s | FileCheck %s -check-prefix=ALL
+
+target triple = "r600--"
+
+declare i32 @llvm.r600.read.tidig.x() nounwind readnone
+
+; A branch on a kernel argument is the same for all threads, so its region
+; can keep its branches; the branch on the thread index still needs flow
+; blocks.
+
+; CHECK-LABEL: @uniform(
+; CHECK: entry:
+; CHECK-NEXT: %cond = icmp eq i32 %n, 0
+; CHECK-NEXT: br i1 %cond, label %then, label %else
+; CHECK-NOT: Flow
+; CHECK: ret void
+
+; ALL-LABEL: @uniform(
+; ALL: Flow
+define void @uniform(i32 addrspace(1)* %out, i32 %n) {
+entry:
+  %cond = icmp eq i32 %n, 0
+  br i1 %cond, label %then, label %else
+
+then:
+  store i32 1, i32 addrspace(1)* %out
+  br label %end
+
+else:
+  store i32 2, i32 addrspace(1)* %out
+  br label %end
+
+end:
+  ret void
+}
+
+; CHECK-LABEL: @divergent(
+; CHECK: Flow
+; CHECK: ret void
+define void @divergent(i32 addrspace(1)* %out) {
+entry:
+  %tid = call i32 @llvm.r600.read.tidig.x()
+  %cond = icmp eq i32 %tid, 0
+  br i1 %cond, label %then, label %else
+
+then:
+  store i32 1, i32 addrspace(1)* %out
+  br label %end
+
+else:
+  store i32 2, i32 addrspace(1)* %out
+  br label %end
+
+end:
+  ret void
+}
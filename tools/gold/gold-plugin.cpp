@@ -80,6 +80,7 @@ namespace options {
   static std::string extra_library_path;
   static std::string triple;
   static std::string mcpu;
+  static unsigned jobs = 1;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -101,6 +102,12 @@ namespace options {
       extra_library_path = opt.substr(strlen("extra_library_path="));
     } else if (opt.startswith("mtriple=")) {
       triple = opt.substr(strlen("mtriple="));
+    } else if (opt.startswith("jobs=")) {
+      if (opt.substr(strlen("jobs=")).getAsInteger(10, jobs) || jobs == 0) {
+        (*message)(LDPL_WARNING, "Invalid number of jobs. Discarding %s",
+                   opt_);
+        jobs = 1;
+      }
     } else if (opt.startswith("obj-path=")) {
       obj_path = opt.substr(strlen("obj-path="));
     } else if (opt == "emit-llvm") {
@@ -442,13 +449,20 @@ static ld_plugin_status all_symbols_read_hook(void) {
     }
   }
 
-  std::string ObjPath;
+  // With more than one job, code is generated for pieces of the module on
+  // separate threads and each piece is linked in as an object of its own.
+  if (options::jobs > 1)
+    lto_codegen_set_parallelism(code_gen, options::jobs);
+
+  std::vector<std::string> ObjPaths;
   {
-    const char *Temp;
-    if (lto_codegen_compile_to_file(code_gen, &Temp)) {
+    const char **Names;
+    unsigned NumNames;
+    if (lto_codegen_compile_to_files(code_gen, &Names, &NumNames)) {
       (*message)(LDPL_ERROR, "Could not produce a combined object file\n");
+      return LDPS_ERR;
     }
-    ObjPath = Temp;
+    ObjPaths.assign(Names, Names + NumNames);
   }
 
   lto_codegen_dispose(code_gen);
@@ -460,10 +474,12 @@ static ld_plugin_status all_symbols_read_hook(void) {
     }
   }
 
-  if ((*add_input_file)(ObjPath.c_str()) != LDPS_OK) {
-    (*message)(LDPL_ERROR, "Unable to add .o file to the link.");
-    (*message)(LDPL_ERROR, "File left behind in: %s", ObjPath.c_str());
-    return LDPS_ERR;
+  for (unsigned i = 0, e = ObjPaths.size(); i != e; ++i) {
+    if ((*add_input_file)(ObjPaths[i].c_str()) != LDPS_OK) {
+      (*message)(LDPL_ERROR, "Unable to add .o file to the link.");
+      (*message)(LDPL_ERROR, "File left behind in: %s", ObjPaths[i].c_str());
+      return LDPS_ERR;
+    }
   }
 
   if (!options::extra_library_path.empty() &&
@@ -473,7 +489,7 @@ static ld_plugin_status all_symbols_read_hook(void) {
   }
 
   if (options::obj_path.empty())
-    Cleanup.push_back(ObjPath);
+    Cleanup.insert(Cleanup.end(), ObjPaths.begin(), ObjPaths.end());
 
   return LDPS_OK;
 }
@@ -20,14 +20,17 @@
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Object/ELFMerge.h"
 #include "llvm/Pass.h"
 #include "llvm/PassManager.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileOutputBuffer.h"
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
@@ -70,6 +73,11 @@ OptLevel("O",
 static cl::opt<std::string>
 TargetTriple("mtriple", cl::desc("Override target triple for module"));
 
+static cl::opt<unsigned>
+NumThreads("j", cl::desc("Split the module and generate code for the pieces "
+                         "on N threads (ELF object files only)"),
+           cl::value_desc("N"), cl::Prefix, cl::init(1u));
+
 cl::opt<bool> NoVerify("disable-verify", cl::Hidden,
                        cl::desc("Do not verify input module"));
 
@@ -80,6 +88,101 @@ DisableSimplifyLibCalls("disable-simplify-libcalls",
 
 static int compileModule(char**, LLVMContext&);
 
+// configureTargetMachine - Apply the MC options to a newly created target
+// machine.
+static void configureTargetMachine(TargetMachine &Target,
+                                   const Triple &TheTriple) {
+  if (DisableDotLoc)
+    Target.setMCUseLoc(false);
+
+  if (DisableCFI)
+    Target.setMCUseCFI(false);
+
+  if (EnableDwarfDirectory)
+    Target.setMCUseDwarfDirectory(true);
+
+  // Disable .loc support for older OS X versions.
+  if (TheTriple.isMacOSX() &&
+      TheTriple.isMacOSXVersionLT(10, 6))
+    Target.setMCUseLoc(false);
+
+  if (RelaxAll && FileType == TargetMachine::CGFT_ObjectFile)
+    Target.setMCRelaxAll(true);
+}
+
+// createTargetMachine - Create and configure a target machine for the
+// options given on the command line.
+static TargetMachine *createTargetMachine(const Target *TheTarget,
+                                          const Triple &TheTriple,
+                                          const std::string &FeaturesStr,
+                                          const TargetOptions &Options,
+                                          CodeGenOpt::Level OLvl) {
+  TargetMachine *Target =
+    TheTarget->createTargetMachine(TheTriple.getTriple(), MCPU, FeaturesStr,
+                                   Options, RelocModel, CMModel, OLvl);
+  assert(Target && "Could not allocate target machine!");
+  configureTargetMachine(*Target, TheTriple);
+  return Target;
+}
+
+// addAnalysisPasses - Add the passes that code generation for the module
+// relies on.
+static void addAnalysisPasses(PassManager &PM, TargetMachine &Target,
+                              const Triple &TheTriple, Module *mod) {
+  // Add an appropriate TargetLibraryInfo pass for the module's triple.
+  TargetLibraryInfo *TLI = new TargetLibraryInfo(TheTriple);
+  if (DisableSimplifyLibCalls)
+    TLI->disableAllFunctions();
+  PM.add(TLI);
+
+  // Add intenal analysis passes from the target machine.
+  Target.addAnalysisPasses(PM);
+
+  // Add the target data from the target machine, if it exists, or the module.
+  if (const DataLayout *TD = Target.getDataLayout())
+    PM.add(new DataLayout(*TD));
+  else
+    PM.add(new DataLayout(mod));
+}
+
+namespace {
+/// PartitionObjectCompiler - Generates an object file for one piece of the
+/// module with a target machine set up like the one for the whole module.
+class PartitionObjectCompiler : public PartitionCompiler {
+  const Target *TheTarget;
+  Triple TheTriple;
+  std::string FeaturesStr;
+  TargetOptions Options;
+  CodeGenOpt::Level OLvl;
+
+public:
+  PartitionObjectCompiler(const Target *TheTarget, const Triple &TheTriple,
+                          const std::string &FeaturesStr,
+                          const TargetOptions &Options,
+                          CodeGenOpt::Level OLvl)
+    : TheTarget(TheTarget), TheTriple(TheTriple), FeaturesStr(FeaturesStr),
+      Options(Options), OLvl(OLvl) {}
+
+  virtual bool compile(Module &M, raw_ostream &OS, std::string &ErrMsg) {
+    OwningPtr<TargetMachine>
+      target(createTargetMachine(TheTarget, TheTriple, FeaturesStr, Options,
+                                 OLvl));
+    TargetMachine &Target = *target.get();
+
+    PassManager PM;
+    addAnalysisPasses(PM, Target, TheTriple, &M);
+    formatted_raw_ostream FOS(OS);
+    if (Target.addPassesToEmitFile(PM, FOS, TargetMachine::CGFT_ObjectFile,
+                                   NoVerify)) {
+      ErrMsg = "target does not support generation of this file type!";
+      return true;
+    }
+    PM.run(M);
+    return false;
+  }
+};
+}
+
 // GetFileNameRoot - Helper function to get the basename of a filename.
 static inline std::string
 GetFileNameRoot(const std::string &InputFilename) {
@@ -97,9 +200,22 @@ GetFileNameRoot(const std::string &InputFilename) {
   return outputFilename;
 }
 
-static tool_output_file *GetOutputStream(const char *TargetName,
-                                         Triple::OSType OS,
-                                         const char *ProgName) {
+/// RemoveOutputFile - Remove the output file, if it is a regular file.
+static void RemoveOutputFile() {
+  sys::fs::file_status Status;
+  if (sys::fs::status(OutputFilename, Status) ||
+      !sys::fs::is_regular_file(Status))
+    return;
+  bool Existed;
+  sys::fs::remove(OutputFilename, Existed);
+}
+
+/// GetOutputStream - Open the output file in \p Out, or in \p MappedOut for
+/// object files that do not go to standard output; those are written through
+/// a mapping of the file once the object writer knows their size.
+static bool GetOutputStream(const char *TargetName, Triple::OSType OS,
+                            OwningPtr<tool_output_file> &Out,
+                            OwningPtr<raw_mmap_ostream> &MappedOut) {
   // If we don't yet have an output filename, make one.
   if (OutputFilename.empty()) {
     if (InputFilename == "-")
@@ -143,20 +259,44 @@ static tool_output_file *GetOutputStream(const char *TargetName,
     break;
   }
 
+  if (FileType == TargetMachine::CGFT_ObjectFile && OutputFilename != "-") {
+    // Nothing is written until the run succeeds; like tool_output_file, do
+    // not leave the output of an earlier run behind if it fails.
+    RemoveOutputFile();
+    MappedOut.reset(new raw_mmap_ostream(OutputFilename));
+    return true;
+  }
+
   // Open the file.
   std::string error;
   sys::fs::OpenFlags OpenFlags = sys::fs::F_None;
   if (Binary)
     OpenFlags |= sys::fs::F_Binary;
-  tool_output_file *FDOut = new tool_output_file(OutputFilename.c_str(), error,
-                                                 OpenFlags);
+  Out.reset(new tool_output_file(OutputFilename.c_str(), error, OpenFlags));
   if (!error.empty()) {
     errs() << error << '\n';
-    delete FDOut;
-    return 0;
+    return false;
   }
 
-  return FDOut;
+  return true;
+}
+
+/// KeepOutput - Declare success: keep the output file, or write out the mapped
+/// one. Returns false if that fails.
+static bool KeepOutput(OwningPtr<tool_output_file> &Out,
+                       OwningPtr<raw_mmap_ostream> &MappedOut,
+                       const char *ProgName) {
+  if (Out) {
+    Out->keep();
+    return true;
+  }
+  if (error_code EC = MappedOut->commit()) {
+    errs() << ProgName << ": error writing '" << OutputFilename << "': "
+           << EC.message() << '\n';
+    RemoveOutputFile();
+    return false;
+  }
+  return true;
 }
 
 // main - Entry point for the llc compiler.
@@ -280,67 +420,78 @@ static int compileModule(char **argv, LLVMContext &Context) {
   Options.EnableSegmentedStacks = SegmentedStacks;
   Options.UseInitArray = UseInitArray;
 
-  OwningPtr<TargetMachine>
-    target(TheTarget->createTargetMachine(TheTriple.getTriple(),
-                                          MCPU, FeaturesStr, Options,
-                                          RelocModel, CMModel, OLvl));
-  assert(target.get() && "Could not allocate target machine!");
+  // -mcpu=help and -mattr=help are answered while the target machine is
+  // created.
+  OwningPtr<TargetMachine> target;
+  if (SkipModule)
+    target.reset(createTargetMachine(TheTarget, TheTriple, FeaturesStr,
+                                     Options, OLvl));
   assert(mod && "Should have exited after outputting help!");
-  TargetMachine &Target = *target.get();
-
-  if (DisableDotLoc)
-    Target.setMCUseLoc(false);
-
-  if (DisableCFI)
-    Target.setMCUseCFI(false);
-
-  if (EnableDwarfDirectory)
-    Target.setMCUseDwarfDirectory(true);
 
   if (GenerateSoftFloatCalls)
     FloatABIForCalls = FloatABI::Soft;
 
-  // Disable .loc support for older OS X versions.
-  if (TheTriple.isMacOSX() &&
-      TheTriple.isMacOSXVersionLT(10, 6))
-    Target.setMCUseLoc(false);
-
   // Figure out where we are going to send the output.
-  OwningPtr<tool_output_file> Out
-    (GetOutputStream(TheTarget->getName(), TheTriple.getOS(), argv[0]));
-  if (!Out) return 1;
+  OwningPtr<tool_output_file> Out;
+  OwningPtr<raw_mmap_ostream> MappedOut;
+  if (!GetOutputStream(TheTarget->getName(), TheTriple.getOS(), Out,
+                       MappedOut))
+    return 1;
+  raw_ostream &OS = Out ? static_cast<raw_ostream &>(Out->os()) : *MappedOut;
 
-  // Build up all of the passes that we want to do to the module.
-  PassManager PM;
+  if (RelaxAll && FileType != TargetMachine::CGFT_ObjectFile)
+    errs() << argv[0]
+           << ": warning: ignoring -mc-relax-all because filetype != obj";
 
-  // Add an appropriate TargetLibraryInfo pass for the module's triple.
-  TargetLibraryInfo *TLI = new TargetLibraryInfo(TheTriple);
-  if (DisableSimplifyLibCalls)
-    TLI->disableAllFunctions();
-  PM.add(TLI);
-
-  // Add intenal analysis passes from the target machine.
-  Target.addAnalysisPasses(PM);
+  if (NumThreads > 1) {
+    // The pieces are put back together as object files; assembly for each
+    // would reuse the same local labels.
+    const char *Reason = 0;
+    if (FileType != TargetMachine::CGFT_ObjectFile)
+      Reason = "filetype != obj";
+    else if (!TheTriple.isOSBinFormatELF())
+      Reason = "the object format is not ELF";
+    else if (!StartAfter.empty() || !StopAfter.empty())
+      Reason = "-start-after or -stop-after is given";
+
+    if (Reason) {
+      errs() << argv[0] << ": warning: ignoring -j because " << Reason
+             << '\n';
+    } else {
+      PartitionObjectCompiler PC(TheTarget, TheTriple, FeaturesStr, Options,
+                                 OLvl);
+      std::vector<std::string> Objects;
+      std::string ErrMsg;
+      cl::PrintOptionValues();
+      if (splitCodeGen(*mod, NumThreads, PC, Objects, ErrMsg)) {
+        errs() << argv[0] << ": " << ErrMsg << '\n';
+        return 1;
+      }
+      std::vector<StringRef> ObjectRefs(Objects.begin(), Objects.end());
+      if (error_code EC = object::mergeELFObjects(ObjectRefs, OS)) {
+        errs() << argv[0] << ": error combining object files: "
+               << EC.message() << '\n';
+        return 1;
+      }
+      return KeepOutput(Out, MappedOut, argv[0]) ? 0 : 1;
+    }
+  }
 
-  // Add the target data from the target machine, if it exists, or the module.
-  if (const DataLayout *TD = Target.getDataLayout())
-    PM.add(new DataLayout(*TD));
-  else
-    PM.add(new DataLayout(mod));
+  // The pieces of a parallel run each create their own target machine; only
+  // the serial path needs one for the whole module.
+  target.reset(createTargetMachine(TheTarget, TheTriple, FeaturesStr, Options,
+                                   OLvl));
+  TargetMachine &Target = *target.get();
 
   // Override default to generate verbose assembly.
   Target.setAsmVerbosityDefault(true);
 
-  if (RelaxAll) {
-    if (FileType != TargetMachine::CGFT_ObjectFile)
-      errs() << argv[0]
-             << ": warning: ignoring -mc-relax-all because filetype != obj";
-    else
-      Target.setMCRelaxAll(true);
-  }
+  // Build up all of the passes that we want to do to the module.
+  PassManager PM;
+  addAnalysisPasses(PM, Target, TheTriple, mod);
 
   {
-    formatted_raw_ostream FOS(Out->os());
+    formatted_raw_ostream FOS(OS);
 
     AnalysisID StartAfterID = 0;
     AnalysisID StopAfterID = 0;
@@ -377,7 +528,8 @@ static int compileModule(char **argv, LLVMContext &Context) {
   }
 
   // Declare success.
-  Out->keep();
+  if (!KeepOutput(Out, MappedOut, argv[0]))
+    return 1;
 
   return 0;
 }
@@ -61,5 +61,45 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddr) { // PR11677
   passes.run(*m);
 }
 
+static void writeFunctionsToBuffer(SmallVectorImpl<char> &Buffer) {
+  OwningPtr<Module> Mod(new Module("test-index", getGlobalContext()));
+  LLVMContext &Context = Mod->getContext();
+  FunctionType *FuncTy = FunctionType::get(Type::getInt32Ty(Context), false);
+  for (unsigned i = 0; i != 4; ++i) {
+    Function *Func = Function::Create(FuncTy, GlobalValue::ExternalLinkage,
+                                      "func" + Twine(i), Mod.get());
+    BasicBlock *Entry = BasicBlock::Create(Context, "entry", Func);
+    ReturnInst::Create(Context, ConstantInt::get(Type::getInt32Ty(Context), i),
+                       Entry);
+  }
+  raw_svector_ostream OS(Buffer);
+  WriteBitcodeToFile(Mod.get(), OS);
+}
+
+TEST(BitReaderTest, MaterializeOneFunction) {
+  SmallString<1024> Mem;
+  writeFunctionsToBuffer(Mem);
+  MemoryBuffer *Buffer = MemoryBuffer::getMemBuffer(Mem.str(), "test", false);
+  std::string errMsg;
+  OwningPtr<Module> m(getLazyBitcodeModule(Buffer, getGlobalContext(),
+                                           &errMsg));
+  ASSERT_TRUE(m.get() != 0) << errMsg;
+
+  // The function index lets the last body be read on its own.
+  Function *F = m->getFunction("func3");
+  EXPECT_FALSE(F->Materialize(&errMsg)) << errMsg;
+  ReturnInst *Ret = cast<ReturnInst>(F->getEntryBlock().getTerminator());
+  EXPECT_EQ(3u, cast<ConstantInt>(Ret->getReturnValue())->getZExtValue());
+  EXPECT_TRUE(m->getFunction("func0")->isMaterializable());
+
+  EXPECT_FALSE(m->MaterializeAllPermanently(&errMsg)) << errMsg;
+  for (unsigned i = 0; i != 4; ++i) {
+    Function *G = m->getFunction(("func" + Twine(i)).str());
+    Ret = cast<ReturnInst>(G->getEntryBlock().getTerminator());
+    EXPECT_EQ(i, cast<ConstantInt>(Ret->getReturnValue())->getZExtValue());
+  }
+  EXPECT_FALSE(verifyModule(*m, ReturnStatusAction));
+}
+
 }
 }
@@ -16,6 +16,7 @@
 #include "llvm-c/Core.h"
 #include "llvm-c/ExecutionEngine.h"
 #include "llvm-c/Target.h"
+#include "llvm-c/TargetMachine.h"
 #include "llvm-c/Transforms/Scalar.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/Support/Host.h"
@@ -194,3 +195,53 @@ TEST_F(MCJITCAPITest, custom_memory_manager) {
   EXPECT_EQ(42, functionPointer.usable());
   EXPECT_TRUE(didCallAllocateCodeSection);
 }
+
+TEST_F(MCJITCAPITest, codegen_session) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  buildSimpleFunction();
+
+  LLVMModuleRef Other = LLVMModuleCreateWithName("other_module");
+  LLVMSetTarget(Other, HostTriple.c_str());
+  LLVMValueRef OtherFunction = LLVMAddFunction(
+    Other, "other_function", LLVMFunctionType(LLVMInt32Type(), 0, 0, 0));
+  LLVMBuilderRef builder = LLVMCreateBuilder();
+  LLVMPositionBuilderAtEnd(builder,
+                           LLVMAppendBasicBlock(OtherFunction, "entry"));
+  LLVMBuildRet(builder, LLVMConstInt(LLVMInt32Type(), 7, 0));
+  LLVMDisposeBuilder(builder);
+
+  LLVMTargetRef Target;
+  ASSERT_FALSE(LLVMGetTargetFromTriple(HostTriple.c_str(), &Target, &Error));
+  LLVMTargetMachineRef TM = LLVMCreateTargetMachine(
+    Target, const_cast<char *>(HostTriple.c_str()), "", "",
+    LLVMCodeGenLevelDefault, LLVMRelocDefault, LLVMCodeModelDefault);
+
+  LLVMModuleRef Modules[2] = { Module, Other };
+  std::string Expected[2];
+  for (unsigned i = 0; i != 2; ++i) {
+    LLVMMemoryBufferRef Buf;
+    ASSERT_FALSE(LLVMTargetMachineEmitToMemoryBuffer(TM, Modules[i],
+                                                     LLVMObjectFile, &Error,
+                                                     &Buf));
+    Expected[i].assign(LLVMGetBufferStart(Buf), LLVMGetBufferSize(Buf));
+    LLVMDisposeMemoryBuffer(Buf);
+  }
+
+  // The output for each module must not depend on what the session
+  // compiled before it.
+  LLVMCodeGenSessionRef Session =
+    LLVMCreateCodeGenSession(TM, LLVMObjectFile, &Error);
+  ASSERT_TRUE(Session != 0);
+  for (unsigned i = 0; i != 4; ++i) {
+    LLVMMemoryBufferRef Buf =
+      LLVMCodeGenSessionEmitToMemoryBuffer(Session, Modules[i % 2]);
+    EXPECT_EQ(Expected[i % 2], std::string(LLVMGetBufferStart(Buf),
+                                           LLVMGetBufferSize(Buf)));
+    LLVMDisposeMemoryBuffer(Buf);
+  }
+
+  LLVMDisposeCodeGenSession(Session);
+  LLVMDisposeTargetMachine(TM);
+  LLVMDisposeModule(Other);
+}
@@ -11,10 +11,12 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
 #include "llvm/ExecutionEngine/JIT.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/FileSystem.h"
 #include "MCJITTestBase.h"
 #include "gtest/gtest.h"
 
@@ -86,6 +88,36 @@ private:
   bool                            DuplicateInserted;
 };
 
+class TestFileObjectCache : public FileObjectCache {
+public:
+  TestFileObjectCache(StringRef Dir, StringRef TargetKey, uint64_t MaxSize = 0)
+    : FileObjectCache(Dir, TargetKey, MaxSize), Hits(0), Stores(0) { }
+
+  virtual void notifyObjectCompiled(const Module *M, const MemoryBuffer *Obj) {
+    ++Stores;
+    FileObjectCache::notifyObjectCompiled(M, Obj);
+  }
+
+  virtual MemoryBuffer* getObject(const Module* M) {
+    MemoryBuffer *Obj = FileObjectCache::getObject(M);
+    if (Obj)
+      ++Hits;
+    return Obj;
+  }
+
+  unsigned Hits;
+  unsigned Stores;
+};
+
+static unsigned countFiles(StringRef Dir) {
+  unsigned Count = 0;
+  error_code EC;
+  for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+       I.increment(EC))
+    ++Count;
+  return Count;
+}
+
 class MCJITObjectCacheTest : public testing::Test, public MCJITTestBase {
 protected:
 
@@ -238,5 +270,96 @@ TEST_F(MCJITObjectCacheTest, VerifyNonLoadFromCache) {
   EXPECT_FALSE(Cache->wereDuplicatesInserted());
 }
 
+TEST_F(MCJITObjectCacheTest, FileCacheLoadFromDisk) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  SmallString<128> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("objcache", Dir));
+
+  {
+    TestFileObjectCache Cache(Dir, "key");
+    createJIT(M.take());
+    TheJIT->setObjectCache(&Cache);
+    compileAndRun();
+    EXPECT_EQ(0U, Cache.Hits);
+    EXPECT_EQ(1U, Cache.Stores);
+    TheJIT.reset();
+  }
+  EXPECT_EQ(1U, countFiles(Dir));
+
+  // A new cache on the same directory stands in for a later process.  The
+  // module has another name but the same contents, so it should be a hit.
+  MM = new SectionMemoryManager;
+  M.reset(createEmptyModule("<renamed>"));
+  Main = insertMainFunction(M.get(), OriginalRC);
+  {
+    TestFileObjectCache Cache(Dir, "key");
+    createJIT(M.take());
+    TheJIT->setObjectCache(&Cache);
+    compileAndRun();
+    EXPECT_EQ(1U, Cache.Hits);
+    EXPECT_EQ(0U, Cache.Stores);
+    TheJIT.reset();
+  }
+
+  sys::fs::remove_all(Dir.str());
+}
+
+TEST_F(MCJITObjectCacheTest, FileCacheTargetKeyMismatch) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  SmallString<128> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("objcache", Dir));
+
+  TestFileObjectCache First(Dir, "key-a");
+  OwningPtr<MemoryBuffer> Obj(MemoryBuffer::getMemBuffer("object"));
+  First.notifyObjectCompiled(M.get(), Obj.get());
+
+  TestFileObjectCache Second(Dir, "key-b");
+  OwningPtr<MemoryBuffer> Found(Second.getObject(M.get()));
+  EXPECT_EQ(0, Found.get());
+
+  Found.reset(First.getObject(M.get()));
+  ASSERT_TRUE(0 != Found.get());
+  EXPECT_EQ("object", Found->getBuffer());
+
+  sys::fs::remove_all(Dir.str());
+}
+
+TEST_F(MCJITObjectCacheTest, FileCacheSizeLimit) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  SmallString<128> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("objcache", Dir));
+
+  // Room for two of the three objects.
+  TestFileObjectCache Cache(Dir, "key", 250);
+  std::string Contents(100, 'x');
+  OwningPtr<MemoryBuffer> Obj(MemoryBuffer::getMemBuffer(Contents));
+  OwningPtr<Module> Mods[3];
+  for (unsigned i = 0; i != 3; ++i) {
+    Mods[i].reset(createEmptyModule("<main>"));
+    insertMainFunction(Mods[i].get(), i);
+  }
+
+  // The uses most likely fall in the same second, where only the order in
+  // which the cache saw them tells them apart.  The hit makes 0 newer than 1,
+  // so 1 is the one to go.
+  Cache.notifyObjectCompiled(Mods[0].get(), Obj.get());
+  Cache.notifyObjectCompiled(Mods[1].get(), Obj.get());
+  delete Cache.getObject(Mods[0].get());
+  Cache.notifyObjectCompiled(Mods[2].get(), Obj.get());
+  EXPECT_EQ(2U, countFiles(Dir));
+
+  OwningPtr<MemoryBuffer> Hit(Cache.getObject(Mods[0].get()));
+  EXPECT_TRUE(0 != Hit.get());
+  Hit.reset(Cache.getObject(Mods[2].get()));
+  EXPECT_TRUE(0 != Hit.get());
+  Hit.reset(Cache.getObject(Mods[1].get()));
+  EXPECT_TRUE(0 == Hit.get());
+
+  sys::fs::remove_all(Dir.str());
+}
+
 } // Namespace
 
@@ -11,6 +11,8 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormattedStream.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "gtest/gtest.h"
@@ -117,4 +119,81 @@ TEST(FileOutputBuffer, Test) {
   uint32_t RemovedCount;
   ASSERT_NO_ERROR(fs::remove_all(TestDirectory.str(), RemovedCount));
 }
+
+/// readFile - Return the contents of \p Path, or "<missing>".
+std::string readFile(StringRef Path) {
+  OwningPtr<MemoryBuffer> Buffer;
+  if (MemoryBuffer::getFile(Path, Buffer))
+    return "<missing>";
+  return Buffer->getBuffer().str();
+}
+
+TEST(FileOutputBuffer, MmapOstream) {
+  SmallString<128> TestDirectory;
+  {
+    ASSERT_NO_ERROR(
+        fs::createUniqueDirectory("FileOutputBuffer-test", TestDirectory));
+  }
+  SmallString<128> File(TestDirectory);
+  File.append("/file");
+
+  // Output that fits in the reserved space is written to the mapped file.
+  {
+    raw_mmap_ostream OS(File);
+    OS << "header";
+    OS.reserveExtraSpace(9);
+    OS << "-body" << 1234;
+    ASSERT_NO_ERROR(OS.commit());
+  }
+  EXPECT_EQ("header-body1234", readFile(File));
+
+  // Output in excess of the reservation is kept, and so is output that is
+  // smaller than it.
+  {
+    raw_mmap_ostream OS(File);
+    OS.reserveExtraSpace(4);
+    OS << "abcdefgh";
+    OS.reserveExtraSpace(100);
+    OS << "ijk";
+    ASSERT_NO_ERROR(OS.commit());
+  }
+  EXPECT_EQ("abcdefghijk", readFile(File));
+
+  // Without a reservation the output is written by commit().
+  {
+    raw_mmap_ostream OS(File);
+    OS << "plain";
+    ASSERT_NO_ERROR(OS.commit());
+  }
+  EXPECT_EQ("plain", readFile(File));
+
+  // A formatted stream on top takes over the buffering and flushes into the
+  // mapping.
+  {
+    raw_mmap_ostream OS(File);
+    {
+      formatted_raw_ostream FOS(OS);
+      FOS << "start";
+      FOS.reserveExtraSpace(6);
+      FOS << "-" << 12345;
+    }
+    ASSERT_NO_ERROR(OS.commit());
+  }
+  EXPECT_EQ("start-12345", readFile(File));
+
+  // Nothing is written if the stream is not committed.
+  SmallString<128> File2(TestDirectory);
+  File2.append("/file2");
+  {
+    raw_mmap_ostream OS(File2);
+    OS.reserveExtraSpace(4);
+    OS << "data";
+  }
+  bool Exists = true;
+  ASSERT_NO_ERROR(fs::exists(Twine(File2), Exists));
+  EXPECT_FALSE(Exists);
+
+  uint32_t RemovedCount;
+  ASSERT_NO_ERROR(fs::remove_all(TestDirectory.str(), RemovedCount));
+}
 } // anonymous namespace
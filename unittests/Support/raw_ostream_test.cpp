@@ -143,4 +143,14 @@ TEST(raw_ostreamTest, WriteEscaped) {
   EXPECT_EQ("\\001\\010\\200", Str);
 }
 
+TEST(raw_ostreamTest, ReserveExtraSpace) {
+  SmallString<16> Vec;
+  raw_svector_ostream OS(Vec);
+  OS << "abc";
+  OS.reserveExtraSpace(1000);
+  EXPECT_LE(1003u, Vec.capacity());
+  OS << "def";
+  EXPECT_EQ("abcdef", OS.str());
+}
+
 }
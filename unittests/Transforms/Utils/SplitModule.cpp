@@ -0,0 +1,134 @@
+//===- SplitModule.cpp - Unit tests for extractModulePartition ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/Verifier.h"
+#include "llvm/Assembly/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <map>
+#include <string>
+
+using namespace llvm;
+
+namespace {
+
+const char *ModuleString =
+  "@.str = private unnamed_addr constant [3 x i8] c\"hi\\00\"\n"
+  "@state = internal global i32 0\n"
+  "@shared = global i32 1\n"
+  "@llvm.global_ctors = appending global [1 x { i32, void ()* }] "
+  "[{ i32, void ()* } { i32 65535, void ()* @init }]\n"
+  "@d_alias = alias i32 (i32)* @d\n"
+  "declare void @use(i8*)\n"
+  "define internal void @init() {\n"
+  "  store i32 1, i32* @shared\n"
+  "  ret void\n"
+  "}\n"
+  "define internal i32 @helper(i32 %x) {\n"
+  "  %v = load i32* @state\n"
+  "  %r = add i32 %x, %v\n"
+  "  store i32 %r, i32* @state\n"
+  "  ret i32 %r\n"
+  "}\n"
+  "define i32 @a(i32 %x) {\n"
+  "  %r = call i32 @helper(i32 %x)\n"
+  "  %s = mul i32 %r, %r\n"
+  "  %t = mul i32 %s, %r\n"
+  "  %u = mul i32 %t, %r\n"
+  "  ret i32 %u\n"
+  "}\n"
+  "define i32 @b(i32 %x) {\n"
+  "  %r = call i32 @helper(i32 %x)\n"
+  "  ret i32 %r\n"
+  "}\n"
+  "define i32 @c(i32 %x) {\n"
+  "  call void @use(i8* getelementptr ([3 x i8]* @.str, i32 0, i32 0))\n"
+  "  %r = call i32 @d_alias(i32 %x)\n"
+  "  %s = add i32 %r, 1\n"
+  "  %t = add i32 %s, 2\n"
+  "  %u = add i32 %t, 3\n"
+  "  ret i32 %u\n"
+  "}\n"
+  "define i32 @d(i32 %x) {\n"
+  "  call void @use(i8* getelementptr ([3 x i8]* @.str, i32 0, i32 0))\n"
+  "  %v = load i32* @shared\n"
+  "  %r = add i32 %x, %v\n"
+  "  ret i32 %r\n"
+  "}\n";
+
+const unsigned NumPartitions = 3;
+
+/// Owners - The partitions that define each global value.
+typedef std::map<std::string, std::vector<unsigned> > Owners;
+
+Owners splitModule() {
+  Owners Result;
+  for (unsigned P = 0; P != NumPartitions; ++P) {
+    LLVMContext Context;
+    SMDiagnostic Err;
+    OwningPtr<Module> M(ParseAssemblyString(ModuleString, 0, Err, Context));
+    EXPECT_TRUE(M.get() != 0);
+    if (!M)
+      return Result;
+
+    extractModulePartition(*M, P, NumPartitions);
+    EXPECT_FALSE(verifyModule(*M, ReturnStatusAction));
+
+    for (Module::global_iterator I = M->global_begin(), E = M->global_end();
+         I != E; ++I)
+      if (!I->isDeclaration())
+        Result[I->getName()].push_back(P);
+    for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
+      if (!I->isDeclaration())
+        Result[I->getName()].push_back(P);
+    for (Module::alias_iterator I = M->alias_begin(), E = M->alias_end();
+         I != E; ++I)
+      Result[I->getName()].push_back(P);
+  }
+  return Result;
+}
+
+TEST(SplitModuleTest, EachDefinitionInOnePartition) {
+  Owners O = splitModule();
+
+  const char *Unique[] = { "state", "shared", "llvm.global_ctors", "d_alias",
+                           "init", "helper", "a", "b", "c", "d" };
+  for (unsigned I = 0; I != array_lengthof(Unique); ++I)
+    EXPECT_EQ(1u, O[Unique[I]].size()) << Unique[I];
+
+  // Local symbols go with their users, and aliases with their targets.
+  EXPECT_EQ(O["helper"], O["a"]);
+  EXPECT_EQ(O["helper"], O["b"]);
+  EXPECT_EQ(O["state"], O["helper"]);
+  EXPECT_EQ(O["init"], O["llvm.global_ctors"]);
+  EXPECT_EQ(O["d_alias"], O["d"]);
+
+  // The string is copied into every partition that uses it.
+  std::vector<unsigned> StrUsers = O["c"];
+  StrUsers.insert(StrUsers.end(), O["d"].begin(), O["d"].end());
+  std::sort(StrUsers.begin(), StrUsers.end());
+  StrUsers.erase(std::unique(StrUsers.begin(), StrUsers.end()),
+                 StrUsers.end());
+  EXPECT_EQ(StrUsers, O[".str"]);
+
+  // The groups are spread over more than one partition.
+  EXPECT_NE(O["a"], O["c"]);
+}
+
+TEST(SplitModuleTest, Deterministic) {
+  EXPECT_EQ(splitModule(), splitModule());
+}
+
+}
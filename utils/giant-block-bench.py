@@ -0,0 +1,207 @@
+#!/usr/bin/env python
+
+"""Measure how code generation time grows with the size of a basic block.
+
+Generates functions consisting of a single huge basic block in one of
+several shapes, runs llc on each size with -time-passes, and reports for
+every pass and every SelectionDAG phase the time taken at each size and the
+growth exponent between the two largest sizes.  An exponent near 1 means the
+phase is linear in the block size; anything much above that is flagged.
+
+Shapes:
+  chain    - one long dependent chain of integer arithmetic
+  fanout   - many values computed from a few inputs, summed at the end
+  memory   - a long run of loads and stores through distinct pointers
+  float    - independent floating point chains interleaved
+
+Example:
+  giant-block-bench.py --llc=./bin/llc --sizes=2000,4000,8000 chain memory
+  giant-block-bench.py --llc=./bin/llc --llc-arg=-march=qpu float
+"""
+
+# This script runs with Python 2.7 and 3.2+
+
+from __future__ import print_function
+import argparse
+import math
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def gen_chain(n):
+    body = ['  %v0 = add i32 %a, %b']
+    for i in range(1, n):
+        op = ('add', 'xor', 'mul', 'sub')[i % 4]
+        body.append('  %%v%d = %s i32 %%v%d, %d' % (i, op, i - 1, i + 1))
+    body.append('  ret i32 %%v%d' % (n - 1))
+    return ('define i32 @f(i32 %a, i32 %b) {\nentry:\n' +
+            '\n'.join(body) + '\n}\n')
+
+
+def gen_fanout(n):
+    body = []
+    for i in range(n):
+        op = ('add', 'xor', 'mul', 'sub')[i % 4]
+        src = ('%a', '%b', '%c')[i % 3]
+        body.append('  %%v%d = %s i32 %s, %d' % (i, op, src, i + 1))
+    body.append('  %s0 = add i32 %v0, %v1')
+    for i in range(2, n):
+        body.append('  %%s%d = add i32 %%s%d, %%v%d' % (i - 1, i - 2, i))
+    body.append('  ret i32 %%s%d' % (n - 2))
+    return ('define i32 @f(i32 %a, i32 %b, i32 %c) {\nentry:\n' +
+            '\n'.join(body) + '\n}\n')
+
+
+def gen_memory(n):
+    body = []
+    for i in range(n // 2):
+        body.append('  %%p%d = getelementptr i32* %%p, i32 %d' % (i, i))
+        body.append('  %%q%d = getelementptr i32* %%q, i32 %d' % (i, i))
+        body.append('  %%x%d = load i32* %%p%d' % (i, i))
+        body.append('  %%y%d = add i32 %%x%d, %d' % (i, i, i))
+        body.append('  store i32 %%y%d, i32* %%q%d' % (i, i))
+    body.append('  ret void')
+    return ('define void @f(i32* noalias %p, i32* noalias %q) {\nentry:\n' +
+            '\n'.join(body) + '\n}\n')
+
+
+def gen_float(n):
+    lanes = 8
+    body = []
+    for l in range(lanes):
+        body.append('  %%f%d_0 = fadd float %%a, %d.0' % (l, l))
+    steps = max(1, n // lanes)
+    for i in range(1, steps):
+        for l in range(lanes):
+            op = ('fadd', 'fmul')[i % 2]
+            body.append('  %%f%d_%d = %s float %%f%d_%d, %%b' %
+                        (l, i, op, l, i - 1))
+    body.append('  %%r0 = fadd float %%f0_%d, %%f1_%d' %
+                (steps - 1, steps - 1))
+    for l in range(2, lanes):
+        body.append('  %%r%d = fadd float %%r%d, %%f%d_%d' %
+                    (l - 1, l - 2, l, steps - 1))
+    body.append('  ret float %%r%d' % (lanes - 2))
+    return ('define float @f(float %a, float %b) {\nentry:\n' +
+            '\n'.join(body) + '\n}\n')
+
+
+SHAPES = {
+    'chain': gen_chain,
+    'fanout': gen_fanout,
+    'memory': gen_memory,
+    'float': gen_float,
+}
+
+# One row of a -time-passes table: one or more "time (percent%)" columns
+# followed by the name.  The last column is always the wall time.
+TIMING_ROW = re.compile(r'^\s*((?:[\d.]+\s+\(\s*[\d.]+%\)\s+)+)(.+?)\s*$')
+TIMING_COL = re.compile(r'([\d.]+)\s+\(\s*[\d.]+%\)')
+
+
+def parse_time_passes(text):
+    """Return {(group, name): wall seconds} from llc -time-passes output."""
+    times = {}
+    group = ''
+    lines = text.splitlines()
+    for i, line in enumerate(lines):
+        # Each table starts with its title between two rules of '='.
+        if (0 < i < len(lines) - 1 and lines[i - 1].startswith('===-') and
+                lines[i + 1].startswith('===-')):
+            group = line.strip().strip('.').strip()
+            continue
+        m = TIMING_ROW.match(line)
+        if not m or m.group(2) == 'Total':
+            continue
+        wall = float(TIMING_COL.findall(m.group(1))[-1])
+        key = (group, m.group(2))
+        times[key] = times.get(key, 0.0) + wall
+    return times
+
+
+def run_llc(llc, args, ir):
+    fd, path = tempfile.mkstemp(suffix='.ll')
+    try:
+        with os.fdopen(fd, 'w') as f:
+            f.write(ir)
+        cmd = [llc, '-time-passes', '-o', os.devnull] + args + [path]
+        p = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                             stderr=subprocess.PIPE, universal_newlines=True)
+        _, err = p.communicate()
+        if p.returncode != 0:
+            sys.exit('error: %s failed:\n%s' % (' '.join(cmd), err))
+        return parse_time_passes(err)
+    finally:
+        os.remove(path)
+
+
+def report(shape, sizes, results, threshold, min_time):
+    print('== %s' % shape)
+    keys = set()
+    for r in results:
+        keys.update(r.keys())
+    rows = []
+    for key in keys:
+        times = [r.get(key, 0.0) for r in results]
+        exponent = None
+        if times[-2] >= min_time and times[-1] >= min_time:
+            exponent = (math.log(times[-1] / times[-2]) /
+                        math.log(float(sizes[-1]) / sizes[-2]))
+        rows.append((times[-1], key, times, exponent))
+    rows.sort(reverse=True)
+
+    header = ''.join('%10d' % s for s in sizes)
+    print('%s  %6s  %s' % (header, 'exp', 'phase'))
+    for _, key, times, exponent in rows:
+        cols = ''.join('%10.4f' % t for t in times)
+        exp = '%6.2f' % exponent if exponent is not None else '%6s' % '-'
+        flag = ' <--' if exponent is not None and exponent > threshold else ''
+        name = key[1] if not key[0] else '%s: %s' % (key[0], key[1])
+        print('%s  %s  %s%s' % (cols, exp, name, flag))
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('shapes', nargs='*', default=sorted(SHAPES),
+                        help='shapes to measure (default: all)')
+    parser.add_argument('--llc', default='llc', help='llc binary to run')
+    parser.add_argument('--llc-arg', action='append', default=[],
+                        help='extra argument for llc, may be repeated')
+    parser.add_argument('--sizes', default='1000,2000,4000,8000',
+                        help='comma separated instruction counts')
+    parser.add_argument('--threshold', type=float, default=1.3,
+                        help='flag phases growing faster than n^threshold')
+    parser.add_argument('--min-time', type=float, default=0.01,
+                        help='ignore phases faster than this many seconds')
+    parser.add_argument('--emit', metavar='DIR',
+                        help='write the generated IR to DIR instead of '
+                             'running llc')
+    args = parser.parse_args()
+
+    sizes = [int(s) for s in args.sizes.split(',')]
+    if len(sizes) < 2:
+        parser.error('need at least two sizes')
+    for shape in args.shapes:
+        if shape not in SHAPES:
+            parser.error('unknown shape %r' % shape)
+
+    for shape in args.shapes:
+        if args.emit:
+            for n in sizes:
+                path = os.path.join(args.emit, '%s-%d.ll' % (shape, n))
+                with open(path, 'w') as f:
+                    f.write(SHAPES[shape](n))
+            continue
+        results = [run_llc(args.llc, args.llc_arg, SHAPES[shape](n))
+                   for n in sizes]
+        report(shape, sizes, results, args.threshold, args.min_time)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python
+
+"""Measure how assembler relaxation time grows with the size of a section.
+
+Generates x86-64 assembly files of several branch-heavy shapes, assembles
+each size to an object file with llvm-mc, and reports the time taken at each
+size and the growth exponent between the two largest sizes.  An exponent
+near 1 means layout and relaxation are linear in the section size; anything
+much above that is flagged.
+
+Shapes:
+  cascade  - every jump is pushed out of range by the one after it, which
+             lies between it and its target
+  backward - every jump goes back over the one before it, which pushes it
+             out of range
+  exits    - many functions whose blocks all branch to the function exit
+  mixed    - aligned functions with short and long branches in both
+             directions
+
+Example:
+  relax-bench.py --llvm-mc=./bin/llvm-mc --sizes=2000,4000,8000 cascade
+  relax-bench.py --emit=/tmp/relax mixed
+"""
+
+# This script runs with Python 2.7 and 3.2+
+
+from __future__ import print_function
+import argparse
+import math
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def gen_cascade(n):
+    # Jump i targets the label just after jump i + 1, which is 126 bytes
+    # away, so it only fits until jump i + 1 is relaxed.  The last one never
+    # fits, which starts the chain.
+    lines = ['  .text', '  .globl f', 'f:']
+    for i in range(n):
+        if i >= 2:
+            lines.append('.Lt%d:' % (i - 2))
+        lines.append('  jmp .Lt%d' % i if i != n - 1 else '  jmp .Lend')
+        lines.append('  .fill 62, 1, 0x90')
+    lines.append('.Lt%d:' % (n - 2))
+    lines.append('  .fill 200, 1, 0x90')
+    lines.append('.Lend:')
+    lines.append('  ret')
+    return '\n'.join(lines) + '\n'
+
+
+def gen_backward(n):
+    # Jump i goes back to the label before jump i - 1 and only fits until
+    # that one is relaxed.  The first one never fits.
+    lines = ['  .text', '  .globl f', 'f:', '.Lb0:', '  .fill 200, 1, 0x90']
+    for i in range(n):
+        lines.append('.Lb%d:' % (i + 1))
+        lines.append('  jmp .Lb%d' % i)
+        lines.append('  .fill 124, 1, 0x90')
+    lines.append('  ret')
+    return '\n'.join(lines) + '\n'
+
+
+def gen_exits(n):
+    lines = ['  .text']
+    blocks = 20
+    for f in range(max(1, n // blocks)):
+        lines += ['  .p2align 4', '  .globl f%d' % f, 'f%d:' % f]
+        for b in range(blocks):
+            lines.append('  testl %edi, %edi')
+            lines.append('  je .Lexit%d' % f)
+            lines.append('  addl $%d, %%eax' % (b + 1))
+        lines += ['.Lexit%d:' % f, '  ret']
+    return '\n'.join(lines) + '\n'
+
+
+def gen_mixed(n):
+    r = random.Random(n)
+    lines = ['  .text']
+    blocks = 50
+    for f in range(max(1, n // blocks)):
+        lines += ['  .p2align 4', '  .globl g%d' % f, 'g%d:' % f]
+        for b in range(blocks):
+            lines.append('.Lg%d_%d:' % (f, b))
+            lines.append('  .fill %d, 1, 0x90' % r.randint(1, 40))
+            t = r.randint(0, blocks)
+            op = r.choice(('jmp', 'jne', 'jb', 'jle'))
+            lines.append('  %s .Lg%d_%d' % (op, f, t))
+            if r.random() < 0.1:
+                lines.append('  .p2align 3')
+        lines += ['.Lg%d_%d:' % (f, blocks), '  ret']
+    return '\n'.join(lines) + '\n'
+
+
+SHAPES = {
+    'cascade': gen_cascade,
+    'backward': gen_backward,
+    'exits': gen_exits,
+    'mixed': gen_mixed,
+}
+
+
+def run_mc(mc, args, asm, repeat):
+    fd, path = tempfile.mkstemp(suffix='.s')
+    try:
+        with os.fdopen(fd, 'w') as f:
+            f.write(asm)
+        cmd = [mc, '-filetype=obj', '-triple=x86_64-linux-gnu',
+               '-o', os.devnull] + args + [path]
+        best = None
+        for _ in range(repeat):
+            start = time.time()
+            p = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE,
+                                 universal_newlines=True)
+            _, err = p.communicate()
+            elapsed = time.time() - start
+            if p.returncode != 0:
+                sys.exit('error: %s failed:\n%s' % (' '.join(cmd), err))
+            if best is None or elapsed < best:
+                best = elapsed
+        return best
+    finally:
+        os.remove(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('shapes', nargs='*', default=sorted(SHAPES),
+                        help='shapes to measure (default: all)')
+    parser.add_argument('--llvm-mc', default='llvm-mc',
+                        help='llvm-mc binary to run')
+    parser.add_argument('--mc-arg', action='append', default=[],
+                        help='extra argument for llvm-mc, may be repeated')
+    parser.add_argument('--sizes', default='2000,4000,8000,16000',
+                        help='comma separated branch counts')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='report the best of this many runs')
+    parser.add_argument('--threshold', type=float, default=1.3,
+                        help='flag shapes growing faster than n^threshold')
+    parser.add_argument('--min-time', type=float, default=0.01,
+                        help='ignore runs faster than this many seconds')
+    parser.add_argument('--emit', metavar='DIR',
+                        help='write the generated assembly to DIR instead '
+                             'of running llvm-mc')
+    args = parser.parse_args()
+
+    sizes = [int(s) for s in args.sizes.split(',')]
+    if len(sizes) < 2:
+        parser.error('need at least two sizes')
+    for shape in args.shapes:
+        if shape not in SHAPES:
+            parser.error('unknown shape %r' % shape)
+
+    if not args.emit:
+        print('%-10s%s  %6s' % ('shape', ''.join('%10d' % s for s in sizes),
+                                'exp'))
+    for shape in args.shapes:
+        if args.emit:
+            for n in sizes:
+                path = os.path.join(args.emit, '%s-%d.s' % (shape, n))
+                with open(path, 'w') as f:
+                    f.write(SHAPES[shape](n))
+            continue
+        times = [run_mc(args.llvm_mc, args.mc_arg, SHAPES[shape](n),
+                        args.repeat) for n in sizes]
+        exponent = None
+        if times[-2] >= args.min_time and times[-1] >= args.min_time:
+            exponent = (math.log(times[-1] / times[-2]) /
+                        math.log(float(sizes[-1]) / sizes[-2]))
+        cols = ''.join('%10.4f' % t for t in times)
+        exp = '%6.2f' % exponent if exponent is not None else '%6s' % '-'
+        flag = ' <--' if exponent is not None and exponent > args.threshold \
+            else ''
+        print('%-10s%s  %s%s' % (shape, cols, exp, flag))
+
+
+if __name__ == '__main__':
+    main()